@@ -74,6 +74,8 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+@class AFEventSource;
+
 //http请求会话管理类
 @interface AFHTTPSessionManager : AFURLSessionManager <NSSecureCoding, NSCopying>
 
@@ -319,6 +321,127 @@ NS_ASSUME_NONNULL_BEGIN
                          success:(nullable void (^)(NSURLSessionDataTask *task, id _Nullable responseObject))success
                          failure:(nullable void (^)(NSURLSessionDataTask * _Nullable task, NSError *error))failure;
 
+///---------------------------
+/// @name Server-Sent Events
+///---------------------------
+
+/**
+ Creates an event source for a `GET` request to the specified URL. The event source is not connected until it is opened.
+
+ @param URLString The URL string used to create the request URL.
+ @param parameters The parameters to be encoded according to the client request serializer.
+ @param error The error that occurred while constructing the request.
+
+ @return An event source using the receiver, or `nil` if the request could not be constructed.
+ */
+//根据传入的url和参数创建一个服务器推送事件源，打开以后才连接
+- (nullable AFEventSource *)eventSourceWithURLString:(NSString *)URLString
+                                          parameters:(nullable id)parameters
+                                               error:(NSError * _Nullable __autoreleasing *)error;
+
+@end
+
+#pragma mark -
+
+typedef NS_ENUM(NSInteger, AFEventSourceState) {
+    AFEventSourceStateConnecting = 0,
+    AFEventSourceStateOpen       = 1,
+    AFEventSourceStateClosed     = 2,
+};
+
+/**
+ `AFEventSource` receives Server-Sent Events over one long-lived `text/event-stream` connection, replacing periodic polling.
+
+ The response is parsed incrementally in the data task delegate as it arrives. When the connection ends or fails, the event source reconnects after the reconnection interval, sending the last event ID it received in the `Last-Event-ID` header so that the server can resume the stream. If no data, including comment heartbeats, arrives for `heartbeatTimeout`, the connection is considered lost and is re-established. Responses that fail validation, and `204 No Content` responses, close the event source instead.
+
+ An open event source is retained by its connection until it is closed.
+ */
+//通过一个长连接接收服务器推送事件，代替轮询。连接断开后带着Last-Event-ID重连，超过心跳超时没有收到数据时重新连接
+@interface AFEventSource : NSObject
+
+/**
+ Initializes an event source that connects with the specified session manager.
+
+ @param sessionManager The session manager the connection is made with.
+ @param request The request for the event stream. `Accept`, `Cache-Control` and `Last-Event-ID` headers are set on each connection.
+ */
+//使用会话管理类和请求初始化
+- (instancetype)initWithSessionManager:(AFURLSessionManager *)sessionManager
+                               request:(NSURLRequest *)request NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ The session manager the connection is made with.
+ */
+@property (readonly, nonatomic, strong) AFURLSessionManager *sessionManager;
+
+/**
+ The request for the event stream.
+ */
+@property (readonly, nonatomic, copy) NSURLRequest *request;
+
+/**
+ The state of the event source. `AFEventSourceStateClosed` until it is opened.
+ */
+//事件源的状态，打开之前为关闭状态
+@property (readonly, atomic, assign) AFEventSourceState state;
+
+/**
+ The last event ID received, sent in the `Last-Event-ID` header when reconnecting. An `id` field with an empty value resets it to `nil`, and the header is then omitted.
+ */
+//收到的最后一个事件ID，重连时放在Last-Event-ID请求头中。空的id字段会把它重置为nil，重连时不再发送
+@property (readonly, atomic, copy, nullable) NSString *lastEventIdentifier;
+
+/**
+ The time to wait before reconnecting. Updated by the `retry` field of the stream. `3` seconds by default.
+ */
+//重连前等待的时间，流中的retry字段会更新这个值，默认为3秒
+@property (atomic, assign) NSTimeInterval reconnectionInterval;
+
+/**
+ The time without any data after which the connection is considered lost. `0` disables the heartbeat check. `45` seconds by default.
+ */
+//超过多长时间没有收到任何数据时认为连接已经断开，为0时不检查，默认为45秒
+@property (atomic, assign) NSTimeInterval heartbeatTimeout;
+
+/**
+ The queue the handlers are executed on. If `nil`, the main queue is used.
+ */
+//执行各个处理block的队列，为nil时使用主队列
+@property (atomic, strong, nullable) dispatch_queue_t handlerQueue;
+
+/**
+ Sets a block to be executed with each event of the specified type, for example `message` for events without an `event` field.
+ */
+//设置处理指定类型事件的block，没有event字段的事件类型为message
+- (void)setHandler:(nullable void (^)(AFServerSentEvent *event))handler
+      forEventType:(NSString *)type;
+
+/**
+ Sets a block to be executed each time a connection starts receiving data.
+ */
+//设置每次连接开始收到数据时执行的block
+- (void)setOpenHandler:(nullable void (^)(void))handler;
+
+/**
+ Sets a block to be executed when a connection fails. If the event source will reconnect, its state is `AFEventSourceStateConnecting`, otherwise it is `AFEventSourceStateClosed`.
+ */
+//设置连接失败时执行的block，会重连时状态为连接中，否则为关闭
+- (void)setErrorHandler:(nullable void (^)(NSError *error))handler;
+
+/**
+ Connects to the event stream, if the event source is closed.
+ */
+//连接事件流
+- (void)open;
+
+/**
+ Closes the connection and stops reconnecting.
+ */
+//关闭连接，不再重连
+- (void)close;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -373,6 +373,21 @@
     return dataTask;
 }
 
+#pragma mark -
+
+//使用请求序列化对象生成GET请求，创建一个未连接的事件源
+- (AFEventSource *)eventSourceWithURLString:(NSString *)URLString
+                                 parameters:(id)parameters
+                                      error:(NSError *__autoreleasing *)error
+{
+    NSMutableURLRequest *request = [self.requestSerializer requestWithMethod:@"GET" URLString:[[NSURL URLWithString:URLString relativeToURL:self.baseURL] absoluteString] parameters:parameters error:error];
+    if (!request) {
+        return nil;
+    }
+
+    return [[AFEventSource alloc] initWithSessionManager:self request:request];
+}
+
 #pragma mark - NSObject
 
 //重写NSObject的描述函数，拼接类名字，对象指针，完整的url字符串，会话信息，操作队列
@@ -445,3 +460,255 @@
 }
 
 @end
+
+#pragma mark -
+
+@interface AFEventSource ()
+@property (readwrite, nonatomic, strong) AFURLSessionManager *sessionManager;
+@property (readwrite, nonatomic, copy) NSURLRequest *request;
+@property (readwrite, atomic, assign) AFEventSourceState state;
+@property (readwrite, atomic, copy) NSString *lastEventIdentifier;
+//保护状态的串行队列
+@property (readwrite, nonatomic, strong) dispatch_queue_t queue;
+@property (readwrite, nonatomic, strong) NSMutableDictionary *mutableHandlersKeyedByEventType;
+@property (readwrite, atomic, copy) void (^openHandler)(void);
+@property (readwrite, atomic, copy) void (^errorHandler)(NSError *error);
+@property (readwrite, nonatomic, strong) NSURLSessionDataTask *task;
+@property (readwrite, nonatomic, strong) AFServerSentEventParser *parser;
+//每次连接和关闭时递增，用于丢弃旧连接的回调
+@property (readwrite, atomic, assign) NSUInteger generation;
+@property (readwrite, atomic, assign) CFAbsoluteTime lastActivityTime;
+@property (readwrite, nonatomic, strong) dispatch_source_t heartbeatTimer;
+@property (readwrite, nonatomic, assign) BOOL heartbeatTimedOut;
+@end
+
+@implementation AFEventSource
+
+- (instancetype)initWithSessionManager:(AFURLSessionManager *)sessionManager
+                               request:(NSURLRequest *)request
+{
+    NSParameterAssert(sessionManager);
+    NSParameterAssert(request);
+
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.sessionManager = sessionManager;
+    self.request = request;
+    self.state = AFEventSourceStateClosed;
+    self.reconnectionInterval = 3.0;
+    self.heartbeatTimeout = 45.0;
+    self.queue = dispatch_queue_create("com.alamofire.networking.event-source", DISPATCH_QUEUE_SERIAL);
+    self.mutableHandlersKeyedByEventType = [NSMutableDictionary dictionary];
+
+    return self;
+}
+
+- (void)setHandler:(void (^)(AFServerSentEvent *))handler
+      forEventType:(NSString *)type
+{
+    NSParameterAssert(type);
+
+    @synchronized (self.mutableHandlersKeyedByEventType) {
+        self.mutableHandlersKeyedByEventType[type] = [handler copy];
+    }
+}
+
+- (void)open {
+    dispatch_sync(self.queue, ^{
+        if (self.state != AFEventSourceStateClosed) {
+            return;
+        }
+
+        self.state = AFEventSourceStateConnecting;
+        [self connect];
+    });
+}
+
+- (void)close {
+    dispatch_sync(self.queue, ^{
+        self.state = AFEventSourceStateClosed;
+        self.generation++;
+        [self stopHeartbeatTimer];
+        [self.task cancel];
+        self.task = nil;
+        self.parser = nil;
+    });
+}
+
+#pragma mark -
+
+//在queue上建立一个新连接，事件和心跳在会话队列上到达
+- (void)connect {
+    NSMutableURLRequest *mutableRequest = [self.request mutableCopy];
+    mutableRequest.cachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+    [mutableRequest setValue:@"text/event-stream" forHTTPHeaderField:@"Accept"];
+    [mutableRequest setValue:@"no-cache" forHTTPHeaderField:@"Cache-Control"];
+    if (self.lastEventIdentifier) {
+        [mutableRequest setValue:self.lastEventIdentifier forHTTPHeaderField:@"Last-Event-ID"];
+    }
+
+    NSUInteger generation = ++self.generation;
+    __weak __typeof__(self) weakSelf = self;
+    AFServerSentEventParser *parser = [[AFServerSentEventParser alloc] initWithEventHandler:^(AFServerSentEvent *event) {
+        [weakSelf receiveEvent:event generation:generation];
+    }];
+    //事件ID在重连之间保留，没有id字段的事件继续使用之前的ID
+    parser.lastEventIdentifier = self.lastEventIdentifier;
+
+    __block BOOL receivedData = NO;
+    parser.heartbeatHandler = ^{
+        __strong __typeof__(weakSelf) strongSelf = weakSelf;
+        if (!strongSelf) {
+            return;
+        }
+
+        strongSelf.lastActivityTime = CFAbsoluteTimeGetCurrent();
+        if (!receivedData) {
+            receivedData = YES;
+            dispatch_async(strongSelf.queue, ^{
+                [strongSelf connectionDidOpenWithGeneration:generation];
+            });
+        }
+    };
+
+    self.parser = parser;
+    self.heartbeatTimedOut = NO;
+    self.task = [self.sessionManager dataTaskWithRequest:mutableRequest streamParser:parser downloadProgress:nil completionHandler:^(NSURLResponse *response, __unused id responseObject, NSError *error) {
+        dispatch_async(self.queue, ^{
+            [self connectionDidCompleteWithResponse:response error:error parser:parser generation:generation];
+        });
+    }];
+    [self.task resume];
+    [self startHeartbeatTimer];
+}
+
+- (void)connectionDidOpenWithGeneration:(NSUInteger)generation {
+    if (generation != self.generation || self.state != AFEventSourceStateConnecting) {
+        return;
+    }
+
+    self.state = AFEventSourceStateOpen;
+    void (^openHandler)(void) = self.openHandler;
+    if (openHandler) {
+        dispatch_async(self.handlerQueue ?: dispatch_get_main_queue(), ^{
+            if (generation == self.generation) {
+                openHandler();
+            }
+        });
+    }
+}
+
+//按事件类型分发到处理block所在的队列
+- (void)receiveEvent:(AFServerSentEvent *)event generation:(NSUInteger)generation {
+    if (generation != self.generation) {
+        return;
+    }
+
+    //空的id字段重置事件ID，这时事件的ID为nil
+    self.lastEventIdentifier = event.identifier;
+
+    void (^handler)(AFServerSentEvent *) = nil;
+    @synchronized (self.mutableHandlersKeyedByEventType) {
+        handler = self.mutableHandlersKeyedByEventType[event.type];
+    }
+
+    if (handler) {
+        dispatch_async(self.handlerQueue ?: dispatch_get_main_queue(), ^{
+            if (generation == self.generation) {
+                handler(event);
+            }
+        });
+    }
+}
+
+//验证失败和204响应关闭事件源，其他情况在重连间隔之后重连
+- (void)connectionDidCompleteWithResponse:(NSURLResponse *)response
+                                    error:(NSError *)error
+                                   parser:(AFServerSentEventParser *)parser
+                               generation:(NSUInteger)generation
+{
+    if (generation != self.generation || self.state == AFEventSourceStateClosed) {
+        return;
+    }
+
+    [self stopHeartbeatTimer];
+    self.task = nil;
+    self.parser = nil;
+
+    self.lastEventIdentifier = parser.lastEventIdentifier;
+    if (parser.reconnectionInterval > 0) {
+        self.reconnectionInterval = parser.reconnectionInterval;
+    }
+
+    if (self.heartbeatTimedOut) {
+        error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:@{NSLocalizedDescriptionKey: NSLocalizedStringFromTable(@"The event stream did not send any data within the heartbeat timeout.", @"AFNetworking", nil)}];
+    }
+
+    BOOL shouldClose = [error.domain isEqualToString:AFURLResponseSerializationErrorDomain] || ([response isKindOfClass:[NSHTTPURLResponse class]] && [(NSHTTPURLResponse *)response statusCode] == 204);
+    self.state = shouldClose ? AFEventSourceStateClosed : AFEventSourceStateConnecting;
+
+    void (^errorHandler)(NSError *) = self.errorHandler;
+    if (error && errorHandler) {
+        dispatch_async(self.handlerQueue ?: dispatch_get_main_queue(), ^{
+            errorHandler(error);
+        });
+    }
+
+    if (shouldClose) {
+        self.generation++;
+        return;
+    }
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.reconnectionInterval * NSEC_PER_SEC)), self.queue, ^{
+        if (generation == self.generation && self.state == AFEventSourceStateConnecting) {
+            [self connect];
+        }
+    });
+}
+
+#pragma mark - Heartbeat
+
+- (void)startHeartbeatTimer {
+    [self stopHeartbeatTimer];
+
+    NSTimeInterval heartbeatTimeout = self.heartbeatTimeout;
+    if (heartbeatTimeout <= 0) {
+        return;
+    }
+
+    self.lastActivityTime = CFAbsoluteTimeGetCurrent();
+
+    //每隔四分之一的超时时间检查一次
+    uint64_t interval = MAX((uint64_t)(heartbeatTimeout / 4.0 * NSEC_PER_SEC), NSEC_PER_MSEC);
+    dispatch_source_t timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.queue);
+    dispatch_source_set_timer(timer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)interval), interval, interval / 10);
+
+    __weak __typeof__(self) weakSelf = self;
+    dispatch_source_set_event_handler(timer, ^{
+        __strong __typeof__(weakSelf) strongSelf = weakSelf;
+        if (strongSelf.task && CFAbsoluteTimeGetCurrent() - strongSelf.lastActivityTime > heartbeatTimeout) {
+            strongSelf.heartbeatTimedOut = YES;
+            [strongSelf stopHeartbeatTimer];
+            [strongSelf.task cancel];
+        }
+    });
+    dispatch_resume(timer);
+
+    self.heartbeatTimer = timer;
+}
+
+- (void)stopHeartbeatTimer {
+    if (self.heartbeatTimer) {
+        dispatch_source_cancel(self.heartbeatTimer);
+        self.heartbeatTimer = nil;
+    }
+}
+
+- (void)dealloc {
+    [self stopHeartbeatTimer];
+}
+
+@end
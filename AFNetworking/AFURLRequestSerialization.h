@@ -93,6 +93,7 @@ typedef NS_ENUM(NSUInteger, AFHTTPRequestQueryStringSerializationStyle) {
 };
 
 @protocol AFMultipartFormData;
+@class AFUploadDeduplicator, AFURLSessionManager;
 
 /**
  `AFHTTPRequestSerializer` conforms to the `AFURLRequestSerialization` & `AFURLResponseSerialization` protocols, offering a concrete base implementation of query string / URL form-encoded parameter serialization and default request headers, as well as response status code and content type validation.
@@ -304,6 +305,50 @@ forHTTPHeaderField:(NSString *)field;
                              writingStreamContentsToFile:(NSURL *)fileURL
                                        completionHandler:(nullable void (^)(NSError * _Nullable error))handler;
 
+/**
+ Creates an `NSMutableURLRequest` by removing the `HTTPBodyStream` from a request, and asynchronously writing its contents into the specified file, reporting progress and invoking the completion handler when finished.
+
+ Requests created by `multipartFormRequestWithMethod:URLString:parameters:constructingBodyWithBlock:error:` are written with large vectored writes, taking file parts directly from memory-mapped files, instead of being pumped through a stream.
+
+ @param request The multipart form request. The `HTTPBodyStream` property of `request` must not be `nil`.
+ @param fileURL The file URL to write multipart form contents to.
+ @param progressBlock A block object to be executed on the main queue as the contents are written. The progress may be cancelled to stop writing, in which case the partially written file is removed and the completion handler receives an `NSURLErrorCancelled` error.
+ @param handler A handler block to execute on the main queue.
+ */
+//同上，并且在主队列中回调写入进度，可以通过取消进度来停止写入
+- (NSMutableURLRequest *)requestWithMultipartFormRequest:(NSURLRequest *)request
+                             writingStreamContentsToFile:(NSURL *)fileURL
+                                                progress:(nullable void (^)(NSProgress *writingProgress))progressBlock
+                                       completionHandler:(nullable void (^)(NSError * _Nullable error))handler;
+
+/**
+ Creates an `NSMutableURLRequest` that continues uploading the multipart form body of the specified request from an offset the server has confirmed.
+
+ The returned request reuses the encoded boundaries and headers of the original body, skips the parts before `offset` without opening their files, and seeks into the part containing `offset`. Its `Content-Length` is the number of remaining bytes, and a `Content-Range: bytes offset-last/total` header describes the position of those bytes in the whole body. Only use it with servers that accept `Content-Range` on upload requests.
+
+ @param request The multipart form request created by `multipartFormRequestWithMethod:URLString:parameters:constructingBodyWithBlock:error:`.
+ @param offset The number of bytes of the body the server has already received.
+
+ @return The resumed request, or `nil` if the body of `request` is not a multipart form body or `offset` is past its end.
+ */
+//从服务器确认收到的位置继续上传multipart body，之前的数据不再发送
+- (nullable NSMutableURLRequest *)requestWithMultipartFormRequest:(NSURLRequest *)request
+                                               resumingFromOffset:(unsigned long long)offset;
+
+/**
+ Asynchronously creates an `NSMutableURLRequest` from a multipart form request, replacing the contents of file parts the server already has with references.
+
+ The contents of each file part are hashed with SHA-256 and looked up with `deduplicator`, through its `sessionManager`. Parts found on the server are sent without a body, with the hex digest in the `digestHeaderField` header of the part. The `Content-Length` of the request is updated accordingly. Parts that cannot be looked up are sent in full.
+
+ @param request The multipart form request created by `multipartFormRequestWithMethod:URLString:parameters:constructingBodyWithBlock:error:`.
+ @param deduplicator The deduplicator used to look up the contents of the file parts.
+ @param handler A handler block to execute on the main queue, with the deduplicated request.
+ */
+//异步计算文件part内容的摘要并查询服务器，服务器已有的part只发送摘要作为引用，不发送内容
+- (void)deduplicateFilePartsOfMultipartFormRequest:(NSURLRequest *)request
+                                  withDeduplicator:(AFUploadDeduplicator *)deduplicator
+                                 completionHandler:(void (^)(NSMutableURLRequest *request))handler;
+
 @end
 
 #pragma mark -
@@ -404,6 +449,8 @@ forHTTPHeaderField:(NSString *)field;
 
  When uploading over a 3G or EDGE connection, requests may fail with "request body stream exhausted". Setting a maximum packet size and delay according to the recommended values (`kAFUploadStream3GSuggestedPacketSize` and `kAFUploadStream3GSuggestedDelay`) lowers the risk of the input stream exceeding its allocated bandwidth. Unfortunately, there is no definite way to distinguish between a 3G, EDGE, or LTE connection over `NSURLConnection`. As such, it is not recommended that you throttle bandwidth based solely on network reachability. Instead, you should consider checking for the "request body stream exhausted" in a failure block, and then retrying the request with throttled bandwidth.
 
+ The delay blocks the thread that reads the upload stream and only applies to this request. To limit the total bandwidth of all requests of a manager without blocking, use the `bandwidthLimiter` of `AFURLSessionManager` instead.
+
  @param numberOfBytes Maximum packet size, in number of bytes. The default packet size for an input stream is 16kb.
  @param delay Duration of delay each time a packet is read. By default, no delay is set.
  */
@@ -416,7 +463,9 @@ forHTTPHeaderField:(NSString *)field;
 #pragma mark -
 
 /**
- `AFJSONRequestSerializer` is a subclass of `AFHTTPRequestSerializer` that encodes parameters as JSON using `NSJSONSerialization`, setting the `Content-Type` of the encoded request to `application/json`.
+ `AFJSONRequestSerializer` is a subclass of `AFHTTPRequestSerializer` that encodes parameters as JSON, setting the `Content-Type` of the encoded request to `application/json`.
+
+ With the default `writingOptions`, parameters are validated and encoded in a single traversal by a built-in writer, producing output equivalent to that of `NSJSONSerialization`. Any other writing options are handled by `NSJSONSerialization`.
  */
 //AFHTTPRequestSerializer的子类，数据编码的时候使用NSJSONSerialization编码，
 //并且设置‘Content-Type’为‘application/json’
@@ -428,6 +477,12 @@ forHTTPHeaderField:(NSString *)field;
 //写josn的方法
 @property (nonatomic, assign) NSJSONWritingOptions writingOptions;
 
+/**
+ Whether the encoded parameters are provided as the request's `HTTPBodyStream` instead of its `HTTPBody`. The parameters are validated and measured when the request is created, so invalid parameters still produce an error and a `Content-Length` header is set, and are then encoded chunk by chunk while the body is read, so large payloads are never fully held in memory. The parameters must not be mutated until the request has been sent. Only applies when `writingOptions` is `0`. `NO` by default.
+ */
+//是否通过HTTPBodyStream边编码边上传，而不是一次生成整个HTTPBody
+@property (nonatomic, assign) BOOL streamsHTTPBody;
+
 /**
  Creates and returns a JSON serializer with specified reading and writing options.
 
@@ -475,6 +530,127 @@ forHTTPHeaderField:(NSString *)field;
 
 #pragma mark -
 
+/**
+ `AFMessagePackRequestSerializer` is a subclass of `AFHTTPRequestSerializer` that encodes parameters as MessagePack, setting the `Content-Type` of the encoded request to `application/msgpack`.
+
+ Parameters may contain `NSDictionary`, `NSArray`, `NSString`, `NSNumber`, `NSNull`, `NSData`, which is encoded as binary, and `NSDate`, which is encoded with the timestamp extension type. Integers are written in their smallest encoding. `NSDecimalNumber` values are written as strings so that they keep their precision.
+ */
+//AFHTTPRequestSerializer的子类，参数编码为MessagePack，
+//并且设置‘Content-Type’为‘application/msgpack’
+@interface AFMessagePackRequestSerializer : AFHTTPRequestSerializer
+
+@end
+
+#pragma mark -
+
+/**
+ `AFCBORRequestSerializer` is a subclass of `AFHTTPRequestSerializer` that encodes parameters as CBOR (RFC 7049), setting the `Content-Type` of the encoded request to `application/cbor`.
+
+ Parameters may contain `NSDictionary`, `NSArray`, `NSString`, `NSNumber`, `NSNull`, `NSData`, which is encoded as a byte string, and `NSDate`, which is encoded as an epoch-based date (tag 1). Integers are written in their smallest encoding. `NSDecimalNumber` values are written as text strings so that they keep their precision.
+ */
+//AFHTTPRequestSerializer的子类，参数编码为CBOR，
+//并且设置‘Content-Type’为‘application/cbor’
+@interface AFCBORRequestSerializer : AFHTTPRequestSerializer
+
+@end
+
+#pragma mark -
+
+/**
+ `AFUploadDeduplicator` avoids uploading contents the server already has. Contents are identified by their SHA-256 digest, calculated in a streaming pass, and looked up with a `HEAD` request to the lookup URL followed by the hex digest. A successful response means the server has the contents, and a `404` response means it does not.
+
+ Digests confirmed by the server, or uploaded in full, are kept in a least-recently-used cache so that repeated uploads skip the lookup.
+ */
+//按内容的SHA-256摘要去重上传，向服务器查询内容是否已经存在，最近确认过的摘要保存在LRU缓存中，不再查询
+@interface AFUploadDeduplicator : NSObject
+
+/**
+ The URL the hex digest is appended to as a path component to look up contents.
+ */
+//查询地址，摘要作为路径的最后一部分
+@property (readonly, nonatomic, copy) NSURL *lookupURL;
+
+/**
+ The session manager that sends the lookup requests of `lookUpFileAtURL:completionHandler:`, so that they use its session configuration, security policy and authentication challenge blocks. If `nil` (default), files are only looked up in the cache.
+ */
+//发送查询请求的会话管理对象，查询使用它的会话配置、安全策略和认证回调。为nil时只查询缓存
+@property (nonatomic, strong, nullable) AFURLSessionManager *sessionManager;
+
+/**
+ The header field that carries the hex digest of uploaded contents and references. `X-Content-SHA256` by default.
+ */
+//上传内容和引用中携带摘要的头信息，默认为`X-Content-SHA256`
+@property (nonatomic, copy) NSString *digestHeaderField;
+
+/**
+ The maximum number of digests kept in the cache. `1024` by default.
+ */
+//缓存的最大摘要数，默认为1024
+@property (nonatomic, assign) NSUInteger maximumNumberOfCachedDigests;
+
+/**
+ The total number of bytes that were not uploaded because the server already had them.
+ */
+//因为服务器已有而没有上传的总字节数
+@property (readonly, nonatomic, assign) int64_t numberOfBytesSaved;
+
+/**
+ Initializes a deduplicator with the specified lookup URL.
+ */
+//使用查询地址初始化
+- (instancetype)initWithLookupURL:(NSURL *)lookupURL;
+
+/**
+ Returns the lowercase hex SHA-256 digest of the contents of a file, reading it in a single streaming pass.
+ */
+//流式读取文件，返回内容的SHA-256摘要的小写十六进制字符串
++ (nullable NSString *)SHA256DigestOfFileAtURL:(NSURL *)fileURL
+                                         error:(NSError * _Nullable __autoreleasing *)error;
+
+/**
+ Calculates the digest of a file on a background queue and looks it up with `sessionManager`, using the cache first.
+
+ @param fileURL The file to look up.
+ @param handler A block called on a background queue with the digest, whether the server has the contents, and the error that occurred, if any.
+ */
+//在后台计算文件摘要并通过sessionManager查询，优先使用缓存
+- (void)lookUpFileAtURL:(NSURL *)fileURL
+      completionHandler:(void (^)(NSString * _Nullable digest, BOOL exists, NSError * _Nullable error))handler;
+
+/**
+ Calculates the digest of a file on a background queue and looks it up with the specified session manager, using the cache first.
+
+ @param fileURL The file to look up.
+ @param sessionManager The session manager that sends the lookup request, or `nil` to only look up the cache.
+ @param handler A block called on a background queue with the digest, whether the server has the contents, and the error that occurred, if any.
+ */
+//在后台计算文件摘要并通过指定的会话管理对象查询，优先使用缓存
+- (void)lookUpFileAtURL:(NSURL *)fileURL
+         sessionManager:(nullable AFURLSessionManager *)sessionManager
+      completionHandler:(void (^)(NSString * _Nullable digest, BOOL exists, NSError * _Nullable error))handler;
+
+/**
+ Records that the server has the contents with the specified digest, for example after they were uploaded in full.
+ */
+//记录服务器已有某个摘要的内容，例如完整上传之后
+- (void)cacheDigest:(NSString *)digest;
+
+/**
+ Returns whether the cache contains the specified digest.
+ */
+//缓存中是否有某个摘要
+- (BOOL)hasCachedDigest:(NSString *)digest;
+
+/**
+ Adds bytes to `numberOfBytesSaved`.
+ */
+//增加节省的字节数
+- (void)addNumberOfBytesSaved:(int64_t)numberOfBytes;
+
+@end
+
+#pragma mark -
+
 ///----------------
 /// @name Constants
 ///----------------
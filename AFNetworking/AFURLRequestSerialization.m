@@ -20,6 +20,7 @@
 // THE SOFTWARE.
 
 #import "AFURLRequestSerialization.h"
+#import "AFURLSessionManager.h"
 
 #if TARGET_OS_IOS || TARGET_OS_WATCH || TARGET_OS_TV
 #import <MobileCoreServices/MobileCoreServices.h>
@@ -27,6 +28,11 @@
 #import <CoreServices/CoreServices.h>
 #endif
 
+#import <CommonCrypto/CommonDigest.h>
+#import <fcntl.h>
+#import <sys/uio.h>
+#import <xlocale.h>
+
 NSString * const AFURLRequestSerializationErrorDomain = @"com.alamofire.error.serialization.request";
 NSString * const AFNetworkingOperationFailingURLRequestErrorKey = @"com.alamofire.serialization.request.error.response";
 
@@ -197,6 +203,29 @@ NSArray * AFQueryStringPairsFromKeyAndValue(NSString *key, id value) {
 
 #pragma mark -
 
+//将请求的body流写入文件
+@interface AFMultipartBodySpooler : NSObject
+//写入进度，可以取消
+@property (readonly, nonatomic, strong) NSProgress *progress;
+//在主队列中回调的进度block
+@property (nonatomic, copy) void (^progressBlock)(NSProgress *writingProgress);
+
+//根据body流和目标文件初始化
+- (instancetype)initWithInputStream:(NSInputStream *)inputStream
+                            fileURL:(NSURL *)fileURL;
+
+//写入文件，失败或者被取消时删除写了一半的文件
+- (BOOL)spool:(NSError * __autoreleasing *)error;
+@end
+
+//计算multipart请求中文件part的摘要并查询服务器，服务器已有的part只发送摘要，在主队列中回调去重后的请求
+static void AFDeduplicateFilePartsOfMultipartFormRequest(NSURLRequest *request, AFUploadDeduplicator *deduplicator, void (^handler)(NSMutableURLRequest *request));
+
+//返回从offset开始读取multipart body的新流，不是multipart body或者offset超出长度时返回nil
+static NSInputStream * AFMultipartBodyStreamBySeekingToOffset(NSInputStream *bodyStream, unsigned long long offset, unsigned long long *contentLength);
+
+#pragma mark -
+
 //http请求序列化Observed的key路径
 static NSArray * AFHTTPRequestSerializerObservedKeyPaths() {
     static NSArray *_AFHTTPRequestSerializerObservedKeyPaths = nil;
@@ -208,17 +237,113 @@ static NSArray * AFHTTPRequestSerializerObservedKeyPaths() {
     return _AFHTTPRequestSerializerObservedKeyPaths;
 }
 
-//用来设置key value Observer的context
-static void *AFHTTPRequestSerializerObserverContext = &AFHTTPRequestSerializerObserverContext;
+//被显式设置过的请求属性，只有设置过的属性才会被写入生成的request
+typedef NS_OPTIONS(NSUInteger, AFHTTPRequestSerializerRequestProperties) {
+    AFHTTPRequestSerializerAllowsCellularAccessProperty    = 1 << 0,
+    AFHTTPRequestSerializerCachePolicyProperty             = 1 << 1,
+    AFHTTPRequestSerializerHTTPShouldHandleCookiesProperty = 1 << 2,
+    AFHTTPRequestSerializerHTTPShouldUsePipeliningProperty = 1 << 3,
+    AFHTTPRequestSerializerNetworkServiceTypeProperty      = 1 << 4,
+    AFHTTPRequestSerializerTimeoutIntervalProperty         = 1 << 5,
+};
+
+#pragma mark -
+
+//请求序列化配置的不可变快照。只在setter修改配置时重新生成，生成请求时直接读取，不需要切换队列也不需要KVC
+@interface AFHTTPRequestSerializerSnapshot : NSObject
+//请求头信息（不可变）
+@property (readonly, nonatomic, copy) NSDictionary *HTTPRequestHeaders;
+
+- (instancetype)initWithHTTPRequestHeaders:(NSDictionary *)headers
+                         changedProperties:(AFHTTPRequestSerializerRequestProperties)changedProperties
+                         requestSerializer:(AFHTTPRequestSerializer *)serializer;
+
+//将设置过的请求属性写入request
+- (void)applyRequestPropertiesToRequest:(NSMutableURLRequest *)request;
+//将默认请求头合并到request中，request中已经存在的头保持不变
+- (void)applyHTTPRequestHeadersToRequest:(NSMutableURLRequest *)request;
+@end
+
+@implementation AFHTTPRequestSerializerSnapshot {
+    AFHTTPRequestSerializerRequestProperties _changedProperties;
+    BOOL _allowsCellularAccess;
+    NSURLRequestCachePolicy _cachePolicy;
+    BOOL _HTTPShouldHandleCookies;
+    BOOL _HTTPShouldUsePipelining;
+    NSURLRequestNetworkServiceType _networkServiceType;
+    NSTimeInterval _timeoutInterval;
+}
+
+- (instancetype)initWithHTTPRequestHeaders:(NSDictionary *)headers
+                         changedProperties:(AFHTTPRequestSerializerRequestProperties)changedProperties
+                         requestSerializer:(AFHTTPRequestSerializer *)serializer
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _HTTPRequestHeaders = [headers copy] ?: @{};
+    _changedProperties = changedProperties;
+    _allowsCellularAccess = serializer.allowsCellularAccess;
+    _cachePolicy = serializer.cachePolicy;
+    _HTTPShouldHandleCookies = serializer.HTTPShouldHandleCookies;
+    _HTTPShouldUsePipelining = serializer.HTTPShouldUsePipelining;
+    _networkServiceType = serializer.networkServiceType;
+    _timeoutInterval = serializer.timeoutInterval;
+
+    return self;
+}
+
+- (void)applyRequestPropertiesToRequest:(NSMutableURLRequest *)request {
+    if (_changedProperties == 0) {
+        return;
+    }
+
+    if (_changedProperties & AFHTTPRequestSerializerAllowsCellularAccessProperty) {
+        request.allowsCellularAccess = _allowsCellularAccess;
+    }
+    if (_changedProperties & AFHTTPRequestSerializerCachePolicyProperty) {
+        request.cachePolicy = _cachePolicy;
+    }
+    if (_changedProperties & AFHTTPRequestSerializerHTTPShouldHandleCookiesProperty) {
+        request.HTTPShouldHandleCookies = _HTTPShouldHandleCookies;
+    }
+    if (_changedProperties & AFHTTPRequestSerializerHTTPShouldUsePipeliningProperty) {
+        request.HTTPShouldUsePipelining = _HTTPShouldUsePipelining;
+    }
+    if (_changedProperties & AFHTTPRequestSerializerNetworkServiceTypeProperty) {
+        request.networkServiceType = _networkServiceType;
+    }
+    if (_changedProperties & AFHTTPRequestSerializerTimeoutIntervalProperty) {
+        request.timeoutInterval = _timeoutInterval;
+    }
+}
+
+- (void)applyHTTPRequestHeadersToRequest:(NSMutableURLRequest *)request {
+    //新建的request没有任何头信息，直接整体赋值，省去逐个查询
+    if ([request.allHTTPHeaderFields count] == 0) {
+        request.allHTTPHeaderFields = self.HTTPRequestHeaders;
+        return;
+    }
+
+    [self.HTTPRequestHeaders enumerateKeysAndObjectsUsingBlock:^(id field, id value, BOOL * __unused stop) {
+        if (![request valueForHTTPHeaderField:field]) {
+            [request setValue:value forHTTPHeaderField:field];
+        }
+    }];
+}
+
+@end
+
+#pragma mark -
 
 //声明AFHTTPRequestSerializer类，遵循AFURLRequestSerialization协议
 @interface AFHTTPRequestSerializer ()
-/*这个就是用来存放具体的那个属性发生了变化，也就是当
-- (void)observeValueForKeyPath:(NSString *)keyPath
-                      ofObject:(__unused id)object
-                        change:(NSDictionary *)change
-                       context:(void *)context 被调用的时候，检测值是否发生变化，将发生变化的keyPath添加到集合中，当然如果新值为nil的话，需要从集合中删除掉*/
-@property (readwrite, nonatomic, strong) NSMutableSet *mutableObservedChangedKeyPaths;
+//被显式设置过的请求属性，只在requestHeaderModificationQueue中修改
+@property (readwrite, nonatomic, assign) AFHTTPRequestSerializerRequestProperties changedRequestProperties;
+//当前配置的快照，修改时整体替换（atomic保证读取的线程安全）
+@property (readwrite, atomic, strong) AFHTTPRequestSerializerSnapshot *snapshot;
 //请求的头信息
 @property (readwrite, nonatomic, strong) NSMutableDictionary *mutableHTTPRequestHeaders;
 //为修改请求头时而专门创建的队列
@@ -250,6 +375,8 @@ static void *AFHTTPRequestSerializerObserverContext = &AFHTTPRequestSerializerOb
     self.mutableHTTPRequestHeaders = [NSMutableDictionary dictionary];
     //初始化修改头信息队列
     self.requestHeaderModificationQueue = dispatch_queue_create("requestHeaderModificationQueue", DISPATCH_QUEUE_CONCURRENT);
+    //生成初始快照
+    self.snapshot = [[AFHTTPRequestSerializerSnapshot alloc] initWithHTTPRequestHeaders:self.mutableHTTPRequestHeaders changedProperties:0 requestSerializer:self];
 
     // Accept-Language HTTP Header; see http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.4
     NSMutableArray *acceptLanguagesComponents = [NSMutableArray array];
@@ -287,26 +414,9 @@ static void *AFHTTPRequestSerializerObserverContext = &AFHTTPRequestSerializerOb
     // HTTP Method Definitions; see http://www.w3.org/Protocols/rfc2616/rfc2616-sec9.html
     self.HTTPMethodsEncodingParametersInURI = [NSSet setWithObjects:@"GET", @"HEAD", @"DELETE", nil];
 
-    //添加key value Observer
-    self.mutableObservedChangedKeyPaths = [NSMutableSet set];
-    for (NSString *keyPath in AFHTTPRequestSerializerObservedKeyPaths()) {
-        if ([self respondsToSelector:NSSelectorFromString(keyPath)]) {
-            [self addObserver:self forKeyPath:keyPath options:NSKeyValueObservingOptionNew context:AFHTTPRequestSerializerObserverContext];
-        }
-    }
-
     return self;
 }
 
-- (void)dealloc {
-    //移除key value Observer
-    for (NSString *keyPath in AFHTTPRequestSerializerObservedKeyPaths()) {
-        if ([self respondsToSelector:NSSelectorFromString(keyPath)]) {
-            [self removeObserver:self forKeyPath:keyPath context:AFHTTPRequestSerializerObserverContext];
-        }
-    }
-}
-
 #pragma mark -
 
 // Workarounds for crashing behavior using Key-Value Observing with XCTest
@@ -317,6 +427,7 @@ static void *AFHTTPRequestSerializerObserverContext = &AFHTTPRequestSerializerOb
     [self willChangeValueForKey:NSStringFromSelector(@selector(allowsCellularAccess))];
     _allowsCellularAccess = allowsCellularAccess;
     [self didChangeValueForKey:NSStringFromSelector(@selector(allowsCellularAccess))];
+    [self markRequestPropertyAsChanged:AFHTTPRequestSerializerAllowsCellularAccessProperty];
 }
 
 //willChangeValueForKey didChangeValueForKey 手动触发kvo机制
@@ -324,6 +435,7 @@ static void *AFHTTPRequestSerializerObserverContext = &AFHTTPRequestSerializerOb
     [self willChangeValueForKey:NSStringFromSelector(@selector(cachePolicy))];
     _cachePolicy = cachePolicy;
     [self didChangeValueForKey:NSStringFromSelector(@selector(cachePolicy))];
+    [self markRequestPropertyAsChanged:AFHTTPRequestSerializerCachePolicyProperty];
 }
 
 //willChangeValueForKey didChangeValueForKey 手动触发kvo机制
@@ -331,6 +443,7 @@ static void *AFHTTPRequestSerializerObserverContext = &AFHTTPRequestSerializerOb
     [self willChangeValueForKey:NSStringFromSelector(@selector(HTTPShouldHandleCookies))];
     _HTTPShouldHandleCookies = HTTPShouldHandleCookies;
     [self didChangeValueForKey:NSStringFromSelector(@selector(HTTPShouldHandleCookies))];
+    [self markRequestPropertyAsChanged:AFHTTPRequestSerializerHTTPShouldHandleCookiesProperty];
 }
 
 //willChangeValueForKey didChangeValueForKey 手动触发kvo机制
@@ -338,6 +451,7 @@ static void *AFHTTPRequestSerializerObserverContext = &AFHTTPRequestSerializerOb
     [self willChangeValueForKey:NSStringFromSelector(@selector(HTTPShouldUsePipelining))];
     _HTTPShouldUsePipelining = HTTPShouldUsePipelining;
     [self didChangeValueForKey:NSStringFromSelector(@selector(HTTPShouldUsePipelining))];
+    [self markRequestPropertyAsChanged:AFHTTPRequestSerializerHTTPShouldUsePipeliningProperty];
 }
 
 //willChangeValueForKey didChangeValueForKey 手动触发kvo机制
@@ -345,6 +459,7 @@ static void *AFHTTPRequestSerializerObserverContext = &AFHTTPRequestSerializerOb
     [self willChangeValueForKey:NSStringFromSelector(@selector(networkServiceType))];
     _networkServiceType = networkServiceType;
     [self didChangeValueForKey:NSStringFromSelector(@selector(networkServiceType))];
+    [self markRequestPropertyAsChanged:AFHTTPRequestSerializerNetworkServiceTypeProperty];
 }
 
 //willChangeValueForKey didChangeValueForKey 手动触发kvo机制
@@ -352,37 +467,51 @@ static void *AFHTTPRequestSerializerObserverContext = &AFHTTPRequestSerializerOb
     [self willChangeValueForKey:NSStringFromSelector(@selector(timeoutInterval))];
     _timeoutInterval = timeoutInterval;
     [self didChangeValueForKey:NSStringFromSelector(@selector(timeoutInterval))];
+    [self markRequestPropertyAsChanged:AFHTTPRequestSerializerTimeoutIntervalProperty];
 }
 
 #pragma mark -
-//返回http请求的头信息
-- (NSDictionary *)HTTPRequestHeaders {
-    NSDictionary __block *value;
-    //同步线程，阻塞当前线程，等block完成后继续
-    dispatch_sync(self.requestHeaderModificationQueue, ^{
-        value = [NSDictionary dictionaryWithDictionary:self.mutableHTTPRequestHeaders];
+
+//重新生成快照，必须在requestHeaderModificationQueue的栅栏中调用
+- (void)rebuildSnapshot {
+    self.snapshot = [[AFHTTPRequestSerializerSnapshot alloc] initWithHTTPRequestHeaders:self.mutableHTTPRequestHeaders changedProperties:self.changedRequestProperties requestSerializer:self];
+}
+
+//记录被设置过的请求属性，并重新生成快照
+- (void)markRequestPropertyAsChanged:(AFHTTPRequestSerializerRequestProperties)property {
+    dispatch_barrier_sync(self.requestHeaderModificationQueue, ^{
+        self.changedRequestProperties |= property;
+        [self rebuildSnapshot];
+    });
+}
+
+//整体替换请求头，并重新生成快照
+- (void)replaceHTTPRequestHeaders:(NSDictionary *)headers {
+    dispatch_barrier_sync(self.requestHeaderModificationQueue, ^{
+        self.mutableHTTPRequestHeaders = [headers mutableCopy];
+        [self rebuildSnapshot];
     });
-    return value;
+}
+
+//返回http请求的头信息，直接返回快照中的不可变字典，不需要拷贝
+- (NSDictionary *)HTTPRequestHeaders {
+    return self.snapshot.HTTPRequestHeaders;
 }
 
 //使用key value设置http的头信息
 - (void)setValue:(NSString *)value
 forHTTPHeaderField:(NSString *)field
 {
-    //毫无疑问,dispatch_barrier_async函数的作用与barrier的意思相同,在进程管理中起到一个栅栏的作用,它等待所有位于barrier函数之前的操作执行完毕后执行,并且在barrier函数执行之后,barrier函数之后的操作才会得到执行,该函数需要同dispatch_queue_create函数生成的concurrent Dispatch Queue队列一起使用
-    dispatch_barrier_async(self.requestHeaderModificationQueue, ^{
+    //栅栏函数同步执行，保证修改完成返回后，之后生成的请求一定能读到新的快照
+    dispatch_barrier_sync(self.requestHeaderModificationQueue, ^{
         [self.mutableHTTPRequestHeaders setValue:value forKey:field];
+        [self rebuildSnapshot];
     });
 }
 
 //根据传入的key值  返回http头信息中对应的value
 - (NSString *)valueForHTTPHeaderField:(NSString *)field {
-    NSString __block *value;
-    //同步线程，阻塞当前线程，等block完成后继续
-    dispatch_sync(self.requestHeaderModificationQueue, ^{
-        value = [self.mutableHTTPRequestHeaders valueForKey:field];
-    });
-    return value;
+    return self.snapshot.HTTPRequestHeaders[field];
 }
 
 //使用Base64编码的用户名，密码填充Authorization HTTP头，这个方法将覆盖之前设置的这个Header
@@ -396,8 +525,9 @@ forHTTPHeaderField:(NSString *)field
 
 - (void)clearAuthorizationHeader {
     //栅栏函数，等待栅栏之前的操作执行完毕后执行，并且处于栅栏函数后的方法，需要等待栅栏函数执行完成后执行
-    dispatch_barrier_async(self.requestHeaderModificationQueue, ^{
+    dispatch_barrier_sync(self.requestHeaderModificationQueue, ^{
         [self.mutableHTTPRequestHeaders removeObjectForKey:@"Authorization"];
+        [self rebuildSnapshot];
     });
 }
 
@@ -430,11 +560,8 @@ forHTTPHeaderField:(NSString *)field
     NSMutableURLRequest *mutableRequest = [[NSMutableURLRequest alloc] initWithURL:url];
     mutableRequest.HTTPMethod = method;
 
-    for (NSString *keyPath in AFHTTPRequestSerializerObservedKeyPaths()) {
-        if ([self.mutableObservedChangedKeyPaths containsObject:keyPath]) {
-            [mutableRequest setValue:[self valueForKeyPath:keyPath] forKey:keyPath];
-        }
-    }
+    //从快照中读取设置过的请求属性
+    [self.snapshot applyRequestPropertiesToRequest:mutableRequest];
 
     mutableRequest = [[self requestBySerializingRequest:mutableRequest withParameters:parameters error:error] mutableCopy];
 
@@ -486,45 +613,25 @@ forHTTPHeaderField:(NSString *)field
 - (NSMutableURLRequest *)requestWithMultipartFormRequest:(NSURLRequest *)request
                              writingStreamContentsToFile:(NSURL *)fileURL
                                        completionHandler:(void (^)(NSError *error))handler
+{
+    return [self requestWithMultipartFormRequest:request writingStreamContentsToFile:fileURL progress:nil completionHandler:handler];
+}
+
+- (NSMutableURLRequest *)requestWithMultipartFormRequest:(NSURLRequest *)request
+                             writingStreamContentsToFile:(NSURL *)fileURL
+                                                progress:(void (^)(NSProgress *writingProgress))progressBlock
+                                       completionHandler:(void (^)(NSError *error))handler
 {
     NSParameterAssert(request.HTTPBodyStream);
     NSParameterAssert([fileURL isFileURL]);
 
-    NSInputStream *inputStream = request.HTTPBodyStream;
-    NSOutputStream *outputStream = [[NSOutputStream alloc] initWithURL:fileURL append:NO];
-    __block NSError *error = nil;
+    AFMultipartBodySpooler *spooler = [[AFMultipartBodySpooler alloc] initWithInputStream:request.HTTPBodyStream fileURL:fileURL];
+    spooler.progressBlock = progressBlock;
 
-    //异步请求
+    //异步将body写入文件
     dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        //将输入流中的数据读取到输出流中
-        [inputStream scheduleInRunLoop:[NSRunLoop currentRunLoop] forMode:NSDefaultRunLoopMode];
-        [outputStream scheduleInRunLoop:[NSRunLoop currentRunLoop] forMode:NSDefaultRunLoopMode];
-
-        [inputStream open];
-        [outputStream open];
-
-        while ([inputStream hasBytesAvailable] && [outputStream hasSpaceAvailable]) {
-            uint8_t buffer[1024];
-
-            NSInteger bytesRead = [inputStream read:buffer maxLength:1024];
-            if (inputStream.streamError || bytesRead < 0) {
-                error = inputStream.streamError;
-                break;
-            }
-
-            NSInteger bytesWritten = [outputStream write:buffer maxLength:(NSUInteger)bytesRead];
-            if (outputStream.streamError || bytesWritten < 0) {
-                error = outputStream.streamError;
-                break;
-            }
-
-            if (bytesRead == 0 && bytesWritten == 0) {
-                break;
-            }
-        }
-
-        [outputStream close];
-        [inputStream close];
+        NSError *error = nil;
+        [spooler spool:&error];
 
         if (handler) {
             //异步回调
@@ -540,6 +647,41 @@ forHTTPHeaderField:(NSString *)field
     return mutableRequest;
 }
 
+- (NSMutableURLRequest *)requestWithMultipartFormRequest:(NSURLRequest *)request
+                                      resumingFromOffset:(unsigned long long)offset
+{
+    NSParameterAssert(request.HTTPBodyStream);
+
+    unsigned long long contentLength = 0;
+    NSInputStream *bodyStream = AFMultipartBodyStreamBySeekingToOffset(request.HTTPBodyStream, offset, &contentLength);
+    if (!bodyStream) {
+        return nil;
+    }
+
+    NSMutableURLRequest *mutableRequest = [request mutableCopy];
+    mutableRequest.HTTPBodyStream = bodyStream;
+    [mutableRequest setValue:[NSString stringWithFormat:@"%llu", contentLength - offset] forHTTPHeaderField:@"Content-Length"];
+    //整个body已经被确认时，按照RFC 7233用*表示没有要发送的范围
+    if (offset < contentLength) {
+        [mutableRequest setValue:[NSString stringWithFormat:@"bytes %llu-%llu/%llu", offset, contentLength - 1, contentLength] forHTTPHeaderField:@"Content-Range"];
+    } else {
+        [mutableRequest setValue:[NSString stringWithFormat:@"bytes */%llu", contentLength] forHTTPHeaderField:@"Content-Range"];
+    }
+
+    return mutableRequest;
+}
+
+- (void)deduplicateFilePartsOfMultipartFormRequest:(NSURLRequest *)request
+                                  withDeduplicator:(AFUploadDeduplicator *)deduplicator
+                                 completionHandler:(void (^)(NSMutableURLRequest *request))handler
+{
+    NSParameterAssert(request.HTTPBodyStream);
+    NSParameterAssert(deduplicator);
+    NSParameterAssert(handler);
+
+    AFDeduplicateFilePartsOfMultipartFormRequest(request, deduplicator, handler);
+}
+
 #pragma mark - AFURLRequestSerialization
 
 - (NSURLRequest *)requestBySerializingRequest:(NSURLRequest *)request
@@ -551,11 +693,7 @@ forHTTPHeaderField:(NSString *)field
     NSMutableURLRequest *mutableRequest = [request mutableCopy];
 
     //使用HTTPRequestHeaders设置mutableRequest的header
-    [self.HTTPRequestHeaders enumerateKeysAndObjectsUsingBlock:^(id field, id value, BOOL * __unused stop) {
-        if (![request valueForHTTPHeaderField:field]) {
-            [mutableRequest setValue:value forHTTPHeaderField:field];
-        }
-    }];
+    [self.snapshot applyHTTPRequestHeadersToRequest:mutableRequest];
 
     NSString *query = nil;
     //获取序列化字符串
@@ -611,21 +749,6 @@ forHTTPHeaderField:(NSString *)field
     return [super automaticallyNotifiesObserversForKey:key];
 }
 
-//key value Observed的响应回调函数
-- (void)observeValueForKeyPath:(NSString *)keyPath
-                      ofObject:(__unused id)object
-                        change:(NSDictionary *)change
-                       context:(void *)context
-{
-    if (context == AFHTTPRequestSerializerObserverContext) {
-        if ([change[NSKeyValueChangeNewKey] isEqual:[NSNull null]]) {
-            [self.mutableObservedChangedKeyPaths removeObject:keyPath];
-        } else {
-            [self.mutableObservedChangedKeyPaths addObject:keyPath];
-        }
-    }
-}
-
 #pragma mark - NSSecureCoding
 
 //支持加密归档
@@ -640,7 +763,7 @@ forHTTPHeaderField:(NSString *)field
         return nil;
     }
 
-    self.mutableHTTPRequestHeaders = [[decoder decodeObjectOfClass:[NSDictionary class] forKey:NSStringFromSelector(@selector(mutableHTTPRequestHeaders))] mutableCopy];
+    [self replaceHTTPRequestHeaders:[decoder decodeObjectOfClass:[NSDictionary class] forKey:NSStringFromSelector(@selector(mutableHTTPRequestHeaders))]];
     self.queryStringSerializationStyle = (AFHTTPRequestQueryStringSerializationStyle)[[decoder decodeObjectOfClass:[NSNumber class] forKey:NSStringFromSelector(@selector(queryStringSerializationStyle))] unsignedIntegerValue];
 
     return self;
@@ -648,11 +771,8 @@ forHTTPHeaderField:(NSString *)field
 
 //使用coder加密归档对象
 - (void)encodeWithCoder:(NSCoder *)coder {
-    //同步操作
-    dispatch_sync(self.requestHeaderModificationQueue, ^{
-        //归档http 的头信息
-        [coder encodeObject:self.mutableHTTPRequestHeaders forKey:NSStringFromSelector(@selector(mutableHTTPRequestHeaders))];
-    });
+    //归档http 的头信息
+    [coder encodeObject:self.HTTPRequestHeaders forKey:NSStringFromSelector(@selector(mutableHTTPRequestHeaders))];
     //归档http序列化的方式
     [coder encodeInteger:self.queryStringSerializationStyle forKey:NSStringFromSelector(@selector(queryStringSerializationStyle))];
 }
@@ -661,9 +781,7 @@ forHTTPHeaderField:(NSString *)field
 //NSCopying协议，实现copy方法
 - (instancetype)copyWithZone:(NSZone *)zone {
     AFHTTPRequestSerializer *serializer = [[[self class] allocWithZone:zone] init];
-    dispatch_sync(self.requestHeaderModificationQueue, ^{
-        serializer.mutableHTTPRequestHeaders = [self.mutableHTTPRequestHeaders mutableCopyWithZone:zone];
-    });
+    [serializer replaceHTTPRequestHeaders:self.HTTPRequestHeaders];
     serializer.queryStringSerializationStyle = self.queryStringSerializationStyle;
     serializer.queryStringSerialization = self.queryStringSerialization;
 
@@ -734,6 +852,8 @@ NSTimeInterval const kAFUploadStream3GSuggestedDelay = 0.2;
 
 - (NSInteger)read:(uint8_t *)buffer
         maxLength:(NSUInteger)length;
+//在还没有读取过的块中定位到offset，之前的数据不再读取
+- (BOOL)seekToOffset:(unsigned long long)offset;
 @end
 
 @interface AFMultipartBodyStream : NSInputStream <NSStreamDelegate>
@@ -754,6 +874,8 @@ NSTimeInterval const kAFUploadStream3GSuggestedDelay = 0.2;
 - (void)setInitialAndFinalBoundaries;
 //添加body信息
 - (void)appendHTTPBodyPart:(AFHTTPBodyPart *)bodyPart;
+//返回从offset开始读取的新流，复用已经编码好的分隔符和头信息，跳过的文件不会被打开
+- (instancetype)bodyStreamBySeekingToOffset:(unsigned long long)offset;
 @end
 
 #pragma mark -
@@ -974,6 +1096,10 @@ NSTimeInterval const kAFUploadStream3GSuggestedDelay = 0.2;
 @property (readwrite, nonatomic, strong) NSOutputStream *outputStream;
 //数据缓存池
 @property (readwrite, nonatomic, strong) NSMutableData *buffer;
+//NSURLSession可能在不同线程上读取body流，用锁保证body块的读取状态同一时间只被一个线程修改
+@property (readwrite, nonatomic, strong) NSLock *lock;
+//打开流时定位到的位置
+@property (readwrite, nonatomic, assign) unsigned long long initialOffset;
 @end
 
 @implementation AFMultipartBodyStream
@@ -993,6 +1119,7 @@ NSTimeInterval const kAFUploadStream3GSuggestedDelay = 0.2;
     self.stringEncoding = encoding;
     self.HTTPBodyParts = [NSMutableArray array];
     self.numberOfBytesInPacket = NSIntegerMax;
+    self.lock = [[NSLock alloc] init];
 
     return self;
 }
@@ -1012,6 +1139,8 @@ NSTimeInterval const kAFUploadStream3GSuggestedDelay = 0.2;
 
 //将bodyPart加入到body块数组中
 - (void)appendHTTPBodyPart:(AFHTTPBodyPart *)bodyPart {
+    //添加时就编码好分隔符和头信息，读取时只需要拷贝
+    [bodyPart encodeSegments];
     [self.HTTPBodyParts addObject:bodyPart];
 }
 
@@ -1025,20 +1154,29 @@ NSTimeInterval const kAFUploadStream3GSuggestedDelay = 0.2;
 - (NSInteger)read:(uint8_t *)buffer
         maxLength:(NSUInteger)length
 {
+    [self.lock lock];
     if ([self streamStatus] == NSStreamStatusClosed) {
+        [self.lock unlock];
         return 0;
     }
+    //打开时定位失败
+    if ([self streamStatus] == NSStreamStatusError) {
+        [self.lock unlock];
+        return -1;
+    }
 
     NSInteger totalNumberOfBytesRead = 0;
+    //每次最多读取一个包的大小，没有设置包大小时一次尽量填满调用方的buffer
+    NSUInteger readLength = MIN(length, self.numberOfBytesInPacket);
 
     //从当前的body块中读取信息，读取不成功返回，读取成功后延迟delay时间并且返回读取的长度
-    while ((NSUInteger)totalNumberOfBytesRead < MIN(length, self.numberOfBytesInPacket)) {
+    while ((NSUInteger)totalNumberOfBytesRead < readLength) {
         if (!self.currentHTTPBodyPart || ![self.currentHTTPBodyPart hasBytesAvailable]) {
             if (!(self.currentHTTPBodyPart = [self.HTTPBodyPartEnumerator nextObject])) {
                 break;
             }
         } else {
-            NSUInteger maxLength = MIN(length, self.numberOfBytesInPacket) - (NSUInteger)totalNumberOfBytesRead;
+            NSUInteger maxLength = readLength - (NSUInteger)totalNumberOfBytesRead;
             NSInteger numberOfBytesRead = [self.currentHTTPBodyPart read:&buffer[totalNumberOfBytesRead] maxLength:maxLength];
             if (numberOfBytesRead == -1) {
                 self.streamError = self.currentHTTPBodyPart.inputStream.streamError;
@@ -1052,6 +1190,7 @@ NSTimeInterval const kAFUploadStream3GSuggestedDelay = 0.2;
             }
         }
     }
+    [self.lock unlock];
 
     return totalNumberOfBytesRead;
 }
@@ -1070,7 +1209,9 @@ NSTimeInterval const kAFUploadStream3GSuggestedDelay = 0.2;
 #pragma mark - NSStream
 //打开流，初始化相关信息
 - (void)open {
+    [self.lock lock];
     if (self.streamStatus == NSStreamStatusOpen) {
+        [self.lock unlock];
         return;
     }
 
@@ -1078,11 +1219,29 @@ NSTimeInterval const kAFUploadStream3GSuggestedDelay = 0.2;
 
     [self setInitialAndFinalBoundaries];
     self.HTTPBodyPartEnumerator = [self.HTTPBodyParts objectEnumerator];
+
+    //整块跳过offset之前的body块，从offset所在的块中间开始读取
+    unsigned long long offset = self.initialOffset;
+    while (offset > 0 && (self.currentHTTPBodyPart = [self.HTTPBodyPartEnumerator nextObject])) {
+        unsigned long long contentLength = [self.currentHTTPBodyPart contentLength];
+        if (offset < contentLength) {
+            if (![self.currentHTTPBodyPart seekToOffset:offset]) {
+                self.streamError = self.currentHTTPBodyPart.inputStream.streamError;
+                self.streamStatus = NSStreamStatusError;
+            }
+            break;
+        }
+        offset -= contentLength;
+        self.currentHTTPBodyPart = nil;
+    }
+    [self.lock unlock];
 }
 
 //关闭流
 - (void)close {
+    [self.lock lock];
     self.streamStatus = NSStreamStatusClosed;
+    [self.lock unlock];
 }
 
 - (id)propertyForKey:(__unused NSString *)key {
@@ -1131,19 +1290,28 @@ NSTimeInterval const kAFUploadStream3GSuggestedDelay = 0.2;
 
 #pragma mark - NSCopying
 
-//实现AFMultipartBodyStream的copy协议
+//实现AFMultipartBodyStream的copy协议，NSURLSession需要新的body流时从头重新读取
 - (instancetype)copyWithZone:(NSZone *)zone {
     AFMultipartBodyStream *bodyStreamCopy = [[[self class] allocWithZone:zone] initWithStringEncoding:self.stringEncoding];
 
+    //块的拷贝共享已经编码好的分隔符和头信息，不需要重新编码
     for (AFHTTPBodyPart *bodyPart in self.HTTPBodyParts) {
         [bodyStreamCopy appendHTTPBodyPart:[bodyPart copy]];
     }
 
     [bodyStreamCopy setInitialAndFinalBoundaries];
+    bodyStreamCopy.initialOffset = self.initialOffset;
 
     return bodyStreamCopy;
 }
 
+- (instancetype)bodyStreamBySeekingToOffset:(unsigned long long)offset {
+    AFMultipartBodyStream *bodyStream = [self copy];
+    bodyStream.initialOffset = offset;
+
+    return bodyStream;
+}
+
 @end
 
 #pragma mark -
@@ -1162,7 +1330,23 @@ typedef enum {
     NSInputStream *_inputStream;
     //解析时读偏移
     unsigned long long _phaseReadOffset;
-}
+    //body在内存中或者映射到内存时，读取body期间使用的数据
+    NSData *_bodyData;
+    //body在内存中或者映射到内存时是否已经读完
+    BOOL _hasReadBodyData;
+    //预先编码好的分隔符和头信息，只在头信息、分隔符或编码方式改变后重新编码
+    NSData *_initialBoundaryData;
+    NSData *_encapsulationBoundaryData;
+    NSData *_headersData;
+    NSData *_finalBoundaryData;
+}
+
+//预先编码分隔符和头信息
+- (void)encodeSegments;
+//编码好的开头分隔符、头信息和结尾分隔符
+- (NSData *)encapsulationBoundaryData;
+- (NSData *)headersData;
+- (NSData *)closingBoundaryData;
 
 //转换到下个要解析的内容
 - (BOOL)transitionToNextPhase;
@@ -1208,6 +1392,22 @@ typedef enum {
     return _inputStream;
 }
 
+//头信息、分隔符和编码方式改变后，需要重新编码
+- (void)setHeaders:(NSDictionary *)headers {
+    _headers = headers;
+    _headersData = nil;
+}
+
+- (void)setBoundary:(NSString *)boundary {
+    _boundary = [boundary copy];
+    _headersData = nil;
+}
+
+- (void)setStringEncoding:(NSStringEncoding)stringEncoding {
+    _stringEncoding = stringEncoding;
+    _headersData = nil;
+}
+
 //拼装http头参数信息
 - (NSString *)stringForHeaders {
     NSMutableString *headerString = [NSMutableString string];
@@ -1219,20 +1419,59 @@ typedef enum {
     return [NSString stringWithString:headerString];
 }
 
+//一次编码所有分隔符和头信息，开头和结尾分隔符在打开流时才能确定，所以都预先编码。已经编码过的块（例如拷贝出来的块）不再重复编码
+- (void)encodeSegments {
+    if (_headersData) {
+        return;
+    }
+
+    _initialBoundaryData = [AFMultipartFormInitialBoundary(self.boundary) dataUsingEncoding:self.stringEncoding];
+    _encapsulationBoundaryData = [AFMultipartFormEncapsulationBoundary(self.boundary) dataUsingEncoding:self.stringEncoding];
+    _finalBoundaryData = [AFMultipartFormFinalBoundary(self.boundary) dataUsingEncoding:self.stringEncoding];
+    _headersData = [[self stringForHeaders] dataUsingEncoding:self.stringEncoding];
+}
+
+- (NSData *)encapsulationBoundaryData {
+    if (!_headersData) {
+        [self encodeSegments];
+    }
+
+    return [self hasInitialBoundary] ? _initialBoundaryData : _encapsulationBoundaryData;
+}
+
+- (NSData *)headersData {
+    if (!_headersData) {
+        [self encodeSegments];
+    }
+
+    return _headersData;
+}
+
+- (NSData *)closingBoundaryData {
+    if (!_headersData) {
+        [self encodeSegments];
+    }
+
+    return [self hasFinalBoundary] ? _finalBoundaryData : [NSData data];
+}
+
+//NSData类型的body直接从内存拷贝，文件类型的body映射到内存后拷贝，都不需要创建输入流
+- (BOOL)readsBodyFromMemory {
+    if (_inputStream) {
+        return NO;
+    }
+
+    return [self.body isKindOfClass:[NSData class]] || ([self.body isKindOfClass:[NSURL class]] && [self.body isFileURL]);
+}
+
 //计算整个http请求的长度，包含头，分隔符和body
 - (unsigned long long)contentLength {
     unsigned long long length = 0;
 
-    NSData *encapsulationBoundaryData = [([self hasInitialBoundary] ? AFMultipartFormInitialBoundary(self.boundary) : AFMultipartFormEncapsulationBoundary(self.boundary)) dataUsingEncoding:self.stringEncoding];
-    length += [encapsulationBoundaryData length];
-
-    NSData *headersData = [[self stringForHeaders] dataUsingEncoding:self.stringEncoding];
-    length += [headersData length];
-
+    length += [[self encapsulationBoundaryData] length];
+    length += [[self headersData] length];
     length += _bodyContentLength;
-
-    NSData *closingBoundaryData = ([self hasFinalBoundary] ? [AFMultipartFormFinalBoundary(self.boundary) dataUsingEncoding:self.stringEncoding] : [NSData data]);
-    length += [closingBoundaryData length];
+    length += [[self closingBoundaryData] length];
 
     return length;
 }
@@ -1244,6 +1483,10 @@ typedef enum {
         return YES;
     }
 
+    if ([self readsBodyFromMemory]) {
+        return !_hasReadBodyData;
+    }
+
     switch (self.inputStream.streamStatus) {
         case NSStreamStatusNotOpen:
         case NSStreamStatusOpening:
@@ -1267,36 +1510,35 @@ typedef enum {
 
     //读取分隔符
     if (_phase == AFEncapsulationBoundaryPhase) {
-        NSData *encapsulationBoundaryData = [([self hasInitialBoundary] ? AFMultipartFormInitialBoundary(self.boundary) : AFMultipartFormEncapsulationBoundary(self.boundary)) dataUsingEncoding:self.stringEncoding];
-        totalNumberOfBytesRead += [self readData:encapsulationBoundaryData intoBuffer:&buffer[totalNumberOfBytesRead] maxLength:(length - (NSUInteger)totalNumberOfBytesRead)];
+        totalNumberOfBytesRead += [self readData:[self encapsulationBoundaryData] intoBuffer:&buffer[totalNumberOfBytesRead] maxLength:(length - (NSUInteger)totalNumberOfBytesRead)];
     }
 
     //读取头信息
     if (_phase == AFHeaderPhase) {
-        NSData *headersData = [[self stringForHeaders] dataUsingEncoding:self.stringEncoding];
-        totalNumberOfBytesRead += [self readData:headersData intoBuffer:&buffer[totalNumberOfBytesRead] maxLength:(length - (NSUInteger)totalNumberOfBytesRead)];
+        totalNumberOfBytesRead += [self readData:[self headersData] intoBuffer:&buffer[totalNumberOfBytesRead] maxLength:(length - (NSUInteger)totalNumberOfBytesRead)];
     }
 
-    //读取body信息
+    //读取body信息，内存中的body只读了一部分时不能再从输入流读取
     if (_phase == AFBodyPhase) {
-        NSInteger numberOfBytesRead = 0;
-
-        numberOfBytesRead = [self.inputStream read:&buffer[totalNumberOfBytesRead] maxLength:(length - (NSUInteger)totalNumberOfBytesRead)];
-        if (numberOfBytesRead == -1) {
-            return -1;
+        if (_bodyData) {
+            totalNumberOfBytesRead += [self readData:_bodyData intoBuffer:&buffer[totalNumberOfBytesRead] maxLength:(length - (NSUInteger)totalNumberOfBytesRead)];
         } else {
-            totalNumberOfBytesRead += numberOfBytesRead;
+            NSInteger numberOfBytesRead = [self.inputStream read:&buffer[totalNumberOfBytesRead] maxLength:(length - (NSUInteger)totalNumberOfBytesRead)];
+            if (numberOfBytesRead == -1) {
+                return -1;
+            } else {
+                totalNumberOfBytesRead += numberOfBytesRead;
 
-            if ([self.inputStream streamStatus] >= NSStreamStatusAtEnd) {
-                [self transitionToNextPhase];
+                if ([self.inputStream streamStatus] >= NSStreamStatusAtEnd) {
+                    [self transitionToNextPhase];
+                }
             }
         }
     }
 
     //读取结尾分隔符信息
     if (_phase == AFFinalBoundaryPhase) {
-        NSData *closingBoundaryData = ([self hasFinalBoundary] ? [AFMultipartFormFinalBoundary(self.boundary) dataUsingEncoding:self.stringEncoding] : [NSData data]);
-        totalNumberOfBytesRead += [self readData:closingBoundaryData intoBuffer:&buffer[totalNumberOfBytesRead] maxLength:(length - (NSUInteger)totalNumberOfBytesRead)];
+        totalNumberOfBytesRead += [self readData:[self closingBoundaryData] intoBuffer:&buffer[totalNumberOfBytesRead] maxLength:(length - (NSUInteger)totalNumberOfBytesRead)];
     }
 
     return totalNumberOfBytesRead;
@@ -1307,8 +1549,10 @@ typedef enum {
             maxLength:(NSUInteger)length
 {
     NSRange range = NSMakeRange((NSUInteger)_phaseReadOffset, MIN([data length] - ((NSUInteger)_phaseReadOffset), length));
-    //将data信息读取到buffer
-    [data getBytes:buffer range:range];
+    //将data信息直接拷贝到buffer
+    if (range.length > 0) {
+        memcpy(buffer, (const uint8_t *)[data bytes] + range.location, range.length);
+    }
 
     _phaseReadOffset += range.length;
 
@@ -1320,26 +1564,31 @@ typedef enum {
     return (NSInteger)range.length;
 }
 
-//切换到下一个解析方式
+//切换到下一个解析方式，在读取流的线程上执行，由AFMultipartBodyStream的锁保证同一时间只有一个线程访问
 - (BOOL)transitionToNextPhase {
-    if (![[NSThread currentThread] isMainThread]) {
-        dispatch_sync(dispatch_get_main_queue(), ^{
-            [self transitionToNextPhase];
-        });
-        return YES;
-    }
-
     switch (_phase) {
         case AFEncapsulationBoundaryPhase:
             _phase = AFHeaderPhase;
             break;
         case AFHeaderPhase:
-            [self.inputStream scheduleInRunLoop:[NSRunLoop currentRunLoop] forMode:NSRunLoopCommonModes];
-            [self.inputStream open];
+            //文件在读到时才映射到内存，映射完成后文件描述符就会关闭，读完后立即解除映射
+            if ([self readsBodyFromMemory]) {
+                _bodyData = [self.body isKindOfClass:[NSData class]] ? self.body : [NSData dataWithContentsOfURL:self.body options:NSDataReadingMappedAlways error:nil];
+            }
+
+            //映射失败时退回使用输入流。body流只通过read:maxLength:同步读取，不需要加入runloop，直接在当前线程打开
+            if (!_bodyData) {
+                [self.inputStream open];
+            }
             _phase = AFBodyPhase;
             break;
         case AFBodyPhase:
-            [self.inputStream close];
+            if (_bodyData) {
+                _bodyData = nil;
+                _hasReadBodyData = YES;
+            } else {
+                [self.inputStream close];
+            }
             _phase = AFFinalBoundaryPhase;
             break;
         case AFFinalBoundaryPhase:
@@ -1352,6 +1601,55 @@ typedef enum {
     return YES;
 }
 
+//块还没有被读取过时，定位到offset
+- (BOOL)seekToOffset:(unsigned long long)offset {
+    unsigned long long boundaryLength = [[self encapsulationBoundaryData] length];
+    if (offset < boundaryLength) {
+        _phaseReadOffset = offset;
+        return YES;
+    }
+    offset -= boundaryLength;
+    [self transitionToNextPhase];
+
+    unsigned long long headersLength = [[self headersData] length];
+    if (offset < headersLength) {
+        _phaseReadOffset = offset;
+        return YES;
+    }
+    offset -= headersLength;
+    [self transitionToNextPhase];
+
+    if (offset < self.bodyContentLength) {
+        //内存中和映射的body直接移动读偏移
+        if (_bodyData) {
+            _phaseReadOffset = offset;
+            return YES;
+        }
+
+        //文件流可以直接定位，其它流只能读取后丢弃
+        if ([self.inputStream setProperty:@(offset) forKey:NSStreamFileCurrentOffsetKey]) {
+            return YES;
+        }
+
+        uint8_t buffer[16 * 1024];
+        while (offset > 0) {
+            NSInteger numberOfBytesRead = [self.inputStream read:buffer maxLength:(NSUInteger)MIN(offset, (unsigned long long)sizeof(buffer))];
+            if (numberOfBytesRead <= 0) {
+                return NO;
+            }
+            offset -= (unsigned long long)numberOfBytesRead;
+        }
+
+        return YES;
+    }
+    offset -= self.bodyContentLength;
+    [self transitionToNextPhase];
+
+    _phaseReadOffset = offset;
+
+    return YES;
+}
+
 #pragma mark - NSCopying
 //实现AFHTTPBodyPart的copy协议
 - (instancetype)copyWithZone:(NSZone *)zone {
@@ -1360,8 +1658,18 @@ typedef enum {
     bodyPart.stringEncoding = self.stringEncoding;
     bodyPart.headers = self.headers;
     bodyPart.bodyContentLength = self.bodyContentLength;
-    bodyPart.body = self.body;
+    //可以拷贝的输入流（例如json body流）拷贝后从头读取，其它输入流只能共享
+    if ([self.body isKindOfClass:[NSInputStream class]] && [self.body conformsToProtocol:@protocol(NSCopying)]) {
+        bodyPart.body = [self.body copy];
+    } else {
+        bodyPart.body = self.body;
+    }
     bodyPart.boundary = self.boundary;
+    //编码好的分隔符和头信息是不可变的，直接共享
+    bodyPart->_initialBoundaryData = _initialBoundaryData;
+    bodyPart->_encapsulationBoundaryData = _encapsulationBoundaryData;
+    bodyPart->_headersData = _headersData;
+    bodyPart->_finalBoundaryData = _finalBoundaryData;
 
     return bodyPart;
 }
@@ -1370,64 +1678,1153 @@ typedef enum {
 
 #pragma mark -
 
-@implementation AFJSONRequestSerializer
+//每次writev最多写入的字节数和向量个数
+static NSUInteger const kAFMultipartBodySpoolerMaximumWriteLength = 8 * 1024 * 1024;
+static int const kAFMultipartBodySpoolerMaximumNumberOfVectors = 512;
+//普通输入流的读取缓存大小
+static NSUInteger const kAFMultipartBodySpoolerStreamBufferLength = 256 * 1024;
+
+static NSError * AFMultipartBodySpoolerPOSIXError() {
+    return [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+}
+
+@interface AFMultipartBodySpooler () {
+    //目标文件描述符
+    int _fileDescriptor;
+    //等待写入的向量
+    struct iovec *_vectors;
+    int _numberOfVectors;
+    NSUInteger _pendingLength;
+}
+@property (readwrite, nonatomic, strong) NSInputStream *inputStream;
+@property (readwrite, nonatomic, strong) NSURL *fileURL;
+@property (readwrite, nonatomic, strong) NSProgress *progress;
+//等待写入的向量引用的数据，写入前必须保持不被释放
+@property (readwrite, nonatomic, strong) NSMutableArray *pendingSegments;
+@end
 
-//返回一个默认的AFJSONRequestSerializer
-+ (instancetype)serializer {
-    return [self serializerWithWritingOptions:(NSJSONWritingOptions)0];
-}
+@implementation AFMultipartBodySpooler
 
-//返回一个默认的AFJSONRequestSerializer
-+ (instancetype)serializerWithWritingOptions:(NSJSONWritingOptions)writingOptions
+- (instancetype)initWithInputStream:(NSInputStream *)inputStream
+                            fileURL:(NSURL *)fileURL
 {
-    AFJSONRequestSerializer *serializer = [[self alloc] init];
-    serializer.writingOptions = writingOptions;
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
 
-    return serializer;
+    self.inputStream = inputStream;
+    self.fileURL = fileURL;
+    self.progress = [NSProgress progressWithTotalUnitCount:-1];
+    self.progress.cancellable = YES;
+    self.pendingSegments = [NSMutableArray array];
+    _fileDescriptor = -1;
+    _vectors = calloc(kAFMultipartBodySpoolerMaximumNumberOfVectors, sizeof(struct iovec));
+
+    return self;
 }
 
-#pragma mark - AFURLRequestSerialization
+- (void)dealloc {
+    free(_vectors);
+}
 
-- (NSURLRequest *)requestBySerializingRequest:(NSURLRequest *)request
-                               withParameters:(id)parameters
-                                        error:(NSError *__autoreleasing *)error
-{
-    NSParameterAssert(request);
+- (BOOL)spool:(NSError * __autoreleasing *)error {
+    _fileDescriptor = open([[self.fileURL path] fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (_fileDescriptor < 0) {
+        if (error) {
+            *error = AFMultipartBodySpoolerPOSIXError();
+        }
+        return NO;
+    }
 
-    //如果Http请求中的参数都已经序列化，直接调用父类方法
-    if ([self.HTTPMethodsEncodingParametersInURI containsObject:[[request HTTPMethod] uppercaseString]]) {
-        return [super requestBySerializingRequest:request withParameters:parameters error:error];
+    NSError *spoolError = nil;
+    BOOL success = NO;
+    if ([self.inputStream isKindOfClass:[AFMultipartBodyStream class]]) {
+        success = [self spoolMultipartBodyStream:(AFMultipartBodyStream *)self.inputStream error:&spoolError];
+    } else {
+        success = [self spoolInputStream:self.inputStream error:&spoolError];
     }
 
-    NSMutableURLRequest *mutableRequest = [request mutableCopy];
+    if (close(_fileDescriptor) != 0 && success) {
+        spoolError = AFMultipartBodySpoolerPOSIXError();
+        success = NO;
+    }
+    _fileDescriptor = -1;
 
-    //拼接json的序列化请求
-    [self.HTTPRequestHeaders enumerateKeysAndObjectsUsingBlock:^(id field, id value, BOOL * __unused stop) {
-        if (![request valueForHTTPHeaderField:field]) {
-            [mutableRequest setValue:value forHTTPHeaderField:field];
+    //失败或者被取消时不保留写了一半的文件
+    if (!success) {
+        [[NSFileManager defaultManager] removeItemAtURL:self.fileURL error:nil];
+        if (error) {
+            *error = spoolError;
         }
-    }];
+    }
 
-    if (parameters) {
-        if (![mutableRequest valueForHTTPHeaderField:@"Content-Type"]) {
-            [mutableRequest setValue:@"application/json" forHTTPHeaderField:@"Content-Type"];
-        }
+    return success;
+}
 
-        if (![NSJSONSerialization isValidJSONObject:parameters]) {
+//multipart body的分隔符、头信息和内存中的body直接作为向量，文件映射到内存后作为向量，合并成大块的writev写入
+- (BOOL)spoolMultipartBodyStream:(AFMultipartBodyStream *)bodyStream
+                           error:(NSError * __autoreleasing *)error
+{
+    [bodyStream setInitialAndFinalBoundaries];
+    self.progress.totalUnitCount = (int64_t)[bodyStream contentLength];
+    [self reportProgress];
+
+    for (AFHTTPBodyPart *bodyPart in bodyStream.HTTPBodyParts) {
+        if (![self appendSegment:[bodyPart encapsulationBoundaryData] error:error] || ![self appendSegment:[bodyPart headersData] error:error]) {
+            return NO;
+        }
+
+        NSData *bodyData = nil;
+        if ([bodyPart.body isKindOfClass:[NSData class]]) {
+            bodyData = bodyPart.body;
+        } else if ([bodyPart.body isKindOfClass:[NSURL class]] && [bodyPart.body isFileURL]) {
+            bodyData = [NSData dataWithContentsOfURL:bodyPart.body options:NSDataReadingMappedAlways error:nil];
+        }
+
+        if (bodyData) {
+            if (![self appendSegment:bodyData error:error]) {
+                return NO;
+            }
+        } else {
+            //无法映射的文件和输入流只能顺序读取
+            if (![self flush:error] || ![self spoolInputStream:[[bodyPart copy] inputStream] error:error]) {
+                return NO;
+            }
+        }
+
+        if (![self appendSegment:[bodyPart closingBoundaryData] error:error]) {
+            return NO;
+        }
+    }
+
+    return [self flush:error];
+}
+
+//普通的输入流使用大缓存读取后写入
+- (BOOL)spoolInputStream:(NSInputStream *)inputStream
+                   error:(NSError * __autoreleasing *)error
+{
+    uint8_t *buffer = malloc(kAFMultipartBodySpoolerStreamBufferLength);
+    BOOL success = YES;
+
+    [inputStream open];
+    while (YES) {
+        if ([self.progress isCancelled]) {
+            success = [self cancel:error];
+            break;
+        }
+
+        NSInteger numberOfBytesRead = [inputStream read:buffer maxLength:kAFMultipartBodySpoolerStreamBufferLength];
+        if (numberOfBytesRead < 0) {
             if (error) {
-                NSDictionary *userInfo = @{NSLocalizedFailureReasonErrorKey: NSLocalizedStringFromTable(@"The `parameters` argument is not valid JSON.", @"AFNetworking", nil)};
-                *error = [[NSError alloc] initWithDomain:AFURLRequestSerializationErrorDomain code:NSURLErrorCannotDecodeContentData userInfo:userInfo];
+                *error = inputStream.streamError;
             }
-            return nil;
+            success = NO;
+            break;
+        } else if (numberOfBytesRead == 0) {
+            break;
+        }
+
+        struct iovec vector = {buffer, (size_t)numberOfBytesRead};
+        if (![self writeVectors:&vector count:1 error:error]) {
+            success = NO;
+            break;
+        }
+    }
+    [inputStream close];
+    free(buffer);
+
+    return success;
+}
+
+//加入一段等待写入的数据，超过单次写入的限制时先写入
+- (BOOL)appendSegment:(NSData *)segment
+                error:(NSError * __autoreleasing *)error
+{
+    const uint8_t *bytes = [segment bytes];
+    NSUInteger length = [segment length];
+    if (length == 0) {
+        return YES;
+    }
+
+    [self.pendingSegments addObject:segment];
+    NSUInteger offset = 0;
+    while (offset < length) {
+        if (_numberOfVectors == kAFMultipartBodySpoolerMaximumNumberOfVectors || _pendingLength >= kAFMultipartBodySpoolerMaximumWriteLength) {
+            if (![self flush:error]) {
+                return NO;
+            }
+            //flush会释放引用的数据，剩余部分还需要
+            [self.pendingSegments addObject:segment];
+        }
+
+        NSUInteger vectorLength = MIN(length - offset, kAFMultipartBodySpoolerMaximumWriteLength - MIN(_pendingLength, kAFMultipartBodySpoolerMaximumWriteLength));
+        _vectors[_numberOfVectors].iov_base = (void *)(bytes + offset);
+        _vectors[_numberOfVectors].iov_len = vectorLength;
+        _numberOfVectors++;
+        _pendingLength += vectorLength;
+        offset += vectorLength;
+    }
+
+    return YES;
+}
+
+//写入所有等待的向量
+- (BOOL)flush:(NSError * __autoreleasing *)error {
+    if ([self.progress isCancelled]) {
+        return [self cancel:error];
+    }
+
+    BOOL success = [self writeVectors:_vectors count:_numberOfVectors error:error];
+    _numberOfVectors = 0;
+    _pendingLength = 0;
+    [self.pendingSegments removeAllObjects];
+
+    return success;
+}
+
+//writev可能只写入一部分，循环写入直到全部完成
+- (BOOL)writeVectors:(struct iovec *)vectors
+               count:(int)count
+               error:(NSError * __autoreleasing *)error
+{
+    int index = 0;
+    while (index < count) {
+        ssize_t numberOfBytesWritten = writev(_fileDescriptor, &vectors[index], count - index);
+        if (numberOfBytesWritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (error) {
+                *error = AFMultipartBodySpoolerPOSIXError();
+            }
+            return NO;
+        }
+
+        self.progress.completedUnitCount += numberOfBytesWritten;
+
+        size_t remainingLength = (size_t)numberOfBytesWritten;
+        while (index < count && remainingLength >= vectors[index].iov_len) {
+            remainingLength -= vectors[index].iov_len;
+            index++;
+        }
+        if (index < count) {
+            vectors[index].iov_base = (uint8_t *)vectors[index].iov_base + remainingLength;
+            vectors[index].iov_len -= remainingLength;
+        }
+    }
+
+    [self reportProgress];
+
+    return YES;
+}
+
+- (void)reportProgress {
+    if (self.progressBlock) {
+        void (^progressBlock)(NSProgress *) = self.progressBlock;
+        NSProgress *progress = self.progress;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            progressBlock(progress);
+        });
+    }
+}
+
+- (BOOL)cancel:(NSError * __autoreleasing *)error {
+    if (error) {
+        *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+    }
+
+    return NO;
+}
+
+@end
+
+#pragma mark -
+
+//流式计算摘要时每次读取的字节数
+static NSUInteger const kAFUploadDeduplicatorReadBufferLength = 256 * 1024;
+
+@interface AFUploadDeduplicator ()
+@property (readwrite, nonatomic, copy) NSURL *lookupURL;
+//最近确认过的摘要，越靠后越新
+@property (readwrite, nonatomic, strong) NSMutableOrderedSet *cachedDigests;
+@property (readwrite, nonatomic, strong) NSLock *lock;
+@end
+
+@implementation AFUploadDeduplicator {
+    int64_t _numberOfBytesSaved;
+}
+
+- (instancetype)initWithLookupURL:(NSURL *)lookupURL {
+    NSParameterAssert(lookupURL);
+
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.lookupURL = lookupURL;
+    self.digestHeaderField = @"X-Content-SHA256";
+    self.maximumNumberOfCachedDigests = 1024;
+    self.cachedDigests = [NSMutableOrderedSet orderedSet];
+    self.lock = [[NSLock alloc] init];
+
+    return self;
+}
+
++ (NSString *)SHA256DigestOfFileAtURL:(NSURL *)fileURL
+                                error:(NSError * __autoreleasing *)error
+{
+    NSInputStream *inputStream = [NSInputStream inputStreamWithURL:fileURL];
+    uint8_t *buffer = malloc(kAFUploadDeduplicatorReadBufferLength);
+    CC_SHA256_CTX context;
+    CC_SHA256_Init(&context);
+
+    BOOL success = YES;
+    [inputStream open];
+    while (YES) {
+        NSInteger numberOfBytesRead = [inputStream read:buffer maxLength:kAFUploadDeduplicatorReadBufferLength];
+        if (numberOfBytesRead < 0 || !inputStream) {
+            if (error) {
+                *error = inputStream.streamError ?: [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadUnknownError userInfo:nil];
+            }
+            success = NO;
+            break;
+        } else if (numberOfBytesRead == 0) {
+            break;
+        }
+
+        CC_SHA256_Update(&context, buffer, (CC_LONG)numberOfBytesRead);
+    }
+    [inputStream close];
+    free(buffer);
+
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final(digest, &context);
+    if (!success) {
+        return nil;
+    }
+
+    NSMutableString *hexDigest = [NSMutableString stringWithCapacity:CC_SHA256_DIGEST_LENGTH * 2];
+    for (NSUInteger idx = 0; idx < CC_SHA256_DIGEST_LENGTH; idx++) {
+        [hexDigest appendFormat:@"%02x", digest[idx]];
+    }
+
+    return hexDigest;
+}
+
+- (void)lookUpFileAtURL:(NSURL *)fileURL
+      completionHandler:(void (^)(NSString *digest, BOOL exists, NSError *error))handler
+{
+    [self lookUpFileAtURL:fileURL sessionManager:self.sessionManager completionHandler:handler];
+}
+
+//查询请求由会话管理对象发送，使用它的会话配置、安全策略和认证回调
+- (void)lookUpFileAtURL:(NSURL *)fileURL
+         sessionManager:(AFURLSessionManager *)sessionManager
+      completionHandler:(void (^)(NSString *digest, BOOL exists, NSError *error))handler
+{
+    NSParameterAssert(handler);
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        NSError *error = nil;
+        NSString *digest = [[self class] SHA256DigestOfFileAtURL:fileURL error:&error];
+        if (!digest) {
+            handler(nil, NO, error);
+            return;
+        }
+
+        //最近确认过的内容不需要再查询
+        if ([self hasCachedDigest:digest]) {
+            handler(digest, YES, nil);
+            return;
+        }
+
+        if (!sessionManager) {
+            handler(digest, NO, nil);
+            return;
+        }
+
+        NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[self.lookupURL URLByAppendingPathComponent:digest]];
+        request.HTTPMethod = @"HEAD";
+        //只根据状态码判断，响应序列化对象的校验错误不影响结果
+        [[sessionManager dataTaskWithRequest:request uploadProgress:nil downloadProgress:nil completionHandler:^(NSURLResponse *response, __unused id responseObject, NSError *lookupError) {
+            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                NSInteger statusCode = [response isKindOfClass:[NSHTTPURLResponse class]] ? [(NSHTTPURLResponse *)response statusCode] : 0;
+                if (statusCode >= 200 && statusCode < 300) {
+                    [self cacheDigest:digest];
+                    handler(digest, YES, nil);
+                } else if (statusCode == 404) {
+                    handler(digest, NO, nil);
+                } else {
+                    handler(digest, NO, lookupError ?: [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse userInfo:nil]);
+                }
+            });
+        }] resume];
+    });
+}
+
+- (void)cacheDigest:(NSString *)digest {
+    [self.lock lock];
+    [self.cachedDigests removeObject:digest];
+    [self.cachedDigests addObject:digest];
+    while ([self.cachedDigests count] > self.maximumNumberOfCachedDigests) {
+        [self.cachedDigests removeObjectAtIndex:0];
+    }
+    [self.lock unlock];
+}
+
+//命中时移到最新的位置
+- (BOOL)hasCachedDigest:(NSString *)digest {
+    [self.lock lock];
+    BOOL hasCachedDigest = [self.cachedDigests containsObject:digest];
+    if (hasCachedDigest) {
+        [self.cachedDigests removeObject:digest];
+        [self.cachedDigests addObject:digest];
+    }
+    [self.lock unlock];
+
+    return hasCachedDigest;
+}
+
+- (int64_t)numberOfBytesSaved {
+    [self.lock lock];
+    int64_t numberOfBytesSaved = _numberOfBytesSaved;
+    [self.lock unlock];
+
+    return numberOfBytesSaved;
+}
+
+- (void)addNumberOfBytesSaved:(int64_t)numberOfBytes {
+    [self.lock lock];
+    _numberOfBytesSaved += numberOfBytes;
+    [self.lock unlock];
+}
+
+@end
+
+static void AFDeduplicateFilePartsOfMultipartFormRequest(NSURLRequest *request, AFUploadDeduplicator *deduplicator, void (^handler)(NSMutableURLRequest *request)) {
+    NSMutableURLRequest *mutableRequest = [request mutableCopy];
+    if (![request.HTTPBodyStream isKindOfClass:[AFMultipartBodyStream class]]) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            handler(mutableRequest);
+        });
+        return;
+    }
+
+    //在副本上修改，原来的请求不受影响
+    AFMultipartBodyStream *bodyStream = [(AFMultipartBodyStream *)request.HTTPBodyStream copy];
+    dispatch_group_t group = dispatch_group_create();
+    for (AFHTTPBodyPart *bodyPart in bodyStream.HTTPBodyParts) {
+        if (![bodyPart.body isKindOfClass:[NSURL class]] || ![bodyPart.body isFileURL]) {
+            continue;
+        }
+
+        dispatch_group_enter(group);
+        [deduplicator lookUpFileAtURL:bodyPart.body completionHandler:^(NSString *digest, BOOL exists, __unused NSError *error) {
+            if (exists) {
+                NSMutableDictionary *headers = [bodyPart.headers mutableCopy];
+                headers[deduplicator.digestHeaderField] = digest;
+                [deduplicator addNumberOfBytesSaved:(int64_t)bodyPart.bodyContentLength];
+
+                bodyPart.headers = headers;
+                bodyPart.body = [NSData data];
+                bodyPart.bodyContentLength = 0;
+            }
+            dispatch_group_leave(group);
+        }];
+    }
+
+    dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+        mutableRequest.HTTPBodyStream = bodyStream;
+        [mutableRequest setValue:[NSString stringWithFormat:@"%llu", [bodyStream contentLength]] forHTTPHeaderField:@"Content-Length"];
+        handler(mutableRequest);
+    });
+}
+
+static NSInputStream * AFMultipartBodyStreamBySeekingToOffset(NSInputStream *bodyStream, unsigned long long offset, unsigned long long *contentLength) {
+    if (![bodyStream isKindOfClass:[AFMultipartBodyStream class]]) {
+        return nil;
+    }
+
+    AFMultipartBodyStream *multipartBodyStream = (AFMultipartBodyStream *)bodyStream;
+    [multipartBodyStream setInitialAndFinalBoundaries];
+    if (offset > [multipartBodyStream contentLength]) {
+        return nil;
+    }
+
+    if (contentLength) {
+        *contentLength = [multipartBodyStream contentLength];
+    }
+
+    return [multipartBodyStream bodyStreamBySeekingToOffset:offset];
+}
+
+#pragma mark -
+
+//流式json写入器每次编码的块大小
+static NSUInteger const kAFJSONBodyWriterChunkSize = 32 * 1024;
+
+//json对象校验失败时返回的错误，与NSJSONSerialization校验失败时的错误一致
+static NSError * AFJSONBodyWriterInvalidParametersError() {
+    NSDictionary *userInfo = @{NSLocalizedFailureReasonErrorKey: NSLocalizedStringFromTable(@"The `parameters` argument is not valid JSON.", @"AFNetworking", nil)};
+    return [[NSError alloc] initWithDomain:AFURLRequestSerializationErrorDomain code:NSURLErrorCannotDecodeContentData userInfo:userInfo];
+}
+
+//编码结果的缓存，用于避免NSMutableData每次追加时的消息发送
+typedef struct {
+    uint8_t *bytes;
+    NSUInteger length;
+    NSUInteger capacity;
+} AFJSONBodyBuffer;
+
+static inline void AFJSONBodyBufferReserve(AFJSONBodyBuffer *buffer, NSUInteger additionalLength) {
+    if (buffer->length + additionalLength <= buffer->capacity) {
+        return;
+    }
+
+    NSUInteger capacity = MAX(MAX(buffer->capacity * 2, buffer->length + additionalLength), (NSUInteger)256);
+    buffer->bytes = reallocf(buffer->bytes, capacity);
+    buffer->capacity = capacity;
+}
+
+static inline void AFJSONBodyBufferAppend(AFJSONBodyBuffer *buffer, const void *bytes, NSUInteger length) {
+    AFJSONBodyBufferReserve(buffer, length);
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+static inline void AFJSONBodyBufferAppendByte(AFJSONBodyBuffer *buffer, uint8_t byte) {
+    AFJSONBodyBufferReserve(buffer, 1);
+    buffer->bytes[buffer->length++] = byte;
+}
+
+//与NSJSONSerialization一致，转义双引号、反斜杠、斜杠和控制字符
+static inline BOOL AFJSONByteNeedsEscaping(uint8_t byte) {
+    return byte < 0x20 || byte == '"' || byte == '\\' || byte == '/';
+}
+
+static void AFJSONBodyBufferAppendEscapedByte(AFJSONBodyBuffer *buffer, uint8_t byte) {
+    static const char AFJSONHexDigits[] = "0123456789abcdef";
+    uint8_t escape[6] = {'\\', byte, '0', '0', 0, 0};
+    NSUInteger length = 2;
+    switch (byte) {
+        case '"':
+        case '\\':
+        case '/':
+            break;
+        case '\b':
+            escape[1] = 'b';
+            break;
+        case '\f':
+            escape[1] = 'f';
+            break;
+        case '\n':
+            escape[1] = 'n';
+            break;
+        case '\r':
+            escape[1] = 'r';
+            break;
+        case '\t':
+            escape[1] = 't';
+            break;
+        default:
+            escape[1] = 'u';
+            escape[4] = (uint8_t)AFJSONHexDigits[byte >> 4];
+            escape[5] = (uint8_t)AFJSONHexDigits[byte & 0x0F];
+            length = 6;
+            break;
+    }
+
+    AFJSONBodyBufferAppend(buffer, escape, length);
+}
+
+//追加UTF-8字节，不需要转义的连续字节整段拷贝
+static void AFJSONBodyBufferAppendEscapedUTF8(AFJSONBodyBuffer *buffer, const uint8_t *bytes, NSUInteger length) {
+    NSUInteger runStart = 0;
+    for (NSUInteger idx = 0; idx < length; idx++) {
+        if (AFJSONByteNeedsEscaping(bytes[idx])) {
+            AFJSONBodyBufferAppend(buffer, bytes + runStart, idx - runStart);
+            AFJSONBodyBufferAppendEscapedByte(buffer, bytes[idx]);
+            runStart = idx + 1;
+        }
+    }
+
+    AFJSONBodyBufferAppend(buffer, bytes + runStart, length - runStart);
+}
+
+//追加json字符串，ASCII字符串直接访问内部存储，其他字符串分段转换为UTF-8，字符串中有无法编码的字符(如单独的代理项)时返回NO
+static BOOL AFJSONBodyBufferAppendString(AFJSONBodyBuffer *buffer, NSString *string) {
+    AFJSONBodyBufferAppendByte(buffer, '"');
+
+    CFStringRef stringRef = (__bridge CFStringRef)string;
+    const char *ASCIIString = CFStringGetCStringPtr(stringRef, kCFStringEncodingASCII);
+    if (ASCIIString) {
+        AFJSONBodyBufferAppendEscapedUTF8(buffer, (const uint8_t *)ASCIIString, (NSUInteger)CFStringGetLength(stringRef));
+    } else {
+        uint8_t chunk[4096];
+        NSRange remainingRange = NSMakeRange(0, [string length]);
+        while (remainingRange.length > 0) {
+            NSUInteger usedLength = 0;
+            BOOL converted = [string getBytes:chunk maxLength:sizeof(chunk) usedLength:&usedLength encoding:NSUTF8StringEncoding options:(NSStringEncodingConversionOptions)0 range:remainingRange remainingRange:&remainingRange];
+            if (!converted || usedLength == 0) {
+                return NO;
+            }
+
+            AFJSONBodyBufferAppendEscapedUTF8(buffer, chunk, usedLength);
+        }
+    }
+
+    AFJSONBodyBufferAppendByte(buffer, '"');
+
+    return YES;
+}
+
+//整数格式化的快速路径，从bufferEnd向前写入，返回写入的长度
+static NSUInteger AFJSONFormatUnsignedInteger(char *bufferEnd, unsigned long long value) {
+    char *cursor = bufferEnd;
+    do {
+        *--cursor = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value > 0);
+
+    return (NSUInteger)(bufferEnd - cursor);
+}
+
+//浮点数使用能够精确还原的最短有效位数格式化，不受当前locale影响
+static NSUInteger AFJSONFormatDouble(char *buffer, size_t size, double value, BOOL isFloat) {
+    int precision = isFloat ? 6 : 15;
+    int maximumPrecision = isFloat ? 9 : 17;
+    int length = 0;
+    for (; precision <= maximumPrecision; precision++) {
+        length = snprintf_l(buffer, size, NULL, "%.*g", precision, value);
+        double parsedValue = strtod_l(buffer, NULL, NULL);
+        if (isFloat ? ((float)parsedValue == (float)value) : (parsedValue == value)) {
+            break;
+        }
+    }
+
+    return (NSUInteger)length;
+}
+
+//追加json数字，NaN和无穷大不是合法的json，返回NO
+static BOOL AFJSONBodyBufferAppendNumber(AFJSONBodyBuffer *buffer, NSNumber *number) {
+    if ((__bridge CFBooleanRef)number == kCFBooleanTrue) {
+        AFJSONBodyBufferAppend(buffer, "true", 4);
+        return YES;
+    } else if ((__bridge CFBooleanRef)number == kCFBooleanFalse) {
+        AFJSONBodyBufferAppend(buffer, "false", 5);
+        return YES;
+    }
+
+    if ([number isKindOfClass:[NSDecimalNumber class]]) {
+        if ([number isEqualToNumber:[NSDecimalNumber notANumber]]) {
+            return NO;
+        }
+
+        NSData *data = [[number stringValue] dataUsingEncoding:NSUTF8StringEncoding];
+        AFJSONBodyBufferAppend(buffer, [data bytes], [data length]);
+        return YES;
+    }
+
+    char formatted[32];
+    char *formattedEnd = formatted + sizeof(formatted);
+    switch ([number objCType][0]) {
+        case 'B':
+        case 'c':
+        case 's':
+        case 'i':
+        case 'l':
+        case 'q': {
+            long long value = [number longLongValue];
+            unsigned long long magnitude = value < 0 ? (0ULL - (unsigned long long)value) : (unsigned long long)value;
+            NSUInteger length = AFJSONFormatUnsignedInteger(formattedEnd, magnitude);
+            if (value < 0) {
+                *(formattedEnd - length - 1) = '-';
+                length++;
+            }
+            AFJSONBodyBufferAppend(buffer, formattedEnd - length, length);
+            break;
+        }
+        case 'C':
+        case 'S':
+        case 'I':
+        case 'L':
+        case 'Q': {
+            NSUInteger length = AFJSONFormatUnsignedInteger(formattedEnd, [number unsignedLongLongValue]);
+            AFJSONBodyBufferAppend(buffer, formattedEnd - length, length);
+            break;
+        }
+        default: {
+            BOOL isFloat = [number objCType][0] == 'f';
+            double value = isFloat ? [number floatValue] : [number doubleValue];
+            if (isnan(value) || isinf(value)) {
+                return NO;
+            }
+            AFJSONBodyBufferAppend(buffer, formatted, AFJSONFormatDouble(formatted, sizeof(formatted), value, isFloat));
+            break;
+        }
+    }
+
+    return YES;
+}
+
+//json容器的遍历状态，容器中的对象由容器本身持有
+typedef struct {
+    __unsafe_unretained id *objects;
+    __unsafe_unretained id *keys;
+    NSUInteger count;
+    NSUInteger index;
+    BOOL isDictionary;
+} AFJSONBodyWriterFrame;
+
+/**
+ 单次遍历完成校验和编码的json写入器，使用显式的栈代替递归，可以一次写完，也可以分块写出
+ */
+@interface AFJSONBodyWriter : NSObject
+//需要编码的json对象
+@property (readonly, nonatomic, strong) id JSONObject;
+//是否已经全部写完
+@property (readonly, nonatomic, assign, getter = isFinished) BOOL finished;
+//缓存中是否还有未读取的字节
+@property (readonly, nonatomic, assign, getter = hasBytesAvailable) BOOL bytesAvailable;
+
+//一次编码整个json对象，编码结果直接交给NSData，不发生拷贝
++ (NSData *)dataWithJSONObject:(id)JSONObject
+                         error:(NSError * __autoreleasing *)error;
+//只计算编码后的长度，编码结果分块丢弃，不会保留整个body
++ (BOOL)getLength:(unsigned long long *)length
+     ofJSONObject:(id)JSONObject
+            error:(NSError * __autoreleasing *)error;
+
+- (instancetype)initWithJSONObject:(id)JSONObject;
+//继续编码，直到缓存中至少有length个未读取的字节或者全部写完，json对象不合法时返回NO
+- (BOOL)writeUntilBufferLength:(NSUInteger)length
+                         error:(NSError * __autoreleasing *)error;
+//从缓存中读取最多length个字节
+- (NSUInteger)readBytes:(uint8_t *)bytes
+              maxLength:(NSUInteger)length;
+@end
+
+@interface AFJSONBodyWriter () {
+    //编码结果缓存
+    AFJSONBodyBuffer _buffer;
+    //缓存中已经读取的位置
+    NSUInteger _bufferOffset;
+    //容器遍历栈
+    AFJSONBodyWriterFrame *_frames;
+    NSUInteger _numberOfFrames;
+    NSUInteger _framesCapacity;
+    //是否已经开始编码根对象
+    BOOL _started;
+}
+@property (readwrite, nonatomic, strong) id JSONObject;
+@property (readwrite, nonatomic, assign, getter = isFinished) BOOL finished;
+@end
+
+@implementation AFJSONBodyWriter
+
++ (NSData *)dataWithJSONObject:(id)JSONObject
+                         error:(NSError * __autoreleasing *)error
+{
+    AFJSONBodyWriter *writer = [[self alloc] initWithJSONObject:JSONObject];
+    if (![writer writeUntilBufferLength:NSUIntegerMax error:error]) {
+        return nil;
+    }
+
+    //把缓存的所有权交给NSData
+    NSData *data = [[NSData alloc] initWithBytesNoCopy:writer->_buffer.bytes length:writer->_buffer.length freeWhenDone:YES];
+    writer->_buffer = (AFJSONBodyBuffer){NULL, 0, 0};
+
+    return data;
+}
+
++ (BOOL)getLength:(unsigned long long *)length
+     ofJSONObject:(id)JSONObject
+            error:(NSError * __autoreleasing *)error
+{
+    AFJSONBodyWriter *writer = [[self alloc] initWithJSONObject:JSONObject];
+    unsigned long long totalLength = 0;
+    while (![writer isFinished]) {
+        if (![writer writeUntilBufferLength:kAFJSONBodyWriterChunkSize error:error]) {
+            return NO;
+        }
+
+        totalLength += writer->_buffer.length - writer->_bufferOffset;
+        writer->_bufferOffset = writer->_buffer.length;
+    }
+
+    if (length) {
+        *length = totalLength;
+    }
+
+    return YES;
+}
+
+- (instancetype)initWithJSONObject:(id)JSONObject {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.JSONObject = JSONObject;
+
+    return self;
+}
+
+- (void)dealloc {
+    while (_numberOfFrames > 0) {
+        [self popFrame];
+    }
+
+    free(_frames);
+    free(_buffer.bytes);
+}
+
+- (BOOL)hasBytesAvailable {
+    return _bufferOffset < _buffer.length;
+}
+
+- (BOOL)writeUntilBufferLength:(NSUInteger)length
+                         error:(NSError * __autoreleasing *)error
+{
+    //缓存已经全部读完时从头复用
+    if (_bufferOffset == _buffer.length) {
+        _buffer.length = 0;
+        _bufferOffset = 0;
+    }
+
+    while (![self isFinished] && _buffer.length - _bufferOffset < length) {
+        if (!_started) {
+            _started = YES;
+            //与isValidJSONObject:一致，根对象必须是数组或字典
+            if (!([self.JSONObject isKindOfClass:[NSArray class]] || [self.JSONObject isKindOfClass:[NSDictionary class]]) || ![self writeValue:self.JSONObject]) {
+                return [self failWithError:error];
+            }
+            continue;
+        }
+
+        if (_numberOfFrames == 0) {
+            self.finished = YES;
+            break;
+        }
+
+        AFJSONBodyWriterFrame *frame = &_frames[_numberOfFrames - 1];
+        if (frame->index == frame->count) {
+            AFJSONBodyBufferAppendByte(&_buffer, frame->isDictionary ? '}' : ']');
+            [self popFrame];
+            continue;
+        }
+
+        NSUInteger index = frame->index++;
+        if (index > 0) {
+            AFJSONBodyBufferAppendByte(&_buffer, ',');
+        }
+
+        if (frame->isDictionary) {
+            id key = frame->keys[index];
+            if (![key isKindOfClass:[NSString class]] || !AFJSONBodyBufferAppendString(&_buffer, key)) {
+                return [self failWithError:error];
+            }
+            AFJSONBodyBufferAppendByte(&_buffer, ':');
+        }
+
+        //writeValue:可能会扩容遍历栈，之后不能再使用frame
+        if (![self writeValue:frame->objects[index]]) {
+            return [self failWithError:error];
+        }
+    }
+
+    return YES;
+}
+
+- (NSUInteger)readBytes:(uint8_t *)bytes
+              maxLength:(NSUInteger)length
+{
+    NSUInteger numberOfBytesRead = MIN(length, _buffer.length - _bufferOffset);
+    memcpy(bytes, _buffer.bytes + _bufferOffset, numberOfBytesRead);
+    _bufferOffset += numberOfBytesRead;
+
+    return numberOfBytesRead;
+}
+
+//写入一个json值，容器只写入开始符号并入栈，其中的元素在之后的循环中写入
+- (BOOL)writeValue:(id)value {
+    if ([value isKindOfClass:[NSString class]]) {
+        return AFJSONBodyBufferAppendString(&_buffer, value);
+    } else if ([value isKindOfClass:[NSNumber class]]) {
+        return AFJSONBodyBufferAppendNumber(&_buffer, value);
+    } else if ([value isKindOfClass:[NSDictionary class]]) {
+        AFJSONBodyBufferAppendByte(&_buffer, '{');
+        [self pushFrameWithContainer:value isDictionary:YES];
+        return YES;
+    } else if ([value isKindOfClass:[NSArray class]]) {
+        AFJSONBodyBufferAppendByte(&_buffer, '[');
+        [self pushFrameWithContainer:value isDictionary:NO];
+        return YES;
+    } else if ([value isKindOfClass:[NSNull class]]) {
+        AFJSONBodyBufferAppend(&_buffer, "null", 4);
+        return YES;
+    }
+
+    return NO;
+}
+
+//容器入栈，一次取出所有元素，避免每个元素一次消息发送和字典查找
+- (void)pushFrameWithContainer:(id)container
+                  isDictionary:(BOOL)isDictionary
+{
+    if (_numberOfFrames == _framesCapacity) {
+        _framesCapacity = MAX(_framesCapacity * 2, (NSUInteger)16);
+        _frames = reallocf(_frames, _framesCapacity * sizeof(AFJSONBodyWriterFrame));
+    }
+
+    AFJSONBodyWriterFrame *frame = &_frames[_numberOfFrames++];
+    frame->count = [container count];
+    frame->index = 0;
+    frame->isDictionary = isDictionary;
+    frame->objects = (__unsafe_unretained id *)calloc(MAX(frame->count, (NSUInteger)1), sizeof(id));
+    frame->keys = NULL;
+
+    if (isDictionary) {
+        frame->keys = (__unsafe_unretained id *)calloc(MAX(frame->count, (NSUInteger)1), sizeof(id));
+        [(NSDictionary *)container getObjects:frame->objects andKeys:frame->keys count:frame->count];
+    } else {
+        [(NSArray *)container getObjects:frame->objects range:NSMakeRange(0, frame->count)];
+    }
+}
+
+- (void)popFrame {
+    AFJSONBodyWriterFrame *frame = &_frames[--_numberOfFrames];
+    free(frame->objects);
+    free(frame->keys);
+}
+
+- (BOOL)failWithError:(NSError * __autoreleasing *)error {
+    self.finished = YES;
+    if (error) {
+        *error = AFJSONBodyWriterInvalidParametersError();
+    }
+
+    return NO;
+}
+
+@end
+
+#pragma mark -
+
+/**
+ 边读取边编码的json body流，整个body不会同时保存在内存中
+ */
+@interface AFJSONBodyStream : NSInputStream <NSStreamDelegate>
+//需要编码的json对象
+@property (readonly, nonatomic, strong) id JSONObject;
+//编码后的总长度
+@property (readonly, nonatomic, assign) unsigned long long contentLength;
+
+- (instancetype)initWithJSONObject:(id)JSONObject
+                     contentLength:(unsigned long long)contentLength;
+@end
+
+@interface AFJSONBodyStream () <NSCopying>
+@property (readwrite, nonatomic, strong) id JSONObject;
+@property (readwrite, nonatomic, assign) unsigned long long contentLength;
+//json写入器，每次打开流时重新创建
+@property (readwrite, nonatomic, strong) AFJSONBodyWriter *writer;
+@end
+
+@implementation AFJSONBodyStream
+#if (defined(__IPHONE_OS_VERSION_MAX_ALLOWED) && __IPHONE_OS_VERSION_MAX_ALLOWED >= 80000) || (defined(__MAC_OS_X_VERSION_MAX_ALLOWED) && __MAC_OS_X_VERSION_MAX_ALLOWED >= 1100)
+@synthesize delegate;
+#endif
+@synthesize streamStatus;
+@synthesize streamError;
+
+- (instancetype)initWithJSONObject:(id)JSONObject
+                     contentLength:(unsigned long long)contentLength
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.JSONObject = JSONObject;
+    self.contentLength = contentLength;
+
+    return self;
+}
+
+#pragma mark - NSInputStream
+
+- (NSInteger)read:(uint8_t *)buffer
+        maxLength:(NSUInteger)length
+{
+    if ([self streamStatus] != NSStreamStatusOpen) {
+        return 0;
+    }
+
+    //缓存读完后再编码下一块
+    if (![self.writer hasBytesAvailable]) {
+        NSError *error = nil;
+        if (![self.writer writeUntilBufferLength:kAFJSONBodyWriterChunkSize error:&error]) {
+            self.streamError = error;
+            self.streamStatus = NSStreamStatusError;
+            return -1;
+        }
+    }
+
+    NSUInteger numberOfBytesRead = [self.writer readBytes:buffer maxLength:length];
+    if (numberOfBytesRead == 0 && [self.writer isFinished]) {
+        self.streamStatus = NSStreamStatusAtEnd;
+    }
+
+    return (NSInteger)numberOfBytesRead;
+}
+
+- (BOOL)getBuffer:(__unused uint8_t **)buffer
+           length:(__unused NSUInteger *)len
+{
+    return NO;
+}
+
+- (BOOL)hasBytesAvailable {
+    return [self streamStatus] == NSStreamStatusOpen;
+}
+
+#pragma mark - NSStream
+
+- (void)open {
+    if (self.streamStatus == NSStreamStatusOpen) {
+        return;
+    }
+
+    self.streamStatus = NSStreamStatusOpen;
+    self.writer = [[AFJSONBodyWriter alloc] initWithJSONObject:self.JSONObject];
+}
+
+- (void)close {
+    self.streamStatus = NSStreamStatusClosed;
+    self.writer = nil;
+}
+
+- (id)propertyForKey:(__unused NSString *)key {
+    return nil;
+}
+
+- (BOOL)setProperty:(__unused id)property
+             forKey:(__unused NSString *)key
+{
+    return NO;
+}
+
+- (void)scheduleInRunLoop:(__unused NSRunLoop *)aRunLoop
+                  forMode:(__unused NSString *)mode
+{}
+
+- (void)removeFromRunLoop:(__unused NSRunLoop *)aRunLoop
+                  forMode:(__unused NSString *)mode
+{}
+
+#pragma mark - Undocumented CFReadStream Bridged Methods
+
+- (void)_scheduleInCFRunLoop:(__unused CFRunLoopRef)aRunLoop
+                     forMode:(__unused CFStringRef)aMode
+{}
+
+- (void)_unscheduleFromCFRunLoop:(__unused CFRunLoopRef)aRunLoop
+                         forMode:(__unused CFStringRef)aMode
+{}
+
+- (BOOL)_setCFClientFlags:(__unused CFOptionFlags)inFlags
+                 callback:(__unused CFReadStreamClientCallBack)inCallback
+                  context:(__unused CFStreamClientContext *)inContext {
+    return NO;
+}
+
+#pragma mark - NSCopying
+
+//NSURLSession需要重新发送body时会拷贝流，拷贝出的流从头开始编码
+- (instancetype)copyWithZone:(NSZone *)zone {
+    return [[[self class] allocWithZone:zone] initWithJSONObject:self.JSONObject contentLength:self.contentLength];
+}
+
+@end
+
+#pragma mark -
+
+@implementation AFJSONRequestSerializer
+
+//返回一个默认的AFJSONRequestSerializer
++ (instancetype)serializer {
+    return [self serializerWithWritingOptions:(NSJSONWritingOptions)0];
+}
+
+//返回一个默认的AFJSONRequestSerializer
++ (instancetype)serializerWithWritingOptions:(NSJSONWritingOptions)writingOptions
+{
+    AFJSONRequestSerializer *serializer = [[self alloc] init];
+    serializer.writingOptions = writingOptions;
+
+    return serializer;
+}
+
+#pragma mark - AFURLRequestSerialization
+
+- (NSURLRequest *)requestBySerializingRequest:(NSURLRequest *)request
+                               withParameters:(id)parameters
+                                        error:(NSError *__autoreleasing *)error
+{
+    NSParameterAssert(request);
+
+    //如果Http请求中的参数都已经序列化，直接调用父类方法
+    if ([self.HTTPMethodsEncodingParametersInURI containsObject:[[request HTTPMethod] uppercaseString]]) {
+        return [super requestBySerializingRequest:request withParameters:parameters error:error];
+    }
+
+    NSMutableURLRequest *mutableRequest = [request mutableCopy];
+
+    //拼接json的序列化请求
+    [self.snapshot applyHTTPRequestHeadersToRequest:mutableRequest];
+
+    if (parameters) {
+        if (![mutableRequest valueForHTTPHeaderField:@"Content-Type"]) {
+            [mutableRequest setValue:@"application/json" forHTTPHeaderField:@"Content-Type"];
         }
 
-        NSData *jsonData = [NSJSONSerialization dataWithJSONObject:parameters options:self.writingOptions error:error];
-        
-        if (!jsonData) {
-            return nil;
+        //默认的写入选项使用单次遍历的json写入器，校验和编码同时完成
+        if (self.writingOptions == 0 && self.streamsHTTPBody) {
+            //先校验并计算长度，上传时再分块编码
+            unsigned long long contentLength = 0;
+            if (![AFJSONBodyWriter getLength:&contentLength ofJSONObject:parameters error:error]) {
+                return nil;
+            }
+
+            [mutableRequest setHTTPBodyStream:[[AFJSONBodyStream alloc] initWithJSONObject:parameters contentLength:contentLength]];
+            [mutableRequest setValue:[NSString stringWithFormat:@"%llu", contentLength] forHTTPHeaderField:@"Content-Length"];
+        } else if (self.writingOptions == 0) {
+            NSData *jsonData = [AFJSONBodyWriter dataWithJSONObject:parameters error:error];
+            if (!jsonData) {
+                return nil;
+            }
+
+            [mutableRequest setHTTPBody:jsonData];
+        } else {
+            if (![NSJSONSerialization isValidJSONObject:parameters]) {
+                if (error) {
+                    *error = AFJSONBodyWriterInvalidParametersError();
+                }
+                return nil;
+            }
+
+            NSData *jsonData = [NSJSONSerialization dataWithJSONObject:parameters options:self.writingOptions error:error];
+
+            if (!jsonData) {
+                return nil;
+            }
+
+            [mutableRequest setHTTPBody:jsonData];
         }
-        
-        [mutableRequest setHTTPBody:jsonData];
     }
 
     return mutableRequest;
@@ -1442,6 +2839,7 @@ typedef enum {
     }
 
     self.writingOptions = [[decoder decodeObjectOfClass:[NSNumber class] forKey:NSStringFromSelector(@selector(writingOptions))] unsignedIntegerValue];
+    self.streamsHTTPBody = [decoder decodeBoolForKey:NSStringFromSelector(@selector(streamsHTTPBody))];
 
     return self;
 }
@@ -1451,6 +2849,7 @@ typedef enum {
     [super encodeWithCoder:coder];
 
     [coder encodeInteger:self.writingOptions forKey:NSStringFromSelector(@selector(writingOptions))];
+    [coder encodeBool:self.streamsHTTPBody forKey:NSStringFromSelector(@selector(streamsHTTPBody))];
 }
 
 #pragma mark - NSCopying
@@ -1458,6 +2857,7 @@ typedef enum {
 - (instancetype)copyWithZone:(NSZone *)zone {
     AFJSONRequestSerializer *serializer = [super copyWithZone:zone];
     serializer.writingOptions = self.writingOptions;
+    serializer.streamsHTTPBody = self.streamsHTTPBody;
 
     return serializer;
 }
@@ -1499,11 +2899,7 @@ typedef enum {
 
     NSMutableURLRequest *mutableRequest = [request mutableCopy];
 
-    [self.HTTPRequestHeaders enumerateKeysAndObjectsUsingBlock:^(id field, id value, BOOL * __unused stop) {
-        if (![request valueForHTTPHeaderField:field]) {
-            [mutableRequest setValue:value forHTTPHeaderField:field];
-        }
-    }];
+    [self.snapshot applyHTTPRequestHeadersToRequest:mutableRequest];
 
     if (parameters) {
         if (![mutableRequest valueForHTTPHeaderField:@"Content-Type"]) {
@@ -1555,3 +2951,319 @@ typedef enum {
 }
 
 @end
+
+#pragma mark -
+
+//二进制请求体的编码格式
+typedef NS_ENUM(NSInteger, AFBinaryBodyFormat) {
+    AFBinaryBodyFormatMessagePack = 0,
+    AFBinaryBodyFormatCBOR        = 1,
+};
+
+//编码时允许的最大嵌套层数，避免循环引用的容器导致无限递归
+static NSUInteger const kAFBinaryBodyMaximumDepth = 1024;
+
+//参数无法编码时返回的错误
+static NSError * AFBinaryBodyInvalidParametersError(AFBinaryBodyFormat format) {
+    NSString *failureReason = format == AFBinaryBodyFormatMessagePack ? NSLocalizedStringFromTable(@"The `parameters` argument is not valid MessagePack.", @"AFNetworking", nil) : NSLocalizedStringFromTable(@"The `parameters` argument is not valid CBOR.", @"AFNetworking", nil);
+    return [[NSError alloc] initWithDomain:AFURLRequestSerializationErrorDomain code:NSURLErrorCannotDecodeContentData userInfo:@{NSLocalizedFailureReasonErrorKey: failureReason}];
+}
+
+//按大端字节序追加整数的低length个字节
+static inline void AFBinaryBodyBufferAppendBigEndian(AFJSONBodyBuffer *buffer, uint64_t value, NSUInteger length) {
+    AFJSONBodyBufferReserve(buffer, length);
+    for (NSUInteger idx = 0; idx < length; idx++) {
+        buffer->bytes[buffer->length + idx] = (uint8_t)(value >> (8 * (length - idx - 1)));
+    }
+    buffer->length += length;
+}
+
+static inline void AFBinaryBodyBufferAppendTypedValue(AFJSONBodyBuffer *buffer, uint8_t type, uint64_t value, NSUInteger length) {
+    AFJSONBodyBufferAppendByte(buffer, type);
+    AFBinaryBodyBufferAppendBigEndian(buffer, value, length);
+}
+
+static inline uint64_t AFBinaryBodyBitsOfDouble(double value) {
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+//CBOR的数据项头，主类型在高3位，长度或数值使用最短的编码
+static void AFCBORBufferAppendHead(AFJSONBodyBuffer *buffer, uint8_t majorType, uint64_t value) {
+    uint8_t type = (uint8_t)(majorType << 5);
+    if (value < 24) {
+        AFJSONBodyBufferAppendByte(buffer, type | (uint8_t)value);
+    } else if (value <= UINT8_MAX) {
+        AFBinaryBodyBufferAppendTypedValue(buffer, type | 24, value, 1);
+    } else if (value <= UINT16_MAX) {
+        AFBinaryBodyBufferAppendTypedValue(buffer, type | 25, value, 2);
+    } else if (value <= UINT32_MAX) {
+        AFBinaryBodyBufferAppendTypedValue(buffer, type | 26, value, 4);
+    } else {
+        AFBinaryBodyBufferAppendTypedValue(buffer, type | 27, value, 8);
+    }
+}
+
+//MessagePack的长度头，fixType为0时表示该类型没有fix格式
+static void AFMessagePackBufferAppendLength(AFJSONBodyBuffer *buffer, uint64_t length, uint8_t fixType, uint64_t fixMaximum, uint8_t type8, uint8_t type16, uint8_t type32) {
+    if (fixType && length <= fixMaximum) {
+        AFJSONBodyBufferAppendByte(buffer, fixType | (uint8_t)length);
+    } else if (type8 && length <= UINT8_MAX) {
+        AFBinaryBodyBufferAppendTypedValue(buffer, type8, length, 1);
+    } else if (length <= UINT16_MAX) {
+        AFBinaryBodyBufferAppendTypedValue(buffer, type16, length, 2);
+    } else {
+        AFBinaryBodyBufferAppendTypedValue(buffer, type32, length, 4);
+    }
+}
+
+static void AFBinaryBodyBufferAppendUnsignedInteger(AFJSONBodyBuffer *buffer, uint64_t value, AFBinaryBodyFormat format) {
+    if (format == AFBinaryBodyFormatCBOR) {
+        AFCBORBufferAppendHead(buffer, 0, value);
+    } else if (value <= 0x7f) {
+        AFJSONBodyBufferAppendByte(buffer, (uint8_t)value);
+    } else if (value <= UINT8_MAX) {
+        AFBinaryBodyBufferAppendTypedValue(buffer, 0xcc, value, 1);
+    } else if (value <= UINT16_MAX) {
+        AFBinaryBodyBufferAppendTypedValue(buffer, 0xcd, value, 2);
+    } else if (value <= UINT32_MAX) {
+        AFBinaryBodyBufferAppendTypedValue(buffer, 0xce, value, 4);
+    } else {
+        AFBinaryBodyBufferAppendTypedValue(buffer, 0xcf, value, 8);
+    }
+}
+
+static void AFBinaryBodyBufferAppendInteger(AFJSONBodyBuffer *buffer, int64_t value, AFBinaryBodyFormat format) {
+    if (value >= 0) {
+        AFBinaryBodyBufferAppendUnsignedInteger(buffer, (uint64_t)value, format);
+    } else if (format == AFBinaryBodyFormatCBOR) {
+        //CBOR负整数编码为-1-value
+        AFCBORBufferAppendHead(buffer, 1, ~(uint64_t)value);
+    } else if (value >= -32) {
+        AFJSONBodyBufferAppendByte(buffer, (uint8_t)value);
+    } else if (value >= INT8_MIN) {
+        AFBinaryBodyBufferAppendTypedValue(buffer, 0xd0, (uint64_t)value, 1);
+    } else if (value >= INT16_MIN) {
+        AFBinaryBodyBufferAppendTypedValue(buffer, 0xd1, (uint64_t)value, 2);
+    } else if (value >= INT32_MIN) {
+        AFBinaryBodyBufferAppendTypedValue(buffer, 0xd2, (uint64_t)value, 4);
+    } else {
+        AFBinaryBodyBufferAppendTypedValue(buffer, 0xd3, (uint64_t)value, 8);
+    }
+}
+
+static void AFBinaryBodyBufferAppendDouble(AFJSONBodyBuffer *buffer, double value, AFBinaryBodyFormat format) {
+    AFBinaryBodyBufferAppendTypedValue(buffer, format == AFBinaryBodyFormatCBOR ? 0xfb : 0xcb, AFBinaryBodyBitsOfDouble(value), 8);
+}
+
+static void AFBinaryBodyBufferAppendNumber(AFJSONBodyBuffer *buffer, NSNumber *number, AFBinaryBodyFormat format) {
+    if (CFGetTypeID((__bridge CFTypeRef)number) == CFBooleanGetTypeID()) {
+        BOOL value = [number boolValue];
+        AFJSONBodyBufferAppendByte(buffer, format == AFBinaryBodyFormatCBOR ? (value ? 0xf5 : 0xf4) : (value ? 0xc3 : 0xc2));
+        return;
+    }
+
+    const char *objCType = [number objCType];
+    if (strcmp(objCType, @encode(double)) == 0 || strcmp(objCType, @encode(float)) == 0) {
+        AFBinaryBodyBufferAppendDouble(buffer, [number doubleValue], format);
+    } else if (strcmp(objCType, @encode(unsigned long long)) == 0) {
+        AFBinaryBodyBufferAppendUnsignedInteger(buffer, [number unsignedLongLongValue], format);
+    } else {
+        AFBinaryBodyBufferAppendInteger(buffer, [number longLongValue], format);
+    }
+}
+
+//追加UTF-8字符串，ASCII字符串直接访问内部存储，其他字符串直接转换到缓存中
+static BOOL AFBinaryBodyBufferAppendString(AFJSONBodyBuffer *buffer, NSString *string, AFBinaryBodyFormat format) {
+    CFStringRef stringRef = (__bridge CFStringRef)string;
+    const char *ASCIIString = CFStringGetCStringPtr(stringRef, kCFStringEncodingASCII);
+    NSUInteger length = ASCIIString ? (NSUInteger)CFStringGetLength(stringRef) : [string lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    if (length == 0 && [string length] > 0) {
+        return NO;
+    }
+
+    if (format == AFBinaryBodyFormatCBOR) {
+        AFCBORBufferAppendHead(buffer, 3, length);
+    } else {
+        AFMessagePackBufferAppendLength(buffer, length, 0xa0, 31, 0xd9, 0xda, 0xdb);
+    }
+
+    if (ASCIIString) {
+        AFJSONBodyBufferAppend(buffer, ASCIIString, length);
+        return YES;
+    }
+
+    AFJSONBodyBufferReserve(buffer, length);
+    NSUInteger usedLength = 0;
+    if (![string getBytes:buffer->bytes + buffer->length maxLength:length usedLength:&usedLength encoding:NSUTF8StringEncoding options:(NSStringEncodingConversionOptions)0 range:NSMakeRange(0, [string length]) remainingRange:NULL] || usedLength != length) {
+        return NO;
+    }
+    buffer->length += length;
+
+    return YES;
+}
+
+//日期在MessagePack中编码为时间戳扩展类型(-1)，在CBOR中编码为标签1的浮点数秒数
+static void AFBinaryBodyBufferAppendDate(AFJSONBodyBuffer *buffer, NSDate *date, AFBinaryBodyFormat format) {
+    NSTimeInterval timeInterval = [date timeIntervalSince1970];
+    if (format == AFBinaryBodyFormatCBOR) {
+        AFCBORBufferAppendHead(buffer, 6, 1);
+        AFBinaryBodyBufferAppendDouble(buffer, timeInterval, format);
+        return;
+    }
+
+    int64_t seconds = (int64_t)floor(timeInterval);
+    uint32_t nanoseconds = (uint32_t)MIN(llround((timeInterval - seconds) * NSEC_PER_SEC), 999999999LL);
+    if (seconds >= 0 && seconds <= UINT32_MAX && nanoseconds == 0) {
+        AFJSONBodyBufferAppend(buffer, "\xd6\xff", 2);
+        AFBinaryBodyBufferAppendBigEndian(buffer, (uint64_t)seconds, 4);
+    } else if (seconds >= 0 && (uint64_t)seconds < (1ULL << 34)) {
+        AFJSONBodyBufferAppend(buffer, "\xd7\xff", 2);
+        AFBinaryBodyBufferAppendBigEndian(buffer, ((uint64_t)nanoseconds << 34) | (uint64_t)seconds, 8);
+    } else {
+        AFJSONBodyBufferAppend(buffer, "\xc7\x0c\xff", 3);
+        AFBinaryBodyBufferAppendBigEndian(buffer, nanoseconds, 4);
+        AFBinaryBodyBufferAppendBigEndian(buffer, (uint64_t)seconds, 8);
+    }
+}
+
+//单次遍历编码对象，遇到不支持的类型或者嵌套过深时返回NO
+static BOOL AFBinaryBodyBufferAppendObject(AFJSONBodyBuffer *buffer, id object, AFBinaryBodyFormat format, NSUInteger depth) {
+    if (depth > kAFBinaryBodyMaximumDepth) {
+        return NO;
+    }
+
+    if ([object isKindOfClass:[NSString class]]) {
+        return AFBinaryBodyBufferAppendString(buffer, object, format);
+    } else if ([object isKindOfClass:[NSDecimalNumber class]]) {
+        //十进制数编码为浮点数会丢失精度，编码为字符串
+        return AFBinaryBodyBufferAppendString(buffer, [object stringValue], format);
+    } else if ([object isKindOfClass:[NSNumber class]]) {
+        AFBinaryBodyBufferAppendNumber(buffer, object, format);
+    } else if ([object isKindOfClass:[NSDictionary class]]) {
+        NSDictionary *dictionary = object;
+        if (format == AFBinaryBodyFormatCBOR) {
+            AFCBORBufferAppendHead(buffer, 5, [dictionary count]);
+        } else {
+            AFMessagePackBufferAppendLength(buffer, [dictionary count], 0x80, 15, 0, 0xde, 0xdf);
+        }
+
+        //快速枚举比block枚举每层占用的栈更少
+        for (id key in dictionary) {
+            if (!AFBinaryBodyBufferAppendObject(buffer, key, format, depth + 1) || !AFBinaryBodyBufferAppendObject(buffer, dictionary[key], format, depth + 1)) {
+                return NO;
+            }
+        }
+    } else if ([object isKindOfClass:[NSArray class]]) {
+        NSArray *array = object;
+        if (format == AFBinaryBodyFormatCBOR) {
+            AFCBORBufferAppendHead(buffer, 4, [array count]);
+        } else {
+            AFMessagePackBufferAppendLength(buffer, [array count], 0x90, 15, 0, 0xdc, 0xdd);
+        }
+
+        for (id value in array) {
+            if (!AFBinaryBodyBufferAppendObject(buffer, value, format, depth + 1)) {
+                return NO;
+            }
+        }
+    } else if ([object isKindOfClass:[NSData class]]) {
+        NSData *data = object;
+        if (format == AFBinaryBodyFormatCBOR) {
+            AFCBORBufferAppendHead(buffer, 2, [data length]);
+        } else {
+            AFMessagePackBufferAppendLength(buffer, [data length], 0, 0, 0xc4, 0xc5, 0xc6);
+        }
+        AFJSONBodyBufferAppend(buffer, [data bytes], [data length]);
+    } else if ([object isKindOfClass:[NSDate class]]) {
+        AFBinaryBodyBufferAppendDate(buffer, object, format);
+    } else if (object == [NSNull null]) {
+        AFJSONBodyBufferAppendByte(buffer, format == AFBinaryBodyFormatCBOR ? 0xf6 : 0xc0);
+    } else {
+        return NO;
+    }
+
+    return YES;
+}
+
+//编码参数，失败时返回nil
+static NSData * AFBinaryBodyDataWithObject(id object, AFBinaryBodyFormat format, NSError * __autoreleasing *error) {
+    AFJSONBodyBuffer buffer = {NULL, 0, 0};
+    if (!AFBinaryBodyBufferAppendObject(&buffer, object, format, 0)) {
+        free(buffer.bytes);
+        if (error) {
+            *error = AFBinaryBodyInvalidParametersError(format);
+        }
+        return nil;
+    }
+
+    //缓存直接交给NSData，不再拷贝
+    return [NSData dataWithBytesNoCopy:buffer.bytes length:buffer.length freeWhenDone:YES];
+}
+
+//编码参数后设置为请求体，GET、HEAD和DELETE请求的参数由调用方交给父类放在url中
+static NSURLRequest * AFBinaryRequestBySerializingRequest(AFHTTPRequestSerializer *serializer, NSURLRequest *request, id parameters, AFBinaryBodyFormat format, NSString *contentType, NSError * __autoreleasing *error) {
+    NSMutableURLRequest *mutableRequest = [request mutableCopy];
+
+    [serializer.snapshot applyHTTPRequestHeadersToRequest:mutableRequest];
+
+    if (parameters) {
+        if (![mutableRequest valueForHTTPHeaderField:@"Content-Type"]) {
+            [mutableRequest setValue:contentType forHTTPHeaderField:@"Content-Type"];
+        }
+
+        NSData *bodyData = AFBinaryBodyDataWithObject(parameters, format, error);
+        if (!bodyData) {
+            return nil;
+        }
+
+        [mutableRequest setHTTPBody:bodyData];
+    }
+
+    return mutableRequest;
+}
+
+#pragma mark -
+
+@implementation AFMessagePackRequestSerializer
+
+#pragma mark - AFURLRequestSerialization
+
+//生成MessagePack请求
+- (NSURLRequest *)requestBySerializingRequest:(NSURLRequest *)request
+                               withParameters:(id)parameters
+                                        error:(NSError *__autoreleasing *)error
+{
+    NSParameterAssert(request);
+
+    if ([self.HTTPMethodsEncodingParametersInURI containsObject:[[request HTTPMethod] uppercaseString]]) {
+        return [super requestBySerializingRequest:request withParameters:parameters error:error];
+    }
+
+    return AFBinaryRequestBySerializingRequest(self, request, parameters, AFBinaryBodyFormatMessagePack, @"application/msgpack", error);
+}
+
+@end
+
+#pragma mark -
+
+@implementation AFCBORRequestSerializer
+
+#pragma mark - AFURLRequestSerialization
+
+//生成CBOR请求
+- (NSURLRequest *)requestBySerializingRequest:(NSURLRequest *)request
+                               withParameters:(id)parameters
+                                        error:(NSError *__autoreleasing *)error
+{
+    NSParameterAssert(request);
+
+    if ([self.HTTPMethodsEncodingParametersInURI containsObject:[[request HTTPMethod] uppercaseString]]) {
+        return [super requestBySerializingRequest:request withParameters:parameters error:error];
+    }
+
+    return AFBinaryRequestBySerializingRequest(self, request, parameters, AFBinaryBodyFormatCBOR, @"application/cbor", error);
+}
+
+@end
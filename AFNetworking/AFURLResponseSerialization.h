@@ -48,6 +48,30 @@ NS_ASSUME_NONNULL_BEGIN
 
 @end
 
+/**
+ The `AFURLResponseStreamSerialization` protocol is adopted by response serializers that can also decode a response body read from a stream, such as a downloaded file, without loading it in memory first.
+
+ @see `AFURLSessionManager -downloadTaskWithRequest:progress:destination:serializingCompletionHandler:`
+ */
+//可以从输入流解码响应数据的响应序列化协议，比如下载好的文件，不需要先把数据读进内存
+@protocol AFURLResponseStreamSerialization <AFURLResponseSerialization>
+
+/**
+ The response object decoded from the body of a specified response, read from a stream.
+
+ @param response The response to be processed.
+ @param inputStream An unopened stream of the response body.
+ @param error The error that occurred while attempting to decode the response body.
+
+ @return The object decoded from the specified stream.
+ */
+//从输入流解码响应数据，输入流还没有打开
+- (nullable id)responseObjectForResponse:(nullable NSURLResponse *)response
+                             inputStream:(NSInputStream *)inputStream
+                                   error:(NSError * _Nullable __autoreleasing *)error NS_SWIFT_NOTHROW;
+
+@end
+
 #pragma mark -
 
 /**
@@ -82,6 +106,8 @@ NS_ASSUME_NONNULL_BEGIN
 
 /**
  The acceptable MIME types for responses. When non-`nil`, responses with a `Content-Type` with MIME types that do not intersect with the set will result in an error during validation.
+
+ Entries of the form `type/*` accept every subtype of `type`, and `*/*` accepts every MIME type. When the set contains `application/json`, MIME types with a `+json` structured syntax suffix, such as `application/problem+json`, are accepted as well.
  */
 //设置Http响应的合法状态类型队列
 @property (nonatomic, copy, nullable) NSSet <NSString *> *acceptableContentTypes;
@@ -107,6 +133,12 @@ NS_ASSUME_NONNULL_BEGIN
 #pragma mark -
 
 
+//JSON响应的解码实现
+typedef NS_ENUM(NSUInteger, AFJSONReadingBackend) {
+    AFJSONReadingBackendFoundation = 0,     //使用NSJSONSerialization解码
+    AFJSONReadingBackendStructuralIndex,    //先用向量指令找出所有结构字符的位置，再按位置构建对象
+};
+
 /**
  `AFJSONResponseSerializer` is a subclass of `AFHTTPResponseSerializer` that validates and decodes JSON responses.
 
@@ -130,10 +162,30 @@ NS_ASSUME_NONNULL_BEGIN
 
 /**
  Whether to remove keys with `NSNull` values from response JSON. Defaults to `NO`.
+
+ When `YES`, responses are decoded with the structural index regardless of `readingBackend`, so keys are dropped while containers are built instead of in a second pass over the decoded objects. Only responses the structural index does not handle, those that start with a byte order mark or are encoded as UTF-16 or UTF-32, are decoded with `NSJSONSerialization` and then cleaned in a second pass.
  */
-//是否移除响应的json数据中value为NSNull的Key.默认为NO
+//是否移除响应的json数据中value为NSNull的Key.默认为NO。为YES时使用结构索引解码，构建容器时直接去掉NSNull
 @property (nonatomic, assign) BOOL removesKeysWithNullValues;
 
+/**
+ Whether to decode the response JSON lazily. Defaults to `NO`.
+
+ When `YES`, the response data is validated and a compact structural index is built in a single pass. Objects and arrays are returned as immutable `NSDictionary` and `NSArray` instances backed by the response data, which decode their strings, numbers and nested containers only when they are first accessed, so the cost scales with the values the app reads rather than with the size of the payload. Decoded values are cached, and the returned objects are safe to read from multiple threads.
+
+ Lazy decoding does not apply when `readingOptions` contains `NSJSONReadingMutableContainers` or `NSJSONReadingMutableLeaves`, or to responses that start with a byte order mark or are encoded as UTF-16 or UTF-32; such responses are decoded eagerly.
+ */
+//是否延迟解码：只建立结构索引，访问到的值才解码，默认为NO
+@property (nonatomic, assign) BOOL decodesLazily;
+
+/**
+ The implementation used to decode response JSON eagerly. `AFJSONReadingBackendFoundation` by default.
+
+ `AFJSONReadingBackendStructuralIndex` decodes in two stages: the first classifies quotes, escapes and structural characters 64 bytes at a time, using SSE2 on x86_64 and NEON on arm64 with a scalar fallback elsewhere, and records their positions; the second walks those positions to validate the grammar and build the object tree, creating each container once. It honors `readingOptions` and produces objects equal to those returned by `NSJSONSerialization`, and keys with `NSNull` values are dropped while containers are built when `removesKeysWithNullValues` is `YES`. Responses that start with a byte order mark or are encoded as UTF-16 or UTF-32 are decoded with `NSJSONSerialization`. This property has no effect when `decodesLazily` is `YES`.
+ */
+//立即解码时使用的实现，默认为AFJSONReadingBackendFoundation
+@property (nonatomic, assign) AFJSONReadingBackend readingBackend;
+
 /**
  Creates and returns a JSON serializer with specified reading and writing options.
 
@@ -146,6 +198,328 @@ NS_ASSUME_NONNULL_BEGIN
 
 #pragma mark -
 
+/**
+ The `AFJSONModel` protocol is adopted by model classes that `AFJSONModelResponseSerializer` can decode directly from JSON.
+ */
+//可以直接从JSON解码的模型类
+@protocol AFJSONModel <NSObject>
+
+/**
+ The JSON key paths of the properties to decode, keyed by property name. Key paths use `.` to reach into nested objects, for example `@"avatar_image.url"`. Properties that are not listed are left untouched.
+ */
+//属性名到JSON key路径的映射，key路径用.访问嵌套的对象
++ (NSDictionary <NSString *, NSString *> *)JSONKeyPathsByPropertyKey;
+
+@optional
+
+/**
+ The model classes of the elements of array properties, keyed by property name. Properties declared with a class that adopts `AFJSONModel` are decoded as models without being listed here.
+ */
+//元素为模型的数组属性对应的模型类
++ (NSDictionary <NSString *, Class> *)JSONModelClassesByPropertyKey;
+
+@end
+
+/**
+ `AFJSONModelResponseSerializer` is a subclass of `AFJSONResponseSerializer` that decodes JSON responses directly into model objects, without building an intermediate tree of Foundation objects.
+
+ The schema of a model class is built from `+JSONKeyPathsByPropertyKey` and the declared types of its properties the first time the class is decoded, and is cached for the lifetime of the process. Values are assigned through the property setters while the structural index of the response is walked: numeric and `BOOL` properties are set without creating `NSNumber` objects, short strings that repeat within a response share a single `NSString` instance, and members whose keys are not mapped are skipped without allocating. Skipped members are checked for balanced brackets and valid literals and numbers, but their strings are not decoded.
+
+ Object properties may be declared as `NSString`, `NSNumber`, `NSURL`, `NSArray`, `NSDictionary`, their mutable subclasses, `id`, or a class adopting `AFJSONModel`. `null` values and values of the wrong type leave the property untouched. Read-only properties are set through their instance variables, and read-only properties without one, such as computed properties, are skipped.
+
+ When `modelClass` is `nil`, responses are decoded as by `AFJSONResponseSerializer`. Otherwise `readingOptions`, `removesKeysWithNullValues`, `decodesLazily` and `readingBackend` do not apply.
+ */
+//把JSON响应直接解码成模型对象，不经过中间的NSDictionary
+@interface AFJSONModelResponseSerializer : AFJSONResponseSerializer
+
+/**
+ The class of the models to decode. The class must adopt `AFJSONModel`.
+ */
+//要解码的模型类
+@property (nonatomic, strong, nullable) Class modelClass;
+
+/**
+ The key path of the value to decode as models, for example `@"data"`. An object is decoded as a single model, and an array as an array of models. If `nil`, the root value is decoded.
+ */
+//要解码成模型的值的key路径，为nil时解码根对象
+@property (nonatomic, copy, nullable) NSString *rootKeyPath;
+
+/**
+ Creates and returns a model serializer for the specified model class and root key path.
+ */
+//使用模型类和key路径创建对象
++ (instancetype)serializerWithModelClass:(Class)modelClass
+                             rootKeyPath:(nullable NSString *)rootKeyPath;
+
+@end
+
+#pragma mark -
+
+/**
+ The `AFURLResponseStreamParsing` protocol is adopted by objects that parse a response body incrementally, as it is received, instead of decoding it once it has been collected in memory.
+
+ @see `AFURLSessionManager -dataTaskWithRequest:streamParser:downloadProgress:completionHandler:`
+ */
+//增量解析响应数据的协议，数据边收边解析，不在内存中拼接
+@protocol AFURLResponseStreamParsing <NSObject>
+
+/**
+ Parses the next chunk of the response body.
+ */
+//解析下一块数据
+- (BOOL)parseData:(NSData *)data
+            error:(NSError * _Nullable __autoreleasing *)error;
+
+/**
+ Finishes parsing after the last chunk of the response body, and returns the response object.
+ */
+//所有数据都解析完以后结束解析，返回响应对象
+- (nullable id)finishParsingWithError:(NSError * _Nullable __autoreleasing *)error;
+
+@optional
+
+/**
+ The response serializer that validates the response before its body is parsed. If `nil`, the response serializer of the session manager is used.
+ */
+//解析数据前用于验证响应的序列化对象，为nil时使用会话管理类的
+@property (readonly, nonatomic, strong, nullable) AFHTTPResponseSerializer *responseSerializer;
+
+/**
+ Sets a block to be executed when the parser cannot keep up with the data it receives and the transfer should be suspended, and again when it can be resumed. Calls always alternate between `YES` and `NO`, starting with `YES`.
+ */
+//设置解析跟不上接收速度需要暂停传输时，和可以恢复传输时执行的block，两种调用交替出现
+- (void)setBackpressureHandler:(nullable void (^)(BOOL shouldSuspend))handler;
+
+/**
+ Finishes parsing after the last chunk of the response body, and calls `completionHandler` with the response object once it is ready. When implemented, session managers call this method instead of `finishParsingWithError:`, so that parsers waiting for work on other queues do not block a thread.
+
+ @param completionHandler A block object to be executed on any queue with the response object and the error that occurred, if any.
+ */
+//异步结束解析，响应对象准备好后回调。实现时会话管理类使用这个方法，不占用线程等待
+- (void)finishParsingWithCompletionHandler:(void (^)(id _Nullable responseObject, NSError * _Nullable error))completionHandler;
+
+@end
+
+#pragma mark -
+
+/**
+ `AFJSONStreamParser` parses UTF-8 JSON incrementally as it is fed chunks of data, building objects as their tokens complete.
+
+ Elements of large arrays can be handed out one at a time as each one is parsed, instead of being collected into the document. Only the parser state, the partial token and the element currently being built are kept in memory, so a very large response made of one big array can be processed with a fixed working set.
+
+ A parser is not thread safe, and should be fed from one queue at a time.
+ */
+//增量解析json，每收到一块数据就解析一块，大数组的元素可以解析完一个交出一个，不放进文档中
+@interface AFJSONStreamParser : NSObject <AFURLResponseStreamParsing>
+
+/**
+ Sets a block to be executed with each element of the arrays at the specified key path, as soon as the element is parsed. Elements handed to the block are not added to the array, which is left empty in the parsed document.
+
+ @param keyPath The dot-separated object keys leading to the array, for example `data.posts`. Arrays along the way are passed through, so `data.posts` also matches the `posts` array of every object in a `data` array. An empty key path matches a top-level array.
+ @param handler A block object to be executed with each element. Setting `stop` to `YES` stops parsing, and the parser fails with an `NSURLErrorCancelled` error. Pass `nil` to remove the handler.
+ */
+//设置指定key path上的数组每解析完一个元素时执行的block，交给block的元素不放进数组
+- (void)setElementHandler:(nullable void (^)(id element, BOOL *stop))handler
+       forArrayAtKeyPath:(NSString *)keyPath;
+
+/**
+ Parses the next chunk of data.
+
+ @param data The next chunk of the JSON document.
+ @param error The error that occurred while parsing, if any. Once an error has occurred, the parser ignores further data and keeps returning that error.
+
+ @return `YES` if the chunk was parsed, otherwise `NO`.
+ */
+//解析下一块数据
+- (BOOL)parseData:(NSData *)data
+            error:(NSError * _Nullable __autoreleasing *)error;
+
+/**
+ Finishes parsing after the last chunk of data, and returns the parsed document.
+
+ @param error The error that occurred while parsing, if any, for example because the document is incomplete.
+
+ @return The parsed document, with the arrays handed out element by element left empty, or `nil` if the document could not be parsed or contained only whitespace.
+ */
+//所有数据都解析完以后结束解析，返回解析出的文档
+- (nullable id)finishParsingWithError:(NSError * _Nullable __autoreleasing *)error;
+
+@end
+
+#pragma mark -
+
+/**
+ `AFJSONLinesResponseSerializer` is a subclass of `AFHTTPResponseSerializer` that validates and decodes newline-delimited JSON (NDJSON / JSON Lines) responses as an array of records. Each non-empty line is parsed independently as one JSON value.
+
+ To process large responses record by record as they arrive, use an `AFJSONLinesStreamParser` instead.
+
+ By default, `AFJSONLinesResponseSerializer` accepts the following MIME types:
+
+ - `application/x-ndjson`
+ - `application/ndjson`
+ - `application/jsonl`
+ - `application/x-jsonlines`
+ */
+//验证并且解码每行一个json值的响应，返回所有记录组成的数组
+@interface AFJSONLinesResponseSerializer : AFHTTPResponseSerializer
+
+//初始化方法
+- (instancetype)init;
+
+/**
+ Options for reading each record and creating the Foundation objects. Fragments are always allowed. `0` by default.
+ */
+//读取每条记录的配置，总是允许顶层不是容器的值，默认为0
+@property (nonatomic, assign) NSJSONReadingOptions readingOptions;
+
+@end
+
+#pragma mark -
+
+/**
+ `AFJSONLinesStreamParser` splits a newline-delimited JSON response into records as its chunks arrive, parses each record independently, and delivers them in batches.
+
+ Records are parsed on the queue the parser is fed from, optionally spreading each batch across threads, and batches are delivered in order, through a private serial queue that targets the queue of the records handler. When the number of batches waiting for the records handler reaches `maximumNumberOfPendingBatches`, the parser asks for the transfer to be suspended until the handler catches up. The backpressure handler is called in order on a private serial queue, outside of the locks of the parser.
+ */
+//把每行一个json值的响应在数据到达时拆分成记录，逐条解析并分批交给调用者，调用者处理不过来时暂停传输
+@interface AFJSONLinesStreamParser : NSObject <AFURLResponseStreamParsing>
+
+/**
+ Initializes a parser that delivers records to the specified block.
+
+ @param recordsHandler A block object to be executed with each batch of records, in order.
+ @param queue The queue the records handler is executed on. If `nil`, the main queue is used.
+ */
+//使用处理每批记录的block和执行block的队列初始化，队列为nil时使用主队列
+- (instancetype)initWithRecordsHandler:(void (^)(NSArray *records))recordsHandler
+                                 queue:(nullable dispatch_queue_t)queue NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ The serializer that validates the response before its body is parsed, and whose `readingOptions` are used for each record. An `AFJSONLinesResponseSerializer` by default.
+ */
+//验证响应的序列化对象，同时提供每条记录的读取配置
+@property (nonatomic, strong) AFJSONLinesResponseSerializer *responseSerializer;
+
+/**
+ The maximum number of records in a batch. `100` by default.
+ */
+//每批最多包含的记录数，默认为100
+@property (nonatomic, assign) NSUInteger batchSize;
+
+/**
+ Whether the records of a batch are parsed concurrently. `NO` by default.
+ */
+//一批中的记录是否并发解析，默认为NO
+@property (nonatomic, assign) BOOL parsesBatchesConcurrently;
+
+/**
+ The number of delivered batches the records handler may fall behind before the transfer is suspended. `0` disables backpressure. `4` by default.
+ */
+//记录处理block落后多少批时暂停传输，为0时不暂停，默认为4
+@property (nonatomic, assign) NSUInteger maximumNumberOfPendingBatches;
+
+/**
+ The number of records parsed so far.
+ */
+//已经解析的记录数
+@property (readonly, nonatomic, assign) NSUInteger numberOfRecords;
+
+/**
+ Finishes parsing after the last chunk of data, delivering the remaining records.
+
+ Unless it is called from the records handler, this method blocks until every batch has been handled, so that the completion handler of a task never runs before its last records are delivered. Session managers use `finishParsingWithCompletionHandler:` instead, which does not block.
+
+ @return The number of records parsed, as an `NSNumber`, or `nil` if a record could not be parsed.
+ */
+//所有数据都解析完以后结束解析，交出剩余的记录，等记录都处理完后返回记录总数
+- (nullable id)finishParsingWithError:(NSError * _Nullable __autoreleasing *)error;
+
+@end
+
+#pragma mark -
+
+/**
+ `AFServerSentEvent` is an event received from a `text/event-stream` response.
+ */
+//text/event-stream响应中的一个事件
+@interface AFServerSentEvent : NSObject
+
+/**
+ The type of the event, from its `event` field. `message` if the event has no type.
+ */
+//事件类型，没有event字段时为message
+@property (readonly, nonatomic, copy) NSString *type;
+
+/**
+ The data of the event. The values of multiple `data` fields are joined with newlines.
+ */
+//事件数据，多个data字段用换行连接
+@property (readonly, nonatomic, copy) NSString *data;
+
+/**
+ The last event ID at the time the event was dispatched, if any.
+ */
+//事件分发时的最后一个事件ID
+@property (readonly, nonatomic, copy, nullable) NSString *identifier;
+
+- (instancetype)initWithType:(NSString *)type
+                        data:(NSString *)data
+                  identifier:(nullable NSString *)identifier NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+#pragma mark -
+
+/**
+ `AFServerSentEventParser` parses a `text/event-stream` response incrementally, dispatching each event as soon as the blank line that ends it arrives.
+
+ Its response serializer accepts the `text/event-stream` MIME type. Events and heartbeats are reported on the queue the parser is fed from. A leading byte order mark is skipped even if it is split across chunks, and invalid UTF-8 sequences are replaced with U+FFFD.
+ */
+//增量解析text/event-stream响应，收到结束事件的空行时立即分发事件
+@interface AFServerSentEventParser : NSObject <AFURLResponseStreamParsing>
+
+/**
+ Initializes a parser that dispatches events to the specified block.
+
+ @param eventHandler A block object to be executed with each event, in order.
+ */
+//使用处理每个事件的block初始化
+- (instancetype)initWithEventHandler:(void (^)(AFServerSentEvent *event))eventHandler NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ The serializer that validates the response before its body is parsed. It accepts `text/event-stream` and status codes in the `2XX` range.
+ */
+//验证响应的序列化对象，接受text/event-stream
+@property (nonatomic, strong) AFHTTPResponseSerializer *responseSerializer;
+
+/**
+ A block object to be executed whenever data arrives, including comment lines that servers send to keep the connection alive.
+ */
+//每次收到数据时执行的block，包括服务器用于保持连接的注释行
+@property (nonatomic, copy, nullable) void (^heartbeatHandler)(void);
+
+/**
+ The last event ID, if any. An `id` field with an empty value resets it to `nil`. Set it before parsing to continue from the last event ID of a previous connection.
+ */
+//最后一个事件ID，空的id字段会把它重置为nil。解析前设置时继续使用之前连接的事件ID
+@property (nonatomic, copy, nullable) NSString *lastEventIdentifier;
+
+/**
+ The reconnection time set by the `retry` field of the stream, or `0` if it has not been set.
+ */
+//流的retry字段设置的重连时间，没有设置时为0
+@property (readonly, nonatomic, assign) NSTimeInterval reconnectionInterval;
+
+@end
+
+#pragma mark -
+
 /**
  `AFXMLParserResponseSerializer` is a subclass of `AFHTTPResponseSerializer` that validates and decodes XML responses as an `NSXMLParser` objects.
 
@@ -153,9 +527,116 @@ NS_ASSUME_NONNULL_BEGIN
 
  - `application/xml`
  - `text/xml`
+
+ To process large responses element by element as they arrive, use an `AFXMLStreamParser` instead. Responses read from a stream, such as downloaded files, are handed to the returned parser as a stream, so the document is never loaded in memory at once.
  */
 //验证并解码http响应中的xml信息
-@interface AFXMLParserResponseSerializer : AFHTTPResponseSerializer
+@interface AFXMLParserResponseSerializer : AFHTTPResponseSerializer <AFURLResponseStreamSerialization>
+
+@end
+
+#pragma mark -
+
+/**
+ `AFXMLElement` is an element of an XML document parsed by `AFXMLStreamParser`.
+ */
+//AFXMLStreamParser解析出的xml元素
+@interface AFXMLElement : NSObject
+
+/**
+ The qualified name of the element, including its namespace prefix if any.
+ */
+//元素名，包括命名空间前缀
+@property (readonly, nonatomic, copy) NSString *name;
+
+/**
+ The attributes of the element, keyed by qualified name, with entity references replaced.
+ */
+//元素的属性
+@property (readonly, nonatomic, copy) NSDictionary <NSString *, NSString *> *attributes;
+
+/**
+ The child elements, in document order. Elements handed out by an element handler of the parser are not included.
+ */
+//子元素，不包括交给元素处理block的元素
+@property (readonly, nonatomic, copy) NSArray <AFXMLElement *> *children;
+
+/**
+ The character data directly contained by the element, including CDATA sections, with entity references replaced. Character data made only of whitespace next to a child element is not included.
+ */
+//元素直接包含的字符数据，子元素旁边只有空白的部分不包括在内
+@property (readonly, nonatomic, copy) NSString *text;
+
+- (instancetype)initWithName:(NSString *)name
+                  attributes:(NSDictionary <NSString *, NSString *> *)attributes
+                    children:(NSArray <AFXMLElement *> *)children
+                        text:(NSString *)text NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ Returns the first child element with the specified name, if any.
+ */
+//第一个指定名字的子元素
+- (nullable AFXMLElement *)childNamed:(NSString *)name;
+
+/**
+ Returns the child elements with the specified name.
+ */
+//所有指定名字的子元素
+- (NSArray <AFXMLElement *> *)childrenNamed:(NSString *)name;
+
+@end
+
+#pragma mark -
+
+/**
+ `AFXMLStreamParser` parses an XML response incrementally with the libxml2 push parser as it is fed chunks of data, building a lightweight tree of `AFXMLElement` objects.
+
+ Elements at declared element paths can be handed out one at a time as soon as their end tag is parsed, instead of being added to their parent. Only the elements that are still open, their children so far and the incomplete markup at the end of the last chunk are kept in memory, so a large feed can be processed record by record with a working set bounded by the size of one record, while it is still being received.
+
+ The parser checks that the document is well-formed. The encoding is detected from the byte order mark and the XML declaration. Entities declared in the internal subset of the document type declaration are replaced, but external entities and document type definitions are never loaded, so references to external entities are errors. Namespace prefixes are kept as part of names, and namespace declarations as `xmlns` attributes. A parser is not thread safe, and should be fed from one queue at a time.
+ */
+//增量解析xml，每收到一块数据就解析一块，指定路径上的元素解析完一个交出一个，不放进父元素中
+@interface AFXMLStreamParser : NSObject <AFURLResponseStreamParsing>
+
+/**
+ The serializer that validates the response before its body is parsed. An `AFXMLParserResponseSerializer` by default.
+ */
+//验证响应的序列化对象，默认为AFXMLParserResponseSerializer
+@property (nonatomic, strong) AFHTTPResponseSerializer *responseSerializer;
+
+/**
+ Sets a block to be executed with each element at the specified path, as soon as its end tag is parsed. Elements handed to the block are not added to their parent.
+
+ @param path The slash-separated names of the elements leading from the root element to the element, for example `rss/channel/item`.
+ @param handler A block object to be executed with each element. Setting `stop` to `YES` stops parsing, and the parser fails with an `NSURLErrorCancelled` error. Pass `nil` to remove the handler.
+ */
+//设置指定路径上的元素解析完时执行的block，交给block的元素不放进父元素
+- (void)setElementHandler:(nullable void (^)(AFXMLElement *element, BOOL *stop))handler
+           forElementPath:(NSString *)path;
+
+/**
+ Parses the next chunk of data.
+
+ @param data The next chunk of the XML document.
+ @param error The error that occurred while parsing, if any. Once an error has occurred, the parser ignores further data and keeps returning that error.
+
+ @return `YES` if the chunk was parsed, otherwise `NO`.
+ */
+//解析下一块数据
+- (BOOL)parseData:(NSData *)data
+            error:(NSError * _Nullable __autoreleasing *)error;
+
+/**
+ Finishes parsing after the last chunk of data, and returns the root element.
+
+ @param error The error that occurred while parsing, if any, for example because the document is incomplete.
+
+ @return The root element, without the elements handed out by element handlers, or `nil` if the document could not be parsed or its root element was handed out. A document without a root element is an error, except that a response made only of whitespace returns `nil` without an error.
+ */
+//所有数据都解析完以后结束解析，返回根元素
+- (nullable id)finishParsingWithError:(NSError * _Nullable __autoreleasing *)error;
 
 @end
 
@@ -236,6 +717,46 @@ NS_ASSUME_NONNULL_BEGIN
 
 #pragma mark -
 
+/**
+ `AFMessagePackResponseSerializer` is a subclass of `AFHTTPResponseSerializer` that validates and decodes MessagePack responses.
+
+ Maps are decoded as `NSDictionary`, arrays as `NSArray`, strings as `NSString`, integers, floats, and booleans as `NSNumber`, and nil as `NSNull`. Binary values are decoded as `NSData` objects that reference the response data without copying it. Timestamps are decoded as `NSDate`, and other extension types as `NSData` containing their payload.
+
+ By default, `AFMessagePackResponseSerializer` accepts the following MIME types:
+
+ - `application/msgpack`
+ - `application/x-msgpack`
+ - `application/vnd.msgpack`
+ */
+//验证和解码http返回的MessagePack数据，二进制数据直接引用响应数据，不拷贝
+@interface AFMessagePackResponseSerializer : AFHTTPResponseSerializer
+
+//初始化
+- (instancetype)init;
+
+@end
+
+#pragma mark -
+
+/**
+ `AFCBORResponseSerializer` is a subclass of `AFHTTPResponseSerializer` that validates and decodes CBOR (RFC 7049) responses.
+
+ Maps are decoded as `NSDictionary`, arrays as `NSArray`, text strings as `NSString`, integers, floats, and booleans as `NSNumber`, and null and undefined as `NSNull`. Byte strings are decoded as `NSData` objects that reference the response data without copying it. Epoch-based dates (tag 1) are decoded as `NSDate`, and other tags are decoded as their content. Indefinite-length items are supported.
+
+ By default, `AFCBORResponseSerializer` accepts the following MIME types:
+
+ - `application/cbor`
+ */
+//验证和解码http返回的CBOR数据，字节串直接引用响应数据，不拷贝
+@interface AFCBORResponseSerializer : AFHTTPResponseSerializer
+
+//初始化
+- (instancetype)init;
+
+@end
+
+#pragma mark -
+
 /**
  `AFImageResponseSerializer` is a subclass of `AFHTTPResponseSerializer` that validates and decodes image responses.
 
@@ -275,6 +796,8 @@ NS_ASSUME_NONNULL_BEGIN
 
 /**
  `AFCompoundSerializer` is a subclass of `AFHTTPResponseSerializer` that delegates the response serialization to the first `AFHTTPResponseSerializer` object that returns an object for `responseObjectForResponse:data:error:`, falling back on the default behavior of `AFHTTPResponseSerializer`. This is useful for supporting multiple potential types and structures of server responses with a single serializer.
+
+ When the component serializers are set, the compound serializer builds a lookup from MIME type to the first component serializer whose `acceptableContentTypes` accept it, following the wildcard and `+json` suffix rules of `acceptableContentTypes`. A response whose MIME type is found is handed to that serializer only, and falls back on the default behavior of `AFHTTPResponseSerializer` if it does not return an object. Responses of other MIME types, or whose first accepting serializer has `nil` `acceptableContentTypes`, are tried against each component serializer in turn. Changes made to the `acceptableContentTypes` of a component serializer after the compound serializer is created are not reflected in the lookup.
  */
 //接收http组合类型的响应
 @interface AFCompoundResponseSerializer : AFHTTPResponseSerializer
@@ -22,6 +22,16 @@
 #import "AFURLResponseSerialization.h"
 
 #import <TargetConditionals.h>
+#import <objc/runtime.h>
+#import <objc/message.h>
+#import <libxml/parser.h>
+#import <libxml/SAX2.h>
+
+#if defined(__SSE2__)
+#import <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#import <arm_neon.h>
+#endif
 
 #if TARGET_OS_IOS
 #import <UIKit/UIKit.h>
@@ -62,32 +72,124 @@ static BOOL AFErrorOrUnderlyingErrorHasCodeInDomain(NSError *error, NSInteger co
     return NO;
 }
 
-//删除JSON NSDictionary数据里的NSNull对象，直接去掉这个键
-static id AFJSONObjectByRemovingKeysWithNullValues(id JSONObject, NSJSONReadingOptions readingOptions) {
+//可变容器：原地删除值为NSNull的键，不复制任何容器
+static void AFJSONMutableObjectRemoveKeysWithNullValues(id JSONObject) {
     if ([JSONObject isKindOfClass:[NSArray class]]) {
-        NSMutableArray *mutableArray = [NSMutableArray arrayWithCapacity:[(NSArray *)JSONObject count]];
         for (id value in (NSArray *)JSONObject) {
-            [mutableArray addObject:AFJSONObjectByRemovingKeysWithNullValues(value, readingOptions)];
+            AFJSONMutableObjectRemoveKeysWithNullValues(value);
+        }
+    } else if ([JSONObject isKindOfClass:[NSDictionary class]]) {
+        NSMutableArray *nullKeys = nil;
+        for (id key in (NSDictionary *)JSONObject) {
+            id value = [(NSDictionary *)JSONObject objectForKey:key];
+            if (value == [NSNull null]) {
+                if (!nullKeys) {
+                    nullKeys = [NSMutableArray array];
+                }
+                [nullKeys addObject:key];
+            } else {
+                AFJSONMutableObjectRemoveKeysWithNullValues(value);
+            }
+        }
+
+        if (nullKeys) {
+            [(NSMutableDictionary *)JSONObject removeObjectsForKeys:nullKeys];
+        }
+    }
+}
+
+//不可变容器：只重建含有NSNull的容器及其祖先，每个容器直接一次构建成不可变对象；没有变化时返回原对象
+static id AFJSONImmutableObjectByRemovingKeysWithNullValues(id JSONObject) {
+    if ([JSONObject isKindOfClass:[NSArray class]]) {
+        NSArray *array = JSONObject;
+        NSUInteger count = [array count];
+        if (count == 0) {
+            return array;
+        }
+
+        __strong id *objects = (__strong id *)calloc(count, sizeof(id));
+        NSUInteger idx = 0;
+        BOOL changed = NO;
+        for (id value in array) {
+            objects[idx] = AFJSONImmutableObjectByRemovingKeysWithNullValues(value);
+            changed = changed || objects[idx] != value;
+            idx++;
         }
 
-        return (readingOptions & NSJSONReadingMutableContainers) ? mutableArray : [NSArray arrayWithArray:mutableArray];
+        id result = changed ? [NSArray arrayWithObjects:objects count:count] : array;
+        for (idx = 0; idx < count; idx++) {
+            objects[idx] = nil;
+        }
+        free(objects);
+
+        return result;
     } else if ([JSONObject isKindOfClass:[NSDictionary class]]) {
-        NSMutableDictionary *mutableDictionary = [NSMutableDictionary dictionaryWithDictionary:JSONObject];
-        for (id <NSCopying> key in [(NSDictionary *)JSONObject allKeys]) {
-            id value = (NSDictionary *)JSONObject[key];
-            if (!value || [value isEqual:[NSNull null]]) {
-                [mutableDictionary removeObjectForKey:key];
-            } else if ([value isKindOfClass:[NSArray class]] || [value isKindOfClass:[NSDictionary class]]) {
-                mutableDictionary[key] = AFJSONObjectByRemovingKeysWithNullValues(value, readingOptions);
+        NSDictionary *dictionary = JSONObject;
+        NSUInteger count = [dictionary count];
+        if (count == 0) {
+            return dictionary;
+        }
+
+        __strong id *keys = (__strong id *)calloc(count, sizeof(id));
+        __strong id *objects = (__strong id *)calloc(count, sizeof(id));
+        NSUInteger numberOfObjects = 0;
+        BOOL changed = NO;
+        for (id key in dictionary) {
+            id value = [dictionary objectForKey:key];
+            if (value == [NSNull null]) {
+                changed = YES;
+                continue;
             }
+
+            keys[numberOfObjects] = key;
+            objects[numberOfObjects] = AFJSONImmutableObjectByRemovingKeysWithNullValues(value);
+            changed = changed || objects[numberOfObjects] != value;
+            numberOfObjects++;
+        }
+
+        id result = changed ? [NSDictionary dictionaryWithObjects:objects forKeys:keys count:numberOfObjects] : dictionary;
+        for (NSUInteger idx = 0; idx < numberOfObjects; idx++) {
+            keys[idx] = nil;
+            objects[idx] = nil;
         }
+        free(keys);
+        free(objects);
 
-        return (readingOptions & NSJSONReadingMutableContainers) ? mutableDictionary : [NSDictionary dictionaryWithDictionary:mutableDictionary];
+        return result;
     }
 
     return JSONObject;
 }
 
+//删除JSON NSDictionary数据里的NSNull对象，直接去掉这个键
+//可变容器原地修改；不可变容器只重建受影响的路径，不再整棵树复制两遍
+static id AFJSONObjectByRemovingKeysWithNullValues(id JSONObject, NSJSONReadingOptions readingOptions) {
+    if (readingOptions & NSJSONReadingMutableContainers) {
+        AFJSONMutableObjectRemoveKeysWithNullValues(JSONObject);
+        return JSONObject;
+    }
+
+    return AFJSONImmutableObjectByRemovingKeysWithNullValues(JSONObject);
+}
+
+//MIME类型是否在可接受的类型中：支持type/*和*/*通配，application/json也接受+json后缀的类型
+static BOOL AFContentTypesContainMIMEType(NSSet *contentTypes, NSString *MIMEType) {
+    if (!MIMEType) {
+        return NO;
+    }
+
+    if ([contentTypes containsObject:MIMEType] || [contentTypes containsObject:@"*/*"]) {
+        return YES;
+    }
+
+    NSRange separatorRange = [MIMEType rangeOfString:@"/"];
+    if (separatorRange.location != NSNotFound && [contentTypes containsObject:[[MIMEType substringToIndex:NSMaxRange(separatorRange)] stringByAppendingString:@"*"]]) {
+        return YES;
+    }
+
+    return [MIMEType hasSuffix:@"+json"] && [contentTypes containsObject:@"application/json"];
+}
+
 //将Http返回的响应序列化
 @implementation AFHTTPResponseSerializer
 
@@ -120,7 +222,7 @@ static id AFJSONObjectByRemovingKeysWithNullValues(id JSONObject, NSJSONReadingO
     NSError *validationError = nil;
 
     if (response && [response isKindOfClass:[NSHTTPURLResponse class]]) {
-        if (self.acceptableContentTypes && ![self.acceptableContentTypes containsObject:[response MIMEType]] &&
+        if (self.acceptableContentTypes && !AFContentTypesContainMIMEType(self.acceptableContentTypes, [response MIMEType]) &&
             !([response MIMEType] == nil && [data length] == 0)) {
 
             if ([data length] > 0 && [response URL]) {
@@ -216,6 +318,9 @@ static id AFJSONObjectByRemovingKeysWithNullValues(id JSONObject, NSJSONReadingO
 
 #pragma mark -
 
+static id AFJSONLazyObjectWithData(NSData *data, NSJSONReadingOptions readingOptions, BOOL removesKeysWithNullValues, NSError * __autoreleasing *error);
+static id AFJSONStructuralObjectWithData(NSData *data, NSJSONReadingOptions readingOptions, BOOL removesKeysWithNullValues, NSError * __autoreleasing *error);
+
 //验证并且解码http返回的json数据
 @implementation AFJSONResponseSerializer
 
@@ -265,7 +370,31 @@ static id AFJSONObjectByRemovingKeysWithNullValues(id JSONObject, NSJSONReadingO
     
     NSError *serializationError = nil;
     
-    id responseObject = [NSJSONSerialization JSONObjectWithData:data options:self.readingOptions error:&serializationError];
+    //可变选项无法用只读的延迟容器满足，这时直接解码
+    id responseObject = nil;
+    if (self.decodesLazily && !(self.readingOptions & (NSJSONReadingMutableContainers | NSJSONReadingMutableLeaves))) {
+        responseObject = AFJSONLazyObjectWithData(data, self.readingOptions, self.removesKeysWithNullValues, &serializationError);
+        if (responseObject || serializationError) {
+            if (!responseObject && error) {
+                *error = AFErrorWithUnderlyingError(serializationError, *error);
+            }
+            return responseObject;
+        }
+    }
+
+    //结构索引解码时在构建容器的同时去掉NSNull，所以需要去掉NSNull时也使用结构索引，不再对结果做第二遍处理。
+    //超出索引范围的数据交给NSJSONSerialization
+    if (self.readingBackend == AFJSONReadingBackendStructuralIndex || self.removesKeysWithNullValues) {
+        responseObject = AFJSONStructuralObjectWithData(data, self.readingOptions, self.removesKeysWithNullValues, &serializationError);
+        if (responseObject || serializationError) {
+            if (!responseObject && error) {
+                *error = AFErrorWithUnderlyingError(serializationError, *error);
+            }
+            return responseObject;
+        }
+    }
+
+    responseObject = [NSJSONSerialization JSONObjectWithData:data options:self.readingOptions error:&serializationError];
 
     if (!responseObject)
     {
@@ -275,6 +404,7 @@ static id AFJSONObjectByRemovingKeysWithNullValues(id JSONObject, NSJSONReadingO
         return nil;
     }
     
+    //只有结构索引不能处理的数据（带BOM、UTF-16或UTF-32编码、超过4GB）才会到这里，这时单独去掉NSNull
     if (self.removesKeysWithNullValues) {
         return AFJSONObjectByRemovingKeysWithNullValues(responseObject, self.readingOptions);
     }
@@ -292,6 +422,8 @@ static id AFJSONObjectByRemovingKeysWithNullValues(id JSONObject, NSJSONReadingO
 
     self.readingOptions = [[decoder decodeObjectOfClass:[NSNumber class] forKey:NSStringFromSelector(@selector(readingOptions))] unsignedIntegerValue];
     self.removesKeysWithNullValues = [[decoder decodeObjectOfClass:[NSNumber class] forKey:NSStringFromSelector(@selector(removesKeysWithNullValues))] boolValue];
+    self.decodesLazily = [[decoder decodeObjectOfClass:[NSNumber class] forKey:NSStringFromSelector(@selector(decodesLazily))] boolValue];
+    self.readingBackend = [[decoder decodeObjectOfClass:[NSNumber class] forKey:NSStringFromSelector(@selector(readingBackend))] unsignedIntegerValue];
 
     return self;
 }
@@ -302,6 +434,8 @@ static id AFJSONObjectByRemovingKeysWithNullValues(id JSONObject, NSJSONReadingO
 
     [coder encodeObject:@(self.readingOptions) forKey:NSStringFromSelector(@selector(readingOptions))];
     [coder encodeObject:@(self.removesKeysWithNullValues) forKey:NSStringFromSelector(@selector(removesKeysWithNullValues))];
+    [coder encodeObject:@(self.decodesLazily) forKey:NSStringFromSelector(@selector(decodesLazily))];
+    [coder encodeObject:@(self.readingBackend) forKey:NSStringFromSelector(@selector(readingBackend))];
 }
 
 #pragma mark - NSCopying
@@ -311,6 +445,8 @@ static id AFJSONObjectByRemovingKeysWithNullValues(id JSONObject, NSJSONReadingO
     AFJSONResponseSerializer *serializer = [super copyWithZone:zone];
     serializer.readingOptions = self.readingOptions;
     serializer.removesKeysWithNullValues = self.removesKeysWithNullValues;
+    serializer.decodesLazily = self.decodesLazily;
+    serializer.readingBackend = self.readingBackend;
 
     return serializer;
 }
@@ -319,40 +455,3759 @@ static id AFJSONObjectByRemovingKeysWithNullValues(id JSONObject, NSJSONReadingO
 
 #pragma mark -
 
-//验证并解码http响应中的xml信息
-@implementation AFXMLParserResponseSerializer
+//解析过程中期待的下一个记号
+typedef NS_ENUM(NSInteger, AFJSONStreamExpectation) {
+    AFJSONStreamExpectationValue = 0,
+    AFJSONStreamExpectationValueOrArrayEnd,
+    AFJSONStreamExpectationCommaOrArrayEnd,
+    AFJSONStreamExpectationKeyOrObjectEnd,
+    AFJSONStreamExpectationKey,
+    AFJSONStreamExpectationColon,
+    AFJSONStreamExpectationCommaOrObjectEnd,
+    AFJSONStreamExpectationEnd,
+};
+
+//当前未结束的记号
+typedef NS_ENUM(NSInteger, AFJSONStreamToken) {
+    AFJSONStreamTokenNone = 0,
+    AFJSONStreamTokenString,
+    AFJSONStreamTokenNumber,
+    AFJSONStreamTokenLiteral,
+};
+
+//一个未结束的数组或对象
+@interface AFJSONStreamFrame : NSObject
+@property (nonatomic, strong) id container;
+@property (nonatomic, assign) BOOL isObject;
+//对象中正在解析的值对应的key
+@property (nonatomic, copy) NSString *key;
+//数组元素的处理block，为nil时元素放进数组
+@property (nonatomic, copy) void (^elementHandler)(id element, BOOL *stop);
+@end
 
-//返回默认配置的对象
-+ (instancetype)serializer {
-    AFXMLParserResponseSerializer *serializer = [[self alloc] init];
+@implementation AFJSONStreamFrame
+@end
 
-    return serializer;
+static NSError * AFJSONStreamParseError(unsigned long long offset, NSString *reason) {
+    NSDictionary *userInfo = @{
+                               NSLocalizedDescriptionKey: NSLocalizedStringFromTable(@"Data could not be decoded as JSON", @"AFNetworking", nil),
+                               NSLocalizedFailureReasonErrorKey: [NSString stringWithFormat:NSLocalizedStringFromTable(@"%@ at offset %llu.", @"AFNetworking", nil), reason, offset],
+                               };
+
+    return [NSError errorWithDomain:AFURLResponseSerializationErrorDomain code:NSURLErrorCannotParseResponse userInfo:userInfo];
+}
+
+static inline BOOL AFJSONStreamIsNumberByte(uint8_t c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+//校验数字的格式：-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static BOOL AFJSONStreamIsValidNumber(const char *bytes, NSUInteger length, BOOL *isInteger) {
+    NSUInteger idx = 0;
+    if (idx < length && bytes[idx] == '-') {
+        idx++;
+    }
+
+    if (idx < length && bytes[idx] == '0') {
+        idx++;
+    } else if (idx < length && bytes[idx] >= '1' && bytes[idx] <= '9') {
+        while (idx < length && bytes[idx] >= '0' && bytes[idx] <= '9') {
+            idx++;
+        }
+    } else {
+        return NO;
+    }
+
+    *isInteger = YES;
+    if (idx < length && bytes[idx] == '.') {
+        *isInteger = NO;
+        NSUInteger start = ++idx;
+        while (idx < length && bytes[idx] >= '0' && bytes[idx] <= '9') {
+            idx++;
+        }
+        if (idx == start) {
+            return NO;
+        }
+    }
+
+    if (idx < length && (bytes[idx] == 'e' || bytes[idx] == 'E')) {
+        *isInteger = NO;
+        idx++;
+        if (idx < length && (bytes[idx] == '+' || bytes[idx] == '-')) {
+            idx++;
+        }
+        NSUInteger start = idx;
+        while (idx < length && bytes[idx] >= '0' && bytes[idx] <= '9') {
+            idx++;
+        }
+        if (idx == start) {
+            return NO;
+        }
+    }
+
+    return idx == length;
+}
+
+//把已校验过格式的数字转成NSNumber，整数超出范围时依次尝试无符号整数和浮点数，浮点数溢出时返回nil
+static NSNumber * AFJSONStreamNumberWithBytes(const char *bytes, NSUInteger length, BOOL isInteger) {
+    char stackBuffer[64];
+    char *buffer = length < sizeof(stackBuffer) ? stackBuffer : malloc(length + 1);
+    memcpy(buffer, bytes, length);
+    buffer[length] = '\0';
+
+    NSNumber *number = nil;
+    if (isInteger) {
+        errno = 0;
+        long long integerValue = strtoll(buffer, NULL, 10);
+        if (errno != ERANGE) {
+            number = @(integerValue);
+        } else if (buffer[0] != '-') {
+            errno = 0;
+            unsigned long long unsignedIntegerValue = strtoull(buffer, NULL, 10);
+            if (errno != ERANGE) {
+                number = @(unsignedIntegerValue);
+            }
+        }
+    }
+
+    if (!number) {
+        double doubleValue = strtod(buffer, NULL);
+        if (isfinite(doubleValue)) {
+            number = @(doubleValue);
+        }
+    }
+
+    if (buffer != stackBuffer) {
+        free(buffer);
+    }
+
+    return number;
+}
+
+static inline NSInteger AFJSONStreamHexValue(uint8_t c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+static BOOL AFJSONStreamReadUnicodeEscape(const uint8_t *bytes, NSUInteger length, NSUInteger *idx, uint32_t *codeUnit) {
+    if (*idx + 6 > length || bytes[*idx] != '\\' || bytes[*idx + 1] != 'u') {
+        return NO;
+    }
+
+    uint32_t value = 0;
+    for (NSUInteger offset = 2; offset < 6; offset++) {
+        NSInteger digit = AFJSONStreamHexValue(bytes[*idx + offset]);
+        if (digit < 0) {
+            return NO;
+        }
+        value = (value << 4) | (uint32_t)digit;
+    }
+    *idx += 6;
+    *codeUnit = value;
+
+    return YES;
+}
+
+//把带转义字符的字符串内容解码成UTF-8，再创建字符串，代理对不完整时返回nil
+static NSString * AFJSONStreamStringByUnescapingBytes(const uint8_t *bytes, NSUInteger length) {
+    NSMutableData *mutableData = [NSMutableData dataWithCapacity:length];
+    NSUInteger idx = 0;
+    while (idx < length) {
+        NSUInteger start = idx;
+        while (idx < length && bytes[idx] != '\\') {
+            idx++;
+        }
+        [mutableData appendBytes:bytes + start length:idx - start];
+        if (idx == length) {
+            break;
+        }
+
+        if (idx + 1 >= length) {
+            return nil;
+        }
+
+        char character = 0;
+        switch (bytes[idx + 1]) {
+            case '"': character = '"'; break;
+            case '\\': character = '\\'; break;
+            case '/': character = '/'; break;
+            case 'b': character = '\b'; break;
+            case 'f': character = '\f'; break;
+            case 'n': character = '\n'; break;
+            case 'r': character = '\r'; break;
+            case 't': character = '\t'; break;
+            case 'u': {
+                uint32_t codePoint = 0;
+                if (!AFJSONStreamReadUnicodeEscape(bytes, length, &idx, &codePoint)) {
+                    return nil;
+                }
+
+                if (codePoint >= 0xd800 && codePoint <= 0xdbff) {
+                    uint32_t lowSurrogate = 0;
+                    if (!AFJSONStreamReadUnicodeEscape(bytes, length, &idx, &lowSurrogate) || lowSurrogate < 0xdc00 || lowSurrogate > 0xdfff) {
+                        return nil;
+                    }
+                    codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (lowSurrogate - 0xdc00);
+                } else if (codePoint >= 0xdc00 && codePoint <= 0xdfff) {
+                    return nil;
+                }
+
+                uint8_t encoded[4];
+                NSUInteger encodedLength = 0;
+                if (codePoint < 0x80) {
+                    encoded[encodedLength++] = (uint8_t)codePoint;
+                } else if (codePoint < 0x800) {
+                    encoded[encodedLength++] = (uint8_t)(0xc0 | (codePoint >> 6));
+                    encoded[encodedLength++] = (uint8_t)(0x80 | (codePoint & 0x3f));
+                } else if (codePoint < 0x10000) {
+                    encoded[encodedLength++] = (uint8_t)(0xe0 | (codePoint >> 12));
+                    encoded[encodedLength++] = (uint8_t)(0x80 | ((codePoint >> 6) & 0x3f));
+                    encoded[encodedLength++] = (uint8_t)(0x80 | (codePoint & 0x3f));
+                } else {
+                    encoded[encodedLength++] = (uint8_t)(0xf0 | (codePoint >> 18));
+                    encoded[encodedLength++] = (uint8_t)(0x80 | ((codePoint >> 12) & 0x3f));
+                    encoded[encodedLength++] = (uint8_t)(0x80 | ((codePoint >> 6) & 0x3f));
+                    encoded[encodedLength++] = (uint8_t)(0x80 | (codePoint & 0x3f));
+                }
+                [mutableData appendBytes:encoded length:encodedLength];
+                continue;
+            }
+            default:
+                return nil;
+        }
+        [mutableData appendBytes:&character length:1];
+        idx += 2;
+    }
+
+    return (__bridge_transfer NSString *)CFStringCreateWithBytes(kCFAllocatorDefault, [mutableData bytes], (CFIndex)[mutableData length], kCFStringEncodingUTF8, false);
 }
 
+@interface AFJSONStreamParser ()
+@property (readwrite, nonatomic, strong) NSMutableDictionary *mutableElementHandlersKeyedByKeyPath;
+@property (readwrite, nonatomic, strong) NSMutableArray <AFJSONStreamFrame *> *frames;
+@property (readwrite, nonatomic, strong) AFJSONStreamFrame *currentFrame;
+@property (readwrite, nonatomic, strong) id rootObject;
+@property (readwrite, nonatomic, strong) NSError *parseError;
+//跨越数据块的记号的字节
+@property (readwrite, nonatomic, strong) NSMutableData *tokenBuffer;
+@property (readwrite, nonatomic, assign) AFJSONStreamExpectation expectation;
+@property (readwrite, nonatomic, assign) AFJSONStreamToken token;
+@property (readwrite, nonatomic, assign) BOOL escaping;
+@property (readwrite, nonatomic, assign) BOOL tokenHasEscapes;
+//已经解析的字节数，用于错误信息
+@property (readwrite, nonatomic, assign) unsigned long long offset;
+@end
+
+@implementation AFJSONStreamParser
+
 - (instancetype)init {
     self = [super init];
     if (!self) {
         return nil;
     }
 
-    self.acceptableContentTypes = [[NSSet alloc] initWithObjects:@"application/xml", @"text/xml", nil];
+    self.mutableElementHandlersKeyedByKeyPath = [NSMutableDictionary dictionary];
+    self.frames = [NSMutableArray array];
+    self.tokenBuffer = [NSMutableData data];
+    self.expectation = AFJSONStreamExpectationValue;
 
     return self;
 }
 
-#pragma mark - AFURLResponseSerialization
-//这个方法解析数据，把NSData转成相应的对象，上层AFURLConnectionOperation会调用这个方法获取转换后的对象。
-- (id)responseObjectForResponse:(NSHTTPURLResponse *)response
-                           data:(NSData *)data
-                          error:(NSError *__autoreleasing *)error
+- (void)setElementHandler:(void (^)(id, BOOL *))handler
+       forArrayAtKeyPath:(NSString *)keyPath
 {
-    if (![self validateResponse:(NSHTTPURLResponse *)response data:data error:error]) {
-        if (!error || AFErrorOrUnderlyingErrorHasCodeInDomain(*error, NSURLErrorCannotDecodeContentData, AFURLResponseSerializationErrorDomain)) {
-            return nil;
+    NSParameterAssert(keyPath);
+
+    self.mutableElementHandlersKeyedByKeyPath[keyPath] = [handler copy];
+}
+
+#pragma mark -
+
+- (BOOL)failWithError:(NSError *)error {
+    self.parseError = error;
+    self.frames = nil;
+    self.currentFrame = nil;
+    self.rootObject = nil;
+    self.tokenBuffer = nil;
+
+    return NO;
+}
+
+- (BOOL)failWithReason:(NSString *)reason offset:(unsigned long long)offset {
+    return [self failWithError:AFJSONStreamParseError(offset, reason)];
+}
+
+//对象的key或者数组的值都可以出现的位置
+- (BOOL)isExpectingValue {
+    return self.expectation == AFJSONStreamExpectationValue || self.expectation == AFJSONStreamExpectationValueOrArrayEnd;
+}
+
+//只匹配直接作为根或者对象值的数组，key path由各层对象中正在解析的key拼接而成
+- (void (^)(id, BOOL *))elementHandlerForArrayStartingInFrame:(AFJSONStreamFrame *)parentFrame {
+    if ([self.mutableElementHandlersKeyedByKeyPath count] == 0 || (parentFrame && !parentFrame.isObject)) {
+        return nil;
+    }
+
+    NSMutableArray *keys = [NSMutableArray arrayWithCapacity:[self.frames count]];
+    for (AFJSONStreamFrame *frame in self.frames) {
+        if (frame.isObject) {
+            [keys addObject:frame.key];
+        }
+    }
+
+    return self.mutableElementHandlersKeyedByKeyPath[[keys componentsJoinedByString:@"."]];
+}
+
+//解析完一个值以后放进所在的容器或者交给元素处理block
+- (BOOL)addValue:(id)value {
+    AFJSONStreamFrame *frame = self.currentFrame;
+    if (!frame) {
+        self.rootObject = value;
+        self.expectation = AFJSONStreamExpectationEnd;
+    } else if (frame.isObject) {
+        [(NSMutableDictionary *)frame.container setObject:value forKey:frame.key];
+        frame.key = nil;
+        self.expectation = AFJSONStreamExpectationCommaOrObjectEnd;
+    } else if (frame.elementHandler) {
+        BOOL stop = NO;
+        @autoreleasepool {
+            frame.elementHandler(value, &stop);
+        }
+        if (stop) {
+            return [self failWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+        }
+        self.expectation = AFJSONStreamExpectationCommaOrArrayEnd;
+    } else {
+        [(NSMutableArray *)frame.container addObject:value];
+        self.expectation = AFJSONStreamExpectationCommaOrArrayEnd;
+    }
+
+    return YES;
+}
+
+- (void)pushContainer:(id)container isObject:(BOOL)isObject {
+    AFJSONStreamFrame *frame = [[AFJSONStreamFrame alloc] init];
+    frame.container = container;
+    frame.isObject = isObject;
+    if (!isObject) {
+        frame.elementHandler = [self elementHandlerForArrayStartingInFrame:self.currentFrame];
+    }
+
+    [self.frames addObject:frame];
+    self.currentFrame = frame;
+    self.expectation = isObject ? AFJSONStreamExpectationKeyOrObjectEnd : AFJSONStreamExpectationValueOrArrayEnd;
+}
+
+- (BOOL)popContainer {
+    id container = self.currentFrame.container;
+    [self.frames removeLastObject];
+    self.currentFrame = [self.frames lastObject];
+
+    return [self addValue:container];
+}
+
+- (BOOL)finishStringWithBytes:(const uint8_t *)bytes length:(NSUInteger)length offset:(unsigned long long)offset {
+    NSString *string = nil;
+    if (self.tokenHasEscapes) {
+        string = AFJSONStreamStringByUnescapingBytes(bytes, length);
+    } else {
+        string = (__bridge_transfer NSString *)CFStringCreateWithBytes(kCFAllocatorDefault, bytes, (CFIndex)length, kCFStringEncodingUTF8, false);
+    }
+
+    if (!string) {
+        return [self failWithReason:NSLocalizedStringFromTable(@"Invalid string", @"AFNetworking", nil) offset:offset];
+    }
+
+    if (self.expectation == AFJSONStreamExpectationKeyOrObjectEnd || self.expectation == AFJSONStreamExpectationKey) {
+        self.currentFrame.key = string;
+        self.expectation = AFJSONStreamExpectationColon;
+        return YES;
+    }
+
+    return [self addValue:string];
+}
+
+//数字和字面量在遇到下一个不属于它们的字节时结束
+- (BOOL)finishTokenWithOffset:(unsigned long long)offset {
+    NSUInteger length = [self.tokenBuffer length];
+    const char *bytes = [self.tokenBuffer bytes];
+    AFJSONStreamToken token = self.token;
+    self.token = AFJSONStreamTokenNone;
+
+    if (token == AFJSONStreamTokenLiteral) {
+        if (length == 4 && memcmp(bytes, "true", 4) == 0) {
+            return [self addValue:@YES];
+        } else if (length == 5 && memcmp(bytes, "false", 5) == 0) {
+            return [self addValue:@NO];
+        } else if (length == 4 && memcmp(bytes, "null", 4) == 0) {
+            return [self addValue:[NSNull null]];
+        }
+
+        return [self failWithReason:NSLocalizedStringFromTable(@"Invalid literal", @"AFNetworking", nil) offset:offset];
+    }
+
+    BOOL isInteger = NO;
+    if (!AFJSONStreamIsValidNumber(bytes, length, &isInteger)) {
+        return [self failWithReason:NSLocalizedStringFromTable(@"Invalid number", @"AFNetworking", nil) offset:offset];
+    }
+
+    NSNumber *number = AFJSONStreamNumberWithBytes(bytes, length, isInteger);
+    if (!number) {
+        return [self failWithReason:NSLocalizedStringFromTable(@"Number out of range", @"AFNetworking", nil) offset:offset];
+    }
+
+    return [self addValue:number];
+}
+
+- (BOOL)parseData:(NSData *)data
+            error:(NSError * __autoreleasing *)error
+{
+    if (!self.parseError) {
+        //解析失败时记录在parseError中
+        [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+            if (![self parseBytes:bytes length:byteRange.length]) {
+                *stop = YES;
+            }
+        }];
+    }
+
+    if (self.parseError) {
+        if (error) {
+            *error = self.parseError;
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
+//逐字节解析，字符串中不含转义字符和跨块的部分直接从数据块创建
+- (BOOL)parseBytes:(const uint8_t *)bytes length:(NSUInteger)length {
+    unsigned long long baseOffset = self.offset;
+    self.offset += length;
+
+    NSUInteger idx = 0;
+    while (idx < length) {
+        if (self.token == AFJSONStreamTokenString) {
+            NSUInteger start = idx;
+            BOOL escaping = self.escaping;
+            while (idx < length) {
+                uint8_t c = bytes[idx];
+                if (escaping) {
+                    escaping = NO;
+                } else if (c == '\\') {
+                    escaping = YES;
+                    self.tokenHasEscapes = YES;
+                } else if (c == '"') {
+                    break;
+                } else if (c < 0x20) {
+                    return [self failWithReason:NSLocalizedStringFromTable(@"Unescaped control character in string", @"AFNetworking", nil) offset:baseOffset + idx];
+                }
+                idx++;
+            }
+            self.escaping = escaping;
+
+            if (idx == length) {
+                [self.tokenBuffer appendBytes:bytes + start length:idx - start];
+                break;
+            }
+
+            self.token = AFJSONStreamTokenNone;
+            BOOL success = NO;
+            if ([self.tokenBuffer length] == 0) {
+                success = [self finishStringWithBytes:bytes + start length:idx - start offset:baseOffset + idx];
+            } else {
+                [self.tokenBuffer appendBytes:bytes + start length:idx - start];
+                success = [self finishStringWithBytes:[self.tokenBuffer bytes] length:[self.tokenBuffer length] offset:baseOffset + idx];
+            }
+            if (!success) {
+                return NO;
+            }
+            idx++;
+            continue;
+        }
+
+        if (self.token != AFJSONStreamTokenNone) {
+            NSUInteger start = idx;
+            BOOL isNumber = self.token == AFJSONStreamTokenNumber;
+            while (idx < length && (isNumber ? AFJSONStreamIsNumberByte(bytes[idx]) : (bytes[idx] >= 'a' && bytes[idx] <= 'z'))) {
+                idx++;
+            }
+            [self.tokenBuffer appendBytes:bytes + start length:idx - start];
+            if (idx == length) {
+                break;
+            }
+            if (![self finishTokenWithOffset:baseOffset + idx]) {
+                return NO;
+            }
+            continue;
+        }
+
+        uint8_t c = bytes[idx];
+        switch (c) {
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+                break;
+            case '"':
+                if (![self isExpectingValue] && self.expectation != AFJSONStreamExpectationKeyOrObjectEnd && self.expectation != AFJSONStreamExpectationKey) {
+                    return [self failWithReason:NSLocalizedStringFromTable(@"Unexpected string", @"AFNetworking", nil) offset:baseOffset + idx];
+                }
+                self.token = AFJSONStreamTokenString;
+                self.escaping = NO;
+                self.tokenHasEscapes = NO;
+                [self.tokenBuffer setLength:0];
+                break;
+            case '{':
+            case '[':
+                if (![self isExpectingValue]) {
+                    return [self failWithReason:NSLocalizedStringFromTable(@"Unexpected container", @"AFNetworking", nil) offset:baseOffset + idx];
+                }
+                if (c == '{') {
+                    [self pushContainer:[NSMutableDictionary dictionary] isObject:YES];
+                } else {
+                    [self pushContainer:[NSMutableArray array] isObject:NO];
+                }
+                break;
+            case '}':
+                if (self.expectation != AFJSONStreamExpectationKeyOrObjectEnd && self.expectation != AFJSONStreamExpectationCommaOrObjectEnd) {
+                    return [self failWithReason:NSLocalizedStringFromTable(@"Unexpected end of object", @"AFNetworking", nil) offset:baseOffset + idx];
+                }
+                if (![self popContainer]) {
+                    return NO;
+                }
+                break;
+            case ']':
+                if (self.expectation != AFJSONStreamExpectationValueOrArrayEnd && self.expectation != AFJSONStreamExpectationCommaOrArrayEnd) {
+                    return [self failWithReason:NSLocalizedStringFromTable(@"Unexpected end of array", @"AFNetworking", nil) offset:baseOffset + idx];
+                }
+                if (![self popContainer]) {
+                    return NO;
+                }
+                break;
+            case ',':
+                if (self.expectation == AFJSONStreamExpectationCommaOrArrayEnd) {
+                    self.expectation = AFJSONStreamExpectationValue;
+                } else if (self.expectation == AFJSONStreamExpectationCommaOrObjectEnd) {
+                    self.expectation = AFJSONStreamExpectationKey;
+                } else {
+                    return [self failWithReason:NSLocalizedStringFromTable(@"Unexpected comma", @"AFNetworking", nil) offset:baseOffset + idx];
+                }
+                break;
+            case ':':
+                if (self.expectation != AFJSONStreamExpectationColon) {
+                    return [self failWithReason:NSLocalizedStringFromTable(@"Unexpected colon", @"AFNetworking", nil) offset:baseOffset + idx];
+                }
+                self.expectation = AFJSONStreamExpectationValue;
+                break;
+            default:
+                if (![self isExpectingValue] || !(c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n')) {
+                    return [self failWithReason:NSLocalizedStringFromTable(@"Unexpected character", @"AFNetworking", nil) offset:baseOffset + idx];
+                }
+                self.token = (c == 't' || c == 'f' || c == 'n') ? AFJSONStreamTokenLiteral : AFJSONStreamTokenNumber;
+                [self.tokenBuffer setLength:0];
+                continue;
+        }
+        idx++;
+    }
+
+    return YES;
+}
+
+- (id)finishParsingWithError:(NSError * __autoreleasing *)error {
+    if (!self.parseError) {
+        if (self.token == AFJSONStreamTokenString) {
+            [self failWithReason:NSLocalizedStringFromTable(@"Unterminated string", @"AFNetworking", nil) offset:self.offset];
+        } else if (self.token != AFJSONStreamTokenNone) {
+            [self finishTokenWithOffset:self.offset];
+        }
+    }
+
+    //只有空白字符时与AFJSONResponseSerializer一致，既没有对象也没有错误
+    if (!self.parseError && self.expectation == AFJSONStreamExpectationValue && !self.currentFrame) {
+        return nil;
+    }
+
+    if (!self.parseError && self.expectation != AFJSONStreamExpectationEnd) {
+        [self failWithReason:NSLocalizedStringFromTable(@"Unexpected end of data", @"AFNetworking", nil) offset:self.offset];
+    }
+
+    if (self.parseError) {
+        if (error) {
+            *error = self.parseError;
+        }
+        return nil;
+    }
+
+    return self.rootObject;
+}
+
+@end
+
+#pragma mark -
+
+static NSUInteger const kAFJSONLazyMaximumDepth = 1024;
+
+typedef NS_ENUM(uint8_t, AFJSONLazyValueType) {
+    AFJSONLazyValueTypeObject = 0,
+    AFJSONLazyValueTypeArray,
+    AFJSONLazyValueTypeString,
+    AFJSONLazyValueTypeNumber,
+    AFJSONLazyValueTypeTrue,
+    AFJSONLazyValueTypeFalse,
+    AFJSONLazyValueTypeNull,
+};
+
+//结构索引中的一项，按文档顺序排列；对象的每个成员依次是key和value两项
+typedef struct {
+    //字符串和数字内容在数据中的起始位置，容器为左括号的位置
+    uint32_t location;
+    //字符串和数字的字节数，容器为元素或成员的个数
+    uint32_t length;
+    //跳过这个值（包括所有子项）之后的下一项
+    uint32_t next;
+    AFJSONLazyValueType type;
+    //字符串是否含转义字符，数字是否为整数
+    uint8_t flags;
+} AFJSONLazyEntry;
+
+typedef struct {
+    AFJSONLazyEntry *entries;
+    NSUInteger count;
+    NSUInteger capacity;
+} AFJSONLazyIndex;
+
+static inline BOOL AFJSONLazyIsWhitespace(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline BOOL AFJSONLazyIsSimpleEscape(uint8_t c) {
+    return c == '"' || c == '\\' || c == '/' || c == 'b' || c == 'f' || c == 'n' || c == 'r' || c == 't';
+}
+
+//返回一个合法UTF-8多字节序列的长度，不合法时返回0
+static NSUInteger AFJSONLazyUTF8SequenceLength(const uint8_t *bytes, NSUInteger length) {
+    uint8_t c = bytes[0];
+    NSUInteger sequenceLength = 0;
+    uint8_t lowerBound = 0x80, upperBound = 0xbf;
+    if (c >= 0xc2 && c <= 0xdf) {
+        sequenceLength = 2;
+    } else if (c >= 0xe0 && c <= 0xef) {
+        sequenceLength = 3;
+        lowerBound = c == 0xe0 ? 0xa0 : 0x80;
+        upperBound = c == 0xed ? 0x9f : 0xbf;
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        sequenceLength = 4;
+        lowerBound = c == 0xf0 ? 0x90 : 0x80;
+        upperBound = c == 0xf4 ? 0x8f : 0xbf;
+    } else {
+        return 0;
+    }
+
+    if (sequenceLength > length || bytes[1] < lowerBound || bytes[1] > upperBound) {
+        return 0;
+    }
+    for (NSUInteger idx = 2; idx < sequenceLength; idx++) {
+        if (bytes[idx] < 0x80 || bytes[idx] > 0xbf) {
+            return 0;
+        }
+    }
+
+    return sequenceLength;
+}
+
+static BOOL AFJSONLazyIndexAppendEntry(AFJSONLazyIndex *index, AFJSONLazyValueType type, NSUInteger location, NSUInteger length, uint8_t flags) {
+    if (index->count == index->capacity) {
+        NSUInteger capacity = MAX(index->capacity * 2, (NSUInteger)64);
+        AFJSONLazyEntry *entries = realloc(index->entries, capacity * sizeof(AFJSONLazyEntry));
+        if (!entries) {
+            return NO;
+        }
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+
+    AFJSONLazyEntry *entry = &index->entries[index->count];
+    entry->location = (uint32_t)location;
+    entry->length = (uint32_t)length;
+    entry->type = type;
+    entry->flags = flags;
+    index->count++;
+    entry->next = (uint32_t)index->count;
+
+    return YES;
+}
+
+//扫描字符串内容并校验转义字符和UTF-8编码，idx指向左引号之后，结束时指向右引号
+static NSString * AFJSONLazyScanString(const uint8_t *bytes, NSUInteger length, NSUInteger *idx, BOOL *hasEscapes) {
+    NSUInteger position = *idx;
+    while (position < length) {
+        uint8_t c = bytes[position];
+        if (c == '"') {
+            *idx = position;
+            return nil;
+        } else if (c < 0x20) {
+            *idx = position;
+            return NSLocalizedStringFromTable(@"Invalid character in string", @"AFNetworking", nil);
+        } else if (c == '\\') {
+            *hasEscapes = YES;
+            if (position + 1 < length && bytes[position + 1] == 'u') {
+                uint32_t codeUnit = 0;
+                if (!AFJSONStreamReadUnicodeEscape(bytes, length, &position, &codeUnit)) {
+                    break;
+                }
+
+                if (codeUnit >= 0xd800 && codeUnit <= 0xdbff) {
+                    uint32_t lowSurrogate = 0;
+                    if (!AFJSONStreamReadUnicodeEscape(bytes, length, &position, &lowSurrogate) || lowSurrogate < 0xdc00 || lowSurrogate > 0xdfff) {
+                        break;
+                    }
+                } else if (codeUnit >= 0xdc00 && codeUnit <= 0xdfff) {
+                    break;
+                }
+            } else if (position + 1 < length && AFJSONLazyIsSimpleEscape(bytes[position + 1])) {
+                position += 2;
+            } else {
+                break;
+            }
+        } else if (c >= 0x80) {
+            NSUInteger sequenceLength = AFJSONLazyUTF8SequenceLength(bytes + position, length - position);
+            if (sequenceLength == 0) {
+                *idx = position;
+                return NSLocalizedStringFromTable(@"Invalid UTF-8 sequence", @"AFNetworking", nil);
+            }
+            position += sequenceLength;
+        } else {
+            position++;
+        }
+    }
+
+    *idx = position;
+    return position < length ? NSLocalizedStringFromTable(@"Invalid escape sequence", @"AFNetworking", nil) : NSLocalizedStringFromTable(@"Unterminated string", @"AFNetworking", nil);
+}
+
+//一次遍历校验整个文档并建立结构索引，不创建任何Foundation对象
+static BOOL AFJSONLazyIndexBuild(AFJSONLazyIndex *index, const uint8_t *bytes, NSUInteger length, NSError * __autoreleasing *error) {
+    uint32_t containers[kAFJSONLazyMaximumDepth];
+    NSUInteger depth = 0;
+    AFJSONStreamExpectation expectation = AFJSONStreamExpectationValue;
+    NSString *failureReason = nil;
+
+    NSUInteger idx = 0;
+    while (idx < length && !failureReason) {
+        uint8_t c = bytes[idx];
+        if (AFJSONLazyIsWhitespace(c)) {
+            idx++;
+            continue;
+        }
+
+        BOOL closesContainer = NO;
+        BOOL isKey = NO;
+        BOOL appended = YES;
+        switch (expectation) {
+            case AFJSONStreamExpectationColon:
+                if (c != ':') {
+                    failureReason = NSLocalizedStringFromTable(@"Expected colon", @"AFNetworking", nil);
+                    continue;
+                }
+                expectation = AFJSONStreamExpectationValue;
+                idx++;
+                continue;
+            case AFJSONStreamExpectationCommaOrArrayEnd:
+            case AFJSONStreamExpectationCommaOrObjectEnd:
+                if (c == ',') {
+                    expectation = expectation == AFJSONStreamExpectationCommaOrArrayEnd ? AFJSONStreamExpectationValue : AFJSONStreamExpectationKey;
+                    idx++;
+                    continue;
+                } else if (c != (expectation == AFJSONStreamExpectationCommaOrArrayEnd ? ']' : '}')) {
+                    failureReason = NSLocalizedStringFromTable(@"Expected comma or closing bracket", @"AFNetworking", nil);
+                    continue;
+                }
+                closesContainer = YES;
+                break;
+            case AFJSONStreamExpectationKeyOrObjectEnd:
+            case AFJSONStreamExpectationKey:
+                if (c == '}' && expectation == AFJSONStreamExpectationKeyOrObjectEnd) {
+                    closesContainer = YES;
+                } else if (c == '"') {
+                    isKey = YES;
+                } else {
+                    failureReason = NSLocalizedStringFromTable(@"Expected string key", @"AFNetworking", nil);
+                    continue;
+                }
+                break;
+            case AFJSONStreamExpectationValueOrArrayEnd:
+                closesContainer = c == ']';
+                break;
+            case AFJSONStreamExpectationValue:
+                break;
+            case AFJSONStreamExpectationEnd:
+                failureReason = NSLocalizedStringFromTable(@"Unexpected data after root value", @"AFNetworking", nil);
+                continue;
+        }
+
+        if (closesContainer) {
+            index->entries[containers[--depth]].next = (uint32_t)index->count;
+            idx++;
+        } else if (c == '{' || c == '[') {
+            if (depth == kAFJSONLazyMaximumDepth) {
+                failureReason = NSLocalizedStringFromTable(@"Too deeply nested", @"AFNetworking", nil);
+                continue;
+            }
+            containers[depth++] = (uint32_t)index->count;
+            if (!AFJSONLazyIndexAppendEntry(index, c == '{' ? AFJSONLazyValueTypeObject : AFJSONLazyValueTypeArray, idx, 0, 0)) {
+                failureReason = NSLocalizedStringFromTable(@"Out of memory", @"AFNetworking", nil);
+                continue;
+            }
+            expectation = c == '{' ? AFJSONStreamExpectationKeyOrObjectEnd : AFJSONStreamExpectationValueOrArrayEnd;
+            idx++;
+            continue;
+        } else if (c == '"') {
+            NSUInteger start = ++idx;
+            BOOL hasEscapes = NO;
+            failureReason = AFJSONLazyScanString(bytes, length, &idx, &hasEscapes);
+            if (failureReason) {
+                continue;
+            }
+            appended = AFJSONLazyIndexAppendEntry(index, AFJSONLazyValueTypeString, start, idx - start, hasEscapes);
+            idx++;
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            NSUInteger start = idx;
+            while (idx < length && AFJSONStreamIsNumberByte(bytes[idx])) {
+                idx++;
+            }
+
+            BOOL isInteger = NO;
+            const char *number = (const char *)bytes + start;
+            if (!AFJSONStreamIsValidNumber(number, idx - start, &isInteger)) {
+                failureReason = NSLocalizedStringFromTable(@"Invalid number", @"AFNetworking", nil);
+                continue;
+            }
+
+            //只有带指数或位数很多的数字才可能溢出，其余的数字不在这里转换
+            BOOL mayOverflow = idx - start > 300 || memchr(number, 'e', idx - start) || memchr(number, 'E', idx - start);
+            if (mayOverflow && !AFJSONStreamNumberWithBytes(number, idx - start, isInteger)) {
+                failureReason = NSLocalizedStringFromTable(@"Number out of range", @"AFNetworking", nil);
+                continue;
+            }
+            appended = AFJSONLazyIndexAppendEntry(index, AFJSONLazyValueTypeNumber, start, idx - start, isInteger);
+        } else if (c == 't' && idx + 4 <= length && memcmp(bytes + idx, "true", 4) == 0) {
+            appended = AFJSONLazyIndexAppendEntry(index, AFJSONLazyValueTypeTrue, idx, 4, 0);
+            idx += 4;
+        } else if (c == 'f' && idx + 5 <= length && memcmp(bytes + idx, "false", 5) == 0) {
+            appended = AFJSONLazyIndexAppendEntry(index, AFJSONLazyValueTypeFalse, idx, 5, 0);
+            idx += 5;
+        } else if (c == 'n' && idx + 4 <= length && memcmp(bytes + idx, "null", 4) == 0) {
+            appended = AFJSONLazyIndexAppendEntry(index, AFJSONLazyValueTypeNull, idx, 4, 0);
+            idx += 4;
+        } else {
+            failureReason = NSLocalizedStringFromTable(@"Unexpected character", @"AFNetworking", nil);
+            continue;
+        }
+
+        if (!appended) {
+            failureReason = NSLocalizedStringFromTable(@"Out of memory", @"AFNetworking", nil);
+            continue;
+        }
+
+        //key之后期待冒号；值结束后累加所在容器的个数
+        if (isKey) {
+            index->entries[containers[depth - 1]].length++;
+            expectation = AFJSONStreamExpectationColon;
+        } else if (depth == 0) {
+            expectation = AFJSONStreamExpectationEnd;
+        } else {
+            AFJSONLazyEntry *container = &index->entries[containers[depth - 1]];
+            if (container->type == AFJSONLazyValueTypeArray) {
+                container->length++;
+                expectation = AFJSONStreamExpectationCommaOrArrayEnd;
+            } else {
+                expectation = AFJSONStreamExpectationCommaOrObjectEnd;
+            }
+        }
+    }
+
+    if (!failureReason && expectation != AFJSONStreamExpectationEnd) {
+        failureReason = NSLocalizedStringFromTable(@"Unexpected end of data", @"AFNetworking", nil);
+    }
+
+    if (failureReason) {
+        if (error) {
+            *error = AFJSONStreamParseError(idx, failureReason);
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
+//持有响应数据和结构索引，被所有延迟解码的容器共享
+@interface AFJSONLazyDocument : NSObject {
+@public
+    AFJSONLazyIndex _index;
+}
+@property (readonly, nonatomic, strong) NSData *data;
+@property (readonly, nonatomic, assign) BOOL removesKeysWithNullValues;
+//保护各个容器的解码缓存
+@property (readonly, nonatomic, strong) NSLock *lock;
+
+- (id)objectForEntryAtIndex:(NSUInteger)entryIndex;
+@end
+
+@interface AFJSONLazyArray : NSArray
+- (instancetype)initWithDocument:(AFJSONLazyDocument *)document entryIndex:(NSUInteger)entryIndex;
+@end
+
+@interface AFJSONLazyDictionary : NSDictionary
+- (instancetype)initWithDocument:(AFJSONLazyDocument *)document entryIndex:(NSUInteger)entryIndex;
+@end
+
+@implementation AFJSONLazyDocument
+
+- (instancetype)initWithData:(NSData *)data
+   removesKeysWithNullValues:(BOOL)removesKeysWithNullValues
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _data = [data copy];
+    _removesKeysWithNullValues = removesKeysWithNullValues;
+    _lock = [[NSLock alloc] init];
+
+    return self;
+}
+
+- (void)dealloc {
+    free(_index.entries);
+}
+
+- (id)objectForEntryAtIndex:(NSUInteger)entryIndex {
+    const AFJSONLazyEntry *entry = &_index.entries[entryIndex];
+    const uint8_t *bytes = (const uint8_t *)[self.data bytes] + entry->location;
+    switch (entry->type) {
+        case AFJSONLazyValueTypeObject:
+            return [[AFJSONLazyDictionary alloc] initWithDocument:self entryIndex:entryIndex];
+        case AFJSONLazyValueTypeArray:
+            return [[AFJSONLazyArray alloc] initWithDocument:self entryIndex:entryIndex];
+        case AFJSONLazyValueTypeString:
+            if (entry->flags) {
+                return AFJSONStreamStringByUnescapingBytes(bytes, entry->length);
+            }
+            return (__bridge_transfer NSString *)CFStringCreateWithBytes(kCFAllocatorDefault, bytes, (CFIndex)entry->length, kCFStringEncodingUTF8, false);
+        case AFJSONLazyValueTypeNumber:
+            return AFJSONStreamNumberWithBytes((const char *)bytes, entry->length, entry->flags);
+        case AFJSONLazyValueTypeTrue:
+            return @YES;
+        case AFJSONLazyValueTypeFalse:
+            return @NO;
+        case AFJSONLazyValueTypeNull:
+            return [NSNull null];
+    }
+
+    return nil;
+}
+
+@end
+
+@implementation AFJSONLazyArray {
+    AFJSONLazyDocument *_document;
+    NSUInteger _entryIndex;
+    NSUInteger _count;
+    //元素在索引中的位置，第一次访问时建立
+    uint32_t *_elementEntryIndexes;
+    //已解码的元素
+    __strong id *_objects;
+}
+
+- (instancetype)initWithDocument:(AFJSONLazyDocument *)document entryIndex:(NSUInteger)entryIndex {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _document = document;
+    _entryIndex = entryIndex;
+    _count = document->_index.entries[entryIndex].length;
+
+    return self;
+}
+
+- (void)dealloc {
+    if (_objects) {
+        for (NSUInteger idx = 0; idx < _count; idx++) {
+            _objects[idx] = nil;
+        }
+        free(_objects);
+    }
+    free(_elementEntryIndexes);
+}
+
+- (NSUInteger)count {
+    return _count;
+}
+
+- (id)objectAtIndex:(NSUInteger)index {
+    if (index >= _count) {
+        [NSException raise:NSRangeException format:@"*** -[%@ objectAtIndex:]: index %lu beyond bounds [0 .. %ld]", NSStringFromClass([self class]), (unsigned long)index, (long)_count - 1];
+    }
+
+    [_document.lock lock];
+    if (!_elementEntryIndexes) {
+        _elementEntryIndexes = malloc(_count * sizeof(uint32_t));
+        _objects = (__strong id *)calloc(_count, sizeof(id));
+        const AFJSONLazyEntry *entries = _document->_index.entries;
+        uint32_t elementEntryIndex = (uint32_t)_entryIndex + 1;
+        for (NSUInteger idx = 0; idx < _count; idx++) {
+            _elementEntryIndexes[idx] = elementEntryIndex;
+            elementEntryIndex = entries[elementEntryIndex].next;
+        }
+    }
+
+    id object = _objects[index];
+    if (!object) {
+        object = [_document objectForEntryAtIndex:_elementEntryIndexes[index]];
+        _objects[index] = object;
+    }
+    [_document.lock unlock];
+
+    return object;
+}
+
+#pragma mark - NSCopying
+
+- (id)copyWithZone:(__unused NSZone *)zone {
+    return self;
+}
+
+#pragma mark - NSCoding
+
+- (Class)classForCoder {
+    return [NSArray class];
+}
+
+@end
+
+@implementation AFJSONLazyDictionary {
+    AFJSONLazyDocument *_document;
+    NSUInteger _entryIndex;
+    //key对应的值在索引中的位置，第一次访问时建立
+    NSDictionary <NSString *, NSNumber *> *_valueEntryIndexesByKey;
+    //已解码的值
+    NSMutableDictionary *_objectsByKey;
+}
+
+- (instancetype)initWithDocument:(AFJSONLazyDocument *)document entryIndex:(NSUInteger)entryIndex {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _document = document;
+    _entryIndex = entryIndex;
+
+    return self;
+}
+
+//只解码key，值保持未解码；要求已持有锁
+- (NSDictionary *)valueEntryIndexesByKey {
+    if (!_valueEntryIndexesByKey) {
+        const AFJSONLazyEntry *entries = _document->_index.entries;
+        NSUInteger count = entries[_entryIndex].length;
+        NSMutableDictionary *mutableValueEntryIndexesByKey = [NSMutableDictionary dictionaryWithCapacity:count];
+        uint32_t keyEntryIndex = (uint32_t)_entryIndex + 1;
+        for (NSUInteger idx = 0; idx < count; idx++) {
+            uint32_t valueEntryIndex = keyEntryIndex + 1;
+            if (!_document.removesKeysWithNullValues || entries[valueEntryIndex].type != AFJSONLazyValueTypeNull) {
+                mutableValueEntryIndexesByKey[[_document objectForEntryAtIndex:keyEntryIndex]] = @(valueEntryIndex);
+            }
+            keyEntryIndex = entries[valueEntryIndex].next;
+        }
+
+        _valueEntryIndexesByKey = [mutableValueEntryIndexesByKey copy];
+        _objectsByKey = [NSMutableDictionary dictionaryWithCapacity:[_valueEntryIndexesByKey count]];
+    }
+
+    return _valueEntryIndexesByKey;
+}
+
+- (NSUInteger)count {
+    //重复的key和移除的NSNull都会影响个数，所以以解码后的key为准
+    [_document.lock lock];
+    NSUInteger count = [[self valueEntryIndexesByKey] count];
+    [_document.lock unlock];
+
+    return count;
+}
+
+- (id)objectForKey:(id)key {
+    if (!key) {
+        return nil;
+    }
+
+    [_document.lock lock];
+    id object = _objectsByKey[key];
+    if (!object) {
+        NSNumber *valueEntryIndex = [self valueEntryIndexesByKey][key];
+        if (valueEntryIndex) {
+            object = [_document objectForEntryAtIndex:[valueEntryIndex unsignedIntegerValue]];
+            _objectsByKey[key] = object;
+        }
+    }
+    [_document.lock unlock];
+
+    return object;
+}
+
+- (NSEnumerator *)keyEnumerator {
+    [_document.lock lock];
+    NSEnumerator *keyEnumerator = [[self valueEntryIndexesByKey] keyEnumerator];
+    [_document.lock unlock];
+
+    return keyEnumerator;
+}
+
+#pragma mark - NSCopying
+
+- (id)copyWithZone:(__unused NSZone *)zone {
+    return self;
+}
+
+#pragma mark - NSCoding
+
+- (Class)classForCoder {
+    return [NSDictionary class];
+}
+
+@end
+
+//数据是否为不带BOM的UTF-8。NSJSONSerialization还接受带BOM的数据和UTF-16、UTF-32，
+//json文本开头的字符都是ASCII，这些编码的前几个字节中一定有0
+static BOOL AFJSONDataIsUTF8WithoutByteOrderMark(const uint8_t *bytes, NSUInteger length) {
+    if (length >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF) {
+        return NO;
+    }
+
+    if (length >= 2 && ((bytes[0] == 0xFE && bytes[1] == 0xFF) || (bytes[0] == 0xFF && bytes[1] == 0xFE))) {
+        return NO;
+    }
+
+    return memchr(bytes, 0, MIN(length, (NSUInteger)4)) == NULL;
+}
+
+//建立索引并返回根对象；数据不是不带BOM的UTF-8，或者超过索引能表示的范围时返回nil且不设置错误，由调用者改为直接解码
+static id AFJSONLazyObjectWithData(NSData *data, NSJSONReadingOptions readingOptions, BOOL removesKeysWithNullValues, NSError * __autoreleasing *error) {
+    if ([data length] >= UINT32_MAX || !AFJSONDataIsUTF8WithoutByteOrderMark([data bytes], [data length])) {
+        return nil;
+    }
+
+    AFJSONLazyDocument *document = [[AFJSONLazyDocument alloc] initWithData:data removesKeysWithNullValues:removesKeysWithNullValues];
+    NSError *indexError = nil;
+    if (!AFJSONLazyIndexBuild(&document->_index, [document.data bytes], [document.data length], &indexError)) {
+        if (error) {
+            *error = indexError;
+        }
+        return nil;
+    }
+
+    AFJSONLazyValueType rootType = document->_index.entries[0].type;
+    if (rootType != AFJSONLazyValueTypeObject && rootType != AFJSONLazyValueTypeArray && !(readingOptions & NSJSONReadingAllowFragments)) {
+        if (error) {
+            *error = AFJSONStreamParseError(0, NSLocalizedStringFromTable(@"JSON text did not start with array or object", @"AFNetworking", nil));
+        }
+        return nil;
+    }
+
+    return [document objectForEntryAtIndex:0];
+}
+
+#pragma mark -
+
+//每次分类的字节数
+static NSUInteger const kAFJSONStructuralBlockSize = 64;
+
+//一个64字节块中各类字符的位图，第i位对应块中第i个字节
+typedef struct {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t punctuation;
+    uint64_t whitespace;
+    uint64_t control;
+} AFJSONStructuralBlockMasks;
+
+//第一阶段的结果：所有结构字符、引号和标量起始位置，按文档顺序排列
+typedef struct {
+    uint32_t *offsets;
+    NSUInteger count;
+    NSUInteger capacity;
+} AFJSONStructuralIndexes;
+
+#if defined(__SSE2__)
+static inline uint64_t AFJSONStructuralMaskFromVectors(__m128i v0, __m128i v1, __m128i v2, __m128i v3) {
+    return (uint64_t)(uint16_t)_mm_movemask_epi8(v0) | ((uint64_t)(uint16_t)_mm_movemask_epi8(v1) << 16) | ((uint64_t)(uint16_t)_mm_movemask_epi8(v2) << 32) | ((uint64_t)(uint16_t)_mm_movemask_epi8(v3) << 48);
+}
+
+//SSE2：每次比较16个字节
+static inline void AFJSONStructuralClassifyBlock(const uint8_t *block, AFJSONStructuralBlockMasks *masks) {
+    __m128i chunks[4];
+    for (NSUInteger idx = 0; idx < 4; idx++) {
+        chunks[idx] = _mm_loadu_si128((const __m128i *)(const void *)(block + idx * 16));
+    }
+
+    __m128i quote[4], backslash[4], punctuation[4], whitespace[4], control[4];
+    for (NSUInteger idx = 0; idx < 4; idx++) {
+        __m128i chunk = chunks[idx];
+        quote[idx] = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'));
+        backslash[idx] = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'));
+        punctuation[idx] = _mm_or_si128(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('{')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('}'))), _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('[')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(']')))), _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))));
+        whitespace[idx] = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))), _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+        //无符号比较：chunk <= 0x1f
+        control[idx] = _mm_cmpeq_epi8(_mm_min_epu8(chunk, _mm_set1_epi8(0x1f)), chunk);
+    }
+
+    masks->quote = AFJSONStructuralMaskFromVectors(quote[0], quote[1], quote[2], quote[3]);
+    masks->backslash = AFJSONStructuralMaskFromVectors(backslash[0], backslash[1], backslash[2], backslash[3]);
+    masks->punctuation = AFJSONStructuralMaskFromVectors(punctuation[0], punctuation[1], punctuation[2], punctuation[3]);
+    masks->whitespace = AFJSONStructuralMaskFromVectors(whitespace[0], whitespace[1], whitespace[2], whitespace[3]);
+    masks->control = AFJSONStructuralMaskFromVectors(control[0], control[1], control[2], control[3]);
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+//NEON没有movemask，先按位置与上1到128，再两两相加得到位图
+static inline uint64_t AFJSONStructuralMaskFromVectors(uint8x16_t v0, uint8x16_t v1, uint8x16_t v2, uint8x16_t v3) {
+    static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t bitMask = vld1q_u8(bits);
+    uint8x16_t sum0 = vpaddq_u8(vandq_u8(v0, bitMask), vandq_u8(v1, bitMask));
+    uint8x16_t sum1 = vpaddq_u8(vandq_u8(v2, bitMask), vandq_u8(v3, bitMask));
+    sum0 = vpaddq_u8(sum0, sum1);
+    sum0 = vpaddq_u8(sum0, sum0);
+
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+}
+
+static inline uint8x16_t AFJSONStructuralOperatorVector(uint8x16_t chunk) {
+    return vorrq_u8(vorrq_u8(vorrq_u8(vceqq_u8(chunk, vdupq_n_u8('{')), vceqq_u8(chunk, vdupq_n_u8('}'))), vorrq_u8(vceqq_u8(chunk, vdupq_n_u8('[')), vceqq_u8(chunk, vdupq_n_u8(']')))), vorrq_u8(vceqq_u8(chunk, vdupq_n_u8(':')), vceqq_u8(chunk, vdupq_n_u8(','))));
+}
+
+static inline uint8x16_t AFJSONStructuralWhitespaceVector(uint8x16_t chunk) {
+    return vorrq_u8(vorrq_u8(vceqq_u8(chunk, vdupq_n_u8(' ')), vceqq_u8(chunk, vdupq_n_u8('\t'))), vorrq_u8(vceqq_u8(chunk, vdupq_n_u8('\n')), vceqq_u8(chunk, vdupq_n_u8('\r'))));
+}
+
+static inline void AFJSONStructuralClassifyBlock(const uint8_t *block, AFJSONStructuralBlockMasks *masks) {
+    uint8x16_t c0 = vld1q_u8(block), c1 = vld1q_u8(block + 16), c2 = vld1q_u8(block + 32), c3 = vld1q_u8(block + 48);
+    uint8x16_t quote = vdupq_n_u8('"'), backslash = vdupq_n_u8('\\'), control = vdupq_n_u8(0x1f);
+
+    masks->quote = AFJSONStructuralMaskFromVectors(vceqq_u8(c0, quote), vceqq_u8(c1, quote), vceqq_u8(c2, quote), vceqq_u8(c3, quote));
+    masks->backslash = AFJSONStructuralMaskFromVectors(vceqq_u8(c0, backslash), vceqq_u8(c1, backslash), vceqq_u8(c2, backslash), vceqq_u8(c3, backslash));
+    masks->punctuation = AFJSONStructuralMaskFromVectors(AFJSONStructuralOperatorVector(c0), AFJSONStructuralOperatorVector(c1), AFJSONStructuralOperatorVector(c2), AFJSONStructuralOperatorVector(c3));
+    masks->whitespace = AFJSONStructuralMaskFromVectors(AFJSONStructuralWhitespaceVector(c0), AFJSONStructuralWhitespaceVector(c1), AFJSONStructuralWhitespaceVector(c2), AFJSONStructuralWhitespaceVector(c3));
+    masks->control = AFJSONStructuralMaskFromVectors(vcleq_u8(c0, control), vcleq_u8(c1, control), vcleq_u8(c2, control), vcleq_u8(c3, control));
+}
+#else
+//没有向量指令时逐字节分类
+static inline void AFJSONStructuralClassifyBlock(const uint8_t *block, AFJSONStructuralBlockMasks *masks) {
+    memset(masks, 0, sizeof(AFJSONStructuralBlockMasks));
+    for (NSUInteger idx = 0; idx < kAFJSONStructuralBlockSize; idx++) {
+        uint64_t bit = 1ULL << idx;
+        uint8_t c = block[idx];
+        switch (c) {
+            case '"': masks->quote |= bit; break;
+            case '\\': masks->backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',': masks->punctuation |= bit; break;
+            case ' ': case '\t': case '\n': case '\r': masks->whitespace |= bit; break;
+            default: break;
+        }
+        if (c <= 0x1f) {
+            masks->control |= bit;
+        }
+    }
+}
+#endif
+
+//前缀异或：第i位为第0到i位的异或，用来得到引号之间的区域
+static inline uint64_t AFJSONStructuralPrefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+
+    return bits;
+}
+
+//被反斜杠转义的字符；反斜杠很少，逐个处理
+static inline uint64_t AFJSONStructuralEscapedCharacters(uint64_t backslash, BOOL *escapesNextBlock) {
+    uint64_t escaped = 0;
+    if (*escapesNextBlock) {
+        escaped |= 1;
+        backslash &= ~1ULL;
+    }
+    *escapesNextBlock = NO;
+
+    while (backslash) {
+        unsigned int position = (unsigned int)__builtin_ctzll(backslash);
+        backslash &= backslash - 1;
+        if (position == 63) {
+            *escapesNextBlock = YES;
+        } else {
+            uint64_t escapedBit = 1ULL << (position + 1);
+            escaped |= escapedBit;
+            backslash &= ~escapedBit;
+        }
+    }
+
+    return escaped;
+}
+
+static BOOL AFJSONStructuralIndexesReserve(AFJSONStructuralIndexes *structurals, NSUInteger additionalCount) {
+    if (structurals->count + additionalCount <= structurals->capacity) {
+        return YES;
+    }
+
+    NSUInteger capacity = MAX(structurals->capacity * 2, structurals->count + additionalCount);
+    uint32_t *offsets = realloc(structurals->offsets, capacity * sizeof(uint32_t));
+    if (!offsets) {
+        return NO;
+    }
+    structurals->offsets = offsets;
+    structurals->capacity = capacity;
+
+    return YES;
+}
+
+//第一阶段：按64字节分块，用向量指令分类字符，再用位运算求出字符串区域和结构字符的位置
+static NSString * AFJSONStructuralIndexesBuild(AFJSONStructuralIndexes *structurals, const uint8_t *bytes, NSUInteger length, NSUInteger *errorOffset) {
+    BOOL escapesNextBlock = NO;
+    uint64_t inStringCarry = 0;
+    //上一块的最后一个字节是否为空白、结构字符或引号，文档开头视为是
+    uint64_t boundaryCarry = 1;
+
+    for (NSUInteger offset = 0; offset < length; offset += kAFJSONStructuralBlockSize) {
+        const uint8_t *block = bytes + offset;
+        uint8_t paddedBlock[kAFJSONStructuralBlockSize];
+        if (length - offset < kAFJSONStructuralBlockSize) {
+            memset(paddedBlock, ' ', sizeof(paddedBlock));
+            memcpy(paddedBlock, block, length - offset);
+            block = paddedBlock;
+        }
+
+        AFJSONStructuralBlockMasks masks;
+        AFJSONStructuralClassifyBlock(block, &masks);
+
+        uint64_t quote = masks.quote & ~AFJSONStructuralEscapedCharacters(masks.backslash, &escapesNextBlock);
+        //字符串区域包含左引号和内容，不包含右引号
+        uint64_t inString = AFJSONStructuralPrefixXor(quote) ^ inStringCarry;
+        inStringCarry = (uint64_t)((int64_t)inString >> 63);
+
+        uint64_t inStringContent = inString & ~quote;
+        uint64_t invalidControl = masks.control & inStringContent;
+        if (invalidControl) {
+            *errorOffset = offset + (NSUInteger)__builtin_ctzll(invalidControl);
+            return NSLocalizedStringFromTable(@"Invalid character in string", @"AFNetworking", nil);
+        }
+
+        uint64_t boundary = masks.punctuation | masks.whitespace | quote;
+        uint64_t scalar = ~(boundary | inStringContent);
+        uint64_t scalarStart = scalar & ((boundary << 1) | boundaryCarry);
+        boundaryCarry = boundary >> 63;
+
+        uint64_t structural = (masks.punctuation & ~inStringContent) | quote | scalarStart;
+        if (offset + kAFJSONStructuralBlockSize > length) {
+            structural &= (1ULL << (length - offset)) - 1;
+        }
+
+        if (!AFJSONStructuralIndexesReserve(structurals, kAFJSONStructuralBlockSize)) {
+            *errorOffset = offset;
+            return NSLocalizedStringFromTable(@"Out of memory", @"AFNetworking", nil);
+        }
+        while (structural) {
+            structurals->offsets[structurals->count++] = (uint32_t)(offset + (NSUInteger)__builtin_ctzll(structural));
+            structural &= structural - 1;
+        }
+    }
+
+    if (inStringCarry) {
+        *errorOffset = length;
+        return NSLocalizedStringFromTable(@"Unterminated string", @"AFNetworking", nil);
+    }
+
+    return nil;
+}
+
+static inline BOOL AFJSONStructuralIsTokenBoundary(const uint8_t *bytes, NSUInteger length, NSUInteger offset) {
+    if (offset >= length) {
+        return YES;
+    }
+
+    switch (bytes[offset]) {
+        case ' ': case '\t': case '\n': case '\r':
+        case '{': case '}': case '[': case ']': case ':': case ',': case '"':
+            return YES;
+        default:
+            return NO;
+    }
+}
+
+//第二阶段用来暂存未结束容器里的值
+typedef struct {
+    __strong id *objects;
+    NSUInteger count;
+    NSUInteger capacity;
+} AFJSONStructuralValueStack;
+
+static BOOL AFJSONStructuralValueStackPush(AFJSONStructuralValueStack *stack, id object) {
+    if (stack->count == stack->capacity) {
+        NSUInteger capacity = MAX(stack->capacity * 2, (NSUInteger)64);
+        __strong id *objects = (__strong id *)realloc(stack->objects, capacity * sizeof(id));
+        if (!objects) {
+            return NO;
+        }
+        memset((void *)(objects + stack->capacity), 0, (capacity - stack->capacity) * sizeof(id));
+        stack->objects = objects;
+        stack->capacity = capacity;
+    }
+    stack->objects[stack->count++] = object;
+
+    return YES;
+}
+
+static void AFJSONStructuralValueStackPopToCount(AFJSONStructuralValueStack *stack, NSUInteger count) {
+    while (stack->count > count) {
+        stack->objects[--stack->count] = nil;
+    }
+}
+
+//用栈顶的值一次构建数组或字典；对象的值在栈中按key、value交替排列
+static id AFJSONStructuralContainerFromValueStack(AFJSONStructuralValueStack *stack, NSUInteger start, BOOL isObject, NSJSONReadingOptions readingOptions, BOOL removesKeysWithNullValues) {
+    BOOL mutableContainers = (readingOptions & NSJSONReadingMutableContainers) != 0;
+    __strong id *objects = stack->objects + start;
+    NSUInteger count = stack->count - start;
+
+    if (!isObject) {
+        return mutableContainers ? [NSMutableArray arrayWithObjects:objects count:count] : [NSArray arrayWithObjects:objects count:count];
+    }
+
+    NSUInteger numberOfMembers = count / 2;
+    __unsafe_unretained id *keys = (__unsafe_unretained id *)malloc(MAX(numberOfMembers, (NSUInteger)1) * sizeof(id));
+    __unsafe_unretained id *values = (__unsafe_unretained id *)malloc(MAX(numberOfMembers, (NSUInteger)1) * sizeof(id));
+    NSUInteger numberOfEntries = 0;
+    for (NSUInteger idx = 0; idx < numberOfMembers; idx++) {
+        id value = objects[idx * 2 + 1];
+        if (removesKeysWithNullValues && value == [NSNull null]) {
+            continue;
+        }
+        keys[numberOfEntries] = objects[idx * 2];
+        values[numberOfEntries] = value;
+        numberOfEntries++;
+    }
+
+    id dictionary = mutableContainers ? [NSMutableDictionary dictionaryWithObjects:values forKeys:keys count:numberOfEntries] : [NSDictionary dictionaryWithObjects:values forKeys:keys count:numberOfEntries];
+    free(keys);
+    free(values);
+
+    return dictionary;
+}
+
+//第二阶段：沿着结构字符的位置校验语法并构建对象树，每个容器在结束时一次创建
+static id AFJSONStructuralObjectWithData(NSData *data, NSJSONReadingOptions readingOptions, BOOL removesKeysWithNullValues, NSError * __autoreleasing *error) {
+    const uint8_t *bytes = [data bytes];
+    NSUInteger length = [data length];
+    //带BOM的数据和UTF-16、UTF-32交给NSJSONSerialization，结果和它保持一致
+    if (length >= UINT32_MAX || !AFJSONDataIsUTF8WithoutByteOrderMark(bytes, length)) {
+        return nil;
+    }
+
+    AFJSONStructuralIndexes structurals = {NULL, 0, 0};
+    NSUInteger errorOffset = 0;
+    NSString *failureReason = AFJSONStructuralIndexesBuild(&structurals, bytes, length, &errorOffset);
+
+    AFJSONStructuralValueStack stack = {NULL, 0, 0};
+    NSUInteger containerStarts[kAFJSONLazyMaximumDepth];
+    BOOL containerIsObject[kAFJSONLazyMaximumDepth];
+    NSUInteger depth = 0;
+    AFJSONStreamExpectation expectation = AFJSONStreamExpectationValue;
+
+    for (NSUInteger idx = 0; idx < structurals.count && !failureReason; idx++) {
+        NSUInteger offset = structurals.offsets[idx];
+        uint8_t c = bytes[offset];
+        errorOffset = offset;
+
+        BOOL closesContainer = NO;
+        BOOL isKey = NO;
+        switch (expectation) {
+            case AFJSONStreamExpectationColon:
+                if (c != ':') {
+                    failureReason = NSLocalizedStringFromTable(@"Expected colon", @"AFNetworking", nil);
+                }
+                expectation = AFJSONStreamExpectationValue;
+                continue;
+            case AFJSONStreamExpectationCommaOrArrayEnd:
+            case AFJSONStreamExpectationCommaOrObjectEnd:
+                if (c == ',') {
+                    expectation = expectation == AFJSONStreamExpectationCommaOrArrayEnd ? AFJSONStreamExpectationValue : AFJSONStreamExpectationKey;
+                    continue;
+                } else if (c != (expectation == AFJSONStreamExpectationCommaOrArrayEnd ? ']' : '}')) {
+                    failureReason = NSLocalizedStringFromTable(@"Expected comma or closing bracket", @"AFNetworking", nil);
+                    continue;
+                }
+                closesContainer = YES;
+                break;
+            case AFJSONStreamExpectationKeyOrObjectEnd:
+            case AFJSONStreamExpectationKey:
+                if (c == '}' && expectation == AFJSONStreamExpectationKeyOrObjectEnd) {
+                    closesContainer = YES;
+                } else if (c == '"') {
+                    isKey = YES;
+                } else {
+                    failureReason = NSLocalizedStringFromTable(@"Expected string key", @"AFNetworking", nil);
+                    continue;
+                }
+                break;
+            case AFJSONStreamExpectationValueOrArrayEnd:
+                closesContainer = c == ']';
+                break;
+            case AFJSONStreamExpectationValue:
+                break;
+            case AFJSONStreamExpectationEnd:
+                failureReason = NSLocalizedStringFromTable(@"Unexpected data after root value", @"AFNetworking", nil);
+                continue;
+        }
+
+        if (depth == 0 && !closesContainer && c != '{' && c != '[' && !(readingOptions & NSJSONReadingAllowFragments)) {
+            failureReason = NSLocalizedStringFromTable(@"JSON text did not start with array or object", @"AFNetworking", nil);
+            continue;
+        }
+
+        id value = nil;
+        if (closesContainer) {
+            depth--;
+            value = AFJSONStructuralContainerFromValueStack(&stack, containerStarts[depth], containerIsObject[depth], readingOptions, removesKeysWithNullValues);
+            AFJSONStructuralValueStackPopToCount(&stack, containerStarts[depth]);
+        } else if (c == '{' || c == '[') {
+            if (depth == kAFJSONLazyMaximumDepth) {
+                failureReason = NSLocalizedStringFromTable(@"Too deeply nested", @"AFNetworking", nil);
+                continue;
+            }
+            containerStarts[depth] = stack.count;
+            containerIsObject[depth] = c == '{';
+            depth++;
+            expectation = c == '{' ? AFJSONStreamExpectationKeyOrObjectEnd : AFJSONStreamExpectationValueOrArrayEnd;
+            continue;
+        } else if (c == '"') {
+            //第一阶段保证了引号成对出现，下一个位置就是右引号
+            NSUInteger end = structurals.offsets[++idx];
+            const uint8_t *string = bytes + offset + 1;
+            NSUInteger stringLength = end - offset - 1;
+            if (memchr(string, '\\', stringLength)) {
+                value = AFJSONStreamStringByUnescapingBytes(string, stringLength);
+            } else {
+                value = (__bridge_transfer NSString *)CFStringCreateWithBytes(kCFAllocatorDefault, string, (CFIndex)stringLength, kCFStringEncodingUTF8, false);
+            }
+
+            if (!value) {
+                failureReason = NSLocalizedStringFromTable(@"Invalid string", @"AFNetworking", nil);
+                continue;
+            } else if (!isKey && (readingOptions & NSJSONReadingMutableLeaves)) {
+                value = [value mutableCopy];
+            }
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            NSUInteger end = offset;
+            while (end < length && AFJSONStreamIsNumberByte(bytes[end])) {
+                end++;
+            }
+
+            BOOL isInteger = NO;
+            if (!AFJSONStructuralIsTokenBoundary(bytes, length, end) || !AFJSONStreamIsValidNumber((const char *)bytes + offset, end - offset, &isInteger)) {
+                failureReason = NSLocalizedStringFromTable(@"Invalid number", @"AFNetworking", nil);
+                continue;
+            }
+
+            value = AFJSONStreamNumberWithBytes((const char *)bytes + offset, end - offset, isInteger);
+            if (!value) {
+                failureReason = NSLocalizedStringFromTable(@"Number out of range", @"AFNetworking", nil);
+                continue;
+            }
+        } else if (c == 't' && offset + 4 <= length && memcmp(bytes + offset, "true", 4) == 0 && AFJSONStructuralIsTokenBoundary(bytes, length, offset + 4)) {
+            value = @YES;
+        } else if (c == 'f' && offset + 5 <= length && memcmp(bytes + offset, "false", 5) == 0 && AFJSONStructuralIsTokenBoundary(bytes, length, offset + 5)) {
+            value = @NO;
+        } else if (c == 'n' && offset + 4 <= length && memcmp(bytes + offset, "null", 4) == 0 && AFJSONStructuralIsTokenBoundary(bytes, length, offset + 4)) {
+            value = [NSNull null];
+        } else {
+            failureReason = NSLocalizedStringFromTable(@"Unexpected character", @"AFNetworking", nil);
+            continue;
+        }
+
+        if (!AFJSONStructuralValueStackPush(&stack, value)) {
+            failureReason = NSLocalizedStringFromTable(@"Out of memory", @"AFNetworking", nil);
+            continue;
+        }
+
+        if (isKey) {
+            expectation = AFJSONStreamExpectationColon;
+        } else if (depth == 0) {
+            expectation = AFJSONStreamExpectationEnd;
+        } else {
+            expectation = containerIsObject[depth - 1] ? AFJSONStreamExpectationCommaOrObjectEnd : AFJSONStreamExpectationCommaOrArrayEnd;
+        }
+    }
+
+    if (!failureReason && expectation != AFJSONStreamExpectationEnd) {
+        errorOffset = length;
+        failureReason = NSLocalizedStringFromTable(@"Unexpected end of data", @"AFNetworking", nil);
+    }
+
+    id responseObject = failureReason ? nil : stack.objects[0];
+    AFJSONStructuralValueStackPopToCount(&stack, 0);
+    free(stack.objects);
+    free(structurals.offsets);
+
+    if (failureReason && error) {
+        *error = AFJSONStreamParseError(errorOffset, failureReason);
+    }
+
+    return responseObject;
+}
+
+#pragma mark -
+
+//重复出现的短字符串只创建一次
+static NSUInteger const kAFJSONModelInternedStringMaximumLength = 32;
+static NSUInteger const kAFJSONModelInternTableSize = 1024;
+
+typedef NS_ENUM(NSUInteger, AFJSONModelPropertyType) {
+    AFJSONModelPropertyTypeChar = 0,
+    AFJSONModelPropertyTypeUnsignedChar,
+    AFJSONModelPropertyTypeShort,
+    AFJSONModelPropertyTypeUnsignedShort,
+    AFJSONModelPropertyTypeInt,
+    AFJSONModelPropertyTypeUnsignedInt,
+    AFJSONModelPropertyTypeLong,
+    AFJSONModelPropertyTypeUnsignedLong,
+    AFJSONModelPropertyTypeLongLong,
+    AFJSONModelPropertyTypeUnsignedLongLong,
+    AFJSONModelPropertyTypeBool,
+    AFJSONModelPropertyTypeFloat,
+    AFJSONModelPropertyTypeDouble,
+    AFJSONModelPropertyTypeObject,
+};
+
+static inline uint64_t AFJSONModelHash(const uint8_t *bytes, NSUInteger length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (NSUInteger idx = 0; idx < length; idx++) {
+        hash = (hash ^ bytes[idx]) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+@class AFJSONModelSchema;
+
+//跳过的值也要是合法的true、false、null或者数字
+static BOOL AFJSONModelIsValidScalar(const uint8_t *bytes, NSUInteger length) {
+    if ((length == 4 && (memcmp(bytes, "true", 4) == 0 || memcmp(bytes, "null", 4) == 0)) || (length == 5 && memcmp(bytes, "false", 5) == 0)) {
+        return YES;
+    }
+
+    BOOL isInteger = NO;
+    return AFJSONStreamIsValidNumber((const char *)bytes, length, &isInteger);
+}
+
+//KVC在没有setter时按_key、_isKey、key、isKey的顺序查找实例变量，找不到时会抛出异常
+static BOOL AFJSONModelClassCanSetValueForKeyDirectly(Class modelClass, NSString *key) {
+    if (![modelClass accessInstanceVariablesDirectly]) {
+        return NO;
+    }
+
+    NSString *capitalizedKey = [[[key substringToIndex:1] uppercaseString] stringByAppendingString:[key substringFromIndex:1]];
+    for (NSString *name in @[[@"_" stringByAppendingString:key], [@"_is" stringByAppendingString:capitalizedKey], key, [@"is" stringByAppendingString:capitalizedKey]]) {
+        if (class_getInstanceVariable(modelClass, [name UTF8String])) {
+            return YES;
+        }
+    }
+
+    return NO;
+}
+
+//模型类的一个属性
+@interface AFJSONModelProperty : NSObject
+@property (readonly, nonatomic, copy) NSString *name;
+//没有setter的只读属性通过KVC赋值
+@property (readonly, nonatomic, assign) SEL setterSelector;
+@property (readonly, nonatomic, assign) AFJSONModelPropertyType type;
+//为nil时表示id
+@property (readonly, nonatomic, strong) Class objectClass;
+@property (readonly, nonatomic, strong) Class elementModelClass;
+//嵌套模型的schema，第一次用到时取得
+@property (atomic, strong) AFJSONModelSchema *modelSchema;
+
+- (instancetype)initWithProperty:(objc_property_t)property
+                      modelClass:(Class)modelClass
+               elementModelClass:(Class)elementModelClass;
+@end
+
+@implementation AFJSONModelProperty
+
+- (instancetype)initWithProperty:(objc_property_t)property
+                      modelClass:(Class)modelClass
+               elementModelClass:(Class)elementModelClass
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _name = @(property_getName(property));
+    _elementModelClass = elementModelClass;
+
+    char *typeEncoding = property_copyAttributeValue(property, "T");
+    BOOL isSupported = YES;
+    switch (typeEncoding ? typeEncoding[0] : '\0') {
+        case 'c': _type = AFJSONModelPropertyTypeChar; break;
+        case 'C': _type = AFJSONModelPropertyTypeUnsignedChar; break;
+        case 's': _type = AFJSONModelPropertyTypeShort; break;
+        case 'S': _type = AFJSONModelPropertyTypeUnsignedShort; break;
+        case 'i': _type = AFJSONModelPropertyTypeInt; break;
+        case 'I': _type = AFJSONModelPropertyTypeUnsignedInt; break;
+        case 'l': _type = AFJSONModelPropertyTypeLong; break;
+        case 'L': _type = AFJSONModelPropertyTypeUnsignedLong; break;
+        case 'q': _type = AFJSONModelPropertyTypeLongLong; break;
+        case 'Q': _type = AFJSONModelPropertyTypeUnsignedLongLong; break;
+        case 'B': _type = AFJSONModelPropertyTypeBool; break;
+        case 'f': _type = AFJSONModelPropertyTypeFloat; break;
+        case 'd': _type = AFJSONModelPropertyTypeDouble; break;
+        case '@': {
+            _type = AFJSONModelPropertyTypeObject;
+            //@"ClassName<Protocol>"，block的编码是@?
+            if (typeEncoding[1] == '?') {
+                isSupported = NO;
+            } else if (typeEncoding[1] == '"') {
+                NSString *className = [[NSString alloc] initWithBytes:typeEncoding + 2 length:strcspn(typeEncoding + 2, "\"<") encoding:NSUTF8StringEncoding];
+                _objectClass = [className length] > 0 ? NSClassFromString(className) : nil;
+            }
+            break;
+        }
+        default:
+            isSupported = NO;
+            break;
+    }
+    free(typeEncoding);
+
+    if (!isSupported) {
+        return nil;
+    }
+
+    char *setterName = property_copyAttributeValue(property, "S");
+    if (setterName) {
+        _setterSelector = sel_registerName(setterName);
+        free(setterName);
+    } else {
+        _setterSelector = NSSelectorFromString([NSString stringWithFormat:@"set%@%@:", [[_name substringToIndex:1] uppercaseString], [_name substringFromIndex:1]]);
+    }
+
+    if (![modelClass instancesRespondToSelector:_setterSelector]) {
+        _setterSelector = NULL;
+    }
+
+    //没有实例变量的只读属性（例如计算属性）无法赋值，不加入schema
+    if (!_setterSelector && !AFJSONModelClassCanSetValueForKeyDirectly(modelClass, _name)) {
+        return nil;
+    }
+
+    return self;
+}
+
+@end
+
+//schema中的一层JSON对象：key到属性或下一层的散列表，查找时直接比较原始字节
+typedef struct {
+    uint64_t hash;
+    const uint8_t *key;
+    NSUInteger length;
+    __unsafe_unretained id target;
+} AFJSONModelSchemaEntry;
+
+@interface AFJSONModelSchemaNode : NSObject {
+@public
+    AFJSONModelSchemaEntry *_entries;
+    NSUInteger _mask;
+}
+//持有key的字节和查找结果
+@property (readonly, nonatomic, strong) NSArray *keys;
+@property (readonly, nonatomic, strong) NSArray *targets;
+
+- (instancetype)initWithTargetsByKey:(NSDictionary <NSString *, id> *)targetsByKey;
+@end
+
+static id AFJSONModelSchemaNodeTarget(AFJSONModelSchemaNode *node, const uint8_t *key, NSUInteger length) {
+    uint64_t hash = AFJSONModelHash(key, length);
+    for (NSUInteger idx = (NSUInteger)hash & node->_mask; node->_entries[idx].key; idx = (idx + 1) & node->_mask) {
+        AFJSONModelSchemaEntry *entry = &node->_entries[idx];
+        if (entry->hash == hash && entry->length == length && memcmp(entry->key, key, length) == 0) {
+            return entry->target;
+        }
+    }
+
+    return nil;
+}
+
+@implementation AFJSONModelSchemaNode
+
+- (instancetype)initWithTargetsByKey:(NSDictionary <NSString *, id> *)targetsByKey {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    NSMutableArray *mutableKeys = [NSMutableArray arrayWithCapacity:[targetsByKey count]];
+    NSMutableArray *mutableTargets = [NSMutableArray arrayWithCapacity:[targetsByKey count]];
+
+    //装载因子不超过一半
+    NSUInteger capacity = 4;
+    while (capacity < [targetsByKey count] * 2) {
+        capacity *= 2;
+    }
+    _mask = capacity - 1;
+    _entries = calloc(capacity, sizeof(AFJSONModelSchemaEntry));
+
+    for (NSString *key in targetsByKey) {
+        id target = targetsByKey[key];
+        if ([target isKindOfClass:[NSDictionary class]]) {
+            target = [[AFJSONModelSchemaNode alloc] initWithTargetsByKey:target];
+        }
+
+        NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+        [mutableKeys addObject:keyData];
+        [mutableTargets addObject:target];
+
+        uint64_t hash = AFJSONModelHash([keyData bytes], [keyData length]);
+        NSUInteger idx = (NSUInteger)hash & _mask;
+        while (_entries[idx].key) {
+            idx = (idx + 1) & _mask;
+        }
+        _entries[idx].hash = hash;
+        _entries[idx].key = [keyData length] > 0 ? [keyData bytes] : (const uint8_t *)"";
+        _entries[idx].length = [keyData length];
+        _entries[idx].target = target;
+    }
+
+    _keys = [mutableKeys copy];
+    _targets = [mutableTargets copy];
+
+    return self;
+}
+
+- (void)dealloc {
+    free(_entries);
+}
+
+@end
+
+//模型类的schema，每个类只建立一次
+@interface AFJSONModelSchema : NSObject
+@property (readonly, nonatomic, strong) Class modelClass;
+@property (readonly, nonatomic, strong) AFJSONModelSchemaNode *rootNode;
+
++ (instancetype)schemaForModelClass:(Class)modelClass;
+@end
+
+@implementation AFJSONModelSchema
+
++ (instancetype)schemaForModelClass:(Class)modelClass {
+    static NSMutableDictionary *schemasByClass = nil;
+    static NSLock *lock = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        schemasByClass = [NSMutableDictionary dictionary];
+        lock = [[NSLock alloc] init];
+    });
+
+    [lock lock];
+    AFJSONModelSchema *schema = schemasByClass[(id <NSCopying>)modelClass];
+    if (!schema) {
+        schema = [[self alloc] initWithModelClass:modelClass];
+        schemasByClass[(id <NSCopying>)modelClass] = schema;
+    }
+    [lock unlock];
+
+    return schema;
+}
+
+- (instancetype)initWithModelClass:(Class)modelClass {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _modelClass = modelClass;
+
+    NSDictionary *keyPathsByPropertyKey = [modelClass respondsToSelector:@selector(JSONKeyPathsByPropertyKey)] ? [modelClass JSONKeyPathsByPropertyKey] : nil;
+    NSDictionary *modelClassesByPropertyKey = [modelClass respondsToSelector:@selector(JSONModelClassesByPropertyKey)] ? [modelClass JSONModelClassesByPropertyKey] : nil;
+
+    //先建立嵌套的字典，key路径中间的部分对应下一层
+    NSMutableDictionary *targetsByKey = [NSMutableDictionary dictionary];
+    for (NSString *propertyKey in keyPathsByPropertyKey) {
+        objc_property_t objcProperty = class_getProperty(modelClass, [propertyKey UTF8String]);
+        AFJSONModelProperty *property = objcProperty ? [[AFJSONModelProperty alloc] initWithProperty:objcProperty modelClass:modelClass elementModelClass:modelClassesByPropertyKey[propertyKey]] : nil;
+        if (!property) {
+            continue;
+        }
+
+        NSArray *components = [keyPathsByPropertyKey[propertyKey] componentsSeparatedByString:@"."];
+        NSMutableDictionary *mutableTargetsByKey = targetsByKey;
+        for (NSString *component in [components subarrayWithRange:NSMakeRange(0, [components count] - 1)]) {
+            id target = mutableTargetsByKey[component];
+            if (!target) {
+                target = [NSMutableDictionary dictionary];
+                mutableTargetsByKey[component] = target;
+            }
+
+            //同一个key既是属性又是路径的一部分时，保留属性
+            mutableTargetsByKey = [target isKindOfClass:[NSMutableDictionary class]] ? target : nil;
+        }
+        mutableTargetsByKey[[components lastObject]] = property;
+    }
+
+    _rootNode = [[AFJSONModelSchemaNode alloc] initWithTargetsByKey:targetsByKey];
+
+    return self;
+}
+
+@end
+
+//沿着结构字符的位置直接给模型赋值
+@interface AFJSONModelDecoder : NSObject {
+    const uint8_t *_bytes;
+    NSUInteger _length;
+    AFJSONStructuralIndexes _structurals;
+    NSUInteger _cursor;
+    __strong NSString **_internedStrings;
+    const uint8_t **_internedStringBytes;
+    NSUInteger *_internedStringLengths;
+}
+@property (readwrite, nonatomic, copy) NSString *failureReason;
+@property (readwrite, nonatomic, assign) NSUInteger errorOffset;
+
+- (instancetype)initWithData:(NSData *)data;
+- (id)decodeModelsOfClass:(Class)modelClass rootKeyPath:(NSString *)rootKeyPath;
+@end
+
+@implementation AFJSONModelDecoder
+
+- (instancetype)initWithData:(NSData *)data {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _bytes = [data bytes];
+    _length = [data length];
+    _internedStrings = (__strong NSString **)calloc(kAFJSONModelInternTableSize, sizeof(NSString *));
+    _internedStringBytes = calloc(kAFJSONModelInternTableSize, sizeof(const uint8_t *));
+    _internedStringLengths = calloc(kAFJSONModelInternTableSize, sizeof(NSUInteger));
+
+    return self;
+}
+
+- (void)dealloc {
+    for (NSUInteger idx = 0; idx < kAFJSONModelInternTableSize; idx++) {
+        _internedStrings[idx] = nil;
+    }
+    free(_internedStrings);
+    free(_internedStringBytes);
+    free(_internedStringLengths);
+    free(_structurals.offsets);
+}
+
+#pragma mark -
+
+- (BOOL)failWithReason:(NSString *)reason {
+    if (!self.failureReason) {
+        self.failureReason = reason;
+        self.errorOffset = _cursor < _structurals.count ? _structurals.offsets[_cursor] : _length;
+    }
+
+    return NO;
+}
+
+- (uint8_t)currentCharacter {
+    return _cursor < _structurals.count ? _bytes[_structurals.offsets[_cursor]] : '\0';
+}
+
+- (BOOL)consumeSeparator {
+    if ([self currentCharacter] != ',') {
+        return NO;
+    }
+    _cursor++;
+
+    return YES;
+}
+
+- (BOOL)consumeCharacter:(uint8_t)character {
+    if ([self currentCharacter] != character) {
+        return [self failWithReason:[NSString stringWithFormat:NSLocalizedStringFromTable(@"Expected '%c'", @"AFNetworking", nil), character]];
+    }
+    _cursor++;
+
+    return YES;
+}
+
+//当前是左引号时返回字符串内容的范围，第一阶段保证了下一个位置是右引号
+- (const uint8_t *)consumeStringWithLength:(NSUInteger *)length {
+    NSUInteger start = _structurals.offsets[_cursor] + 1;
+    *length = _structurals.offsets[_cursor + 1] - start;
+    _cursor += 2;
+
+    return _bytes + start;
+}
+
+//数字和字面量的字节，要求后面紧跟空白、结构字符或者结束
+- (const uint8_t *)consumeScalarWithLength:(NSUInteger *)length {
+    NSUInteger start = _structurals.offsets[_cursor];
+    NSUInteger end = start;
+    while (end < _length && !AFJSONStructuralIsTokenBoundary(_bytes, _length, end)) {
+        end++;
+    }
+    *length = end - start;
+    _cursor++;
+
+    return _bytes + start;
+}
+
+- (NSString *)stringWithBytes:(const uint8_t *)bytes length:(NSUInteger)length {
+    if (memchr(bytes, '\\', length)) {
+        return AFJSONStreamStringByUnescapingBytes(bytes, length);
+    }
+
+    if (length > kAFJSONModelInternedStringMaximumLength) {
+        return (__bridge_transfer NSString *)CFStringCreateWithBytes(kCFAllocatorDefault, bytes, (CFIndex)length, kCFStringEncodingUTF8, false);
+    }
+
+    //按内容散列到固定大小的表，命中时比较原始字节
+    NSUInteger slot = (NSUInteger)AFJSONModelHash(bytes, length) & (kAFJSONModelInternTableSize - 1);
+    NSString *string = _internedStrings[slot];
+    if (string && _internedStringLengths[slot] == length && memcmp(_internedStringBytes[slot], bytes, length) == 0) {
+        return string;
+    }
+
+    string = (__bridge_transfer NSString *)CFStringCreateWithBytes(kCFAllocatorDefault, bytes, (CFIndex)length, kCFStringEncodingUTF8, false);
+    if (string) {
+        _internedStrings[slot] = string;
+        _internedStringBytes[slot] = bytes;
+        _internedStringLengths[slot] = length;
+    }
+
+    return string;
+}
+
+//跳过一个值，检查括号是否匹配以及字面量和数字是否合法，不创建任何对象
+- (BOOL)skipValue {
+    uint8_t brackets[kAFJSONLazyMaximumDepth];
+    NSUInteger depth = 0;
+    do {
+        uint8_t character = [self currentCharacter];
+        switch (character) {
+            case '{':
+            case '[':
+                if (depth == kAFJSONLazyMaximumDepth) {
+                    return [self failWithReason:NSLocalizedStringFromTable(@"Too deeply nested", @"AFNetworking", nil)];
+                }
+                brackets[depth++] = character == '{' ? '}' : ']';
+                _cursor++;
+                break;
+            case '}':
+            case ']':
+                if (depth == 0 || brackets[--depth] != character) {
+                    return [self failWithReason:NSLocalizedStringFromTable(@"Unexpected closing bracket", @"AFNetworking", nil)];
+                }
+                _cursor++;
+                break;
+            case '"':
+                _cursor += 2;
+                break;
+            case '\0':
+                return [self failWithReason:NSLocalizedStringFromTable(@"Unexpected end of data", @"AFNetworking", nil)];
+            case ',':
+            case ':':
+                if (depth == 0) {
+                    return [self failWithReason:NSLocalizedStringFromTable(@"Unexpected character", @"AFNetworking", nil)];
+                }
+                _cursor++;
+                break;
+            default: {
+                NSUInteger length = 0;
+                const uint8_t *bytes = [self consumeScalarWithLength:&length];
+                if (!AFJSONModelIsValidScalar(bytes, length)) {
+                    _cursor--;
+                    return [self failWithReason:NSLocalizedStringFromTable(@"Unexpected character", @"AFNetworking", nil)];
+                }
+                break;
+            }
+        }
+    } while (depth > 0);
+
+    return YES;
+}
+
+//解码成Foundation对象，用于类型为id、NSArray或NSDictionary的属性
+- (id)readValueWithDepth:(NSUInteger)depth {
+    if (depth > kAFJSONLazyMaximumDepth) {
+        [self failWithReason:NSLocalizedStringFromTable(@"Too deeply nested", @"AFNetworking", nil)];
+        return nil;
+    }
+
+    uint8_t character = [self currentCharacter];
+    if (character == '[') {
+        _cursor++;
+        NSMutableArray *mutableArray = [NSMutableArray array];
+        if ([self currentCharacter] != ']') {
+            do {
+                id value = [self readValueWithDepth:depth + 1];
+                if (!value) {
+                    return nil;
+                }
+                [mutableArray addObject:value];
+            } while ([self consumeSeparator]);
+        }
+
+        return [self consumeCharacter:']'] ? [mutableArray copy] : nil;
+    } else if (character == '{') {
+        _cursor++;
+        NSMutableDictionary *mutableDictionary = [NSMutableDictionary dictionary];
+        if ([self currentCharacter] != '}') {
+            do {
+                if ([self currentCharacter] != '"') {
+                    [self failWithReason:NSLocalizedStringFromTable(@"Expected string key", @"AFNetworking", nil)];
+                    return nil;
+                }
+                NSUInteger length = 0;
+                const uint8_t *bytes = [self consumeStringWithLength:&length];
+                NSString *key = [self stringWithBytes:bytes length:length];
+                id value = key && [self consumeCharacter:':'] ? [self readValueWithDepth:depth + 1] : nil;
+                if (!value) {
+                    if (!key) {
+                        [self failWithReason:NSLocalizedStringFromTable(@"Invalid string", @"AFNetworking", nil)];
+                    }
+                    return nil;
+                }
+                mutableDictionary[key] = value;
+            } while ([self consumeSeparator]);
+        }
+
+        return [self consumeCharacter:'}'] ? [mutableDictionary copy] : nil;
+    } else if (character == '"') {
+        NSUInteger length = 0;
+        const uint8_t *bytes = [self consumeStringWithLength:&length];
+        NSString *string = [self stringWithBytes:bytes length:length];
+        if (!string) {
+            [self failWithReason:NSLocalizedStringFromTable(@"Invalid string", @"AFNetworking", nil)];
+        }
+
+        return string;
+    } else if (character == '\0') {
+        [self failWithReason:NSLocalizedStringFromTable(@"Unexpected end of data", @"AFNetworking", nil)];
+        return nil;
+    }
+
+    NSUInteger length = 0;
+    const uint8_t *bytes = [self consumeScalarWithLength:&length];
+    BOOL isInteger = NO;
+    if (length == 4 && memcmp(bytes, "true", 4) == 0) {
+        return @YES;
+    } else if (length == 5 && memcmp(bytes, "false", 5) == 0) {
+        return @NO;
+    } else if (length == 4 && memcmp(bytes, "null", 4) == 0) {
+        return [NSNull null];
+    } else if (AFJSONStreamIsValidNumber((const char *)bytes, length, &isInteger)) {
+        NSNumber *number = AFJSONStreamNumberWithBytes((const char *)bytes, length, isInteger);
+        if (!number) {
+            _cursor--;
+            [self failWithReason:NSLocalizedStringFromTable(@"Number out of range", @"AFNetworking", nil)];
+        }
+        return number;
+    }
+
+    _cursor--;
+    [self failWithReason:NSLocalizedStringFromTable(@"Unexpected character", @"AFNetworking", nil)];
+
+    return nil;
+}
+
+//给数值类型的属性赋值，不创建NSNumber；不是合法的数字或布尔值时返回NO
+- (BOOL)setScalarWithBytes:(const uint8_t *)bytes
+                    length:(NSUInteger)length
+               forProperty:(AFJSONModelProperty *)property
+                   ofModel:(id)model
+{
+    long long integerValue = 0;
+    unsigned long long unsignedIntegerValue = 0;
+    double doubleValue = 0;
+    BOOL isInteger = NO;
+
+    if (length == 4 && memcmp(bytes, "true", 4) == 0) {
+        integerValue = 1;
+        unsignedIntegerValue = 1;
+        doubleValue = 1;
+    } else if (length == 5 && memcmp(bytes, "false", 5) == 0) {
+        //都是0
+    } else if (!AFJSONStreamIsValidNumber((const char *)bytes, length, &isInteger)) {
+        return NO;
+    } else {
+        //大多数数字放得进栈上的缓冲区，超长的数字才分配内存
+        char stackBuffer[64];
+        char *buffer = length < sizeof(stackBuffer) ? stackBuffer : malloc(length + 1);
+        if (!buffer) {
+            return NO;
+        }
+        memcpy(buffer, bytes, length);
+        buffer[length] = '\0';
+        doubleValue = strtod(buffer, NULL);
+        if (isInteger) {
+            integerValue = strtoll(buffer, NULL, 10);
+            unsignedIntegerValue = buffer[0] == '-' ? (unsigned long long)integerValue : strtoull(buffer, NULL, 10);
+        } else {
+            integerValue = (long long)doubleValue;
+            unsignedIntegerValue = doubleValue < 0 ? (unsigned long long)integerValue : (unsigned long long)doubleValue;
+        }
+        if (buffer != stackBuffer) {
+            free(buffer);
+        }
+    }
+
+    SEL setter = property.setterSelector;
+    if (!setter) {
+        NSNumber *number = property.type == AFJSONModelPropertyTypeFloat || property.type == AFJSONModelPropertyTypeDouble ? @(doubleValue) : (property.type == AFJSONModelPropertyTypeUnsignedLongLong || property.type == AFJSONModelPropertyTypeUnsignedLong ? @(unsignedIntegerValue) : @(integerValue));
+        [model setValue:number forKey:property.name];
+        return YES;
+    }
+
+    switch (property.type) {
+        case AFJSONModelPropertyTypeChar:
+            ((void (*)(id, SEL, char))objc_msgSend)(model, setter, (char)integerValue);
+            break;
+        case AFJSONModelPropertyTypeUnsignedChar:
+            ((void (*)(id, SEL, unsigned char))objc_msgSend)(model, setter, (unsigned char)unsignedIntegerValue);
+            break;
+        case AFJSONModelPropertyTypeShort:
+            ((void (*)(id, SEL, short))objc_msgSend)(model, setter, (short)integerValue);
+            break;
+        case AFJSONModelPropertyTypeUnsignedShort:
+            ((void (*)(id, SEL, unsigned short))objc_msgSend)(model, setter, (unsigned short)unsignedIntegerValue);
+            break;
+        case AFJSONModelPropertyTypeInt:
+            ((void (*)(id, SEL, int))objc_msgSend)(model, setter, (int)integerValue);
+            break;
+        case AFJSONModelPropertyTypeUnsignedInt:
+            ((void (*)(id, SEL, unsigned int))objc_msgSend)(model, setter, (unsigned int)unsignedIntegerValue);
+            break;
+        case AFJSONModelPropertyTypeLong:
+            ((void (*)(id, SEL, long))objc_msgSend)(model, setter, (long)integerValue);
+            break;
+        case AFJSONModelPropertyTypeUnsignedLong:
+            ((void (*)(id, SEL, unsigned long))objc_msgSend)(model, setter, (unsigned long)unsignedIntegerValue);
+            break;
+        case AFJSONModelPropertyTypeLongLong:
+            ((void (*)(id, SEL, long long))objc_msgSend)(model, setter, integerValue);
+            break;
+        case AFJSONModelPropertyTypeUnsignedLongLong:
+            ((void (*)(id, SEL, unsigned long long))objc_msgSend)(model, setter, unsignedIntegerValue);
+            break;
+        case AFJSONModelPropertyTypeBool:
+            ((void (*)(id, SEL, bool))objc_msgSend)(model, setter, integerValue != 0 || doubleValue != 0);
+            break;
+        case AFJSONModelPropertyTypeFloat:
+            ((void (*)(id, SEL, float))objc_msgSend)(model, setter, (float)doubleValue);
+            break;
+        case AFJSONModelPropertyTypeDouble:
+            ((void (*)(id, SEL, double))objc_msgSend)(model, setter, doubleValue);
+            break;
+        case AFJSONModelPropertyTypeObject:
+            break;
+    }
+
+    return YES;
+}
+
+- (BOOL)readValueForProperty:(AFJSONModelProperty *)property
+                     ofModel:(id)model
+                       depth:(NSUInteger)depth
+{
+    uint8_t character = [self currentCharacter];
+    if (property.type != AFJSONModelPropertyTypeObject) {
+        if (character == '-' || (character >= '0' && character <= '9') || character == 't' || character == 'f') {
+            NSUInteger length = 0;
+            const uint8_t *bytes = [self consumeScalarWithLength:&length];
+            if (![self setScalarWithBytes:bytes length:length forProperty:property ofModel:model]) {
+                _cursor--;
+                return [self failWithReason:NSLocalizedStringFromTable(@"Unexpected character", @"AFNetworking", nil)];
+            }
+
+            return YES;
+        }
+
+        return [self skipValue];
+    }
+
+    Class objectClass = property.objectClass;
+    id value = nil;
+    if (character == '"' && (!objectClass || [objectClass isSubclassOfClass:[NSString class]] || objectClass == [NSURL class])) {
+        NSUInteger length = 0;
+        const uint8_t *bytes = [self consumeStringWithLength:&length];
+        value = [self stringWithBytes:bytes length:length];
+        if (!value) {
+            _cursor -= 2;
+            return [self failWithReason:NSLocalizedStringFromTable(@"Invalid string", @"AFNetworking", nil)];
+        }
+
+        if (objectClass == [NSURL class]) {
+            value = [NSURL URLWithString:value];
+        }
+    } else if (character == '{' && [objectClass conformsToProtocol:@protocol(AFJSONModel)]) {
+        AFJSONModelSchema *schema = property.modelSchema;
+        if (!schema) {
+            schema = [AFJSONModelSchema schemaForModelClass:objectClass];
+            property.modelSchema = schema;
+        }
+        value = [self readModelWithSchema:schema depth:depth + 1];
+        if (!value) {
+            return NO;
+        }
+    } else if (character == '[' && property.elementModelClass && (!objectClass || [objectClass isSubclassOfClass:[NSArray class]])) {
+        value = [self readModelsOfClass:property.elementModelClass depth:depth + 1];
+        if (!value) {
+            return NO;
+        }
+    } else if (character == 'n' || !(!objectClass || (character == '[' && [objectClass isSubclassOfClass:[NSArray class]]) || (character == '{' && [objectClass isSubclassOfClass:[NSDictionary class]]) || ((character == '-' || (character >= '0' && character <= '9') || character == 't' || character == 'f') && [objectClass isSubclassOfClass:[NSNumber class]]))) {
+        //null和类型不符的值不赋值
+        return [self skipValue];
+    } else {
+        value = [self readValueWithDepth:depth + 1];
+        if (!value) {
+            return NO;
+        }
+    }
+
+    //可变类型的属性赋可变的副本
+    if (value && objectClass && ![value isKindOfClass:objectClass]) {
+        value = [value respondsToSelector:@selector(mutableCopyWithZone:)] ? [value mutableCopy] : nil;
+        if (![value isKindOfClass:objectClass]) {
+            return YES;
+        }
+    }
+
+    if (value) {
+        if (property.setterSelector) {
+            ((void (*)(id, SEL, id))objc_msgSend)(model, property.setterSelector, value);
+        } else {
+            [model setValue:value forKey:property.name];
+        }
+    }
+
+    return YES;
+}
+
+//把一个JSON对象的成员赋给模型，key路径的中间部分对应下一层节点
+- (BOOL)readObjectIntoModel:(id)model
+                       node:(AFJSONModelSchemaNode *)node
+                      depth:(NSUInteger)depth
+{
+    if (depth > kAFJSONLazyMaximumDepth) {
+        return [self failWithReason:NSLocalizedStringFromTable(@"Too deeply nested", @"AFNetworking", nil)];
+    }
+
+    if (![self consumeCharacter:'{']) {
+        return NO;
+    }
+    if ([self currentCharacter] == '}') {
+        _cursor++;
+        return YES;
+    }
+
+    do {
+        if ([self currentCharacter] != '"') {
+            return [self failWithReason:NSLocalizedStringFromTable(@"Expected string key", @"AFNetworking", nil)];
+        }
+
+        NSUInteger length = 0;
+        const uint8_t *key = [self consumeStringWithLength:&length];
+        id target = nil;
+        if (memchr(key, '\\', length)) {
+            NSData *keyData = [AFJSONStreamStringByUnescapingBytes(key, length) dataUsingEncoding:NSUTF8StringEncoding];
+            target = keyData ? AFJSONModelSchemaNodeTarget(node, [keyData bytes], [keyData length]) : nil;
+        } else {
+            target = AFJSONModelSchemaNodeTarget(node, key, length);
+        }
+
+        if (![self consumeCharacter:':']) {
+            return NO;
+        }
+
+        BOOL success = YES;
+        if ([target isKindOfClass:[AFJSONModelProperty class]]) {
+            success = [self readValueForProperty:target ofModel:model depth:depth];
+        } else if (target && [self currentCharacter] == '{') {
+            success = [self readObjectIntoModel:model node:target depth:depth + 1];
+        } else {
+            success = [self skipValue];
+        }
+
+        if (!success) {
+            return NO;
+        }
+    } while ([self consumeSeparator]);
+
+    return [self consumeCharacter:'}'];
+}
+
+- (id)readModelWithSchema:(AFJSONModelSchema *)schema depth:(NSUInteger)depth {
+    id model = [[schema.modelClass alloc] init];
+
+    return [self readObjectIntoModel:model node:schema.rootNode depth:depth] ? model : nil;
+}
+
+//模型数组，null元素和不是对象的元素被忽略
+- (NSArray *)readModelsOfClass:(Class)modelClass depth:(NSUInteger)depth {
+    if (![self consumeCharacter:'[']) {
+        return nil;
+    }
+
+    AFJSONModelSchema *schema = [AFJSONModelSchema schemaForModelClass:modelClass];
+    NSMutableArray *mutableModels = [NSMutableArray array];
+    if ([self currentCharacter] != ']') {
+        do {
+            if ([self currentCharacter] == '{') {
+                id model = [self readModelWithSchema:schema depth:depth + 1];
+                if (!model) {
+                    return nil;
+                }
+                [mutableModels addObject:model];
+            } else if (![self skipValue]) {
+                return nil;
+            }
+        } while ([self consumeSeparator]);
+    }
+
+    return [self consumeCharacter:']'] ? [mutableModels copy] : nil;
+}
+
+//沿着key路径找到要解码的值，其余成员跳过；found表示路径是否存在
+- (id)readValueAtKeyPathComponents:(NSArray <NSData *> *)components
+                             index:(NSUInteger)index
+                        modelClass:(Class)modelClass
+                             found:(BOOL *)found
+{
+    uint8_t character = [self currentCharacter];
+    if (index == [components count]) {
+        *found = YES;
+        if (character == '{') {
+            return [self readModelWithSchema:[AFJSONModelSchema schemaForModelClass:modelClass] depth:index];
+        } else if (character == '[') {
+            return [self readModelsOfClass:modelClass depth:index];
+        }
+
+        *found = NO;
+        return [self skipValue] ? [NSNull null] : nil;
+    }
+
+    if (character != '{') {
+        return [self skipValue] ? [NSNull null] : nil;
+    }
+
+    _cursor++;
+    id result = [NSNull null];
+    if ([self currentCharacter] != '}') {
+        NSData *component = components[index];
+        do {
+            if ([self currentCharacter] != '"') {
+                [self failWithReason:NSLocalizedStringFromTable(@"Expected string key", @"AFNetworking", nil)];
+                return nil;
+            }
+
+            NSUInteger length = 0;
+            const uint8_t *key = [self consumeStringWithLength:&length];
+            if (![self consumeCharacter:':']) {
+                return nil;
+            }
+
+            if (length == [component length] && memcmp(key, [component bytes], length) == 0) {
+                result = [self readValueAtKeyPathComponents:components index:index + 1 modelClass:modelClass found:found];
+                if (!result) {
+                    return nil;
+                }
+            } else if (![self skipValue]) {
+                return nil;
+            }
+        } while ([self consumeSeparator]);
+    }
+
+    return [self consumeCharacter:'}'] ? result : nil;
+}
+
+- (id)decodeModelsOfClass:(Class)modelClass rootKeyPath:(NSString *)rootKeyPath {
+    NSUInteger errorOffset = 0;
+    NSString *failureReason = AFJSONStructuralIndexesBuild(&_structurals, _bytes, _length, &errorOffset);
+    if (failureReason) {
+        self.failureReason = failureReason;
+        self.errorOffset = errorOffset;
+        return nil;
+    }
+
+    NSMutableArray *components = [NSMutableArray array];
+    for (NSString *component in [rootKeyPath length] > 0 ? [rootKeyPath componentsSeparatedByString:@"."] : @[]) {
+        [components addObject:[component dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+
+    BOOL found = NO;
+    id result = [self readValueAtKeyPathComponents:components index:0 modelClass:modelClass found:&found];
+    if (result && _cursor != _structurals.count) {
+        [self failWithReason:NSLocalizedStringFromTable(@"Unexpected data after root value", @"AFNetworking", nil)];
+        return nil;
+    } else if (result && !found) {
+        [self failWithReason:NSLocalizedStringFromTable(@"No object or array at root key path", @"AFNetworking", nil)];
+        return nil;
+    }
+
+    return result;
+}
+
+@end
+
+#pragma mark -
+
+@implementation AFJSONModelResponseSerializer
+
++ (instancetype)serializerWithModelClass:(Class)modelClass
+                             rootKeyPath:(NSString *)rootKeyPath
+{
+    AFJSONModelResponseSerializer *serializer = [self serializer];
+    serializer.modelClass = modelClass;
+    serializer.rootKeyPath = rootKeyPath;
+
+    return serializer;
+}
+
+#pragma mark - AFURLResponseSerialization
+
+- (id)responseObjectForResponse:(NSURLResponse *)response
+                           data:(NSData *)data
+                          error:(NSError *__autoreleasing *)error
+{
+    if (!self.modelClass) {
+        return [super responseObjectForResponse:response data:data error:error];
+    }
+
+    if (![self validateResponse:(NSHTTPURLResponse *)response data:data error:error]) {
+        if (!error || AFErrorOrUnderlyingErrorHasCodeInDomain(*error, NSURLErrorCannotDecodeContentData, AFURLResponseSerializationErrorDomain)) {
+            return nil;
+        }
+    }
+
+    BOOL isSpace = [data isEqualToData:[NSData dataWithBytes:" " length:1]];
+    if (data.length == 0 || isSpace) {
+        return nil;
+    }
+
+    if ([data length] >= UINT32_MAX) {
+        if (error) {
+            *error = AFErrorWithUnderlyingError(AFJSONStreamParseError(0, NSLocalizedStringFromTable(@"Response too large", @"AFNetworking", nil)), *error);
+        }
+        return nil;
+    }
+
+    AFJSONModelDecoder *decoder = [[AFJSONModelDecoder alloc] initWithData:data];
+    id responseObject = [decoder decodeModelsOfClass:self.modelClass rootKeyPath:self.rootKeyPath];
+    if (!responseObject && error) {
+        *error = AFErrorWithUnderlyingError(AFJSONStreamParseError(decoder.errorOffset, decoder.failureReason), *error);
+    }
+
+    return responseObject;
+}
+
+#pragma mark - NSSecureCoding
+
+- (instancetype)initWithCoder:(NSCoder *)decoder {
+    self = [super initWithCoder:decoder];
+    if (!self) {
+        return nil;
+    }
+
+    //归档中的类名不可信，只接受存在并且遵循AFJSONModel的类
+    NSString *modelClassName = [decoder decodeObjectOfClass:[NSString class] forKey:NSStringFromSelector(@selector(modelClass))];
+    if (modelClassName) {
+        Class modelClass = NSClassFromString(modelClassName);
+        if (![modelClass conformsToProtocol:@protocol(AFJSONModel)]) {
+            return nil;
+        }
+        self.modelClass = modelClass;
+    }
+    self.rootKeyPath = [decoder decodeObjectOfClass:[NSString class] forKey:NSStringFromSelector(@selector(rootKeyPath))];
+
+    return self;
+}
+
+- (void)encodeWithCoder:(NSCoder *)coder {
+    [super encodeWithCoder:coder];
+
+    [coder encodeObject:(self.modelClass ? NSStringFromClass(self.modelClass) : nil) forKey:NSStringFromSelector(@selector(modelClass))];
+    [coder encodeObject:self.rootKeyPath forKey:NSStringFromSelector(@selector(rootKeyPath))];
+}
+
+#pragma mark - NSCopying
+
+- (instancetype)copyWithZone:(NSZone *)zone {
+    AFJSONModelResponseSerializer *serializer = [super copyWithZone:zone];
+    serializer.modelClass = self.modelClass;
+    serializer.rootKeyPath = self.rootKeyPath;
+
+    return serializer;
+}
+
+@end
+
+#pragma mark -
+
+//解析一行记录，行号用于错误信息
+static id AFJSONLinesRecordWithLine(NSData *line, NSUInteger lineNumber, NSJSONReadingOptions readingOptions, NSError * __autoreleasing *error) {
+    NSError *serializationError = nil;
+    id record = [NSJSONSerialization JSONObjectWithData:line options:readingOptions | NSJSONReadingAllowFragments error:&serializationError];
+    if (!record && error) {
+        NSMutableDictionary *userInfo = [NSMutableDictionary dictionary];
+        userInfo[NSLocalizedDescriptionKey] = NSLocalizedStringFromTable(@"Data could not be decoded as JSON Lines", @"AFNetworking", nil);
+        userInfo[NSLocalizedFailureReasonErrorKey] = [NSString stringWithFormat:NSLocalizedStringFromTable(@"Record on line %lu is not valid JSON.", @"AFNetworking", nil), (unsigned long)lineNumber];
+        userInfo[NSUnderlyingErrorKey] = serializationError;
+        *error = [NSError errorWithDomain:AFURLResponseSerializationErrorDomain code:NSURLErrorCannotParseResponse userInfo:userInfo];
+    }
+
+    return record;
+}
+
+//只包含空白字符的行不是记录
+static BOOL AFJSONLinesIsBlankLine(const uint8_t *bytes, NSUInteger length) {
+    for (NSUInteger idx = 0; idx < length; idx++) {
+        if (bytes[idx] != ' ' && bytes[idx] != '\t' && bytes[idx] != '\r') {
+            return NO;
+        }
+    }
+
+    return YES;
+}
+
+@implementation AFJSONLinesResponseSerializer
+
+- (instancetype)init {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.acceptableContentTypes = [NSSet setWithObjects:@"application/x-ndjson", @"application/ndjson", @"application/jsonl", @"application/x-jsonlines", nil];
+
+    return self;
+}
+
+#pragma mark - AFURLResponseSerialization
+
+//按换行拆分响应数据，逐行解析成记录数组
+- (id)responseObjectForResponse:(NSURLResponse *)response
+                           data:(NSData *)data
+                          error:(NSError *__autoreleasing *)error
+{
+    if (![self validateResponse:(NSHTTPURLResponse *)response data:data error:error]) {
+        if (!error || AFErrorOrUnderlyingErrorHasCodeInDomain(*error, NSURLErrorCannotDecodeContentData, AFURLResponseSerializationErrorDomain)) {
+            return nil;
+        }
+    }
+
+    if ([data length] == 0) {
+        return nil;
+    }
+
+    NSMutableArray *records = [NSMutableArray array];
+    const uint8_t *bytes = [data bytes];
+    NSUInteger length = [data length];
+    NSUInteger lineNumber = 0;
+    for (NSUInteger start = 0; start < length; ) {
+        const uint8_t *newline = memchr(bytes + start, '\n', length - start);
+        NSUInteger end = newline ? (NSUInteger)(newline - bytes) : length;
+        lineNumber++;
+
+        if (!AFJSONLinesIsBlankLine(bytes + start, end - start)) {
+            NSError *serializationError = nil;
+            id record = AFJSONLinesRecordWithLine([data subdataWithRange:NSMakeRange(start, end - start)], lineNumber, self.readingOptions, &serializationError);
+            if (!record) {
+                if (error) {
+                    *error = AFErrorWithUnderlyingError(serializationError, *error);
+                }
+                return nil;
+            }
+            [records addObject:record];
+        }
+
+        start = end + 1;
+    }
+
+    return records;
+}
+
+#pragma mark - NSSecureCoding
+
+- (instancetype)initWithCoder:(NSCoder *)decoder {
+    self = [super initWithCoder:decoder];
+    if (!self) {
+        return nil;
+    }
+
+    self.readingOptions = [[decoder decodeObjectOfClass:[NSNumber class] forKey:NSStringFromSelector(@selector(readingOptions))] unsignedIntegerValue];
+
+    return self;
+}
+
+- (void)encodeWithCoder:(NSCoder *)coder {
+    [super encodeWithCoder:coder];
+
+    [coder encodeObject:@(self.readingOptions) forKey:NSStringFromSelector(@selector(readingOptions))];
+}
+
+#pragma mark - NSCopying
+
+- (instancetype)copyWithZone:(NSZone *)zone {
+    AFJSONLinesResponseSerializer *serializer = [super copyWithZone:zone];
+    serializer.readingOptions = self.readingOptions;
+
+    return serializer;
+}
+
+@end
+
+#pragma mark -
+
+@interface AFJSONLinesStreamParser ()
+@property (readwrite, nonatomic, copy) void (^recordsHandler)(NSArray *records);
+@property (readwrite, nonatomic, strong) dispatch_queue_t queue;
+@property (readwrite, nonatomic, copy) void (^backpressureHandler)(BOOL shouldSuspend);
+//上一块数据末尾不完整的行
+@property (readwrite, nonatomic, strong) NSMutableData *partialLine;
+//还没有解析的完整行
+@property (readwrite, nonatomic, strong) NSMutableArray <NSData *> *pendingLines;
+@property (readwrite, nonatomic, assign) NSUInteger numberOfLines;
+@property (readwrite, nonatomic, assign) NSUInteger numberOfRecords;
+@property (readwrite, nonatomic, strong) NSError *parseError;
+//已经交出但记录处理block还没有处理完的批数，由lock保护
+@property (readwrite, nonatomic, assign) NSUInteger numberOfPendingBatches;
+@property (readwrite, nonatomic, assign, getter=isSuspended) BOOL suspended;
+@property (readwrite, nonatomic, strong) NSLock *lock;
+//还没有交给记录处理block的批次，结束解析时等待
+@property (readwrite, nonatomic, strong) dispatch_group_t deliveryGroup;
+//按顺序交出记录的私有串行队列，目标队列为调用方的队列
+@property (readwrite, nonatomic, strong) dispatch_queue_t deliveryQueue;
+//按状态改变的顺序调用背压回调的私有串行队列
+@property (readwrite, nonatomic, strong) dispatch_queue_t backpressureQueue;
+@end
+
+//标记私有的交出队列，结束解析时判断是否在这个队列上
+static void * AFJSONLinesStreamParserQueueKey = &AFJSONLinesStreamParserQueueKey;
+
+@implementation AFJSONLinesStreamParser
+
+- (instancetype)initWithRecordsHandler:(void (^)(NSArray *))recordsHandler
+                                 queue:(dispatch_queue_t)queue
+{
+    NSParameterAssert(recordsHandler);
+
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.recordsHandler = recordsHandler;
+    self.queue = queue ?: dispatch_get_main_queue();
+    self.responseSerializer = [AFJSONLinesResponseSerializer serializer];
+    self.batchSize = 100;
+    self.maximumNumberOfPendingBatches = 4;
+    self.partialLine = [NSMutableData data];
+    self.pendingLines = [NSMutableArray array];
+    self.lock = [[NSLock alloc] init];
+    self.deliveryGroup = dispatch_group_create();
+    //标记只加在私有队列上，不修改调用方的队列
+    self.deliveryQueue = dispatch_queue_create("com.alamofire.networking.json-lines.delivery", DISPATCH_QUEUE_SERIAL);
+    dispatch_set_target_queue(self.deliveryQueue, self.queue);
+    dispatch_queue_set_specific(self.deliveryQueue, AFJSONLinesStreamParserQueueKey, (__bridge void *)self.deliveryQueue, NULL);
+    self.backpressureQueue = dispatch_queue_create("com.alamofire.networking.json-lines.backpressure", DISPATCH_QUEUE_SERIAL);
+
+    return self;
+}
+
+- (void)setBackpressureHandler:(void (^)(BOOL))handler {
+    [self.lock lock];
+    _backpressureHandler = [handler copy];
+    [self.lock unlock];
+}
+
+#pragma mark -
+
+//加入一行，攒够一批时解析并交出
+- (BOOL)addLine:(NSData *)line {
+    self.numberOfLines++;
+    if (AFJSONLinesIsBlankLine([line bytes], [line length])) {
+        //空行也占一个行号，用空数据占位
+        [self.pendingLines addObject:[NSData data]];
+    } else {
+        [self.pendingLines addObject:line];
+    }
+
+    if ([self.pendingLines count] >= MAX(self.batchSize, 1U)) {
+        return [self flushPendingLines];
+    }
+
+    return YES;
+}
+
+//解析攒下的行，按顺序交给记录处理block
+- (BOOL)flushPendingLines {
+    NSArray <NSData *> *lines = [self.pendingLines copy];
+    [self.pendingLines removeAllObjects];
+
+    NSUInteger count = [lines count];
+    if (count == 0) {
+        return YES;
+    }
+
+    NSUInteger firstLineNumber = self.numberOfLines - count + 1;
+    NSJSONReadingOptions readingOptions = self.responseSerializer.readingOptions;
+    __strong id *records = (__strong id *)calloc(count, sizeof(id));
+    __strong NSError **errors = (__strong NSError **)calloc(count, sizeof(NSError *));
+
+    void (^parseLine)(size_t) = ^(size_t idx) {
+        if ([lines[idx] length] > 0) {
+            NSError *error = nil;
+            records[idx] = AFJSONLinesRecordWithLine(lines[idx], firstLineNumber + idx, readingOptions, &error);
+            errors[idx] = error;
+        }
+    };
+
+    if (self.parsesBatchesConcurrently && count > 1) {
+        dispatch_apply(count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), parseLine);
+    } else {
+        for (NSUInteger idx = 0; idx < count; idx++) {
+            parseLine(idx);
+        }
+    }
+
+    NSMutableArray *batch = [NSMutableArray arrayWithCapacity:count];
+    NSError *error = nil;
+    for (NSUInteger idx = 0; idx < count; idx++) {
+        if (records[idx]) {
+            [batch addObject:records[idx]];
+        } else if (!error && errors[idx]) {
+            error = errors[idx];
+        }
+        records[idx] = nil;
+        errors[idx] = nil;
+    }
+    free(records);
+    free(errors);
+
+    //出错时丢弃整批，之前的批次已经交出
+    if (error) {
+        self.parseError = error;
+        return NO;
+    }
+
+    if ([batch count] > 0) {
+        self.numberOfRecords += [batch count];
+        [self deliverRecords:batch];
+    }
+
+    return YES;
+}
+
+//交出一批记录，落后的批数达到上限时请求暂停传输，处理跟上以后请求恢复。
+//暂停和恢复分别在解析线程和交出队列上发生，在锁内按状态改变的顺序排入私有串行队列，回调在锁外调用
+- (void)deliverRecords:(NSArray *)records {
+    [self.lock lock];
+    self.numberOfPendingBatches++;
+    if (self.maximumNumberOfPendingBatches > 0 && self.numberOfPendingBatches >= self.maximumNumberOfPendingBatches && !self.suspended && _backpressureHandler) {
+        self.suspended = YES;
+        [self performBackpressureHandler:_backpressureHandler shouldSuspend:YES];
+    }
+    [self.lock unlock];
+
+    dispatch_group_async(self.deliveryGroup, self.deliveryQueue, ^{
+        self.recordsHandler(records);
+
+        [self.lock lock];
+        self.numberOfPendingBatches--;
+        if (self.suspended && self.numberOfPendingBatches < self.maximumNumberOfPendingBatches) {
+            self.suspended = NO;
+            if (self->_backpressureHandler) {
+                [self performBackpressureHandler:self->_backpressureHandler shouldSuspend:NO];
+            }
+        }
+        [self.lock unlock];
+    });
+}
+
+- (void)performBackpressureHandler:(void (^)(BOOL shouldSuspend))handler
+                     shouldSuspend:(BOOL)shouldSuspend
+{
+    dispatch_async(self.backpressureQueue, ^{
+        handler(shouldSuspend);
+    });
+}
+
+#pragma mark - AFURLResponseStreamParsing
+
+//按换行拆分数据块，跨块的行拼接在partialLine中，每块结束时交出已经完整的记录
+- (BOOL)parseData:(NSData *)data
+            error:(NSError * __autoreleasing *)error
+{
+    if (!self.parseError) {
+        __block BOOL success = YES;
+        [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+            NSUInteger start = 0;
+            while (start < byteRange.length) {
+                const uint8_t *newline = memchr((const uint8_t *)bytes + start, '\n', byteRange.length - start);
+                if (!newline) {
+                    [self.partialLine appendBytes:(const uint8_t *)bytes + start length:byteRange.length - start];
+                    break;
+                }
+
+                NSUInteger end = (NSUInteger)(newline - (const uint8_t *)bytes);
+                NSData *line = nil;
+                if ([self.partialLine length] > 0) {
+                    [self.partialLine appendBytes:(const uint8_t *)bytes + start length:end - start];
+                    line = [self.partialLine copy];
+                    [self.partialLine setLength:0];
+                } else {
+                    line = [NSData dataWithBytes:(const uint8_t *)bytes + start length:end - start];
+                }
+
+                if (![self addLine:line]) {
+                    success = NO;
+                    *stop = YES;
+                    return;
+                }
+                start = end + 1;
+            }
+        }];
+
+        if (success) {
+            [self flushPendingLines];
+        }
+    }
+
+    if (self.parseError) {
+        if (error) {
+            *error = self.parseError;
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
+//解析最后一行没有换行结尾的记录
+- (void)flushPartialLine {
+    if (!self.parseError && [self.partialLine length] > 0) {
+        NSData *line = [self.partialLine copy];
+        [self.partialLine setLength:0];
+        if ([self addLine:line]) {
+            [self flushPendingLines];
+        }
+    }
+}
+
+- (id)finishParsingWithError:(NSError * __autoreleasing *)error {
+    [self flushPartialLine];
+
+    //等最后几批记录都交给记录处理block后再结束，任务的完成回调不会先于这些记录。
+    //在交出队列上结束时，剩余的批次已经排在当前block之后，等待会死锁
+    if (dispatch_get_specific(AFJSONLinesStreamParserQueueKey) != (__bridge void *)self.deliveryQueue) {
+        dispatch_group_wait(self.deliveryGroup, DISPATCH_TIME_FOREVER);
+    }
+
+    if (self.parseError) {
+        if (error) {
+            *error = self.parseError;
+        }
+        return nil;
+    }
+
+    return @(self.numberOfRecords);
+}
+
+//最后几批记录都交出后再回调，不占用线程等待
+- (void)finishParsingWithCompletionHandler:(void (^)(id responseObject, NSError *error))completionHandler {
+    [self flushPartialLine];
+
+    NSError *parseError = self.parseError;
+    NSNumber *numberOfRecords = @(self.numberOfRecords);
+    dispatch_group_notify(self.deliveryGroup, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        completionHandler(parseError ? nil : numberOfRecords, parseError);
+    });
+}
+
+@end
+
+#pragma mark -
+
+@implementation AFServerSentEvent
+
+- (instancetype)initWithType:(NSString *)type
+                        data:(NSString *)data
+                  identifier:(NSString *)identifier
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _type = [type copy];
+    _data = [data copy];
+    _identifier = [identifier copy];
+
+    return self;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p, type: %@, identifier: %@, data: %@>", NSStringFromClass([self class]), self, self.type, self.identifier, self.data];
+}
+
+@end
+
+#pragma mark -
+
+//流开头的UTF-8 BOM
+static const uint8_t AFServerSentEventByteOrderMark[] = {0xef, 0xbb, 0xbf};
+
+//按UTF-8解码一行，不合法的字节序列中最长的合法前缀替换为一个U+FFFD
+static NSString * AFServerSentEventStringByDecodingUTF8(const uint8_t *bytes, NSUInteger length) {
+    NSString *string = (__bridge_transfer NSString *)CFStringCreateWithBytes(kCFAllocatorDefault, bytes, (CFIndex)length, kCFStringEncodingUTF8, false);
+    if (string) {
+        return string;
+    }
+
+    static const uint8_t replacementCharacter[] = {0xef, 0xbf, 0xbd};
+    NSMutableData *data = [NSMutableData dataWithCapacity:length + sizeof(replacementCharacter)];
+    NSUInteger idx = 0;
+    while (idx < length) {
+        uint8_t c = bytes[idx];
+        NSUInteger sequenceLength = 0;
+        uint8_t lowerBound = 0x80, upperBound = 0xbf;
+        if (c < 0x80) {
+            sequenceLength = 1;
+        } else if (c >= 0xc2 && c <= 0xdf) {
+            sequenceLength = 2;
+        } else if (c >= 0xe0 && c <= 0xef) {
+            sequenceLength = 3;
+            lowerBound = c == 0xe0 ? 0xa0 : 0x80;
+            upperBound = c == 0xed ? 0x9f : 0xbf;
+        } else if (c >= 0xf0 && c <= 0xf4) {
+            sequenceLength = 4;
+            lowerBound = c == 0xf0 ? 0x90 : 0x80;
+            upperBound = c == 0xf4 ? 0x8f : 0xbf;
+        }
+
+        NSUInteger matchedLength = 1;
+        while (matchedLength < sequenceLength && idx + matchedLength < length) {
+            uint8_t continuation = bytes[idx + matchedLength];
+            if (continuation < lowerBound || continuation > upperBound) {
+                break;
+            }
+            matchedLength++;
+            lowerBound = 0x80;
+            upperBound = 0xbf;
+        }
+
+        if (matchedLength == sequenceLength) {
+            [data appendBytes:bytes + idx length:matchedLength];
+        } else {
+            [data appendBytes:replacementCharacter length:sizeof(replacementCharacter)];
+        }
+        idx += matchedLength;
+    }
+
+    return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+}
+
+@interface AFServerSentEventParser ()
+@property (readwrite, nonatomic, copy) void (^eventHandler)(AFServerSentEvent *event);
+@property (readwrite, nonatomic, assign) NSTimeInterval reconnectionInterval;
+//上一块数据末尾不完整的行
+@property (readwrite, nonatomic, strong) NSMutableData *partialLine;
+//上一块数据以CR结尾时，下一块开头的LF属于同一个换行
+@property (readwrite, nonatomic, assign) BOOL skipsLeadingLineFeed;
+//流开头已经匹配的BOM字节数，BOM可能被拆在几块数据中
+@property (readwrite, nonatomic, assign) NSUInteger numberOfByteOrderMarkBytes;
+//流开头的BOM是否已经处理完
+@property (readwrite, nonatomic, assign) BOOL checkedByteOrderMark;
+//正在组装的事件
+@property (readwrite, nonatomic, copy) NSString *eventType;
+@property (readwrite, nonatomic, strong) NSMutableString *eventData;
+@property (readwrite, nonatomic, copy) NSString *eventIdentifier;
+@end
+
+@implementation AFServerSentEventParser
+
+- (instancetype)initWithEventHandler:(void (^)(AFServerSentEvent *))eventHandler {
+    NSParameterAssert(eventHandler);
+
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.eventHandler = eventHandler;
+    self.responseSerializer = [AFHTTPResponseSerializer serializer];
+    self.responseSerializer.acceptableContentTypes = [NSSet setWithObject:@"text/event-stream"];
+    self.partialLine = [NSMutableData data];
+    self.eventData = [NSMutableString string];
+
+    return self;
+}
+
+//空行分发事件，其他行按字段处理，未知字段和注释被忽略
+- (void)processLineWithBytes:(const uint8_t *)bytes length:(NSUInteger)length {
+    if (length == 0) {
+        [self dispatchEvent];
+        return;
+    }
+
+    if (bytes[0] == ':') {
+        return;
+    }
+
+    NSString *line = AFServerSentEventStringByDecodingUTF8(bytes, length);
+
+    NSString *field = line;
+    NSString *value = @"";
+    NSRange colonRange = [line rangeOfString:@":"];
+    if (colonRange.location != NSNotFound) {
+        field = [line substringToIndex:colonRange.location];
+        value = [line substringFromIndex:NSMaxRange(colonRange)];
+        if ([value hasPrefix:@" "]) {
+            value = [value substringFromIndex:1];
+        }
+    }
+
+    if ([field isEqualToString:@"data"]) {
+        [self.eventData appendString:value];
+        [self.eventData appendString:@"\n"];
+    } else if ([field isEqualToString:@"event"]) {
+        self.eventType = value;
+    } else if ([field isEqualToString:@"id"]) {
+        //包含NULL字符的ID被忽略
+        if ([value rangeOfCharacterFromSet:[NSCharacterSet characterSetWithRange:NSMakeRange(0, 1)]].location == NSNotFound) {
+            self.eventIdentifier = value;
+        }
+    } else if ([field isEqualToString:@"retry"]) {
+        NSCharacterSet *nonDigits = [[NSCharacterSet decimalDigitCharacterSet] invertedSet];
+        if ([value length] > 0 && [value rangeOfCharacterFromSet:nonDigits].location == NSNotFound) {
+            self.reconnectionInterval = [value doubleValue] / 1000.0;
+        }
+    }
+}
+
+//最后一个事件ID在每次分发时更新，即使事件没有数据
+- (void)dispatchEvent {
+    if (self.eventIdentifier) {
+        self.lastEventIdentifier = [self.eventIdentifier length] > 0 ? self.eventIdentifier : nil;
+    }
+
+    if ([self.eventData length] == 0) {
+        self.eventType = nil;
+        return;
+    }
+
+    [self.eventData deleteCharactersInRange:NSMakeRange([self.eventData length] - 1, 1)];
+    AFServerSentEvent *event = [[AFServerSentEvent alloc] initWithType:([self.eventType length] > 0 ? self.eventType : @"message") data:self.eventData identifier:self.lastEventIdentifier];
+    [self.eventData setString:@""];
+    self.eventType = nil;
+
+    self.eventHandler(event);
+}
+
+#pragma mark - AFURLResponseStreamParsing
+
+//按CR、LF或CRLF拆分行，跨块的行拼接在partialLine中
+- (BOOL)parseData:(NSData *)data
+            error:(__unused NSError * __autoreleasing *)error
+{
+    if ([data length] == 0) {
+        return YES;
+    }
+
+    [data enumerateByteRangesUsingBlock:^(const void *rangeBytes, NSRange byteRange, __unused BOOL *stop) {
+        const uint8_t *bytes = rangeBytes;
+        NSUInteger length = byteRange.length;
+        NSUInteger start = 0;
+
+        //跳过流开头的UTF-8 BOM，不是BOM时已经匹配的字节作为第一行的开头
+        while (!self.checkedByteOrderMark && start < length) {
+            if (bytes[start] == AFServerSentEventByteOrderMark[self.numberOfByteOrderMarkBytes]) {
+                self.numberOfByteOrderMarkBytes++;
+                start++;
+                self.checkedByteOrderMark = self.numberOfByteOrderMarkBytes == sizeof(AFServerSentEventByteOrderMark);
+            } else {
+                [self.partialLine appendBytes:AFServerSentEventByteOrderMark length:self.numberOfByteOrderMarkBytes];
+                self.checkedByteOrderMark = YES;
+            }
+        }
+
+        if (self.skipsLeadingLineFeed && start < length) {
+            self.skipsLeadingLineFeed = NO;
+            if (bytes[start] == '\n') {
+                start++;
+            }
+        }
+
+        NSUInteger idx = start;
+        while (idx < length) {
+            uint8_t c = bytes[idx];
+            if (c != '\n' && c != '\r') {
+                idx++;
+                continue;
+            }
+
+            if ([self.partialLine length] > 0) {
+                [self.partialLine appendBytes:bytes + start length:idx - start];
+                [self processLineWithBytes:[self.partialLine bytes] length:[self.partialLine length]];
+                [self.partialLine setLength:0];
+            } else {
+                [self processLineWithBytes:bytes + start length:idx - start];
+            }
+
+            idx++;
+            if (c == '\r') {
+                if (idx == length) {
+                    self.skipsLeadingLineFeed = YES;
+                } else if (bytes[idx] == '\n') {
+                    idx++;
+                }
+            }
+            start = idx;
+        }
+
+        [self.partialLine appendBytes:bytes + start length:length - start];
+    }];
+
+    if (self.heartbeatHandler) {
+        self.heartbeatHandler();
+    }
+
+    return YES;
+}
+
+//连接结束时没有以空行结束的事件被丢弃
+- (id)finishParsingWithError:(__unused NSError * __autoreleasing *)error {
+    [self.partialLine setLength:0];
+    [self.eventData setString:@""];
+    self.eventType = nil;
+
+    return nil;
+}
+
+@end
+
+#pragma mark -
+
+//验证并解码http响应中的xml信息
+@implementation AFXMLParserResponseSerializer
+
+//返回默认配置的对象
++ (instancetype)serializer {
+    AFXMLParserResponseSerializer *serializer = [[self alloc] init];
+
+    return serializer;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.acceptableContentTypes = [[NSSet alloc] initWithObjects:@"application/xml", @"text/xml", nil];
+
+    return self;
+}
+
+#pragma mark - AFURLResponseSerialization
+//这个方法解析数据，把NSData转成相应的对象，上层AFURLConnectionOperation会调用这个方法获取转换后的对象。
+- (id)responseObjectForResponse:(NSHTTPURLResponse *)response
+                           data:(NSData *)data
+                          error:(NSError *__autoreleasing *)error
+{
+    if (![self validateResponse:(NSHTTPURLResponse *)response data:data error:error]) {
+        if (!error || AFErrorOrUnderlyingErrorHasCodeInDomain(*error, NSURLErrorCannotDecodeContentData, AFURLResponseSerializationErrorDomain)) {
+            return nil;
+        }
+    }
+
+    return [[NSXMLParser alloc] initWithData:data];
+}
+
+#pragma mark - AFURLResponseStreamSerialization
+
+//返回读取输入流的xml解析器，没有数据可以验证内容类型，内容类型不对时也要返回错误
+- (id)responseObjectForResponse:(NSHTTPURLResponse *)response
+                    inputStream:(NSInputStream *)inputStream
+                          error:(NSError *__autoreleasing *)error
+{
+    NSError *validationError = nil;
+    if (![self validateResponse:(NSHTTPURLResponse *)response data:nil error:&validationError]) {
+        if (!validationError || AFErrorOrUnderlyingErrorHasCodeInDomain(validationError, NSURLErrorCannotDecodeContentData, AFURLResponseSerializationErrorDomain)) {
+            if (error) {
+                NSDictionary *userInfo = @{NSLocalizedDescriptionKey: [NSString stringWithFormat:NSLocalizedStringFromTable(@"Request failed: unacceptable content-type: %@", @"AFNetworking", nil), [response MIMEType]]};
+                *error = validationError ?: [NSError errorWithDomain:AFURLResponseSerializationErrorDomain code:NSURLErrorCannotDecodeContentData userInfo:userInfo];
+            }
+            return nil;
+        }
+
+        if (error) {
+            *error = validationError;
+        }
+    }
+
+    return [[NSXMLParser alloc] initWithStream:inputStream];
+}
+
+@end
+
+#pragma mark -
+
+static NSError * AFXMLStreamParseError(NSInteger line, NSInteger column, NSString *reason) {
+    NSDictionary *userInfo = @{
+                               NSLocalizedDescriptionKey: NSLocalizedStringFromTable(@"Data could not be decoded as XML", @"AFNetworking", nil),
+                               NSLocalizedFailureReasonErrorKey: [NSString stringWithFormat:NSLocalizedStringFromTable(@"%@ at line %ld, column %ld.", @"AFNetworking", nil), reason, (long)line, (long)column],
+                               };
+
+    return [NSError errorWithDomain:AFURLResponseSerializationErrorDomain code:NSURLErrorCannotParseResponse userInfo:userInfo];
+}
+
+static inline BOOL AFXMLIsWhitespace(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+//带命名空间前缀的名字
+static NSString * AFXMLQualifiedName(const xmlChar *prefix, const xmlChar *localName) {
+    NSString *name = [[NSString alloc] initWithUTF8String:(const char *)localName];
+
+    return prefix ? [NSString stringWithFormat:@"%@:%@", [[NSString alloc] initWithUTF8String:(const char *)prefix], name] : name;
+}
+
+@implementation AFXMLElement
+
+- (instancetype)initWithName:(NSString *)name
+                  attributes:(NSDictionary <NSString *, NSString *> *)attributes
+                    children:(NSArray <AFXMLElement *> *)children
+                        text:(NSString *)text
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _name = [name copy];
+    _attributes = [attributes copy];
+    _children = [children copy];
+    _text = [text copy];
+
+    return self;
+}
+
+- (AFXMLElement *)childNamed:(NSString *)name {
+    for (AFXMLElement *child in self.children) {
+        if ([child.name isEqualToString:name]) {
+            return child;
+        }
+    }
+
+    return nil;
+}
+
+- (NSArray <AFXMLElement *> *)childrenNamed:(NSString *)name {
+    NSMutableArray *mutableChildren = [NSMutableArray array];
+    for (AFXMLElement *child in self.children) {
+        if ([child.name isEqualToString:name]) {
+            [mutableChildren addObject:child];
+        }
+    }
+
+    return [mutableChildren copy];
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p, name: %@, attributes: %@, children: %lu>", NSStringFromClass([self class]), self, self.name, self.attributes, (unsigned long)[self.children count]];
+}
+
+@end
+
+#pragma mark -
+
+//正在解析的元素
+@interface AFXMLStreamFrame : NSObject
+@property (readwrite, nonatomic, copy) NSString *name;
+@property (readwrite, nonatomic, copy) NSDictionary *attributes;
+@property (readwrite, nonatomic, strong) NSMutableArray *children;
+@property (readwrite, nonatomic, strong) NSMutableData *text;
+//当前这段字符数据在text中开始的位置，以及它是否只有空白
+@property (readwrite, nonatomic, assign) NSUInteger textRunStart;
+@property (readwrite, nonatomic, assign) BOOL textRunIsWhitespace;
+//包括交出去的子元素
+@property (readwrite, nonatomic, assign) BOOL hasChildElements;
+@property (readwrite, nonatomic, copy) NSString *path;
+@property (readwrite, nonatomic, copy) void (^elementHandler)(AFXMLElement *element, BOOL *stop);
+@end
+
+@implementation AFXMLStreamFrame
+@end
+
+@interface AFXMLStreamParser ()
+@property (readwrite, nonatomic, assign) xmlParserCtxtPtr parserContext;
+@property (readwrite, nonatomic, strong) NSMutableDictionary *mutableElementHandlersKeyedByPath;
+@property (readwrite, nonatomic, strong) NSMutableArray <AFXMLStreamFrame *> *frames;
+@property (readwrite, nonatomic, strong) AFXMLElement *rootElement;
+@property (readwrite, nonatomic, strong) NSError *parseError;
+//是否收到过空白以外的字节，只有空白的响应和空响应一样处理
+@property (readwrite, nonatomic, assign) BOOL hasContent;
+
+- (void)startElementWithName:(NSString *)name
+                  attributes:(NSDictionary *)attributes;
+- (void)endElement;
+- (void)appendCharacters:(const xmlChar *)characters
+                  length:(NSUInteger)length
+         isCharacterData:(BOOL)isCharacterData;
+- (BOOL)failWithError:(NSError *)error;
+@end
+
+//libxml2回调的context是解析器。userData不是解析上下文时，libxml2不会绕过getEntity回调去加载外部实体，
+//所以文档类型声明相关的SAX2默认回调要自己传入解析上下文
+static inline AFXMLStreamParser * AFXMLStreamParserForContext(void *context) {
+    return (__bridge AFXMLStreamParser *)context;
+}
+
+static void AFXMLStreamParserStartDocument(void *context) {
+    xmlSAX2StartDocument(AFXMLStreamParserForContext(context).parserContext);
+}
+
+static void AFXMLStreamParserInternalSubset(void *context, const xmlChar *name, const xmlChar *externalIdentifier, const xmlChar *systemIdentifier) {
+    xmlSAX2InternalSubset(AFXMLStreamParserForContext(context).parserContext, name, externalIdentifier, systemIdentifier);
+}
+
+static void AFXMLStreamParserEntityDeclaration(void *context, const xmlChar *name, int type, const xmlChar *publicIdentifier, const xmlChar *systemIdentifier, xmlChar *content) {
+    xmlSAX2EntityDecl(AFXMLStreamParserForContext(context).parserContext, name, type, publicIdentifier, systemIdentifier, content);
+}
+
+static void AFXMLStreamParserStartElement(void *context, const xmlChar *localName, const xmlChar *prefix, const xmlChar *URI, int numberOfNamespaces, const xmlChar **namespaces, int numberOfAttributes, int numberOfDefaultedAttributes, const xmlChar **attributes) {
+    NSMutableDictionary *mutableAttributes = [NSMutableDictionary dictionaryWithCapacity:(NSUInteger)(numberOfNamespaces + numberOfAttributes)];
+
+    //命名空间声明也作为属性保留
+    for (int idx = 0; idx < numberOfNamespaces; idx++) {
+        const xmlChar *namespacePrefix = namespaces[idx * 2];
+        NSString *name = namespacePrefix ? AFXMLQualifiedName((const xmlChar *)"xmlns", namespacePrefix) : @"xmlns";
+        mutableAttributes[name] = namespaces[idx * 2 + 1] ? [[NSString alloc] initWithUTF8String:(const char *)namespaces[idx * 2 + 1]] : @"";
+    }
+
+    //每个属性依次是名字、前缀、命名空间、值的开始和结尾
+    for (int idx = 0; idx < numberOfAttributes; idx++) {
+        const xmlChar **attribute = attributes + idx * 5;
+        NSString *value = [[NSString alloc] initWithBytes:attribute[3] length:(NSUInteger)(attribute[4] - attribute[3]) encoding:NSUTF8StringEncoding];
+        mutableAttributes[AFXMLQualifiedName(attribute[1], attribute[0])] = value ?: @"";
+    }
+
+    [AFXMLStreamParserForContext(context) startElementWithName:AFXMLQualifiedName(prefix, localName) attributes:mutableAttributes];
+}
+
+static void AFXMLStreamParserEndElement(void *context, const xmlChar *localName, const xmlChar *prefix, const xmlChar *URI) {
+    [AFXMLStreamParserForContext(context) endElement];
+}
+
+static void AFXMLStreamParserCharacters(void *context, const xmlChar *characters, int length) {
+    [AFXMLStreamParserForContext(context) appendCharacters:characters length:(NSUInteger)length isCharacterData:NO];
+}
+
+static void AFXMLStreamParserCharacterDataBlock(void *context, const xmlChar *characters, int length) {
+    [AFXMLStreamParserForContext(context) appendCharacters:characters length:(NSUInteger)length isCharacterData:YES];
+}
+
+//只展开文档内部声明的实体，外部实体不加载
+static xmlEntityPtr AFXMLStreamParserGetEntity(void *context, const xmlChar *name) {
+    xmlEntityPtr entity = xmlGetPredefinedEntity(name);
+    if (!entity) {
+        entity = xmlGetDocEntity(AFXMLStreamParserForContext(context).parserContext->myDoc, name);
+    }
+
+    return entity && (entity->etype == XML_INTERNAL_GENERAL_ENTITY || entity->etype == XML_INTERNAL_PREDEFINED_ENTITY) ? entity : NULL;
+}
+
+static xmlEntityPtr AFXMLStreamParserGetParameterEntity(void *context, const xmlChar *name) {
+    xmlEntityPtr entity = xmlGetParameterEntity(AFXMLStreamParserForContext(context).parserContext->myDoc, name);
+
+    return entity && entity->etype == XML_INTERNAL_PARAMETER_ENTITY ? entity : NULL;
+}
+
+//libxml2从2.12开始错误回调的参数是const指针
+#if LIBXML_VERSION >= 21200
+typedef const xmlError * AFXMLErrorPointer;
+#else
+typedef xmlErrorPtr AFXMLErrorPointer;
+#endif
+
+//只有致命错误会让文档不是格式良好的，其他错误和警告忽略
+static void AFXMLStreamParserStructuredError(void *context, AFXMLErrorPointer error) {
+    if (!error || error->level != XML_ERR_FATAL) {
+        return;
+    }
+
+    NSString *reason = error->message ? [[[NSString alloc] initWithUTF8String:error->message] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]] : nil;
+    [AFXMLStreamParserForContext(context) failWithError:AFXMLStreamParseError(error->line, error->int2, reason ?: NSLocalizedStringFromTable(@"Malformed XML", @"AFNetworking", nil))];
+}
+
+@implementation AFXMLStreamParser
+
+- (instancetype)init {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        xmlInitParser();
+    });
+
+    //文档类型声明中的实体仍由libxml2记录在myDoc中，元素、文本和错误交给解析器，注释和处理指令忽略
+    xmlSAXHandler handler;
+    memset(&handler, 0, sizeof(handler));
+    handler.initialized = XML_SAX2_MAGIC;
+    handler.startDocument = AFXMLStreamParserStartDocument;
+    handler.internalSubset = AFXMLStreamParserInternalSubset;
+    handler.entityDecl = AFXMLStreamParserEntityDeclaration;
+    handler.startElementNs = AFXMLStreamParserStartElement;
+    handler.endElementNs = AFXMLStreamParserEndElement;
+    handler.characters = AFXMLStreamParserCharacters;
+    handler.ignorableWhitespace = AFXMLStreamParserCharacters;
+    handler.cdataBlock = AFXMLStreamParserCharacterDataBlock;
+    handler.getEntity = AFXMLStreamParserGetEntity;
+    handler.getParameterEntity = AFXMLStreamParserGetParameterEntity;
+    handler.serror = AFXMLStreamParserStructuredError;
+
+    //编码在收到前几个字节以后才能判断，所以创建时不传数据
+    _parserContext = xmlCreatePushParserCtxt(&handler, (__bridge void *)self, NULL, 0, NULL);
+    if (!_parserContext) {
+        return nil;
+    }
+    xmlCtxtUseOptions(_parserContext, XML_PARSE_NOENT | XML_PARSE_NONET);
+
+    self.responseSerializer = [AFXMLParserResponseSerializer serializer];
+    self.mutableElementHandlersKeyedByPath = [NSMutableDictionary dictionary];
+    self.frames = [NSMutableArray array];
+
+    return self;
+}
+
+- (void)dealloc {
+    if (_parserContext) {
+        //myDoc只用来保存文档类型声明中的实体
+        if (_parserContext->myDoc) {
+            xmlFreeDoc(_parserContext->myDoc);
+            _parserContext->myDoc = NULL;
+        }
+        xmlFreeParserCtxt(_parserContext);
+    }
+}
+
+- (void)setElementHandler:(void (^)(AFXMLElement *, BOOL *))handler
+           forElementPath:(NSString *)path
+{
+    NSParameterAssert(path);
+
+    self.mutableElementHandlersKeyedByPath[path] = [handler copy];
+}
+
+#pragma mark -
+
+//只保留第一个错误，并停止libxml2继续回调
+- (BOOL)failWithError:(NSError *)error {
+    if (!self.parseError) {
+        self.parseError = error;
+        self.frames = nil;
+        self.rootElement = nil;
+        xmlStopParser(self.parserContext);
+    }
+
+    return NO;
+}
+
+- (void)startTextRunInFrame:(AFXMLStreamFrame *)frame {
+    frame.textRunStart = [frame.text length];
+    frame.textRunIsWhitespace = YES;
+}
+
+//子元素旁边只有空白的字符数据不算作元素的文本
+- (void)discardWhitespaceTextRunInFrame:(AFXMLStreamFrame *)frame {
+    if (frame.textRunIsWhitespace && [frame.text length] > frame.textRunStart) {
+        [frame.text setLength:frame.textRunStart];
+    }
+}
+
+//libxml2交出的文本已经是UTF-8，实体引用也已经替换
+- (void)appendCharacters:(const xmlChar *)characters
+                  length:(NSUInteger)length
+         isCharacterData:(BOOL)isCharacterData
+{
+    AFXMLStreamFrame *frame = [self.frames lastObject];
+    if (!frame || length == 0) {
+        return;
+    }
+
+    BOOL isWhitespace = !isCharacterData;
+    for (NSUInteger idx = 0; idx < length && isWhitespace; idx++) {
+        isWhitespace = AFXMLIsWhitespace(characters[idx]);
+    }
+
+    if (!frame.text) {
+        frame.text = [NSMutableData dataWithCapacity:length];
+    }
+    frame.textRunIsWhitespace = frame.textRunIsWhitespace && isWhitespace;
+    [frame.text appendBytes:characters length:length];
+}
+
+- (void)startElementWithName:(NSString *)name
+                  attributes:(NSDictionary *)attributes
+{
+    if (self.parseError) {
+        return;
+    }
+
+    AFXMLStreamFrame *parentFrame = [self.frames lastObject];
+    if (parentFrame) {
+        [self discardWhitespaceTextRunInFrame:parentFrame];
+    }
+
+    AFXMLStreamFrame *frame = [[AFXMLStreamFrame alloc] init];
+    frame.name = name;
+    frame.attributes = attributes;
+    frame.textRunIsWhitespace = YES;
+    if ([self.mutableElementHandlersKeyedByPath count] > 0) {
+        frame.path = parentFrame ? [NSString stringWithFormat:@"%@/%@", parentFrame.path, name] : name;
+        frame.elementHandler = self.mutableElementHandlersKeyedByPath[frame.path];
+    }
+    [self.frames addObject:frame];
+}
+
+- (void)endElement {
+    AFXMLStreamFrame *frame = [self.frames lastObject];
+    if (!frame) {
+        return;
+    }
+
+    if (frame.hasChildElements) {
+        [self discardWhitespaceTextRunInFrame:frame];
+    }
+
+    NSString *text = [frame.text length] > 0 ? [[NSString alloc] initWithData:frame.text encoding:NSUTF8StringEncoding] : nil;
+    AFXMLElement *element = [[AFXMLElement alloc] initWithName:frame.name attributes:(frame.attributes ?: @{}) children:(frame.children ?: @[]) text:(text ?: @"")];
+    [self.frames removeLastObject];
+
+    AFXMLStreamFrame *parentFrame = [self.frames lastObject];
+    if (frame.elementHandler) {
+        BOOL stop = NO;
+        @autoreleasepool {
+            frame.elementHandler(element, &stop);
+        }
+        if (stop) {
+            [self failWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+            return;
+        }
+    } else if (parentFrame) {
+        if (!parentFrame.children) {
+            parentFrame.children = [NSMutableArray array];
+        }
+        [parentFrame.children addObject:element];
+    } else {
+        self.rootElement = element;
+    }
+
+    if (parentFrame) {
+        parentFrame.hasChildElements = YES;
+        [self startTextRunInFrame:parentFrame];
+    }
+}
+
+- (BOOL)parseData:(NSData *)data
+            error:(NSError * __autoreleasing *)error
+{
+    if (!self.parseError) {
+        [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+            if (![self parseBytes:bytes length:byteRange.length]) {
+                *stop = YES;
+            }
+        }];
+    }
+
+    if (self.parseError) {
+        if (error) {
+            *error = self.parseError;
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
+//交给libxml2的推送解析器，它自己保存块末尾不完整的标记
+- (BOOL)parseBytes:(const char *)bytes length:(NSUInteger)length {
+    for (NSUInteger idx = 0; idx < length && !self.hasContent; idx++) {
+        self.hasContent = !AFXMLIsWhitespace((uint8_t)bytes[idx]);
+    }
+
+    while (length > 0) {
+        int chunkLength = (int)MIN(length, (NSUInteger)INT_MAX);
+        xmlParseChunk(self.parserContext, bytes, chunkLength, 0);
+        if (![self checkWellFormed]) {
+            return NO;
+        }
+        bytes += chunkLength;
+        length -= (NSUInteger)chunkLength;
+    }
+
+    return YES;
+}
+
+- (BOOL)checkWellFormed {
+    if (!self.parseError && !self.parserContext->wellFormed) {
+        [self failWithError:AFXMLStreamParseError(xmlSAX2GetLineNumber(self.parserContext), xmlSAX2GetColumnNumber(self.parserContext), NSLocalizedStringFromTable(@"Malformed XML", @"AFNetworking", nil))];
+    }
+
+    return !self.parseError;
+}
+
+- (id)finishParsingWithError:(NSError * __autoreleasing *)error {
+    if (!self.parseError && self.hasContent && self.parserContext->instate != XML_PARSER_EOF) {
+        xmlParseChunk(self.parserContext, NULL, 0, 1);
+        [self checkWellFormed];
+    }
+
+    if (self.parseError) {
+        if (error) {
+            *error = self.parseError;
         }
+        return nil;
     }
 
-    return [[NSXMLParser alloc] initWithData:data];
+    return self.rootElement;
 }
 
 @end
@@ -548,6 +4403,504 @@ static id AFJSONObjectByRemovingKeysWithNullValues(id JSONObject, NSJSONReadingO
 
 #pragma mark -
 
+//二进制响应的解码格式
+typedef NS_ENUM(NSInteger, AFBinaryResponseFormat) {
+    AFBinaryResponseFormatMessagePack = 0,
+    AFBinaryResponseFormatCBOR        = 1,
+};
+
+//解码时允许的最大嵌套层数，避免恶意数据导致递归过深
+static NSUInteger const kAFBinaryResponseMaximumDepth = 1024;
+
+//顺序读取响应数据，data用于创建不拷贝的二进制对象
+typedef struct {
+    const uint8_t *bytes;
+    NSUInteger length;
+    NSUInteger offset;
+    __unsafe_unretained NSData *data;
+} AFBinaryResponseReader;
+
+static NSError * AFBinaryResponseCannotParseError(AFBinaryResponseFormat format) {
+    NSString *description = format == AFBinaryResponseFormatMessagePack ? NSLocalizedStringFromTable(@"Data could not be decoded as MessagePack", @"AFNetworking", nil) : NSLocalizedStringFromTable(@"Data could not be decoded as CBOR", @"AFNetworking", nil);
+    return [NSError errorWithDomain:AFURLResponseSerializationErrorDomain code:NSURLErrorCannotParseResponse userInfo:@{NSLocalizedDescriptionKey: description}];
+}
+
+//读取length个字节，剩余数据不足时返回NULL
+static inline const uint8_t * AFBinaryResponseReaderRead(AFBinaryResponseReader *reader, uint64_t length) {
+    if (length > reader->length - reader->offset) {
+        return NULL;
+    }
+
+    const uint8_t *bytes = reader->bytes + reader->offset;
+    reader->offset += (NSUInteger)length;
+
+    return bytes;
+}
+
+static inline BOOL AFBinaryResponseReaderReadBigEndian(AFBinaryResponseReader *reader, NSUInteger length, uint64_t *value) {
+    const uint8_t *bytes = AFBinaryResponseReaderRead(reader, length);
+    if (!bytes) {
+        return NO;
+    }
+
+    uint64_t result = 0;
+    for (NSUInteger idx = 0; idx < length; idx++) {
+        result = (result << 8) | bytes[idx];
+    }
+    *value = result;
+
+    return YES;
+}
+
+static inline double AFBinaryResponseDoubleFromBits(uint64_t bits) {
+    double value = 0;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline float AFBinaryResponseFloatFromBits(uint32_t bits) {
+    float value = 0;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+//容器中每个元素至少占一个字节，元素个数超过剩余字节数的数据一定无效，避免按伪造的个数分配内存
+static inline BOOL AFBinaryResponseReaderCanContainCount(AFBinaryResponseReader *reader, uint64_t count) {
+    return count <= reader->length - reader->offset;
+}
+
+//字符串直接从响应数据创建，不经过中间的NSData
+static NSString * AFBinaryResponseReaderReadString(AFBinaryResponseReader *reader, uint64_t length) {
+    const uint8_t *bytes = AFBinaryResponseReaderRead(reader, length);
+    if (!bytes) {
+        return nil;
+    }
+
+    return (__bridge_transfer NSString *)CFStringCreateWithBytes(kCFAllocatorDefault, bytes, (CFIndex)length, kCFStringEncodingUTF8, false);
+}
+
+//二进制数据引用响应数据中的字节，不拷贝，创建的对象持有响应数据
+static NSData * AFBinaryResponseReaderReadData(AFBinaryResponseReader *reader, uint64_t length) {
+    const uint8_t *bytes = AFBinaryResponseReaderRead(reader, length);
+    if (!bytes) {
+        return nil;
+    }
+
+    if (length == 0) {
+        return [NSData data];
+    }
+
+    NSData *data = reader->data;
+    return [[NSData alloc] initWithBytesNoCopy:(void *)bytes length:(NSUInteger)length deallocator:^(__unused void *deallocatedBytes, __unused NSUInteger deallocatedLength) {
+        [data self];
+    }];
+}
+
+static id AFMessagePackReaderReadObject(AFBinaryResponseReader *reader, NSUInteger depth);
+
+static NSArray * AFMessagePackReaderReadArray(AFBinaryResponseReader *reader, uint64_t count, NSUInteger depth) {
+    if (!AFBinaryResponseReaderCanContainCount(reader, count)) {
+        return nil;
+    }
+
+    NSMutableArray *mutableArray = [NSMutableArray arrayWithCapacity:(NSUInteger)count];
+    for (uint64_t idx = 0; idx < count; idx++) {
+        id object = AFMessagePackReaderReadObject(reader, depth + 1);
+        if (!object) {
+            return nil;
+        }
+        [mutableArray addObject:object];
+    }
+
+    return [mutableArray copy];
+}
+
+static NSDictionary * AFMessagePackReaderReadMap(AFBinaryResponseReader *reader, uint64_t count, NSUInteger depth) {
+    if (!AFBinaryResponseReaderCanContainCount(reader, count * 2)) {
+        return nil;
+    }
+
+    NSMutableDictionary *mutableDictionary = [NSMutableDictionary dictionaryWithCapacity:(NSUInteger)count];
+    for (uint64_t idx = 0; idx < count; idx++) {
+        id key = AFMessagePackReaderReadObject(reader, depth + 1);
+        id value = key ? AFMessagePackReaderReadObject(reader, depth + 1) : nil;
+        if (!value || ![key conformsToProtocol:@protocol(NSCopying)]) {
+            return nil;
+        }
+        mutableDictionary[key] = value;
+    }
+
+    return [mutableDictionary copy];
+}
+
+//扩展类型-1是时间戳，转换为NSDate，其他扩展类型返回数据部分
+static id AFMessagePackReaderReadExtension(AFBinaryResponseReader *reader, uint64_t length) {
+    const uint8_t *type = AFBinaryResponseReaderRead(reader, 1);
+    if (!type) {
+        return nil;
+    }
+
+    if ((int8_t)*type != -1) {
+        return AFBinaryResponseReaderReadData(reader, length);
+    }
+
+    uint64_t value = 0;
+    if (length == 4 && AFBinaryResponseReaderReadBigEndian(reader, 4, &value)) {
+        return [NSDate dateWithTimeIntervalSince1970:(NSTimeInterval)value];
+    } else if (length == 8 && AFBinaryResponseReaderReadBigEndian(reader, 8, &value)) {
+        return [NSDate dateWithTimeIntervalSince1970:(NSTimeInterval)(value & 0x3ffffffffULL) + (NSTimeInterval)(value >> 34) / NSEC_PER_SEC];
+    } else if (length == 12) {
+        uint64_t nanoseconds = 0;
+        if (AFBinaryResponseReaderReadBigEndian(reader, 4, &nanoseconds) && AFBinaryResponseReaderReadBigEndian(reader, 8, &value)) {
+            return [NSDate dateWithTimeIntervalSince1970:(NSTimeInterval)(int64_t)value + (NSTimeInterval)nanoseconds / NSEC_PER_SEC];
+        }
+    }
+
+    return nil;
+}
+
+//解码一个MessagePack对象，数据无效时返回nil
+static id AFMessagePackReaderReadObject(AFBinaryResponseReader *reader, NSUInteger depth) {
+    const uint8_t *typeByte = AFBinaryResponseReaderRead(reader, 1);
+    if (!typeByte || depth > kAFBinaryResponseMaximumDepth) {
+        return nil;
+    }
+
+    uint8_t type = *typeByte;
+    if (type <= 0x7f) {
+        return @((NSInteger)type);
+    } else if (type >= 0xe0) {
+        return @((NSInteger)(int8_t)type);
+    } else if ((type & 0xe0) == 0xa0) {
+        return AFBinaryResponseReaderReadString(reader, type & 0x1f);
+    } else if ((type & 0xf0) == 0x90) {
+        return AFMessagePackReaderReadArray(reader, type & 0x0f, depth);
+    } else if ((type & 0xf0) == 0x80) {
+        return AFMessagePackReaderReadMap(reader, type & 0x0f, depth);
+    }
+
+    uint64_t value = 0;
+    switch (type) {
+        case 0xc0:
+            return [NSNull null];
+        case 0xc2:
+            return @NO;
+        case 0xc3:
+            return @YES;
+        case 0xc4:
+        case 0xc5:
+        case 0xc6:
+            return AFBinaryResponseReaderReadBigEndian(reader, 1U << (type - 0xc4), &value) ? AFBinaryResponseReaderReadData(reader, value) : nil;
+        case 0xc7:
+        case 0xc8:
+        case 0xc9:
+            return AFBinaryResponseReaderReadBigEndian(reader, 1U << (type - 0xc7), &value) ? AFMessagePackReaderReadExtension(reader, value) : nil;
+        case 0xca:
+            return AFBinaryResponseReaderReadBigEndian(reader, 4, &value) ? @(AFBinaryResponseFloatFromBits((uint32_t)value)) : nil;
+        case 0xcb:
+            return AFBinaryResponseReaderReadBigEndian(reader, 8, &value) ? @(AFBinaryResponseDoubleFromBits(value)) : nil;
+        case 0xcc:
+        case 0xcd:
+        case 0xce:
+        case 0xcf:
+            if (!AFBinaryResponseReaderReadBigEndian(reader, 1U << (type - 0xcc), &value)) {
+                return nil;
+            }
+            return value <= INT64_MAX ? @((int64_t)value) : @(value);
+        case 0xd0:
+            return AFBinaryResponseReaderReadBigEndian(reader, 1, &value) ? @((NSInteger)(int8_t)value) : nil;
+        case 0xd1:
+            return AFBinaryResponseReaderReadBigEndian(reader, 2, &value) ? @((NSInteger)(int16_t)value) : nil;
+        case 0xd2:
+            return AFBinaryResponseReaderReadBigEndian(reader, 4, &value) ? @((NSInteger)(int32_t)value) : nil;
+        case 0xd3:
+            return AFBinaryResponseReaderReadBigEndian(reader, 8, &value) ? @((int64_t)value) : nil;
+        case 0xd4:
+        case 0xd5:
+        case 0xd6:
+        case 0xd7:
+        case 0xd8:
+            return AFMessagePackReaderReadExtension(reader, 1U << (type - 0xd4));
+        case 0xd9:
+        case 0xda:
+        case 0xdb:
+            return AFBinaryResponseReaderReadBigEndian(reader, 1U << (type - 0xd9), &value) ? AFBinaryResponseReaderReadString(reader, value) : nil;
+        case 0xdc:
+        case 0xdd:
+            return AFBinaryResponseReaderReadBigEndian(reader, 2U << (type - 0xdc), &value) ? AFMessagePackReaderReadArray(reader, value, depth) : nil;
+        case 0xde:
+        case 0xdf:
+            return AFBinaryResponseReaderReadBigEndian(reader, 2U << (type - 0xde), &value) ? AFMessagePackReaderReadMap(reader, value, depth) : nil;
+        default:
+            //0xc1未使用
+            return nil;
+    }
+}
+
+#pragma mark -
+
+//半精度浮点数转换为double
+static double AFCBORDoubleFromHalf(uint16_t half) {
+    int exponent = (half >> 10) & 0x1f;
+    int mantissa = half & 0x3ff;
+    double value = 0;
+    if (exponent == 0) {
+        value = ldexp(mantissa, -24);
+    } else if (exponent != 31) {
+        value = ldexp(mantissa + 1024, exponent - 25);
+    } else {
+        value = mantissa == 0 ? INFINITY : NAN;
+    }
+
+    return (half & 0x8000) ? -value : value;
+}
+
+//读取数据项头中的数值，附加信息为31表示不定长度，数值为0
+static BOOL AFCBORReaderReadArgument(AFBinaryResponseReader *reader, uint8_t additionalInformation, uint64_t *value) {
+    if (additionalInformation < 24) {
+        *value = additionalInformation;
+        return YES;
+    } else if (additionalInformation <= 27) {
+        return AFBinaryResponseReaderReadBigEndian(reader, 1U << (additionalInformation - 24), value);
+    } else if (additionalInformation == 31) {
+        *value = 0;
+        return YES;
+    }
+
+    return NO;
+}
+
+static inline BOOL AFCBORReaderReadBreakIfPresent(AFBinaryResponseReader *reader) {
+    if (reader->offset < reader->length && reader->bytes[reader->offset] == 0xff) {
+        reader->offset++;
+        return YES;
+    }
+
+    return NO;
+}
+
+//不定长度的字节串和文本串由相同主类型的定长片段拼接而成
+static id AFCBORReaderReadIndefiniteString(AFBinaryResponseReader *reader, uint8_t majorType) {
+    NSMutableData *mutableData = [NSMutableData data];
+    while (!AFCBORReaderReadBreakIfPresent(reader)) {
+        const uint8_t *head = AFBinaryResponseReaderRead(reader, 1);
+        uint64_t length = 0;
+        if (!head || (*head >> 5) != majorType || (*head & 0x1f) == 31 || !AFCBORReaderReadArgument(reader, *head & 0x1f, &length)) {
+            return nil;
+        }
+
+        const uint8_t *bytes = AFBinaryResponseReaderRead(reader, length);
+        if (!bytes) {
+            return nil;
+        }
+        [mutableData appendBytes:bytes length:(NSUInteger)length];
+    }
+
+    if (majorType == 2) {
+        return [mutableData copy];
+    }
+
+    return [[NSString alloc] initWithData:mutableData encoding:NSUTF8StringEncoding];
+}
+
+static id AFCBORReaderReadObject(AFBinaryResponseReader *reader, NSUInteger depth);
+
+static NSArray * AFCBORReaderReadArray(AFBinaryResponseReader *reader, uint64_t count, BOOL isIndefinite, NSUInteger depth) {
+    if (!isIndefinite && !AFBinaryResponseReaderCanContainCount(reader, count)) {
+        return nil;
+    }
+
+    NSMutableArray *mutableArray = [NSMutableArray arrayWithCapacity:isIndefinite ? 0 : (NSUInteger)count];
+    for (uint64_t idx = 0; isIndefinite ? !AFCBORReaderReadBreakIfPresent(reader) : idx < count; idx++) {
+        id object = AFCBORReaderReadObject(reader, depth + 1);
+        if (!object) {
+            return nil;
+        }
+        [mutableArray addObject:object];
+    }
+
+    return [mutableArray copy];
+}
+
+static NSDictionary * AFCBORReaderReadMap(AFBinaryResponseReader *reader, uint64_t count, BOOL isIndefinite, NSUInteger depth) {
+    if (!isIndefinite && (count > UINT64_MAX / 2 || !AFBinaryResponseReaderCanContainCount(reader, count * 2))) {
+        return nil;
+    }
+
+    NSMutableDictionary *mutableDictionary = [NSMutableDictionary dictionaryWithCapacity:isIndefinite ? 0 : (NSUInteger)count];
+    for (uint64_t idx = 0; isIndefinite ? !AFCBORReaderReadBreakIfPresent(reader) : idx < count; idx++) {
+        id key = AFCBORReaderReadObject(reader, depth + 1);
+        id value = key ? AFCBORReaderReadObject(reader, depth + 1) : nil;
+        if (!value || ![key conformsToProtocol:@protocol(NSCopying)]) {
+            return nil;
+        }
+        mutableDictionary[key] = value;
+    }
+
+    return [mutableDictionary copy];
+}
+
+//解码一个CBOR数据项，数据无效时返回nil
+static id AFCBORReaderReadObject(AFBinaryResponseReader *reader, NSUInteger depth) {
+    const uint8_t *head = AFBinaryResponseReaderRead(reader, 1);
+    uint64_t argument = 0;
+    if (!head || depth > kAFBinaryResponseMaximumDepth) {
+        return nil;
+    }
+
+    uint8_t majorType = *head >> 5;
+    uint8_t additionalInformation = *head & 0x1f;
+    if (majorType == 7) {
+        switch (additionalInformation) {
+            case 20:
+                return @NO;
+            case 21:
+                return @YES;
+            case 22:
+            case 23:
+                return [NSNull null];
+            case 25:
+                return AFBinaryResponseReaderReadBigEndian(reader, 2, &argument) ? @(AFCBORDoubleFromHalf((uint16_t)argument)) : nil;
+            case 26:
+                return AFBinaryResponseReaderReadBigEndian(reader, 4, &argument) ? @(AFBinaryResponseFloatFromBits((uint32_t)argument)) : nil;
+            case 27:
+                return AFBinaryResponseReaderReadBigEndian(reader, 8, &argument) ? @(AFBinaryResponseDoubleFromBits(argument)) : nil;
+            default:
+                return nil;
+        }
+    }
+
+    if (!AFCBORReaderReadArgument(reader, additionalInformation, &argument)) {
+        return nil;
+    }
+
+    BOOL isIndefinite = additionalInformation == 31;
+    switch (majorType) {
+        case 0:
+            return isIndefinite ? nil : (argument <= INT64_MAX ? @((int64_t)argument) : @(argument));
+        case 1:
+            //-1-argument超出int64_t范围时无法表示
+            return (isIndefinite || argument > INT64_MAX) ? nil : @(-1 - (int64_t)argument);
+        case 2:
+            return isIndefinite ? AFCBORReaderReadIndefiniteString(reader, 2) : AFBinaryResponseReaderReadData(reader, argument);
+        case 3:
+            return isIndefinite ? AFCBORReaderReadIndefiniteString(reader, 3) : AFBinaryResponseReaderReadString(reader, argument);
+        case 4:
+            return AFCBORReaderReadArray(reader, argument, isIndefinite, depth);
+        case 5:
+            return AFCBORReaderReadMap(reader, argument, isIndefinite, depth);
+        case 6: {
+            if (isIndefinite) {
+                return nil;
+            }
+
+            //标签1是以秒为单位的时间，其他标签只返回内容
+            id object = AFCBORReaderReadObject(reader, depth + 1);
+            if (argument == 1) {
+                return [object isKindOfClass:[NSNumber class]] ? [NSDate dateWithTimeIntervalSince1970:[object doubleValue]] : nil;
+            }
+            return object;
+        }
+        default:
+            return nil;
+    }
+}
+
+//解码整个响应数据，数据必须恰好包含一个对象
+static id AFBinaryResponseObjectWithData(NSData *data, AFBinaryResponseFormat format, NSError * __autoreleasing *error) {
+    //可变数据在解码后可能被修改，拷贝一份不可变的数据供二进制对象引用
+    NSData *immutableData = [data copy];
+    AFBinaryResponseReader reader = {[immutableData bytes], [immutableData length], 0, immutableData};
+
+    id object = format == AFBinaryResponseFormatMessagePack ? AFMessagePackReaderReadObject(&reader, 0) : AFCBORReaderReadObject(&reader, 0);
+    if (!object || reader.offset != reader.length) {
+        if (error) {
+            *error = AFBinaryResponseCannotParseError(format);
+        }
+        return nil;
+    }
+
+    return object;
+}
+
+//验证响应并解码，验证失败但不是内容类型错误时仍然解码，与json响应序列化一致
+static id AFBinaryResponseObjectForResponse(AFHTTPResponseSerializer *serializer, NSURLResponse *response, NSData *data, AFBinaryResponseFormat format, NSError * __autoreleasing *error) {
+    if (![serializer validateResponse:(NSHTTPURLResponse *)response data:data error:error]) {
+        if (!error || AFErrorOrUnderlyingErrorHasCodeInDomain(*error, NSURLErrorCannotDecodeContentData, AFURLResponseSerializationErrorDomain)) {
+            return nil;
+        }
+    }
+
+    if ([data length] == 0) {
+        return nil;
+    }
+
+    NSError *serializationError = nil;
+    id responseObject = AFBinaryResponseObjectWithData(data, format, &serializationError);
+    if (!responseObject) {
+        if (error) {
+            *error = AFErrorWithUnderlyingError(serializationError, *error);
+        }
+        return nil;
+    }
+
+    return responseObject;
+}
+
+@implementation AFMessagePackResponseSerializer
+
+- (instancetype)init {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.acceptableContentTypes = [[NSSet alloc] initWithObjects:@"application/msgpack", @"application/x-msgpack", @"application/vnd.msgpack", nil];
+
+    return self;
+}
+
+#pragma mark - AFURLResponseSerialization
+
+//解码MessagePack响应
+- (id)responseObjectForResponse:(NSURLResponse *)response
+                           data:(NSData *)data
+                          error:(NSError *__autoreleasing *)error
+{
+    return AFBinaryResponseObjectForResponse(self, response, data, AFBinaryResponseFormatMessagePack, error);
+}
+
+@end
+
+#pragma mark -
+
+@implementation AFCBORResponseSerializer
+
+- (instancetype)init {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.acceptableContentTypes = [[NSSet alloc] initWithObjects:@"application/cbor", nil];
+
+    return self;
+}
+
+#pragma mark - AFURLResponseSerialization
+
+//解码CBOR响应
+- (id)responseObjectForResponse:(NSURLResponse *)response
+                           data:(NSData *)data
+                          error:(NSError *__autoreleasing *)error
+{
+    return AFBinaryResponseObjectForResponse(self, response, data, AFBinaryResponseFormatCBOR, error);
+}
+
+@end
+
+#pragma mark -
+
 #if TARGET_OS_IOS || TARGET_OS_TV || TARGET_OS_WATCH
 #import <CoreGraphics/CoreGraphics.h>
 #import <UIKit/UIKit.h>
@@ -790,6 +5143,8 @@ static UIImage * AFInflatedImageFromResponseWithDataAtScale(NSHTTPURLResponse *r
 @interface AFCompoundResponseSerializer ()
 //组合响应序列化数组
 @property (readwrite, nonatomic, copy) NSArray *responseSerializers;
+//MIME类型到序列化对象的查找表，设置responseSerializers时建立
+@property (readwrite, nonatomic, copy) NSDictionary <NSString *, id <AFURLResponseSerialization>> *responseSerializersByMIMEType;
 @end
 
 @implementation AFCompoundResponseSerializer
@@ -802,6 +5157,49 @@ static UIImage * AFInflatedImageFromResponseWithDataAtScale(NSHTTPURLResponse *r
     return serializer;
 }
 
+- (void)setResponseSerializers:(NSArray *)responseSerializers {
+    _responseSerializers = [responseSerializers copy];
+
+    //每个序列化对象声明的类型都对应到按顺序第一个接受它的序列化对象
+    NSMutableDictionary *mutableResponseSerializersByMIMEType = [NSMutableDictionary dictionary];
+    for (id <AFURLResponseSerialization> serializer in _responseSerializers) {
+        if (![serializer isKindOfClass:[AFHTTPResponseSerializer class]]) {
+            continue;
+        }
+
+        for (NSString *MIMEType in [(AFHTTPResponseSerializer *)serializer acceptableContentTypes]) {
+            if ([MIMEType rangeOfString:@"*"].location != NSNotFound || mutableResponseSerializersByMIMEType[MIMEType]) {
+                continue;
+            }
+
+            id <AFURLResponseSerialization> responseSerializer = [self responseSerializerAcceptingMIMEType:MIMEType];
+            if (responseSerializer) {
+                mutableResponseSerializersByMIMEType[MIMEType] = responseSerializer;
+            }
+        }
+    }
+
+    self.responseSerializersByMIMEType = mutableResponseSerializersByMIMEType;
+}
+
+//按顺序第一个接受该类型的序列化对象；如果它没有限定类型，则返回nil，交给逐个尝试的流程
+- (id <AFURLResponseSerialization>)responseSerializerAcceptingMIMEType:(NSString *)MIMEType {
+    for (id <AFURLResponseSerialization> serializer in self.responseSerializers) {
+        if (![serializer isKindOfClass:[AFHTTPResponseSerializer class]]) {
+            continue;
+        }
+
+        NSSet *acceptableContentTypes = [(AFHTTPResponseSerializer *)serializer acceptableContentTypes];
+        if (!acceptableContentTypes) {
+            return nil;
+        } else if (AFContentTypesContainMIMEType(acceptableContentTypes, MIMEType)) {
+            return serializer;
+        }
+    }
+
+    return nil;
+}
+
 #pragma mark - AFURLResponseSerialization
 
 //这个方法解析数据，把NSData转成相应的对象，上层AFURLConnectionOperation会调用这个方法获取转换后的对象。
@@ -809,6 +5207,28 @@ static UIImage * AFInflatedImageFromResponseWithDataAtScale(NSHTTPURLResponse *r
                            data:(NSData *)data
                           error:(NSError *__autoreleasing *)error
 {
+    //已知的类型直接交给对应的序列化对象
+    NSString *MIMEType = [response isKindOfClass:[NSHTTPURLResponse class]] ? [response MIMEType] : nil;
+    id <AFURLResponseSerialization> matchingSerializer = MIMEType ? self.responseSerializersByMIMEType[MIMEType] : nil;
+    if (!matchingSerializer && MIMEType) {
+        matchingSerializer = [self responseSerializerAcceptingMIMEType:MIMEType];
+    }
+
+    if (matchingSerializer) {
+        NSError *serializerError = nil;
+        id responseObject = [matchingSerializer responseObjectForResponse:response data:data error:&serializerError];
+        if (responseObject) {
+            if (error) {
+                *error = AFErrorWithUnderlyingError(serializerError, *error);
+            }
+
+            return responseObject;
+        }
+
+        return [super responseObjectForResponse:response data:data error:error];
+    }
+
+    //未知的类型按顺序逐个尝试
     for (id <AFURLResponseSerialization> serializer in self.responseSerializers) {
         if (![serializer isKindOfClass:[AFHTTPResponseSerializer class]]) {
             continue;
@@ -91,6 +91,9 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+@class AFNetworkBandwidthLimiter, AFResponseSerializationExecutor, AFDeduplicatedUpload, AFChunkedUpload, AFUploadStreamProducer;
+@protocol AFChunkedUploadProtocol, AFURLResponseDecoding;
+
 
 
 /*   NSURLSessionDelegate
@@ -208,6 +211,28 @@ NS_ASSUME_NONNULL_BEGIN
 //completionBlock使用的分组。如果为空则使用的是AFURLSessionManager使用的是私有组
 @property (nonatomic, strong, nullable) dispatch_group_t completionGroup;
 
+///--------------------------
+/// @name Limiting Bandwidth
+///--------------------------
+
+/**
+ The bandwidth limiter that paces the uploads and downloads of all tasks created by the manager. When a task transfers more bytes than the limiter allows, the task is suspended until enough bandwidth is available again and then resumed, so no thread is ever blocked. These suspensions do not post `AFNetworkingTaskDidSuspendNotification` or `AFNetworkingTaskDidResumeNotification`, and a task that the application suspends while it is paused stays suspended. The same limiter may be shared by several managers to enforce one limit across all of them. `nil` by default.
+ */
+//限制所有任务上传和下载带宽的限速器，任务超出限制后会被暂停，等到带宽足够后自动恢复，不会阻塞任何线程
+@property (nonatomic, strong, nullable) AFNetworkBandwidthLimiter *bandwidthLimiter;
+
+///----------------------------------------
+/// @name Scheduling Response Serialization
+///----------------------------------------
+
+/**
+ The executor that runs the response serialization of tasks created by the manager. If `nil` (default), responses are serialized on a concurrent queue shared by all managers, which runs as many serializations at once as the system allows.
+
+ Each response is serialized in the priority lane of its task: tasks with a `priority` of at least `NSURLSessionTaskPriorityHigh` run in the high priority lane, and tasks with a `priority` of at most `NSURLSessionTaskPriorityLow`, or with a request whose network service type is `NSURLNetworkServiceTypeBackground`, run in the background lane. The same executor may be shared by several managers to bound the serialization work of all of them.
+ */
+//执行所有任务响应序列化的执行器，为nil时使用所有manager共享的并发队列。任务按优先级和networkServiceType进入不同的优先级通道
+@property (nonatomic, strong, nullable) AFResponseSerializationExecutor *serializationExecutor;
+
 ///---------------------------------
 /// @name Working Around System Bugs
 ///---------------------------------
@@ -272,6 +297,38 @@ NS_ASSUME_NONNULL_BEGIN
                              downloadProgress:(nullable void (^)(NSProgress *downloadProgress))downloadProgressBlock
                             completionHandler:(nullable void (^)(NSURLResponse *response, id _Nullable responseObject,  NSError * _Nullable error))completionHandler;
 
+/**
+ Creates an `NSURLSessionDataTask` with the specified request, whose response body is fed to the specified JSON stream parser as it arrives instead of being collected in memory.
+
+ The response is validated by the response serializer when the first data arrives. If it is not valid, the body is not parsed and the task is cancelled. Parsing errors also cancel the task. Element handlers of the parser are called on the session queue, not the main queue.
+
+ @param request The HTTP request for the request.
+ @param parser The parser the response body is fed to. A parser can only be used by one task.
+ @param downloadProgressBlock A block object to be executed when the download progress is updated. Note this block is called on the session queue, not the main queue.
+ @param completionHandler A block object to be executed when the task finishes. This block has no return value and takes three arguments: the server response, the document returned by `finishParsingWithError:`, and the error that occurred, if any.
+ */
+//创建一个数据任务，响应数据边收边交给json增量解析器，不在内存中拼接
+- (NSURLSessionDataTask *)dataTaskWithRequest:(NSURLRequest *)request
+                             JSONStreamParser:(AFJSONStreamParser *)parser
+                             downloadProgress:(nullable void (^)(NSProgress *downloadProgress))downloadProgressBlock
+                            completionHandler:(nullable void (^)(NSURLResponse *response, id _Nullable responseObject,  NSError * _Nullable error))completionHandler;
+
+/**
+ Creates an `NSURLSessionDataTask` with the specified request, whose response body is fed to the specified stream parser as it arrives instead of being collected in memory.
+
+ The response is validated by the `responseSerializer` of the parser, or by the response serializer of the session manager, when the first data arrives. If it is not valid, the body is not parsed and the task is cancelled. Parsing errors also cancel the task. If the parser implements `setBackpressureHandler:`, the task is suspended and resumed as the parser requests.
+
+ @param request The HTTP request for the request.
+ @param parser The parser the response body is fed to, on the session queue. A parser can only be used by one task.
+ @param downloadProgressBlock A block object to be executed when the download progress is updated. Note this block is called on the session queue, not the main queue.
+ @param completionHandler A block object to be executed when the task finishes. This block has no return value and takes three arguments: the server response, the object returned by `finishParsingWithError:`, and the error that occurred, if any.
+ */
+//创建一个数据任务，响应数据边收边交给增量解析器，解析器要求时暂停和恢复任务
+- (NSURLSessionDataTask *)dataTaskWithRequest:(NSURLRequest *)request
+                                 streamParser:(id <AFURLResponseStreamParsing>)parser
+                             downloadProgress:(nullable void (^)(NSProgress *downloadProgress))downloadProgressBlock
+                            completionHandler:(nullable void (^)(NSURLResponse *response, id _Nullable responseObject,  NSError * _Nullable error))completionHandler;
+
 ///---------------------------
 /// @name Running Upload Tasks
 ///---------------------------
@@ -318,6 +375,70 @@ NS_ASSUME_NONNULL_BEGIN
                                                  progress:(nullable void (^)(NSProgress *uploadProgress))uploadProgressBlock
                                         completionHandler:(nullable void (^)(NSURLResponse *response, id _Nullable responseObject, NSError * _Nullable error))completionHandler;
 
+/**
+ Creates an `NSURLSessionUploadTask` that uploads the bytes written to the specified producer as they are written, using chunked transfer encoding.
+
+ The body is read from the bounded buffer of `producer`, so memory use does not grow with the size of the upload. The body cannot be sent again, so the task fails if the session needs a new body stream, for example to follow a `307` redirect. When the task finishes, the producer is closed, and writes that are waiting for space fail.
+
+ @param request The HTTP request for the request. Its `Content-Length` header is removed.
+ @param producer The producer the body is read from. A producer can only be used by one task.
+ @param uploadProgressBlock A block object to be executed when the upload progress is updated. Note this block is called on the session queue, not the main queue.
+ @param completionHandler A block object to be executed when the task finishes. This block has no return value and takes three arguments: the server response, the response object created by that serializer, and the error that occurred, if any.
+ */
+//创建一个边生成边上传的任务，body从生产者有容量限制的环形缓存中读取，使用分块传输编码
+- (NSURLSessionUploadTask *)uploadTaskWithStreamedRequest:(NSURLRequest *)request
+                                                 producer:(AFUploadStreamProducer *)producer
+                                                 progress:(nullable void (^)(NSProgress *uploadProgress))uploadProgressBlock
+                                        completionHandler:(nullable void (^)(NSURLResponse *response, id _Nullable responseObject, NSError * _Nullable error))completionHandler;
+
+/**
+ Uploads a local file unless the server already has its contents, in which case only a reference is sent.
+
+ The SHA-256 digest of the file is calculated in a streaming pass and looked up with `deduplicator`, through the session of the manager. If the server has the contents, `request` is sent without a body. Otherwise the file is uploaded in full. In both cases, the hex digest is sent in the `digestHeaderField` header of the deduplicator. Files that cannot be looked up are uploaded in full.
+
+ @param request The HTTP request for the request.
+ @param fileURL A URL to the local file to be uploaded.
+ @param deduplicator The deduplicator used to look up the contents of the file.
+ @param uploadProgressBlock A block object to be executed when the upload progress is updated. Note this block is called on the session queue, not the main queue.
+ @param completionHandler A block object to be executed when the task finishes. This block has no return value and takes three arguments: the server response, the response object created by that serializer, and the error that occurred, if any.
+
+ @return The upload, which can be cancelled before or after its task is created.
+ */
+//上传前先按内容摘要查询服务器，服务器已有内容时只发送摘要作为引用，返回可以取消的上传
+- (AFDeduplicatedUpload *)uploadWithRequest:(NSURLRequest *)request
+                                   fromFile:(NSURL *)fileURL
+                               deduplicator:(AFUploadDeduplicator *)deduplicator
+                                   progress:(nullable void (^)(NSProgress *uploadProgress))uploadProgressBlock
+                          completionHandler:(nullable void (^)(NSURLResponse *response, id _Nullable responseObject, NSError  * _Nullable error))completionHandler;
+
+///-----------------------------
+/// @name Running Chunked Uploads
+///-----------------------------
+
+/**
+ Creates an `AFChunkedUpload` that uploads a local file as fixed-size chunks, several at a time, and finishes with a commit request.
+
+ The manifest of the upload is written to `manifestURL` after every chunk is confirmed by the server. If a manifest for the same request, file, and chunk size already exists at `manifestURL`, for example after the app was relaunched during an upload, only the chunks that were not confirmed are uploaded. The manifest is removed once the upload has been committed.
+
+ @param request The request used as a template for the requests of the upload. Its URL, headers, and other properties are passed to `protocol`.
+ @param fileURL A URL to the local file to be uploaded.
+ @param chunkSize The number of bytes in each chunk. The last chunk may be shorter.
+ @param manifestURL A file URL where the manifest of the upload is persisted.
+ @param protocol The object that creates the requests of the upload for a specific server protocol, such as `AFTusChunkedUploadProtocol` or `AFS3ChunkedUploadProtocol`.
+ @param uploadProgressBlock A block object to be executed when chunks are confirmed. Note this block is called on a private serial queue, not the main queue.
+ @param completionHandler A block object to be executed when the upload finishes. This block has no return value and takes three arguments: the response of the commit request, the response object created by the response serializer, and the error that occurred, if any.
+
+ @return A chunked upload, which must be resumed to start uploading.
+ */
+//将本地文件分块并发上传，每块确认后持久化清单文件，重新启动后可以从清单继续上传，全部完成后发送提交请求
+- (AFChunkedUpload *)chunkedUploadWithRequest:(NSURLRequest *)request
+                                     fromFile:(NSURL *)fileURL
+                                    chunkSize:(unsigned long long)chunkSize
+                                  manifestURL:(NSURL *)manifestURL
+                                     protocol:(id <AFChunkedUploadProtocol>)protocol
+                                     progress:(nullable void (^)(NSProgress *uploadProgress))uploadProgressBlock
+                            completionHandler:(nullable void (^)(NSURLResponse * _Nullable response, id _Nullable responseObject, NSError * _Nullable error))completionHandler;
+
 ///-----------------------------
 /// @name Running Download Tasks
 ///-----------------------------
@@ -338,6 +459,22 @@ NS_ASSUME_NONNULL_BEGIN
                                           destination:(nullable NSURL * (^)(NSURL *targetPath, NSURLResponse *response))destination
                                     completionHandler:(nullable void (^)(NSURLResponse *response, NSURL * _Nullable filePath, NSError * _Nullable error))completionHandler;
 
+/**
+ Creates an `NSURLSessionDownloadTask` with the specified request, whose downloaded file is passed to the response serializer once it has been moved to its destination.
+
+ The response serializer decodes the file without reading it in memory first: serializers conforming to `AFURLResponseStreamSerialization` are given a stream over the file, and other serializers are given a memory-mapped `NSData` of the file. The file URL is also included in the userInfo dictionary of the `AFNetworkingTaskDidCompleteNotification`. If the file cannot be moved to its destination, it is not serialized, and the task fails with the error of the file manager. Downloads without a destination, or whose destination block returns `nil`, are serialized from a memory-mapped `NSData` of the temporary file, which is deleted once the response object has been created; the file path passed to `completionHandler` is then `nil`.
+
+ @param request The HTTP request for the request.
+ @param downloadProgressBlock A block object to be executed when the download progress is updated. Note this block is called on the session queue, not the main queue.
+ @param destination A block object to be executed in order to determine the destination of the downloaded file. This block takes two arguments, the target path & the server response, and returns the desired file URL of the resulting download.
+ @param completionHandler A block to be executed when a task finishes. This block has no return value and takes four arguments: the server response, the path of the downloaded file, the response object created by the response serializer, and the error that occurred, if any.
+ */
+//创建一个下载任务，移动到最终存储路径的文件以输入流或者内存映射的数据交给响应序列化对象，不把整个文件读进内存
+- (NSURLSessionDownloadTask *)downloadTaskWithRequest:(NSURLRequest *)request
+                                             progress:(nullable void (^)(NSProgress *downloadProgress))downloadProgressBlock
+                                          destination:(nullable NSURL * (^)(NSURL *targetPath, NSURLResponse *response))destination
+                         serializingCompletionHandler:(nullable void (^)(NSURLResponse *response, NSURL * _Nullable filePath, id _Nullable responseObject, NSError * _Nullable error))completionHandler;
+
 /**
  Creates an `NSURLSessionDownloadTask` with the specified resume data.
 
@@ -352,6 +489,24 @@ NS_ASSUME_NONNULL_BEGIN
                                              destination:(nullable NSURL * (^)(NSURL *targetPath, NSURLResponse *response))destination
                                        completionHandler:(nullable void (^)(NSURLResponse *response, NSURL * _Nullable filePath, NSError * _Nullable error))completionHandler;
 
+/**
+ Creates an `NSURLSessionDownloadTask` with the specified request, whose downloaded file is hashed with SHA-256 and verified before it is moved to its destination.
+
+ When the download finishes, the temporary file is moved aside, and hashed while the response is processed, off the session queue. The file is read in 1 MB blocks instead of being mapped in memory. If the digest does not match the expected digest, the file is deleted instead of being moved, and the task fails with an `AFURLSessionManagerErrorDownloadDigestMismatch` error. If the file cannot be moved to its destination, it is deleted as well, and the task fails with the error of the file manager.
+
+ @param request The HTTP request for the request.
+ @param expectedSHA256Digest The expected 32-byte SHA-256 digest of the downloaded file, or `nil` to only compute the digest.
+ @param downloadProgressBlock A block object to be executed when the download progress is updated. Note this block is called on the session queue, not the main queue.
+ @param destination A block object to be executed in order to determine the destination of the downloaded file. This block takes two arguments, the target path & the server response, and returns the desired file URL of the resulting download.
+ @param completionHandler A block to be executed when a task finishes. This block has no return value and takes four arguments: the server response, the path of the downloaded file, the SHA-256 digest of the downloaded file, and the error that occurred, if any.
+ */
+//创建一个下载任务，下载的文件计算SHA-256摘要，校验通过后才移动到最终存储路径
+- (NSURLSessionDownloadTask *)downloadTaskWithRequest:(NSURLRequest *)request
+                                 expectedSHA256Digest:(nullable NSData *)expectedSHA256Digest
+                                             progress:(nullable void (^)(NSProgress *downloadProgress))downloadProgressBlock
+                                          destination:(nullable NSURL * (^)(NSURL *targetPath, NSURLResponse *response))destination
+                                    completionHandler:(nullable void (^)(NSURLResponse *response, NSURL * _Nullable filePath, NSData * _Nullable SHA256Digest, NSError * _Nullable error))completionHandler;
+
 ///---------------------------------
 /// @name Getting Progress for Tasks
 ///---------------------------------
@@ -376,6 +531,28 @@ NS_ASSUME_NONNULL_BEGIN
 //返回指定任务的下载进度
 - (nullable NSProgress *)downloadProgressForTask:(NSURLSessionTask *)task;
 
+/**
+ Returns the number of bytes of the response body of the specified data task received from the network so far, before they were decoded by the response decoder of the task.
+
+ @param task The session data task. Must not be `nil`.
+
+ @return The number of encoded bytes received, or `0` if the task is not managed by the session manager.
+
+ @see `setDataTaskResponseDecoderBlock:`
+ */
+//返回指定数据任务目前收到的、解码前的响应数据字节数
+- (int64_t)countOfEncodedBytesReceivedForTask:(NSURLSessionTask *)task;
+
+/**
+ Returns the number of bytes of the response body of the specified data task handed to its response serializer or stream parser so far, after they were decoded by the response decoder of the task. Without a response decoder, this is the same as the number of encoded bytes received.
+
+ @param task The session data task. Must not be `nil`.
+
+ @return The number of decoded bytes, or `0` if the task is not managed by the session manager.
+ */
+//返回指定数据任务目前解码后交给响应序列化对象或增量解析器的字节数
+- (int64_t)countOfDecodedBytesReceivedForTask:(NSURLSessionTask *)task;
+
 ///-----------------------------------------
 /// @name Setting Session Delegate Callbacks
 ///-----------------------------------------
@@ -452,6 +629,24 @@ NS_ASSUME_NONNULL_BEGIN
 //设置一个当数据任务收到响应的时候执行的回调。可以被 NSURLSessionDataDelegate  URLSession:dataTask:didReceiveResponse:completionHandler:处理
 - (void)setDataTaskDidReceiveResponseBlock:(nullable NSURLSessionResponseDisposition (^)(NSURLSession *session, NSURLSessionDataTask *dataTask, NSURLResponse *response))block;
 
+/**
+ Sets a block to be executed when a data task has received a response, to create the decoder its response body is passed through before it reaches the response serializer or stream parser of the task.
+
+ Use this to decode bodies that `NSURLSession` does not decode itself, such as gzip-wrapped objects served without a `Content-Encoding` header, or encodings it does not support. For example, to decompress `.gz` objects as they arrive:
+
+    [manager setDataTaskResponseDecoderBlock:^id <AFURLResponseDecoding> (NSURLSession *session, NSURLSessionDataTask *dataTask, NSURLResponse *response) {
+        return [[response.URL pathExtension] isEqualToString:@"gz"] ? [AFGzipResponseDecoder decoder] : nil;
+    }];
+
+ `AFBrotliResponseDecoder` decodes Brotli bodies in the same way where the system supports it.
+
+ Decoding errors cancel the task, which then completes with the decoding error.
+
+ @param block A block object to be executed when a data task has received a response. The block returns a new decoder for the response body, or `nil` to leave the body as it is, and takes three arguments: the session, the data task, and the received response.
+ */
+//设置数据任务收到响应时执行的block，返回这个任务的响应数据解码器，响应数据边收边解码后再交给响应序列化对象或增量解析器
+- (void)setDataTaskResponseDecoderBlock:(nullable id <AFURLResponseDecoding> _Nullable (^)(NSURLSession *session, NSURLSessionDataTask *dataTask, NSURLResponse *response))block;
+
 /**
  Sets a block to be executed when a data task has become a download task, as handled by the `NSURLSessionDataDelegate` method `URLSession:dataTask:didBecomeDownloadTask:`.
 
@@ -514,6 +709,563 @@ NS_ASSUME_NONNULL_BEGIN
 
 @end
 
+#pragma mark -
+
+/**
+ The `AFURLResponseDecoding` protocol is adopted by objects that decode a response body, such as a compressed one, as it is received. Decoded bytes are appended to a buffer provided by the session manager, which is reused between chunks and tasks.
+
+ @see `AFURLSessionManager -setDataTaskResponseDecoderBlock:`
+ */
+//边收边解码响应数据的协议，解码后的数据追加到会话管理类提供的可复用缓冲中
+@protocol AFURLResponseDecoding <NSObject>
+
+/**
+ Decodes the next chunk of the response body.
+
+ @param data The next chunk of the encoded response body.
+ @param buffer The buffer the decoded bytes are appended to. Its contents are consumed after the call, so bytes must not be kept in it between calls.
+ @param error The error that occurred while decoding, if any.
+
+ @return `YES` if the chunk was decoded, otherwise `NO`.
+ */
+//解码下一块数据，解码后的数据追加到缓冲中
+- (BOOL)decodeData:(NSData *)data
+          toBuffer:(NSMutableData *)buffer
+             error:(NSError * _Nullable __autoreleasing *)error;
+
+/**
+ Finishes decoding after the last chunk of the response body, appending any remaining decoded bytes to the buffer.
+
+ @param buffer The buffer the remaining decoded bytes are appended to.
+ @param error The error that occurred, for example if the response body is truncated.
+
+ @return `YES` if the response body was decoded completely, otherwise `NO`.
+ */
+//所有数据都解码完以后结束解码，剩下的数据追加到缓冲中，数据不完整时失败
+- (BOOL)finishDecodingToBuffer:(NSMutableData *)buffer
+                         error:(NSError * _Nullable __autoreleasing *)error;
+
+@end
+
+/**
+ `AFGzipResponseDecoder` decompresses gzip and zlib encoded response bodies as they are received, detecting the format from the header of the body. Concatenated gzip members are decompressed one after another.
+
+ A decoder is not thread safe, and can only be used for one response body.
+ */
+//边收边解压gzip或zlib格式的响应数据，根据数据头自动识别格式，支持多个连续的gzip成员
+@interface AFGzipResponseDecoder : NSObject <AFURLResponseDecoding>
+
+/**
+ Creates and returns a decoder for one response body.
+ */
+//创建一个解码器，只能用于一个响应
++ (instancetype)decoder;
+
+@end
+
+/**
+ `AFBrotliResponseDecoder` decompresses Brotli encoded response bodies as they are received, using the Compression library. Brotli decoding is available on iOS 15, macOS 12, tvOS 15 and watchOS 8 and later; on earlier systems no decoder can be created.
+
+ A decoder is not thread safe, and can only be used for one response body.
+ */
+//边收边解压brotli格式的响应数据，系统不支持brotli时无法创建
+@interface AFBrotliResponseDecoder : NSObject <AFURLResponseDecoding>
+
+/**
+ Creates and returns a decoder for one response body, or `nil` if Brotli decoding is not available on this system.
+ */
+//创建一个解码器，只能用于一个响应，系统不支持brotli时返回nil
++ (nullable instancetype)decoder;
+
+@end
+
+#pragma mark -
+
+/**
+ The direction of the traffic paced by an `AFNetworkBandwidthLimiter`.
+
+ - `AFNetworkBandwidthDirectionUpload`: Request bodies sent by tasks.
+ - `AFNetworkBandwidthDirectionDownload`: Response data received by tasks.
+ */
+typedef NS_ENUM(NSInteger, AFNetworkBandwidthDirection) {
+    AFNetworkBandwidthDirectionUpload   = 0,
+    AFNetworkBandwidthDirectionDownload = 1,
+};
+
+/**
+ `AFNetworkBandwidthLimiter` is a token-bucket rate limiter for the traffic of `AFURLSessionManager` tasks.
+
+ A rate can be set for all traffic in a direction, and for the traffic of each network service type, which is read from a task's request. This lets background traffic, such as requests with `NSURLNetworkServiceTypeBackground`, be capped without limiting interactive requests. Each bucket allows bursts of up to one second's worth of bytes. Rates may be changed at any time from any thread.
+ */
+//令牌桶限速器，可以限制某个方向的总带宽，也可以按请求的networkServiceType分别限制带宽
+@interface AFNetworkBandwidthLimiter : NSObject
+
+/**
+ Sets the maximum number of bytes per second transferred in the specified direction by all tasks. `0` removes the limit.
+ */
+//设置某个方向所有任务的总带宽，0表示不限制
+- (void)setBytesPerSecond:(NSUInteger)bytesPerSecond
+             forDirection:(AFNetworkBandwidthDirection)direction;
+
+/**
+ Sets the maximum number of bytes per second transferred in the specified direction by tasks whose request has the specified network service type. `0` removes the limit. This limit applies in addition to the limit for all tasks.
+ */
+//设置某个方向某种networkServiceType的任务的带宽，0表示不限制
+- (void)setBytesPerSecond:(NSUInteger)bytesPerSecond
+             forDirection:(AFNetworkBandwidthDirection)direction
+       networkServiceType:(NSURLRequestNetworkServiceType)networkServiceType;
+
+/**
+ Returns the maximum number of bytes per second transferred in the specified direction by all tasks, or `0` if there is no limit.
+ */
+//返回某个方向的总带宽限制
+- (NSUInteger)bytesPerSecondForDirection:(AFNetworkBandwidthDirection)direction;
+
+/**
+ Returns the maximum number of bytes per second transferred in the specified direction by tasks with the specified network service type, or `0` if there is no limit.
+ */
+//返回某个方向某种networkServiceType的带宽限制
+- (NSUInteger)bytesPerSecondForDirection:(AFNetworkBandwidthDirection)direction
+                      networkServiceType:(NSURLRequestNetworkServiceType)networkServiceType;
+
+/**
+ Records bytes that have been transferred and returns how long the transfer should pause before more bytes are allowed.
+
+ @param numberOfBytes The number of bytes transferred.
+ @param direction The direction of the transfer.
+ @param networkServiceType The network service type of the transferring request.
+
+ @return The time interval to wait before transferring more bytes, or `0` if the transfer may continue immediately.
+ */
+//记录已经传输的字节，返回继续传输前需要等待的时间，0表示不需要等待
+- (NSTimeInterval)consumeBytes:(int64_t)numberOfBytes
+                  forDirection:(AFNetworkBandwidthDirection)direction
+            networkServiceType:(NSURLRequestNetworkServiceType)networkServiceType;
+
+@end
+
+#pragma mark -
+
+/**
+ The priority lanes of an `AFResponseSerializationExecutor`.
+
+ - `AFResponseSerializationPriorityBackground`: Work that nobody is waiting for, such as prefetched responses.
+ - `AFResponseSerializationPriorityDefault`: Ordinary responses.
+ - `AFResponseSerializationPriorityHigh`: Responses needed for what the user is looking at.
+ */
+typedef NS_ENUM(NSInteger, AFResponseSerializationPriority) {
+    AFResponseSerializationPriorityBackground = 0,
+    AFResponseSerializationPriorityDefault    = 1,
+    AFResponseSerializationPriorityHigh       = 2,
+};
+
+/**
+ `AFResponseSerializationExecutor` runs response serialization on a bounded number of workers, taking work from priority lanes.
+
+ At most `maximumConcurrentSerializations` blocks run at once, however many responses arrive. Whenever a worker is free, it takes the oldest block of the highest priority lane that has work, so higher priority work never waits behind lower priority work, and no worker stays idle while any lane has work. Blocks of the same lane start in the order they were added.
+
+ The executor records how many blocks are waiting in each lane, and how long blocks waited before starting, which can be used to choose its width.
+ */
+//有限个工作线程执行响应序列化的执行器，空闲的工作线程从有任务的最高优先级通道取最早的任务，并记录排队数和等待时间
+@interface AFResponseSerializationExecutor : NSObject
+
+/**
+ Creates an executor that runs at most the specified number of blocks at once.
+
+ @param maximumConcurrentSerializations The number of workers. Must be greater than `0`.
+ */
+//创建最多同时执行指定数量任务的执行器
+- (instancetype)initWithMaximumConcurrentSerializations:(NSUInteger)maximumConcurrentSerializations NS_DESIGNATED_INITIALIZER;
+
+/**
+ Creates an executor with one worker for each active processor.
+ */
+//创建执行器，工作线程数等于可用的处理器数
+- (instancetype)init;
+
+/**
+ The maximum number of blocks run at once.
+ */
+//最多同时执行的任务数
+@property (readonly, nonatomic, assign) NSUInteger maximumConcurrentSerializations;
+
+/**
+ Adds a block to the lane of the specified priority. The block runs on one of the workers of the executor.
+ */
+//把block加到指定优先级的通道，由执行器的工作线程执行
+- (void)addSerializationWithPriority:(AFResponseSerializationPriority)priority
+                               block:(dispatch_block_t)block;
+
+/**
+ Serializes a response with the specified response serializer in the lane of the specified priority.
+
+ @param response The response to be processed.
+ @param data The response data to be decoded.
+ @param responseSerializer The response serializer that decodes the response.
+ @param priority The priority lane of the serialization.
+ @param completionHandler A block object to be executed on the worker once the response has been serialized. It takes two arguments: the response object, and the serialization error, if any.
+ */
+//在指定优先级的通道里用指定的响应序列化对象序列化响应，完成后在工作线程上执行回调
+- (void)serializeResponse:(nullable NSURLResponse *)response
+                     data:(nullable NSData *)data
+   withResponseSerializer:(id <AFURLResponseSerialization>)responseSerializer
+                 priority:(AFResponseSerializationPriority)priority
+        completionHandler:(void (^)(id _Nullable responseObject, NSError * _Nullable error))completionHandler;
+
+///--------------
+/// @name Metrics
+///--------------
+
+/**
+ The number of blocks that are running.
+ */
+//正在执行的任务数
+@property (readonly, nonatomic, assign) NSUInteger numberOfRunningSerializations;
+
+/**
+ Returns the number of blocks waiting in the lane of the specified priority.
+ */
+//返回指定优先级的通道里等待执行的任务数
+- (NSUInteger)numberOfPendingSerializationsWithPriority:(AFResponseSerializationPriority)priority;
+
+/**
+ Returns the average time blocks of the specified priority waited in their lane before starting, or `0` if none has started yet.
+ */
+//返回指定优先级的任务开始执行前的平均等待时间
+- (NSTimeInterval)averageWaitTimeForPriority:(AFResponseSerializationPriority)priority;
+
+/**
+ Returns the longest time a block of the specified priority waited in its lane before starting.
+ */
+//返回指定优先级的任务开始执行前的最长等待时间
+- (NSTimeInterval)maximumWaitTimeForPriority:(AFResponseSerializationPriority)priority;
+
+/**
+ Clears the recorded wait times.
+ */
+//清空记录的等待时间
+- (void)resetMetrics;
+
+@end
+
+#pragma mark -
+
+/**
+ `AFChunkedUploadChunk` describes a byte range of a file uploaded by an `AFChunkedUpload`.
+ */
+//分块上传中的一个块
+@interface AFChunkedUploadChunk : NSObject <NSSecureCoding>
+
+/**
+ The zero-based index of the chunk in the file.
+ */
+//块的序号，从0开始
+@property (readonly, nonatomic, assign) NSUInteger index;
+
+/**
+ The offset of the first byte of the chunk in the file.
+ */
+//块在文件中的偏移
+@property (readonly, nonatomic, assign) unsigned long long offset;
+
+/**
+ The number of bytes in the chunk.
+ */
+//块的长度
+@property (readonly, nonatomic, assign) unsigned long long length;
+
+/**
+ The SHA-256 digest of the contents of the chunk, which identifies the chunk by its content. The digest is calculated before the chunk is first uploaded.
+ */
+//块内容的SHA-256摘要，第一次上传前计算
+@property (readonly, nonatomic, copy, nullable) NSData *SHA256Digest;
+
+/**
+ The value returned by the upload protocol once the server confirmed the chunk, such as an entity tag or the URL of a partial upload. `nil` if the chunk has not been uploaded yet.
+ */
+//服务器确认块之后由上传协议返回的值，例如ETag或者部分上传的地址。nil表示还没有上传
+@property (readonly, nonatomic, copy, nullable) NSString *receipt;
+
+@end
+
+/**
+ `AFChunkedUploadManifest` records the state of an `AFChunkedUpload`, so that an interrupted upload can be resumed.
+ */
+//记录分块上传的状态，用于中断后继续上传
+@interface AFChunkedUploadManifest : NSObject <NSSecureCoding>
+
+/**
+ The request used as a template for the requests of the upload.
+
+ Only the URL and HTTP method of the request are written to disk, so that header fields such as `Authorization` are never stored in plaintext. A manifest read from disk is matched with the URL and HTTP method of the request the upload is resumed with, and the requests of the resumed upload are built from that current request.
+ */
+//上传请求的模板，清单文件里只保存url和方法，继续上传时使用调用方当前的请求
+@property (readonly, nonatomic, copy) NSURLRequest *request;
+
+/**
+ The URL of the uploaded file.
+ */
+//上传的文件
+@property (readonly, nonatomic, copy) NSURL *fileURL;
+
+/**
+ The size of the uploaded file when the upload started.
+ */
+//开始上传时文件的大小
+@property (readonly, nonatomic, assign) unsigned long long fileSize;
+
+/**
+ The modification date of the uploaded file when the upload started.
+ */
+//开始上传时文件的修改时间
+@property (readonly, nonatomic, copy, nullable) NSDate *fileModificationDate;
+
+/**
+ The number of bytes in each chunk.
+ */
+//块大小
+@property (readonly, nonatomic, assign) unsigned long long chunkSize;
+
+/**
+ The identifier assigned to the upload by the server, if the upload protocol creates uploads before sending chunks.
+ */
+//服务器分配的上传标识，只有需要先创建上传的协议才有
+@property (readonly, nonatomic, copy, nullable) NSString *uploadIdentifier;
+
+/**
+ The chunks of the file.
+ */
+//文件的所有块
+@property (readonly, nonatomic, copy) NSArray <AFChunkedUploadChunk *> *chunks;
+
+@end
+
+/**
+ The `AFChunkedUploadProtocol` protocol is adopted by objects that create the requests of an `AFChunkedUpload` for a specific server protocol, and interpret the responses.
+
+ The requests returned by the protocol are sent by the session manager. The chunk requests are sent with the contents of the chunk as their body.
+ */
+//分块上传协议，负责创建具体服务器协议的请求并解析响应
+@protocol AFChunkedUploadProtocol <NSObject>
+
+/**
+ Returns the request that uploads the specified chunk.
+ */
+//返回上传某个块的请求
+- (NSURLRequest *)requestForUploadingChunk:(AFChunkedUploadChunk *)chunk
+                                ofManifest:(AFChunkedUploadManifest *)manifest;
+
+/**
+ Returns the value recorded in the manifest for a chunk confirmed by the server, or `nil` with an error if the response cannot be interpreted.
+ */
+//从服务器对某个块的响应中解析出需要记录的值
+- (nullable NSString *)receiptForChunk:(AFChunkedUploadChunk *)chunk
+                              response:(NSHTTPURLResponse *)response
+                                  data:(nullable NSData *)data
+                                 error:(NSError * _Nullable __autoreleasing *)error;
+
+/**
+ Returns the request that commits the upload once all chunks were confirmed by the server.
+ */
+//所有块上传完成后，返回提交上传的请求
+- (NSURLRequest *)requestForCommittingManifest:(AFChunkedUploadManifest *)manifest;
+
+@optional
+
+/**
+ Returns the request that creates the upload on the server before any chunk is sent, or `nil` if the protocol does not create uploads.
+ */
+//返回上传块之前在服务器创建上传的请求，nil表示不需要创建
+- (nullable NSURLRequest *)requestForCreatingUploadOfManifest:(AFChunkedUploadManifest *)manifest;
+
+/**
+ Returns the identifier of the upload created by the request returned by `requestForCreatingUploadOfManifest:`. If this method is not implemented, the chunks are uploaded after the creation request succeeds, and no identifier is recorded.
+ */
+//从创建上传的响应中解析出上传标识
+- (nullable NSString *)uploadIdentifierForCreationResponse:(NSHTTPURLResponse *)response
+                                                      data:(nullable NSData *)data
+                                                     error:(NSError * _Nullable __autoreleasing *)error;
+
+@end
+
+/**
+ `AFTusChunkedUploadProtocol` uploads chunks with the concatenation extension of the tus resumable upload protocol. Each chunk is created as a partial upload, with its digest sent in the `Upload-Checksum` header, and the commit request creates the final upload by concatenating the partial uploads. Requests are sent to the URL of the template request.
+ */
+//使用tus协议的concatenation扩展上传：每块创建为一个部分上传，最后合并为最终上传
+@interface AFTusChunkedUploadProtocol : NSObject <AFChunkedUploadProtocol>
+@end
+
+/**
+ `AFS3ChunkedUploadProtocol` uploads chunks with the multipart upload API of Amazon S3 and compatible servers. The upload is created with a `POST` request to `?uploads`, each chunk is sent as a numbered part with its digest in the `x-amz-checksum-sha256` header, and the commit request lists the entity tags of the parts. Requests are sent to the URL of the template request, which should already be authorized, for example with a presigned URL or an authorization header.
+ */
+//使用S3的multipart upload接口上传：先创建上传，每块作为一个编号的part上传，最后提交所有part的ETag
+@interface AFS3ChunkedUploadProtocol : NSObject <AFChunkedUploadProtocol>
+@end
+
+/**
+ `AFDeduplicatedUpload` is an upload whose file is looked up before its task is created. Instances are created with `-[AFURLSessionManager uploadWithRequest:fromFile:deduplicator:progress:completionHandler:]`.
+ */
+//先查询文件内容再创建任务的上传
+@interface AFDeduplicatedUpload : NSObject
+
+/**
+ The upload task, or `nil` while the file is being looked up or if the upload was cancelled before the lookup finished.
+ */
+//上传任务，查询完成前或者在查询完成前取消时为nil
+@property (readonly, nonatomic, strong, nullable) NSURLSessionUploadTask *task;
+
+/**
+ Cancels the upload. If the lookup is still running, no task is created and the completion handler is called with an `NSURLErrorCancelled` error. Otherwise the task is cancelled.
+ */
+//取消上传，查询还没有完成时不再创建任务并以取消错误回调
+- (void)cancel;
+
+@end
+
+#pragma mark -
+
+/**
+ `AFChunkedUpload` uploads a local file in chunks. Instances are created with `-[AFURLSessionManager chunkedUploadWithRequest:fromFile:chunkSize:manifestURL:protocol:progress:completionHandler:]`.
+
+ Chunks that fail are retried with an increasing delay, up to `maximumNumberOfRetries` times, before the upload fails. A failed or cancelled upload keeps its manifest, so that a new chunked upload with the same manifest URL continues where it stopped.
+ */
+//分块上传，失败的块会延迟重试，失败或者取消后保留清单文件用于继续上传
+@interface AFChunkedUpload : NSObject
+
+/**
+ The manifest of the upload.
+ */
+//上传清单
+@property (readonly, nonatomic, strong) AFChunkedUploadManifest *manifest;
+
+/**
+ The progress of the upload, in bytes of confirmed chunks. Cancelling the progress cancels the upload.
+ */
+//上传进度，以已确认的块的字节数计算，取消进度会取消上传
+@property (readonly, nonatomic, strong) NSProgress *progress;
+
+/**
+ The maximum number of chunks uploaded at the same time. `4` by default.
+ */
+//同时上传的最大块数，默认为4
+@property (nonatomic, assign) NSUInteger maximumNumberOfConcurrentChunks;
+
+/**
+ The number of times a failed request is retried before the upload fails. `3` by default.
+ */
+//请求失败后的最大重试次数，默认为3
+@property (nonatomic, assign) NSUInteger maximumNumberOfRetries;
+
+/**
+ Starts uploading the chunks that were not confirmed yet.
+ */
+//开始上传还没有确认的块
+- (void)resume;
+
+/**
+ Cancels the running requests of the upload. The completion handler is called with an `NSURLErrorCancelled` error.
+ */
+//取消上传
+- (void)cancel;
+
+@end
+
+#pragma mark -
+
+/**
+ `AFUploadStreamProducer` lets data generated while an upload is running, such as log lines or encoded sensor readings, be sent without buffering the whole body first.
+
+ Bytes written to the producer are kept in the fixed capacity buffer of a bound stream pair, which the upload task drains. The upload task waits for more bytes while the buffer is empty, until `-finishWriting` is called. When the buffer is full, writers either block in `-writeData:timeout:error:`, or write as much as fits with `-writeBytes:maxLength:` and wait for the space available handler. All methods may be called from any thread.
+ */
+//上传数据的生产者，写入的数据保存在绑定的流对的固定容量缓存中由上传任务读取，缓存为空时上传任务等待直到结束写入，缓存满时阻塞写入或者在有空间时通知
+@interface AFUploadStreamProducer : NSObject
+
+/**
+ Initializes a producer with a buffer of the specified capacity.
+
+ @param capacity The maximum number of bytes buffered. Must be greater than `0`.
+ */
+//使用缓存容量初始化
+- (instancetype)initWithCapacity:(NSUInteger)capacity NS_DESIGNATED_INITIALIZER;
+
+/**
+ Initializes a producer with a buffer of 256 KB.
+ */
+//使用256KB的缓存初始化
+- (instancetype)init;
+
+/**
+ The maximum number of bytes buffered.
+ */
+//缓存容量
+@property (readonly, nonatomic, assign) NSUInteger capacity;
+
+/**
+ The total number of bytes written to the producer.
+ */
+//已经写入的总字节数
+@property (readonly, nonatomic, assign) unsigned long long numberOfBytesWritten;
+
+/**
+ The stream the upload task reads the body from.
+ */
+//上传任务读取body的流
+@property (readonly, nonatomic, strong) NSInputStream *inputStream;
+
+/**
+ Writes as many bytes as fit in the buffer without blocking.
+
+ If not all bytes fit, the space available handler is called once the upload task has read from the buffer.
+
+ @param bytes The bytes to write.
+ @param length The number of bytes to write.
+
+ @return The number of bytes written, or `-1` if the producer was finished or closed.
+ */
+//不阻塞地写入缓存能容纳的数据，没有全部写入时，缓存被读取后调用空间可用回调
+- (NSInteger)writeBytes:(const uint8_t *)bytes
+              maxLength:(NSUInteger)length;
+
+/**
+ Writes all of the specified data, blocking while the buffer is full.
+
+ @param data The data to write.
+ @param timeout The maximum time to wait for space in the buffer, or a negative value to wait without limit.
+ @param error If the data could not be written, upon return contains an error: `NSURLErrorTimedOut` if the timeout expired, or the error the producer was closed with. Bytes written before the error stay in the buffer.
+
+ @return `YES` if all of the data was written, otherwise `NO`.
+ */
+//写入全部数据，缓存满时阻塞等待，超时或者生产者被关闭时返回NO
+- (BOOL)writeData:(NSData *)data
+          timeout:(NSTimeInterval)timeout
+            error:(NSError * _Nullable __autoreleasing *)error;
+
+/**
+ Sets a block to be executed when space becomes available after `-writeBytes:maxLength:` could not write all of its bytes, or when the producer is closed.
+
+ @param block The block to execute, with the producer as its argument.
+ @param queue The queue on which to execute the block. The main queue is used if `nil`.
+ */
+//设置缓存有空间时执行的回调，在写入没有全部完成后调用
+- (void)setSpaceAvailableHandler:(nullable void (^)(AFUploadStreamProducer *producer))block
+                           queue:(nullable dispatch_queue_t)queue;
+
+/**
+ Marks the end of the body. The upload task finishes sending once the buffered bytes are read.
+ */
+//标记body结束，缓存中的数据读完后上传结束
+- (void)finishWriting;
+
+/**
+ Closes the producer. Writes fail with `error`, and the upload task is cancelled and completes with `error`. Bytes already written are not sent as a complete body.
+
+ @param error The error, or `nil` for an `NSURLErrorCancelled` error.
+ */
+//关闭生产者，之后的写入都以error失败，上传任务被取消并以error结束
+- (void)closeWithError:(nullable NSError *)error;
+
+@end
+
 ///--------------------
 /// @name Notifications
 ///--------------------
@@ -549,6 +1301,42 @@ FOUNDATION_EXPORT NSString * const AFURLSessionDidInvalidateNotification;
 //当下载任务的临时数据转移到目标地的时候发生错误时发送
 FOUNDATION_EXPORT NSString * const AFURLSessionDownloadTaskDidFailToMoveFileNotification;
 
+/**
+ ## Error Domains
+
+ The following error domain is predefined.
+
+ - `NSString * const AFURLSessionManagerErrorDomain`
+
+ ### Constants
+
+ `AFURLSessionManagerErrorDomain`
+ AFURLSessionManager errors. Error codes are described by `AFURLSessionManagerError`.
+ */
+//AFURLSessionManager的错误
+FOUNDATION_EXPORT NSString * const AFURLSessionManagerErrorDomain;
+
+/**
+ The codes of errors in the `AFURLSessionManagerErrorDomain`.
+
+ - `AFURLSessionManagerErrorDownloadDigestMismatch`: The SHA-256 digest of a downloaded file does not match the expected digest. The `userInfo` dictionary of the error includes both digests.
+ */
+typedef NS_ENUM(NSInteger, AFURLSessionManagerError) {
+    AFURLSessionManagerErrorDownloadDigestMismatch = 1,
+};
+
+/**
+ The expected SHA-256 digest of a downloaded file, included in the `userInfo` dictionary of an `AFURLSessionManagerErrorDownloadDigestMismatch` error.
+ */
+//下载文件应有的SHA-256摘要，包含在摘要不匹配错误的userInfo中
+FOUNDATION_EXPORT NSString * const AFURLSessionManagerExpectedSHA256DigestErrorKey;
+
+/**
+ The actual SHA-256 digest of a downloaded file, included in the `userInfo` dictionary of an `AFURLSessionManagerErrorDownloadDigestMismatch` error.
+ */
+//下载文件实际的SHA-256摘要，包含在摘要不匹配错误的userInfo中
+FOUNDATION_EXPORT NSString * const AFURLSessionManagerSHA256DigestErrorKey;
+
 /**
  The raw response data of the task. Included in the userInfo dictionary of the `AFNetworkingTaskDidCompleteNotification` if response data exists for the task.
  */
@@ -579,4 +1367,22 @@ FOUNDATION_EXPORT NSString * const AFNetworkingTaskDidCompleteAssetPathKey;
 //当任务或者序列化时发生错误的时候。包含在AFNetworkingTaskDidCompleteNotification的userinfo中
 FOUNDATION_EXPORT NSString * const AFNetworkingTaskDidCompleteErrorKey;
 
+/**
+ The number of bytes of the response body received from the network, as an `NSNumber`. Included in the userInfo dictionary of the `AFNetworkingTaskDidCompleteNotification` if the response body was decoded by a response decoder.
+ */
+//解码前收到的响应数据字节数。使用了响应解码器时包含在AFNetworkingTaskDidCompleteNotification的userinfo中
+FOUNDATION_EXPORT NSString * const AFNetworkingTaskDidCompleteCountOfEncodedBytesKey;
+
+/**
+ The number of bytes of the response body after decoding, as an `NSNumber`. Included in the userInfo dictionary of the `AFNetworkingTaskDidCompleteNotification` if the response body was decoded by a response decoder.
+ */
+//解码后的响应数据字节数。使用了响应解码器时包含在AFNetworkingTaskDidCompleteNotification的userinfo中
+FOUNDATION_EXPORT NSString * const AFNetworkingTaskDidCompleteCountOfDecodedBytesKey;
+
+/**
+ The SHA-256 digest of the downloaded file. Included in the userInfo dictionary of the `AFNetworkingTaskDidCompleteNotification` if the download task was created with `downloadTaskWithRequest:expectedSHA256Digest:progress:destination:completionHandler:` and the file could be read.
+ */
+//下载文件的SHA-256摘要。要求计算摘要的下载任务包含在AFNetworkingTaskDidCompleteNotification的userinfo中
+FOUNDATION_EXPORT NSString * const AFNetworkingTaskDidCompleteSHA256DigestKey;
+
 NS_ASSUME_NONNULL_END
@@ -22,6 +22,16 @@
 #import "AFURLSessionManager.h"
 //objc运行时头文件
 #import <objc/runtime.h>
+#import <CommonCrypto/CommonDigest.h>
+#import <zlib.h>
+
+//Compression从iOS 15、macOS 12、tvOS 15和watchOS 8开始支持brotli，用更早的SDK编译时没有brotli解码
+#if (defined(__IPHONE_OS_VERSION_MAX_ALLOWED) && __IPHONE_OS_VERSION_MAX_ALLOWED >= 150000) || (defined(__MAC_OS_X_VERSION_MAX_ALLOWED) && __MAC_OS_X_VERSION_MAX_ALLOWED >= 120000) || (defined(__TV_OS_VERSION_MAX_ALLOWED) && __TV_OS_VERSION_MAX_ALLOWED >= 150000) || (defined(__WATCH_OS_VERSION_MAX_ALLOWED) && __WATCH_OS_VERSION_MAX_ALLOWED >= 80000)
+#define AF_COMPRESSION_BROTLI_AVAILABLE 1
+#import <compression.h>
+#else
+#define AF_COMPRESSION_BROTLI_AVAILABLE 0
+#endif
 
 #ifndef NSFoundationVersionNumber_iOS_8_0
 #define NSFoundationVersionNumber_With_Fixed_5871104061079552_bug 1140.11
@@ -100,6 +110,19 @@ NSString * const AFNetworkingTaskDidCompleteResponseDataKey = @"com.alamofire.ne
 NSString * const AFNetworkingTaskDidCompleteErrorKey = @"com.alamofire.networking.task.complete.error";
 //下载任务相关的路径。包含在AFNetworkingTaskDidCompleteNotification的userinfo中
 NSString * const AFNetworkingTaskDidCompleteAssetPathKey = @"com.alamofire.networking.task.complete.assetpath";
+//下载文件的SHA-256摘要。要求计算摘要的下载任务包含在AFNetworkingTaskDidCompleteNotification的userinfo中
+NSString * const AFNetworkingTaskDidCompleteSHA256DigestKey = @"com.alamofire.networking.task.complete.sha256digest";
+
+//AFURLSessionManager的错误
+NSString * const AFURLSessionManagerErrorDomain = @"com.alamofire.error.session.manager";
+//下载文件应有的SHA-256摘要，包含在摘要不匹配错误的userInfo中
+NSString * const AFURLSessionManagerExpectedSHA256DigestErrorKey = @"com.alamofire.session.manager.error.expectedsha256digest";
+//下载文件实际的SHA-256摘要，包含在摘要不匹配错误的userInfo中
+NSString * const AFURLSessionManagerSHA256DigestErrorKey = @"com.alamofire.session.manager.error.sha256digest";
+//解码前收到的响应数据字节数。使用了响应解码器时包含在AFNetworkingTaskDidCompleteNotification的userinfo中
+NSString * const AFNetworkingTaskDidCompleteCountOfEncodedBytesKey = @"com.alamofire.networking.task.complete.encodedbytes";
+//解码后的响应数据字节数。使用了响应解码器时包含在AFNetworkingTaskDidCompleteNotification的userinfo中
+NSString * const AFNetworkingTaskDidCompleteCountOfDecodedBytesKey = @"com.alamofire.networking.task.complete.decodedbytes";
 
 //rul会话管理线程锁的名字
 static NSString * const AFURLSessionManagerLockName = @"com.alamofire.networking.session.manager.lock";
@@ -131,6 +154,8 @@ typedef void (^AFURLSessionTaskDidCompleteBlock)(NSURLSession *session, NSURLSes
 
 //会话数据任务收到响应时的block
 typedef NSURLSessionResponseDisposition (^AFURLSessionDataTaskDidReceiveResponseBlock)(NSURLSession *session, NSURLSessionDataTask *dataTask, NSURLResponse *response);
+//会话数据任务收到响应时返回响应数据解码器的block
+typedef id <AFURLResponseDecoding> (^AFURLSessionDataTaskResponseDecoderBlock)(NSURLSession *session, NSURLSessionDataTask *dataTask, NSURLResponse *response);
 //会话数据任务改变成下载任务时的block
 typedef void (^AFURLSessionDataTaskDidBecomeDownloadTaskBlock)(NSURLSession *session, NSURLSessionDataTask *dataTask, NSURLSessionDownloadTask *downloadTask);
 //会话数据任务收到数据时的block
@@ -153,6 +178,410 @@ typedef void (^AFURLSessionTaskCompletionHandler)(NSURLResponse *response, id re
 
 #pragma mark -
 
+//解码缓冲池中最多保留的缓冲数
+static NSUInteger const AFURLResponseDecodingBufferPoolCapacity = 4;
+//用过的长度超过这个值的缓冲不放回缓冲池，避免一直占用大块内存
+static NSUInteger const AFURLResponseDecodingBufferMaximumPooledLength = 1024 * 1024;
+
+//解码缓冲池，缓冲在数据块和任务之间复用，避免每块数据都重新分配内存
+static NSMutableArray * url_session_manager_decoding_buffer_pool() {
+    static NSMutableArray *af_url_session_manager_decoding_buffer_pool;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        af_url_session_manager_decoding_buffer_pool = [NSMutableArray array];
+    });
+
+    return af_url_session_manager_decoding_buffer_pool;
+}
+
+//从缓冲池取一个解码缓冲，池中没有时新建
+static NSMutableData * url_session_manager_dequeue_decoding_buffer() {
+    NSMutableArray *pool = url_session_manager_decoding_buffer_pool();
+    @synchronized (pool) {
+        NSMutableData *buffer = [pool lastObject];
+        if (buffer) {
+            [pool removeLastObject];
+            return buffer;
+        }
+    }
+
+    return [NSMutableData data];
+}
+
+//把解码缓冲放回缓冲池，池满时丢弃
+static void url_session_manager_enqueue_decoding_buffer(NSMutableData *buffer) {
+    [buffer setLength:0];
+
+    NSMutableArray *pool = url_session_manager_decoding_buffer_pool();
+    @synchronized (pool) {
+        if ([pool count] < AFURLResponseDecodingBufferPoolCapacity) {
+            [pool addObject:buffer];
+        }
+    }
+}
+
+//每次解压预留的最小和最大输出空间
+static NSUInteger const AFGzipResponseDecoderMinimumOutputLength = 16 * 1024;
+static NSUInteger const AFGzipResponseDecoderMaximumOutputLength = 1024 * 1024;
+
+//解压失败的错误
+static NSError * AFResponseDecodingError(NSString *reason) {
+    NSMutableDictionary *userInfo = [NSMutableDictionary dictionary];
+    userInfo[NSLocalizedDescriptionKey] = NSLocalizedStringFromTable(@"The response body could not be decompressed.", @"AFNetworking", nil);
+    if (reason) {
+        userInfo[NSLocalizedFailureReasonErrorKey] = reason;
+    }
+
+    return [NSError errorWithDomain:AFURLResponseSerializationErrorDomain code:NSURLErrorCannotDecodeRawData userInfo:userInfo];
+}
+
+@interface AFGzipResponseDecoder ()
+//是否收到过数据
+@property (readwrite, nonatomic, assign) BOOL receivedData;
+//当前的gzip成员或zlib流是否已经结束
+@property (readwrite, nonatomic, assign) BOOL streamEnded;
+//解压失败的错误，之后的数据都不再解压
+@property (readwrite, nonatomic, strong) NSError *decodingError;
+@end
+
+@implementation AFGzipResponseDecoder {
+    z_stream _stream;
+}
+
++ (instancetype)decoder {
+    return [[self alloc] init];
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    //窗口大小加32，根据数据头自动识别gzip和zlib格式
+    if (inflateInit2(&_stream, MAX_WBITS + 32) != Z_OK) {
+        return nil;
+    }
+
+    return self;
+}
+
+- (void)dealloc {
+    inflateEnd(&_stream);
+}
+
+//记录解压失败的错误
+- (BOOL)failWithReason:(NSString *)reason {
+    self.decodingError = AFResponseDecodingError(reason);
+
+    return NO;
+}
+
+//解压一段数据到缓冲末尾，每次按输入长度预留输出空间，空间用完时继续解压
+- (BOOL)inflateBytes:(const uint8_t *)bytes
+              length:(NSUInteger)length
+            toBuffer:(NSMutableData *)buffer
+{
+    while (length > 0) {
+        //一个gzip成员结束后还有数据时，按下一个成员解压
+        if (self.streamEnded) {
+            if (inflateReset(&_stream) != Z_OK) {
+                return [self failWithReason:nil];
+            }
+            self.streamEnded = NO;
+        }
+
+        //zlib的长度是uInt，超长的数据分段解压
+        uInt inputLength = (uInt)MIN(length, (NSUInteger)UINT_MAX);
+        _stream.next_in = (Bytef *)bytes;
+        _stream.avail_in = inputLength;
+
+        do {
+            NSUInteger bufferLength = [buffer length];
+            NSUInteger outputLength = MIN(MAX((NSUInteger)_stream.avail_in * 2, AFGzipResponseDecoderMinimumOutputLength), AFGzipResponseDecoderMaximumOutputLength);
+            [buffer setLength:bufferLength + outputLength];
+            _stream.next_out = (Bytef *)[buffer mutableBytes] + bufferLength;
+            _stream.avail_out = (uInt)outputLength;
+
+            int status = inflate(&_stream, Z_NO_FLUSH);
+            [buffer setLength:bufferLength + (outputLength - _stream.avail_out)];
+
+            if (status == Z_STREAM_END) {
+                self.streamEnded = YES;
+                break;
+            } else if (status == Z_BUF_ERROR) {
+                break;
+            } else if (status != Z_OK) {
+                return [self failWithReason:_stream.msg ? @(_stream.msg) : nil];
+            }
+        } while (_stream.avail_out == 0);
+
+        NSUInteger consumedLength = inputLength - _stream.avail_in;
+        if (consumedLength == 0 && !self.streamEnded) {
+            return [self failWithReason:nil];
+        }
+
+        bytes += consumedLength;
+        length -= consumedLength;
+    }
+
+    return YES;
+}
+
+#pragma mark - AFURLResponseDecoding
+
+- (BOOL)decodeData:(NSData *)data
+          toBuffer:(NSMutableData *)buffer
+             error:(NSError * __autoreleasing *)error
+{
+    if (!self.decodingError && [data length] > 0) {
+        self.receivedData = YES;
+        [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+            if (![self inflateBytes:bytes length:byteRange.length toBuffer:buffer]) {
+                *stop = YES;
+            }
+        }];
+    }
+
+    if (self.decodingError) {
+        if (error) {
+            *error = self.decodingError;
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL)finishDecodingToBuffer:(__unused NSMutableData *)buffer
+                         error:(NSError * __autoreleasing *)error
+{
+    //没有收到数据时认为响应为空，收到了数据但流没有结束说明数据不完整
+    if (!self.decodingError && self.receivedData && !self.streamEnded) {
+        [self failWithReason:NSLocalizedStringFromTable(@"The compressed response body is truncated.", @"AFNetworking", nil)];
+    }
+
+    if (self.decodingError) {
+        if (error) {
+            *error = self.decodingError;
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
+@end
+
+#pragma mark -
+
+@interface AFBrotliResponseDecoder ()
+//是否收到过数据
+@property (readwrite, nonatomic, assign) BOOL receivedData;
+//brotli流是否已经结束
+@property (readwrite, nonatomic, assign) BOOL streamEnded;
+//解压失败的错误，之后的数据都不再解压
+@property (readwrite, nonatomic, strong) NSError *decodingError;
+@end
+
+@implementation AFBrotliResponseDecoder {
+#if AF_COMPRESSION_BROTLI_AVAILABLE
+    compression_stream _stream;
+#endif
+    BOOL _streamInitialized;
+}
+
++ (instancetype)decoder {
+    return [[self alloc] init];
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+#if AF_COMPRESSION_BROTLI_AVAILABLE
+    if (@available(iOS 15.0, macOS 12.0, tvOS 15.0, watchOS 8.0, *)) {
+        _streamInitialized = compression_stream_init(&_stream, COMPRESSION_STREAM_DECODE, COMPRESSION_BROTLI) == COMPRESSION_STATUS_OK;
+    }
+#endif
+
+    //系统不支持brotli时没有解码器
+    return _streamInitialized ? self : nil;
+}
+
+- (void)dealloc {
+#if AF_COMPRESSION_BROTLI_AVAILABLE
+    if (@available(iOS 15.0, macOS 12.0, tvOS 15.0, watchOS 8.0, *)) {
+        if (_streamInitialized) {
+            compression_stream_destroy(&_stream);
+        }
+    }
+#endif
+}
+
+//记录解压失败的错误
+- (BOOL)failWithReason:(NSString *)reason {
+    self.decodingError = AFResponseDecodingError(reason);
+
+    return NO;
+}
+
+#if AF_COMPRESSION_BROTLI_AVAILABLE
+//解压一段数据到缓冲末尾，每次按输入长度预留输出空间，空间用完时继续解压。finalize为YES时输出剩下的数据
+- (BOOL)processBytes:(const uint8_t *)bytes
+              length:(NSUInteger)length
+            toBuffer:(NSMutableData *)buffer
+            finalize:(BOOL)finalize
+{
+    if (self.streamEnded) {
+        return length == 0 ? YES : [self failWithReason:NSLocalizedStringFromTable(@"The compressed response body has data after its end.", @"AFNetworking", nil)];
+    }
+
+    if (@available(iOS 15.0, macOS 12.0, tvOS 15.0, watchOS 8.0, *)) {
+        _stream.src_ptr = bytes;
+        _stream.src_size = length;
+
+        do {
+            size_t inputLength = _stream.src_size;
+            NSUInteger bufferLength = [buffer length];
+            NSUInteger outputLength = MIN(MAX((NSUInteger)inputLength * 2, AFGzipResponseDecoderMinimumOutputLength), AFGzipResponseDecoderMaximumOutputLength);
+            [buffer setLength:bufferLength + outputLength];
+            _stream.dst_ptr = (uint8_t *)[buffer mutableBytes] + bufferLength;
+            _stream.dst_size = outputLength;
+
+            compression_status status = compression_stream_process(&_stream, finalize ? (int)COMPRESSION_STREAM_FINALIZE : 0);
+            NSUInteger producedLength = outputLength - _stream.dst_size;
+            [buffer setLength:bufferLength + producedLength];
+
+            if (status == COMPRESSION_STATUS_END) {
+                self.streamEnded = YES;
+                //brotli流只有一个，结束后不能再有数据
+                if (_stream.src_size > 0) {
+                    return [self failWithReason:NSLocalizedStringFromTable(@"The compressed response body has data after its end.", @"AFNetworking", nil)];
+                }
+                break;
+            } else if (status != COMPRESSION_STATUS_OK || (producedLength == 0 && _stream.src_size == inputLength && inputLength > 0)) {
+                return [self failWithReason:nil];
+            }
+        } while (_stream.src_size > 0 || _stream.dst_size == 0);
+
+        return YES;
+    }
+
+    return [self failWithReason:nil];
+}
+#endif
+
+#pragma mark - AFURLResponseDecoding
+
+- (BOOL)decodeData:(NSData *)data
+          toBuffer:(NSMutableData *)buffer
+             error:(NSError * __autoreleasing *)error
+{
+#if AF_COMPRESSION_BROTLI_AVAILABLE
+    if (!self.decodingError && [data length] > 0) {
+        self.receivedData = YES;
+        [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+            if (![self processBytes:bytes length:byteRange.length toBuffer:buffer finalize:NO]) {
+                *stop = YES;
+            }
+        }];
+    }
+#endif
+
+    if (self.decodingError) {
+        if (error) {
+            *error = self.decodingError;
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL)finishDecodingToBuffer:(NSMutableData *)buffer
+                         error:(NSError * __autoreleasing *)error
+{
+#if AF_COMPRESSION_BROTLI_AVAILABLE
+    //没有收到数据时认为响应为空，收到了数据但流没有结束说明数据不完整
+    if (!self.decodingError && self.receivedData && [self processBytes:NULL length:0 toBuffer:buffer finalize:YES] && !self.streamEnded) {
+        [self failWithReason:NSLocalizedStringFromTable(@"The compressed response body is truncated.", @"AFNetworking", nil)];
+    }
+#endif
+
+    if (self.decodingError) {
+        if (error) {
+            *error = self.decodingError;
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
+@end
+
+#pragma mark -
+
+//计算下载文件摘要时每次从文件读取并交给CC_SHA256_Update的字节数
+static NSUInteger const AFDownloadDigestBlockLength = 1024 * 1024;
+
+//用输入流按块读取文件计算SHA-256摘要，不映射也不把整个文件读进内存
+static NSData * AFSHA256DigestOfFileAtURL(NSURL *fileURL, NSError * __autoreleasing *error) {
+    NSInputStream *inputStream = [NSInputStream inputStreamWithURL:fileURL];
+    if (!inputStream) {
+        if (error) {
+            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadUnknownError userInfo:fileURL ? @{NSURLErrorKey: fileURL} : nil];
+        }
+        return nil;
+    }
+    [inputStream open];
+
+    CC_SHA256_CTX context;
+    CC_SHA256_Init(&context);
+    uint8_t *buffer = malloc(AFDownloadDigestBlockLength);
+    NSInteger numberOfBytesRead = 0;
+    while ((numberOfBytesRead = [inputStream read:buffer maxLength:AFDownloadDigestBlockLength]) > 0) {
+        CC_SHA256_Update(&context, buffer, (CC_LONG)numberOfBytesRead);
+    }
+    free(buffer);
+
+    NSError *streamError = [inputStream streamError];
+    [inputStream close];
+
+    if (numberOfBytesRead < 0) {
+        if (error) {
+            *error = streamError ?: [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadUnknownError userInfo:@{NSURLErrorKey: fileURL}];
+        }
+        return nil;
+    }
+
+    NSMutableData *digest = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final([digest mutableBytes], &context);
+
+    return digest;
+}
+
+//根据任务的优先级和请求的networkServiceType决定响应序列化的优先级
+static AFResponseSerializationPriority AFResponseSerializationPriorityForTask(NSURLSessionTask *task) {
+    if (task.originalRequest.networkServiceType == NSURLNetworkServiceTypeBackground) {
+        return AFResponseSerializationPriorityBackground;
+    }
+
+    //iOS 8之前任务没有优先级
+    if ([task respondsToSelector:@selector(priority)]) {
+        if (task.priority >= NSURLSessionTaskPriorityHigh) {
+            return AFResponseSerializationPriorityHigh;
+        } else if (task.priority <= NSURLSessionTaskPriorityLow) {
+            return AFResponseSerializationPriorityBackground;
+        }
+    }
+
+    return AFResponseSerializationPriorityDefault;
+}
+
 //url会话管理任务代理类，遵循会话任务代理协议，会话数据代理协议，会话下载代理协议
 @interface AFURLSessionManagerTaskDelegate : NSObject <NSURLSessionTaskDelegate, NSURLSessionDataDelegate, NSURLSessionDownloadDelegate>
 //使用一个任务初始化对象
@@ -167,6 +596,10 @@ typedef void (^AFURLSessionTaskCompletionHandler)(NSURLResponse *response, id re
 @property (nonatomic, strong) NSProgress *downloadProgress;
 //下载文件的url地址
 @property (nonatomic, copy) NSURL *downloadFileURL;
+//下载文件移动到最终存储路径失败时的错误
+@property (nonatomic, strong) NSError *downloadFileMoveError;
+//是否把移动好的下载文件交给响应序列化对象
+@property (nonatomic, assign) BOOL serializesDownloadedFile;
 //下载完成时使用的block
 @property (nonatomic, copy) AFURLSessionDownloadTaskDidFinishDownloadingBlock downloadTaskDidFinishDownloading;
 //获取上传进度block
@@ -175,6 +608,48 @@ typedef void (^AFURLSessionTaskCompletionHandler)(NSURLResponse *response, id re
 @property (nonatomic, copy) AFURLSessionTaskProgressBlock downloadProgressBlock;
 //会话任务完成时的block
 @property (nonatomic, copy) AFURLSessionTaskCompletionHandler completionHandler;
+//只用于这个任务的响应序列化对象，为nil时使用manager的
+@property (nonatomic, strong) id <AFURLResponseSerialization> responseSerializer;
+//只能读取一次的body流，会话第一次需要body流时提供
+@property (nonatomic, strong) NSInputStream *bodyStream;
+//不为nil时响应数据边收边解析，不放进mutableData
+@property (nonatomic, strong) id <AFURLResponseStreamParsing> streamParser;
+//收到第一块数据时是否已经验证过响应
+@property (nonatomic, assign) BOOL streamResponseValidated;
+//验证或解析失败的错误，任务被取消后代替取消错误返回
+@property (nonatomic, strong) NSError *streamError;
+//不为nil时响应数据先解码，再交给解析器或者放进mutableData
+@property (nonatomic, strong) id <AFURLResponseDecoding> responseDecoder;
+//从缓冲池取出的解码缓冲，任务完成时放回
+@property (nonatomic, strong) NSMutableData *decodingBuffer;
+//解码缓冲是否用过很大的长度，是的话不放回缓冲池
+@property (nonatomic, assign) BOOL decodingBufferOversized;
+//解码前收到的字节数
+@property (nonatomic, assign) int64_t countOfEncodedBytes;
+//解码后的字节数
+@property (nonatomic, assign) int64_t countOfDecodedBytes;
+//是否计算下载文件的SHA-256摘要
+@property (nonatomic, assign) BOOL computesSHA256Digest;
+//下载文件应有的SHA-256摘要，为nil时只计算不校验
+@property (nonatomic, copy) NSData *expectedSHA256Digest;
+//计算出的下载文件的SHA-256摘要
+@property (nonatomic, copy) NSData *SHA256Digest;
+//等待校验的下载文件，校验通过后才移动到最终存储路径
+@property (nonatomic, copy) NSURL *stagedDownloadFileURL;
+//校验通过后下载文件的最终存储路径
+@property (nonatomic, copy) NSURL *pendingDownloadFileURL;
+//没有最终存储路径时留给响应序列化对象的下载文件，序列化后删除
+@property (nonatomic, copy) NSURL *temporaryDownloadFileURL;
+//调用方是否暂停了任务，限速器和背压不会恢复调用方暂停的任务。暂停状态只在对代理加锁时访问
+@property (nonatomic, assign) BOOL suspendedByCaller;
+//限速器和背压暂停任务的次数，降到0时才恢复任务
+@property (nonatomic, assign) NSUInteger numberOfInternalSuspensions;
+//正在由限速器或背压暂停恢复任务，这时不发送暂停恢复通知
+@property (nonatomic, assign) BOOL changesSuspensionInternally;
+//任务是否正被限速器暂停
+@property (nonatomic, assign) BOOL suspendedByBandwidthLimiter;
+//任务是否正被增量解析器的背压暂停
+@property (nonatomic, assign) BOOL suspendedByStreamParser;
 @end
 
 @implementation AFURLSessionManagerTaskDelegate
@@ -187,6 +662,7 @@ typedef void (^AFURLSessionTaskCompletionHandler)(NSURLResponse *response, id re
     }
     
     _mutableData = [NSMutableData data];
+    _suspendedByCaller = task.state == NSURLSessionTaskStateSuspended;
     _uploadProgress = [[NSProgress alloc] initWithParent:nil userInfo:nil];
     _downloadProgress = [[NSProgress alloc] initWithParent:nil userInfo:nil];
     
@@ -247,12 +723,38 @@ typedef void (^AFURLSessionTaskCompletionHandler)(NSURLResponse *response, id re
 didCompleteWithError:(NSError *)error
 {
     __strong AFURLSessionManager *manager = self.manager;
+    id <AFURLResponseSerialization> responseSerializer = self.responseSerializer ?: manager.responseSerializer;
 
     __block id responseObject = nil;
 
+    //解码器中剩下的数据在序列化前交出去
+    if (self.responseDecoder && !error && !self.streamError) {
+        [self finishDecodingForDataTask:(NSURLSessionDataTask *)task];
+    }
+    [self releaseDecodingBuffer];
+
+    if (self.streamError) {
+        error = self.streamError;
+    }
+
+    //任务失败时删除等待校验和等待序列化的下载文件
+    if (error && self.stagedDownloadFileURL) {
+        [[NSFileManager defaultManager] removeItemAtURL:self.stagedDownloadFileURL error:nil];
+        self.stagedDownloadFileURL = nil;
+    }
+    if (error && self.temporaryDownloadFileURL) {
+        [[NSFileManager defaultManager] removeItemAtURL:self.temporaryDownloadFileURL error:nil];
+        self.temporaryDownloadFileURL = nil;
+    }
+
     __block NSMutableDictionary *userInfo = [NSMutableDictionary dictionary];
     //设置userinfo中网络响应的序列化方法
-    userInfo[AFNetworkingTaskDidCompleteResponseSerializerKey] = manager.responseSerializer;
+    userInfo[AFNetworkingTaskDidCompleteResponseSerializerKey] = responseSerializer;
+    if (self.responseDecoder) {
+        //设置userinfo中解码前后的字节数
+        userInfo[AFNetworkingTaskDidCompleteCountOfEncodedBytesKey] = @(self.countOfEncodedBytes);
+        userInfo[AFNetworkingTaskDidCompleteCountOfDecodedBytesKey] = @(self.countOfDecodedBytes);
+    }
 
     //Performance Improvement from #2672
     NSData *data = nil;
@@ -286,18 +788,11 @@ didCompleteWithError:(NSError *)error
             });
         });
     } else {
-        dispatch_async(url_session_manager_processing_queue(), ^{
-            NSError *serializationError = nil;
-            //将收取到的数据转化为对象
-            responseObject = [manager.responseSerializer responseObjectForResponse:task.response data:data error:&serializationError];
-
-            if (self.downloadFileURL) {
-                responseObject = self.downloadFileURL;
-            }
-
-            if (responseObject) {
+        //设置userinfo中的响应对象和序列化错误，在完成回调队列上回调
+        void (^finishSerialization)(id, NSError *) = ^(id serializedResponseObject, NSError *serializationError) {
+            if (serializedResponseObject) {
                 //设置userinfo中任务的序列化响应对象。
-                userInfo[AFNetworkingTaskDidCompleteSerializedResponseKey] = responseObject;
+                userInfo[AFNetworkingTaskDidCompleteSerializedResponseKey] = serializedResponseObject;
             }
 
             if (serializationError) {
@@ -308,7 +803,7 @@ didCompleteWithError:(NSError *)error
             dispatch_group_async(manager.completionGroup ?: url_session_manager_completion_group(), manager.completionQueue ?: dispatch_get_main_queue(), ^{
                 if (self.completionHandler) {
                     //调用任务完成回调
-                    self.completionHandler(task.response, responseObject, serializationError);
+                    self.completionHandler(task.response, serializedResponseObject, serializationError);
                 }
 
                 dispatch_async(dispatch_get_main_queue(), ^{
@@ -316,8 +811,144 @@ didCompleteWithError:(NSError *)error
                     [[NSNotificationCenter defaultCenter] postNotificationName:AFNetworkingTaskDidCompleteNotification object:task userInfo:userInfo];
                 });
             });
-        });
+        };
+
+        dispatch_block_t serialization = ^{
+            NSError *serializationError = nil;
+            BOOL downloadIsVerified = YES;
+            if (self.stagedDownloadFileURL) {
+                //校验暂存的下载文件，通过后移动到最终存储路径
+                downloadIsVerified = [self verifyStagedDownloadForTask:task error:&serializationError];
+                if (self.SHA256Digest) {
+                    userInfo[AFNetworkingTaskDidCompleteSHA256DigestKey] = self.SHA256Digest;
+                }
+                if (self.downloadFileURL) {
+                    userInfo[AFNetworkingTaskDidCompleteAssetPathKey] = self.downloadFileURL;
+                }
+            }
+
+            NSURL *serializedFileURL = self.downloadFileURL ?: self.temporaryDownloadFileURL;
+            BOOL serializesDownloadedFile = serializedFileURL && self.serializesDownloadedFile;
+            if (!downloadIsVerified) {
+                //摘要不匹配或者没能移动到最终存储路径的下载不交给序列化对象
+            } else if (serializesDownloadedFile && self.downloadFileMoveError) {
+                //没有移动成功的文件不交给序列化对象
+                serializationError = self.downloadFileMoveError;
+            } else if (self.streamParser) {
+                //增量解析的数据已经全部交给解析器，没有收到数据时在这里验证响应
+                if (self.streamResponseValidated || [self validateStreamResponse:task.response data:nil error:&serializationError]) {
+                    //解析器能异步结束时不在序列化线程上等待
+                    if ([self.streamParser respondsToSelector:@selector(finishParsingWithCompletionHandler:)]) {
+                        [self.streamParser finishParsingWithCompletionHandler:finishSerialization];
+                        return;
+                    }
+                    responseObject = [self.streamParser finishParsingWithError:&serializationError];
+                }
+            } else if (serializesDownloadedFile) {
+                //把下载好的文件交给序列化对象
+                responseObject = [self responseObjectForDownloadedFileAtURL:serializedFileURL response:task.response responseSerializer:responseSerializer error:&serializationError];
+            } else {
+                //将收取到的数据转化为对象
+                responseObject = [responseSerializer responseObjectForResponse:task.response data:data error:&serializationError];
+            }
+
+            if (self.downloadFileURL && !serializesDownloadedFile) {
+                responseObject = self.downloadFileURL;
+            }
+
+            //没有最终存储路径的下载文件序列化后删除
+            if (self.temporaryDownloadFileURL) {
+                [[NSFileManager defaultManager] removeItemAtURL:self.temporaryDownloadFileURL error:nil];
+                self.temporaryDownloadFileURL = nil;
+            }
+
+            finishSerialization(responseObject, serializationError);
+        };
+
+        //设置了执行器时在任务对应的优先级通道里序列化，否则在共享的并发队列里序列化
+        AFResponseSerializationExecutor *serializationExecutor = manager.serializationExecutor;
+        if (serializationExecutor) {
+            [serializationExecutor addSerializationWithPriority:AFResponseSerializationPriorityForTask(task) block:serialization];
+        } else {
+            dispatch_async(url_session_manager_processing_queue(), serialization);
+        }
+    }
+}
+
+//计算暂存的下载文件的摘要，不匹配时删除文件并返回错误，匹配时移动到最终存储路径，移动失败时同样删除文件并返回错误
+- (BOOL)verifyStagedDownloadForTask:(NSURLSessionTask *)task error:(NSError * __autoreleasing *)error {
+    NSURL *stagedFileURL = self.stagedDownloadFileURL;
+    self.stagedDownloadFileURL = nil;
+
+    NSError *readingError = nil;
+    self.SHA256Digest = AFSHA256DigestOfFileAtURL(stagedFileURL, &readingError);
+    if (!self.SHA256Digest || (self.expectedSHA256Digest && ![self.SHA256Digest isEqualToData:self.expectedSHA256Digest])) {
+        [[NSFileManager defaultManager] removeItemAtURL:stagedFileURL error:nil];
+        if (error) {
+            if (self.SHA256Digest) {
+                NSMutableDictionary *userInfo = [NSMutableDictionary dictionary];
+                userInfo[NSLocalizedDescriptionKey] = NSLocalizedStringFromTable(@"The downloaded file does not match its expected SHA-256 digest.", @"AFNetworking", nil);
+                userInfo[AFURLSessionManagerExpectedSHA256DigestErrorKey] = self.expectedSHA256Digest;
+                userInfo[AFURLSessionManagerSHA256DigestErrorKey] = self.SHA256Digest;
+                if (task.originalRequest.URL) {
+                    userInfo[NSURLErrorFailingURLErrorKey] = task.originalRequest.URL;
+                }
+                *error = [NSError errorWithDomain:AFURLSessionManagerErrorDomain code:AFURLSessionManagerErrorDownloadDigestMismatch userInfo:userInfo];
+            } else {
+                *error = readingError;
+            }
+        }
+        return NO;
+    }
+
+    //没有最终存储路径时和普通的下载一样处理，需要序列化时留到序列化后再删除
+    NSURL *fileURL = self.pendingDownloadFileURL;
+    if (!fileURL) {
+        if (self.serializesDownloadedFile) {
+            self.temporaryDownloadFileURL = stagedFileURL;
+        } else {
+            [[NSFileManager defaultManager] removeItemAtURL:stagedFileURL error:nil];
+        }
+        return YES;
+    }
+
+    NSError *fileManagerError = nil;
+    if (![[NSFileManager defaultManager] moveItemAtURL:stagedFileURL toURL:fileURL error:&fileManagerError]) {
+        //移动失败时删除暂存的文件，任务以文件管理器的错误失败
+        [[NSFileManager defaultManager] removeItemAtURL:stagedFileURL error:nil];
+        [[NSNotificationCenter defaultCenter] postNotificationName:AFURLSessionDownloadTaskDidFailToMoveFileNotification object:task userInfo:fileManagerError.userInfo];
+        if (error) {
+            *error = fileManagerError;
+        }
+        return NO;
+    }
+    self.downloadFileURL = fileURL;
+
+    return YES;
+}
+
+//下载的文件以输入流或者内存映射的数据交给响应序列化对象，不把整个文件读进内存
+- (id)responseObjectForDownloadedFileAtURL:(NSURL *)fileURL
+                                  response:(NSURLResponse *)response
+                        responseSerializer:(id <AFURLResponseSerialization>)responseSerializer
+                                     error:(NSError * __autoreleasing *)error
+{
+    //临时文件序列化后就删除，不交给可能延后读取的输入流，映射的数据在文件删除后仍然可用
+    if (!self.temporaryDownloadFileURL && [responseSerializer conformsToProtocol:@protocol(AFURLResponseStreamSerialization)]) {
+        NSInputStream *inputStream = [NSInputStream inputStreamWithURL:fileURL];
+        return [(id <AFURLResponseStreamSerialization>)responseSerializer responseObjectForResponse:response inputStream:inputStream error:error];
+    }
+
+    NSError *readingError = nil;
+    NSData *data = [NSData dataWithContentsOfURL:fileURL options:NSDataReadingMappedAlways error:&readingError];
+    if (!data) {
+        if (error) {
+            *error = readingError;
+        }
+        return nil;
     }
+
+    return [responseSerializer responseObjectForResponse:response data:data error:error];
 }
 
 #pragma mark - NSURLSessionDataDelegate
@@ -331,26 +962,158 @@ didCompleteWithError:(NSError *)error
     self.downloadProgress.totalUnitCount = dataTask.countOfBytesExpectedToReceive;
     self.downloadProgress.completedUnitCount = dataTask.countOfBytesReceived;
 
+    self.countOfEncodedBytes += (int64_t)[data length];
+
+    if (self.responseDecoder) {
+        [self decodeData:data dataTask:dataTask];
+        return;
+    }
+
+    [self receiveDecodedData:data dataTask:dataTask];
+}
+
+//把解码后的数据交给解析器，或者添加到mutableData
+- (void)receiveDecodedData:(NSData *)data dataTask:(NSURLSessionDataTask *)dataTask {
+    self.countOfDecodedBytes += (int64_t)[data length];
+
+    if (self.streamParser) {
+        [self parseStreamData:data dataTask:dataTask];
+        return;
+    }
+
     //添加新收到的数据
     [self.mutableData appendData:data];
 }
 
-//会话的任务发送数据
-- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task
-   didSendBodyData:(int64_t)bytesSent
-    totalBytesSent:(int64_t)totalBytesSent
-totalBytesExpectedToSend:(int64_t)totalBytesExpectedToSend{
-    
-    //更新上传进度
-    self.uploadProgress.totalUnitCount = task.countOfBytesExpectedToSend;
-    self.uploadProgress.completedUnitCount = task.countOfBytesSent;
+#pragma mark - Response Decoding
+
+//解码缓冲不存在时从缓冲池取一个，每次使用前清空
+- (NSMutableData *)emptyDecodingBuffer {
+    if (!self.decodingBuffer) {
+        self.decodingBuffer = url_session_manager_dequeue_decoding_buffer();
+    }
+    [self.decodingBuffer setLength:0];
+
+    return self.decodingBuffer;
 }
 
-#pragma mark - NSURLSessionDownloadDelegate
+//把缓冲中解码后的数据交出去，缓冲之后会被复用。拼接到mutableData时直接引用缓冲的内存，
+//解析器可能保留收到的数据，所以交给解析器的是拷贝
+- (void)receiveDecodingBuffer:(NSMutableData *)buffer dataTask:(NSURLSessionDataTask *)dataTask {
+    NSUInteger length = [buffer length];
+    if (length == 0) {
+        return;
+    }
+    if (length > AFURLResponseDecodingBufferMaximumPooledLength) {
+        self.decodingBufferOversized = YES;
+    }
 
-//会话的下载任务回调，写入数据
-- (void)URLSession:(NSURLSession *)session downloadTask:(NSURLSessionDownloadTask *)downloadTask
-      didWriteData:(int64_t)bytesWritten
+    NSData *data = self.streamParser ? [NSData dataWithBytes:[buffer bytes] length:length] : [NSData dataWithBytesNoCopy:[buffer mutableBytes] length:length freeWhenDone:NO];
+    [self receiveDecodedData:data dataTask:dataTask];
+}
+
+//解码一块数据，失败时取消任务
+- (void)decodeData:(NSData *)data dataTask:(NSURLSessionDataTask *)dataTask {
+    if (self.streamError) {
+        return;
+    }
+
+    NSError *error = nil;
+    NSMutableData *buffer = [self emptyDecodingBuffer];
+    if (![self.responseDecoder decodeData:data toBuffer:buffer error:&error]) {
+        self.streamError = error ?: [NSError errorWithDomain:AFURLResponseSerializationErrorDomain code:NSURLErrorCannotDecodeRawData userInfo:nil];
+        [dataTask cancel];
+        return;
+    }
+
+    [self receiveDecodingBuffer:buffer dataTask:dataTask];
+}
+
+//所有数据都收到以后结束解码，交出剩下的数据
+- (void)finishDecodingForDataTask:(NSURLSessionDataTask *)dataTask {
+    NSError *error = nil;
+    NSMutableData *buffer = [self emptyDecodingBuffer];
+    if (![self.responseDecoder finishDecodingToBuffer:buffer error:&error]) {
+        self.streamError = error ?: [NSError errorWithDomain:AFURLResponseSerializationErrorDomain code:NSURLErrorCannotDecodeRawData userInfo:nil];
+        return;
+    }
+
+    [self receiveDecodingBuffer:buffer dataTask:dataTask];
+}
+
+//把解码缓冲放回缓冲池
+- (void)releaseDecodingBuffer {
+    if (!self.decodingBuffer) {
+        return;
+    }
+
+    if (!self.decodingBufferOversized) {
+        url_session_manager_enqueue_decoding_buffer(self.decodingBuffer);
+    }
+    self.decodingBuffer = nil;
+}
+
+#pragma mark - Stream Parsing
+
+//用解析器或者任务的响应序列化对象验证响应，不解析数据
+- (BOOL)validateStreamResponse:(NSURLResponse *)response data:(NSData *)data error:(NSError * __autoreleasing *)error {
+    id <AFURLResponseSerialization> responseSerializer = self.responseSerializer ?: self.manager.responseSerializer;
+    if ([self.streamParser respondsToSelector:@selector(responseSerializer)] && self.streamParser.responseSerializer) {
+        responseSerializer = self.streamParser.responseSerializer;
+    }
+    if (![responseSerializer respondsToSelector:@selector(validateResponse:data:error:)]) {
+        return YES;
+    }
+
+    NSError *validationError = nil;
+    if (![(AFHTTPResponseSerializer *)responseSerializer validateResponse:(NSHTTPURLResponse *)response data:data error:&validationError]) {
+        if (error) {
+            *error = validationError ?: [NSError errorWithDomain:AFURLResponseSerializationErrorDomain code:NSURLErrorBadServerResponse userInfo:nil];
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
+//第一块数据到达时验证响应，之后把数据交给解析器，失败时取消任务
+- (void)parseStreamData:(NSData *)data dataTask:(NSURLSessionDataTask *)dataTask {
+    if (self.streamError) {
+        return;
+    }
+
+    NSError *error = nil;
+    if (!self.streamResponseValidated) {
+        self.streamResponseValidated = YES;
+        if (![self validateStreamResponse:dataTask.response data:data error:&error]) {
+            self.streamError = error;
+            [dataTask cancel];
+            return;
+        }
+    }
+
+    if (![self.streamParser parseData:data error:&error]) {
+        self.streamError = error;
+        [dataTask cancel];
+    }
+}
+
+//会话的任务发送数据
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task
+   didSendBodyData:(int64_t)bytesSent
+    totalBytesSent:(int64_t)totalBytesSent
+totalBytesExpectedToSend:(int64_t)totalBytesExpectedToSend{
+    
+    //更新上传进度
+    self.uploadProgress.totalUnitCount = task.countOfBytesExpectedToSend;
+    self.uploadProgress.completedUnitCount = task.countOfBytesSent;
+}
+
+#pragma mark - NSURLSessionDownloadDelegate
+
+//会话的下载任务回调，写入数据
+- (void)URLSession:(NSURLSession *)session downloadTask:(NSURLSessionDownloadTask *)downloadTask
+      didWriteData:(int64_t)bytesWritten
  totalBytesWritten:(int64_t)totalBytesWritten
 totalBytesExpectedToWrite:(int64_t)totalBytesExpectedToWrite{
     
@@ -375,6 +1138,7 @@ expectedTotalBytes:(int64_t)expectedTotalBytes{
 didFinishDownloadingToURL:(NSURL *)location
 {
     self.downloadFileURL = nil;
+    self.downloadFileMoveError = nil;
 
     if (self.downloadTaskDidFinishDownloading) {
         //下载完成，调用下载完成的block并返回信息
@@ -384,11 +1148,44 @@ didFinishDownloadingToURL:(NSURL *)location
 
             //下载完成，将临时文件存储到指定位置
             if (![[NSFileManager defaultManager] moveItemAtURL:location toURL:self.downloadFileURL error:&fileManagerError]) {
+                self.downloadFileMoveError = fileManagerError;
                 //如果转存文件失败，则发送转存失败通知
                 [[NSNotificationCenter defaultCenter] postNotificationName:AFURLSessionDownloadTaskDidFailToMoveFileNotification object:downloadTask userInfo:fileManagerError.userInfo];
             }
         }
     }
+
+    //没有最终存储路径但需要序列化时，先保留临时文件，序列化后再删除
+    if (!self.downloadFileURL && self.serializesDownloadedFile) {
+        self.temporaryDownloadFileURL = [self stageDownloadedFileAtURL:location];
+    }
+}
+
+//需要计算摘要的下载完成，临时文件返回后就会被删除，先移到暂存路径，在完成回调中计算摘要，不占用会话队列
+- (void)URLSession:(NSURLSession *)session
+      downloadTask:(NSURLSessionDownloadTask *)downloadTask
+didFinishDownloadingToURL:(NSURL *)location
+    destinationURL:(NSURL *)destinationURL
+{
+    if (!destinationURL && self.downloadTaskDidFinishDownloading) {
+        destinationURL = self.downloadTaskDidFinishDownloading(session, downloadTask, location);
+    }
+    self.downloadFileURL = nil;
+    self.pendingDownloadFileURL = destinationURL;
+    self.stagedDownloadFileURL = [self stageDownloadedFileAtURL:location];
+}
+
+//把返回后就会被删除的临时文件移到暂存路径，移动失败时任务以文件管理器的错误失败
+- (NSURL *)stageDownloadedFileAtURL:(NSURL *)location {
+    NSString *fileName = [@"com.alamofire.networking.download." stringByAppendingString:[[NSUUID UUID] UUIDString]];
+    NSURL *stagedFileURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:fileName];
+    NSError *fileManagerError = nil;
+    if (![[NSFileManager defaultManager] moveItemAtURL:location toURL:stagedFileURL error:&fileManagerError]) {
+        self.streamError = fileManagerError;
+        return nil;
+    }
+
+    return stagedFileURL;
 }
 
 @end
@@ -518,26 +1315,20 @@ static NSString * const AFNSURLSessionTaskDidSuspendNotification = @"com.alamofi
 
 - (void)af_resume {
     NSAssert([self respondsToSelector:@selector(state)], @"Does not respond to state");
-    NSURLSessionTaskState state = [self state];
     //已经换为NSURLSessionDataTask的resume函数
     [self af_resume];
     
-    //如果状态需要切换到运行状态，则发送恢复任务通知
-    if (state != NSURLSessionTaskStateRunning) {
-        [[NSNotificationCenter defaultCenter] postNotificationName:AFNSURLSessionTaskDidResumeNotification object:self];
-    }
+    //每次调用都发送恢复任务通知，由会话管理类根据调用方是否暂停过任务决定是否发送公开的通知
+    [[NSNotificationCenter defaultCenter] postNotificationName:AFNSURLSessionTaskDidResumeNotification object:self];
 }
 
 - (void)af_suspend {
     NSAssert([self respondsToSelector:@selector(state)], @"Does not respond to state");
-    NSURLSessionTaskState state = [self state];
     //已经换为NSURLSessionDataTask的suspend函数
     [self af_suspend];
     
-    //如果不是在暂停状态，则发送暂停通知
-    if (state != NSURLSessionTaskStateSuspended) {
-        [[NSNotificationCenter defaultCenter] postNotificationName:AFNSURLSessionTaskDidSuspendNotification object:self];
-    }
+    //每次调用都发送暂停通知，任务被限速器暂停时调用方的暂停也要记录下来
+    [[NSNotificationCenter defaultCenter] postNotificationName:AFNSURLSessionTaskDidSuspendNotification object:self];
 }
 @end
 
@@ -577,6 +1368,8 @@ static NSString * const AFNSURLSessionTaskDidSuspendNotification = @"com.alamofi
 @property (readwrite, nonatomic, copy) AFURLSessionTaskDidCompleteBlock taskDidComplete;
 //会话数据任务收到响应时的block
 @property (readwrite, nonatomic, copy) AFURLSessionDataTaskDidReceiveResponseBlock dataTaskDidReceiveResponse;
+//会话数据任务收到响应时返回响应数据解码器的block
+@property (readwrite, nonatomic, copy) AFURLSessionDataTaskResponseDecoderBlock dataTaskResponseDecoder;
 //会话数据任务改变成下载任务时的block
 @property (readwrite, nonatomic, copy) AFURLSessionDataTaskDidBecomeDownloadTaskBlock dataTaskDidBecomeDownloadTask;
 //会话数据任务收到数据时的block
@@ -589,6 +1382,36 @@ static NSString * const AFNSURLSessionTaskDidSuspendNotification = @"com.alamofi
 @property (readwrite, nonatomic, copy) AFURLSessionDownloadTaskDidWriteDataBlock downloadTaskDidWriteData;
 //会话下载任务恢复时的block
 @property (readwrite, nonatomic, copy) AFURLSessionDownloadTaskDidResumeBlock downloadTaskDidResume;
+
+//根据任务获取任务代理
+- (AFURLSessionManagerTaskDelegate *)delegateForTask:(NSURLSessionTask *)task;
+@end
+
+@interface AFDeduplicatedUpload ()
+@property (readwrite, nonatomic, strong) NSURLSessionUploadTask *task;
+@property (readwrite, nonatomic, copy) void (^cancellationHandler)(void);
+@property (readwrite, nonatomic, assign, getter = isCancelled) BOOL cancelled;
+//查询完成后创建任务，已经取消时返回NO
+- (BOOL)startWithTask:(NSURLSessionUploadTask * (^)(void))taskFactory;
+@end
+
+@interface AFUploadStreamProducer ()
+//关联读取生产者的上传任务，生产者被关闭时取消任务
+- (void)attachToTask:(NSURLSessionTask *)task;
+//任务结束后关闭生产者，返回任务的错误，任务因为生产者被关闭而取消时返回关闭的错误
+- (NSError *)closeWithTaskError:(NSError *)error;
+@end
+
+@interface AFChunkedUpload ()
+//使用会话管理类、请求模板、文件、块大小、清单文件和上传协议初始化
+- (instancetype)initWithSessionManager:(AFURLSessionManager *)sessionManager
+                               request:(NSURLRequest *)request
+                               fileURL:(NSURL *)fileURL
+                             chunkSize:(unsigned long long)chunkSize
+                           manifestURL:(NSURL *)manifestURL
+                              protocol:(id <AFChunkedUploadProtocol>)protocol;
+@property (readwrite, nonatomic, copy) void (^uploadProgressBlock)(NSProgress *uploadProgress);
+@property (readwrite, nonatomic, copy) void (^completionHandler)(NSURLResponse *response, id responseObject, NSError *error);
 @end
 
 @implementation AFURLSessionManager
@@ -631,6 +1454,7 @@ static NSString * const AFNSURLSessionTaskDidSuspendNotification = @"com.alamofi
     self.lock = [[NSLock alloc] init];
     self.lock.name = AFURLSessionManagerLockName;
 
+
     //为每个任务生成一个AFURLSessionManagerTaskDelegate类，并将任务装入该代理类。指定SessionManager为代理
     //类的manager,并且将每个任务和代理类的对应关系保存入mutableTaskDelegatesKeyedByTaskIdentifier
     //并未每个任务添加暂停和恢复通知
@@ -668,6 +1492,17 @@ static NSString * const AFNSURLSessionTaskDidSuspendNotification = @"com.alamofi
     NSURLSessionTask *task = notification.object;
     if ([task respondsToSelector:@selector(taskDescription)]) {
         if ([task.taskDescription isEqualToString:self.taskDescriptionForSessionTasks]) {
+            //限速器和背压恢复任务，或者调用方没有暂停过任务时不发送通知
+            AFURLSessionManagerTaskDelegate *delegate = [self delegateForTask:task];
+            if (delegate) {
+                @synchronized (delegate) {
+                    if (delegate.changesSuspensionInternally || !delegate.suspendedByCaller) {
+                        return;
+                    }
+                    delegate.suspendedByCaller = NO;
+                }
+            }
+
             dispatch_async(dispatch_get_main_queue(), ^{
                 //发送恢复任务通知
                 [[NSNotificationCenter defaultCenter] postNotificationName:AFNetworkingTaskDidResumeNotification object:task];
@@ -681,6 +1516,17 @@ static NSString * const AFNSURLSessionTaskDidSuspendNotification = @"com.alamofi
     NSURLSessionTask *task = notification.object;
     if ([task respondsToSelector:@selector(taskDescription)]) {
         if ([task.taskDescription isEqualToString:self.taskDescriptionForSessionTasks]) {
+            //限速器和背压暂停任务，或者调用方已经暂停过任务时不发送通知
+            AFURLSessionManagerTaskDelegate *delegate = [self delegateForTask:task];
+            if (delegate) {
+                @synchronized (delegate) {
+                    if (delegate.changesSuspensionInternally || delegate.suspendedByCaller) {
+                        return;
+                    }
+                    delegate.suspendedByCaller = YES;
+                }
+            }
+
             dispatch_async(dispatch_get_main_queue(), ^{
                 //发送任务暂停时通知
                 [[NSNotificationCenter defaultCenter] postNotificationName:AFNetworkingTaskDidSuspendNotification object:task];
@@ -784,6 +1630,83 @@ static NSString * const AFNSURLSessionTaskDidSuspendNotification = @"com.alamofi
 
 #pragma mark -
 
+//记录任务传输的字节，超出限速器允许的带宽时暂停任务，等待足够的时间后再恢复，不阻塞会话的线程
+- (void)limitBandwidthForTask:(NSURLSessionTask *)task
+            transferredBytes:(int64_t)numberOfBytes
+                   direction:(AFNetworkBandwidthDirection)direction
+{
+    AFNetworkBandwidthLimiter *bandwidthLimiter = self.bandwidthLimiter;
+    if (!bandwidthLimiter || numberOfBytes <= 0) {
+        return;
+    }
+
+    NSURLRequest *request = task.currentRequest ?: task.originalRequest;
+    NSTimeInterval delay = [bandwidthLimiter consumeBytes:numberOfBytes forDirection:direction networkServiceType:request.networkServiceType];
+    AFURLSessionManagerTaskDelegate *delegate = [self delegateForTask:task];
+    if (delay <= 0 || !delegate || delegate.suspendedByBandwidthLimiter) {
+        return;
+    }
+
+    delegate.suspendedByBandwidthLimiter = YES;
+    [self suspendTaskInternally:task];
+
+    __weak __typeof__(self) weakSelf = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [weakSelf.operationQueue addOperationWithBlock:^{
+            __strong __typeof__(weakSelf) strongSelf = weakSelf;
+            //任务完成后代理已经移除，不再恢复
+            AFURLSessionManagerTaskDelegate *pausedDelegate = [strongSelf delegateForTask:task];
+            if (!pausedDelegate.suspendedByBandwidthLimiter) {
+                return;
+            }
+
+            pausedDelegate.suspendedByBandwidthLimiter = NO;
+            [strongSelf resumeTaskInternally:task];
+        }];
+    });
+}
+
+//限速器或背压暂停任务，不发送暂停通知，和调用方的暂停分开记录
+- (void)suspendTaskInternally:(NSURLSessionTask *)task {
+    AFURLSessionManagerTaskDelegate *delegate = [self delegateForTask:task];
+    if (!delegate) {
+        return;
+    }
+
+    @synchronized (delegate) {
+        delegate.numberOfInternalSuspensions++;
+        if (delegate.numberOfInternalSuspensions == 1 && task.state == NSURLSessionTaskStateRunning) {
+            delegate.changesSuspensionInternally = YES;
+            [task suspend];
+            delegate.changesSuspensionInternally = NO;
+        }
+    }
+}
+
+//限速器或背压恢复任务，所有内部的暂停都结束、调用方也没有暂停任务时才恢复，不发送恢复通知
+- (void)resumeTaskInternally:(NSURLSessionTask *)task {
+    AFURLSessionManagerTaskDelegate *delegate = [self delegateForTask:task];
+    if (!delegate) {
+        return;
+    }
+
+    @synchronized (delegate) {
+        if (delegate.numberOfInternalSuspensions == 0) {
+            return;
+        }
+
+        delegate.numberOfInternalSuspensions--;
+        //任务在暂停期间被取消时不再恢复
+        if (delegate.numberOfInternalSuspensions == 0 && !delegate.suspendedByCaller && task.state == NSURLSessionTaskStateSuspended) {
+            delegate.changesSuspensionInternally = YES;
+            [task resume];
+            delegate.changesSuspensionInternally = NO;
+        }
+    }
+}
+
+#pragma mark -
+
 - (NSArray *)tasksForKeyPath:(NSString *)keyPath {
     __block NSArray *tasks = nil;
     //创建一个信号量semaphore，
@@ -897,6 +1820,60 @@ static NSString * const AFNSURLSessionTaskDidSuspendNotification = @"com.alamofi
     return dataTask;
 }
 
+//创建一个数据任务，响应数据边收边交给json增量解析器
+- (NSURLSessionDataTask *)dataTaskWithRequest:(NSURLRequest *)request
+                             JSONStreamParser:(AFJSONStreamParser *)parser
+                             downloadProgress:(void (^)(NSProgress *downloadProgress))downloadProgressBlock
+                            completionHandler:(void (^)(NSURLResponse *response, id responseObject, NSError *error))completionHandler
+{
+    return [self dataTaskWithRequest:request streamParser:parser downloadProgress:downloadProgressBlock completionHandler:completionHandler];
+}
+
+//创建一个数据任务，响应数据边收边交给增量解析器，解析器要求时暂停和恢复任务
+- (NSURLSessionDataTask *)dataTaskWithRequest:(NSURLRequest *)request
+                                 streamParser:(id <AFURLResponseStreamParsing>)parser
+                             downloadProgress:(void (^)(NSProgress *downloadProgress))downloadProgressBlock
+                            completionHandler:(void (^)(NSURLResponse *response, id responseObject, NSError *error))completionHandler
+{
+    NSParameterAssert(parser);
+
+    NSURLSessionDataTask *dataTask = [self dataTaskWithRequest:request uploadProgress:nil downloadProgress:downloadProgressBlock completionHandler:completionHandler];
+
+    AFURLSessionManagerTaskDelegate *delegate = [self delegateForTask:dataTask];
+    delegate.streamParser = parser;
+    delegate.mutableData = nil;
+
+    //背压和限速器一样在内部暂停任务，不发送暂停恢复通知，也不会恢复调用方暂停的任务
+    if ([parser respondsToSelector:@selector(setBackpressureHandler:)]) {
+        __weak __typeof__(self) weakSelf = self;
+        __weak __typeof__(dataTask) weakDataTask = dataTask;
+        [parser setBackpressureHandler:^(BOOL shouldSuspend) {
+            __strong __typeof__(weakSelf) strongSelf = weakSelf;
+            NSURLSessionDataTask *task = weakDataTask;
+            AFURLSessionManagerTaskDelegate *taskDelegate = [strongSelf delegateForTask:task];
+            if (!taskDelegate) {
+                return;
+            }
+
+            //同一个方向的多次通知只暂停或恢复一次
+            @synchronized (taskDelegate) {
+                if (taskDelegate.suspendedByStreamParser == shouldSuspend) {
+                    return;
+                }
+                taskDelegate.suspendedByStreamParser = shouldSuspend;
+
+                if (shouldSuspend) {
+                    [strongSelf suspendTaskInternally:task];
+                } else {
+                    [strongSelf resumeTaskInternally:task];
+                }
+            }
+        }];
+    }
+
+    return dataTask;
+}
+
 #pragma mark -
 
 //根据指定的请求和本地文件，创建一个上传任务
@@ -959,6 +1936,107 @@ static NSString * const AFNSURLSessionTaskDidSuspendNotification = @"com.alamofi
     return uploadTask;
 }
 
+//根据生产者创建上传任务，任务结束后关闭生产者，唤醒等待空间的写入
+- (NSURLSessionUploadTask *)uploadTaskWithStreamedRequest:(NSURLRequest *)request
+                                                 producer:(AFUploadStreamProducer *)producer
+                                                 progress:(void (^)(NSProgress *uploadProgress))uploadProgressBlock
+                                        completionHandler:(void (^)(NSURLResponse *response, id responseObject, NSError *error))completionHandler
+{
+    NSParameterAssert(producer);
+
+    //长度未知，使用分块传输编码
+    NSMutableURLRequest *mutableRequest = [request mutableCopy];
+    [mutableRequest setValue:nil forHTTPHeaderField:@"Content-Length"];
+    [mutableRequest setValue:@"chunked" forHTTPHeaderField:@"Transfer-Encoding"];
+
+    NSURLSessionUploadTask *uploadTask = [self uploadTaskWithStreamedRequest:mutableRequest progress:uploadProgressBlock completionHandler:^(NSURLResponse *response, id responseObject, NSError *error) {
+        NSError *taskError = [producer closeWithTaskError:error];
+
+        if (completionHandler) {
+            completionHandler(response, responseObject, taskError);
+        }
+    }];
+    [producer attachToTask:uploadTask];
+    [self delegateForTask:uploadTask].bodyStream = producer.inputStream;
+
+    return uploadTask;
+}
+
+//先通过当前会话查询服务器是否已有文件内容，已有时只发送摘要，否则完整上传，完整上传成功后缓存摘要
+- (AFDeduplicatedUpload *)uploadWithRequest:(NSURLRequest *)request
+                                   fromFile:(NSURL *)fileURL
+                               deduplicator:(AFUploadDeduplicator *)deduplicator
+                                   progress:(void (^)(NSProgress *uploadProgress))uploadProgressBlock
+                          completionHandler:(void (^)(NSURLResponse *response, id responseObject, NSError *error))completionHandler
+{
+    NSParameterAssert([fileURL isFileURL]);
+    NSParameterAssert(deduplicator);
+
+    AFDeduplicatedUpload *upload = [[AFDeduplicatedUpload alloc] init];
+    if (completionHandler) {
+        //查询完成前取消时，在完成回调队列上以取消错误回调
+        dispatch_queue_t completionQueue = self.completionQueue ?: dispatch_get_main_queue();
+        upload.cancellationHandler = ^{
+            NSError *cancellationError = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+            dispatch_async(completionQueue, ^{
+                completionHandler(nil, nil, cancellationError);
+            });
+        };
+    }
+
+    [deduplicator lookUpFileAtURL:fileURL sessionManager:self completionHandler:^(NSString *digest, BOOL exists, __unused NSError *error) {
+        NSMutableURLRequest *mutableRequest = [request mutableCopy];
+        if (digest) {
+            [mutableRequest setValue:digest forHTTPHeaderField:deduplicator.digestHeaderField];
+        }
+
+        BOOL started = [upload startWithTask:^NSURLSessionUploadTask *{
+            if (exists) {
+                return [self uploadTaskWithRequest:mutableRequest fromData:[NSData data] progress:uploadProgressBlock completionHandler:completionHandler];
+            }
+
+            return [self uploadTaskWithRequest:mutableRequest fromFile:fileURL progress:uploadProgressBlock completionHandler:^(NSURLResponse *response, id responseObject, NSError *uploadError) {
+                if (!uploadError && digest) {
+                    [deduplicator cacheDigest:digest];
+                }
+
+                if (completionHandler) {
+                    completionHandler(response, responseObject, uploadError);
+                }
+            }];
+        }];
+
+        if (started && exists) {
+            NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:[fileURL path] error:nil];
+            [deduplicator addNumberOfBytesSaved:(int64_t)[attributes fileSize]];
+        }
+    }];
+
+    return upload;
+}
+
+//根据指定的请求和本地文件，创建一个分块上传
+- (AFChunkedUpload *)chunkedUploadWithRequest:(NSURLRequest *)request
+                                     fromFile:(NSURL *)fileURL
+                                    chunkSize:(unsigned long long)chunkSize
+                                  manifestURL:(NSURL *)manifestURL
+                                     protocol:(id <AFChunkedUploadProtocol>)protocol
+                                     progress:(void (^)(NSProgress *uploadProgress))uploadProgressBlock
+                            completionHandler:(void (^)(NSURLResponse *response, id responseObject, NSError *error))completionHandler
+{
+    NSParameterAssert(request);
+    NSParameterAssert([fileURL isFileURL]);
+    NSParameterAssert(chunkSize > 0);
+    NSParameterAssert([manifestURL isFileURL]);
+    NSParameterAssert(protocol);
+
+    AFChunkedUpload *chunkedUpload = [[AFChunkedUpload alloc] initWithSessionManager:self request:request fileURL:fileURL chunkSize:chunkSize manifestURL:manifestURL protocol:protocol];
+    chunkedUpload.uploadProgressBlock = uploadProgressBlock;
+    chunkedUpload.completionHandler = completionHandler;
+
+    return chunkedUpload;
+}
+
 #pragma mark -
 
 //根据指定的请求，创建一个下载任务
@@ -979,6 +2057,54 @@ static NSString * const AFNSURLSessionTaskDidSuspendNotification = @"com.alamofi
     return downloadTask;
 }
 
+//创建一个下载任务，下载的文件计算SHA-256摘要，校验通过后才移动到最终存储路径
+- (NSURLSessionDownloadTask *)downloadTaskWithRequest:(NSURLRequest *)request
+                                 expectedSHA256Digest:(NSData *)expectedSHA256Digest
+                                             progress:(void (^)(NSProgress *downloadProgress)) downloadProgressBlock
+                                          destination:(NSURL * (^)(NSURL *targetPath, NSURLResponse *response))destination
+                                    completionHandler:(void (^)(NSURLResponse *response, NSURL *filePath, NSData *SHA256Digest, NSError *error))completionHandler
+{
+    NSParameterAssert(!expectedSHA256Digest || [expectedSHA256Digest length] == CC_SHA256_DIGEST_LENGTH);
+
+    NSURLSessionDownloadTask *downloadTask = [self downloadTaskWithRequest:request progress:downloadProgressBlock destination:destination completionHandler:nil];
+
+    AFURLSessionManagerTaskDelegate *delegate = [self delegateForTask:downloadTask];
+    delegate.computesSHA256Digest = YES;
+    delegate.expectedSHA256Digest = expectedSHA256Digest;
+    if (completionHandler) {
+        //完成回调执行时代理还被完成回调的block持有，弱引用避免循环引用
+        __weak __typeof__(delegate) weakDelegate = delegate;
+        delegate.completionHandler = ^(NSURLResponse *response, id responseObject, NSError *error) {
+            completionHandler(response, responseObject, weakDelegate.SHA256Digest, error);
+        };
+    }
+
+    return downloadTask;
+}
+
+//创建一个下载任务，移动到最终存储路径的文件交给响应序列化对象，不把整个文件读进内存
+- (NSURLSessionDownloadTask *)downloadTaskWithRequest:(NSURLRequest *)request
+                                             progress:(void (^)(NSProgress *downloadProgress)) downloadProgressBlock
+                                          destination:(NSURL * (^)(NSURL *targetPath, NSURLResponse *response))destination
+                         serializingCompletionHandler:(void (^)(NSURLResponse *response, NSURL *filePath, id responseObject, NSError *error))completionHandler
+{
+    NSURLSessionDownloadTask *downloadTask = [self downloadTaskWithRequest:request progress:downloadProgressBlock destination:destination completionHandler:nil];
+
+    AFURLSessionManagerTaskDelegate *delegate = [self delegateForTask:downloadTask];
+    delegate.serializesDownloadedFile = YES;
+    if (completionHandler) {
+        //完成回调执行时代理还被完成回调的block持有，弱引用避免循环引用
+        __weak __typeof__(delegate) weakDelegate = delegate;
+        delegate.completionHandler = ^(NSURLResponse *response, id responseObject, NSError *error) {
+            __strong __typeof__(weakDelegate) strongDelegate = weakDelegate;
+            NSURL *filePath = strongDelegate.downloadFileMoveError ? nil : strongDelegate.downloadFileURL;
+            completionHandler(response, filePath, responseObject, error);
+        };
+    }
+
+    return downloadTask;
+}
+
 //根据断点数据，创建一个下载任务。用于断点续传
 - (NSURLSessionDownloadTask *)downloadTaskWithResumeData:(NSData *)resumeData
                                                 progress:(void (^)(NSProgress *downloadProgress)) downloadProgressBlock
@@ -1008,6 +2134,16 @@ static NSString * const AFNSURLSessionTaskDidSuspendNotification = @"com.alamofi
     return [[self delegateForTask:task] downloadProgress];
 }
 
+//获取数据任务解码前收到的字节数
+- (int64_t)countOfEncodedBytesReceivedForTask:(NSURLSessionTask *)task {
+    return [[self delegateForTask:task] countOfEncodedBytes];
+}
+
+//获取数据任务解码后的字节数
+- (int64_t)countOfDecodedBytesReceivedForTask:(NSURLSessionTask *)task {
+    return [[self delegateForTask:task] countOfDecodedBytes];
+}
+
 #pragma mark -
 
 //设置当管理会话失效的时候执行的回调函数.被NSURLSessionDelegate  didBecomeInvalidWithError处理
@@ -1059,6 +2195,11 @@ static NSString * const AFNSURLSessionTaskDidSuspendNotification = @"com.alamofi
     self.dataTaskDidReceiveResponse = block;
 }
 
+//设置数据任务收到响应时返回响应数据解码器的block
+- (void)setDataTaskResponseDecoderBlock:(id <AFURLResponseDecoding> (^)(NSURLSession *session, NSURLSessionDataTask *dataTask, NSURLResponse *response))block {
+    self.dataTaskResponseDecoder = block;
+}
+
 //设置一个当数据任务变成下载任务的时候执行的回调。可以被NSURLSessionDataDelegate URLSession:dataTask:didBecomeDownloadTask:处理
 - (void)setDataTaskDidBecomeDownloadTaskBlock:(void (^)(NSURLSession *session, NSURLSessionDataTask *dataTask, NSURLSessionDownloadTask *downloadTask))block {
     self.dataTaskDidBecomeDownloadTask = block;
@@ -1103,7 +2244,8 @@ static NSString * const AFNSURLSessionTaskDidSuspendNotification = @"com.alamofi
     if (selector == @selector(URLSession:task:willPerformHTTPRedirection:newRequest:completionHandler:)) {
         return self.taskWillPerformHTTPRedirection != nil;
     } else if (selector == @selector(URLSession:dataTask:didReceiveResponse:completionHandler:)) {
-        return self.dataTaskDidReceiveResponse != nil;
+        //解码器在收到响应时创建，只设置了解码器block也要响应这个方法
+        return self.dataTaskDidReceiveResponse != nil || self.dataTaskResponseDecoder != nil;
     } else if (selector == @selector(URLSession:dataTask:willCacheResponse:completionHandler:)) {
         return self.dataTaskWillCacheResponse != nil;
     } else if (selector == @selector(URLSessionDidFinishEventsForBackgroundURLSession:)) {
@@ -1217,12 +2359,19 @@ didReceiveChallenge:(NSURLAuthenticationChallenge *)challenge
  needNewBodyStream:(void (^)(NSInputStream *bodyStream))completionHandler
 {
     NSInputStream *inputStream = nil;
+    AFURLSessionManagerTaskDelegate *delegate = [self delegateForTask:task];
 
-    if (self.taskNeedNewBodyStream) {
+    if (delegate.bodyStream) {
+        //只能读取一次的body流，已经被读取过时无法重新发送，任务会失败
+        if (delegate.bodyStream.streamStatus == NSStreamStatusNotOpen) {
+            inputStream = delegate.bodyStream;
+        }
+        delegate.bodyStream = nil;
+    } else if (self.taskNeedNewBodyStream) {
         //获取会话任务的输入流
         inputStream = self.taskNeedNewBodyStream(session, task);
     } else if (task.originalRequest.HTTPBodyStream && [task.originalRequest.HTTPBodyStream conformsToProtocol:@protocol(NSCopying)]) {
-        //拷贝任务的输入流
+        //拷贝任务的输入流，multipart body流的拷贝复用编码好的分隔符和头信息，从头重新读取
         inputStream = [task.originalRequest.HTTPBodyStream copy];
     }
 
@@ -1257,6 +2406,8 @@ totalBytesExpectedToSend:(int64_t)totalBytesExpectedToSend
         //会话任务发送body数据时的block
         self.taskDidSendBodyData(session, task, bytesSent, totalBytesSent, totalUnitCount);
     }
+
+    [self limitBandwidthForTask:task transferredBytes:bytesSent direction:AFNetworkBandwidthDirectionUpload];
 }
 
 //发送指定任务的最后一个信息(任务完成)
@@ -1294,6 +2445,11 @@ didReceiveResponse:(NSURLResponse *)response
         disposition = self.dataTaskDidReceiveResponse(session, dataTask, response);
     }
 
+    //为这个响应创建解码器，响应数据边收边解码
+    if (disposition == NSURLSessionResponseAllow && self.dataTaskResponseDecoder) {
+        [self delegateForTask:dataTask].responseDecoder = self.dataTaskResponseDecoder(session, dataTask, response);
+    }
+
     if (completionHandler) {
         completionHandler(disposition);
     }
@@ -1327,6 +2483,8 @@ didBecomeDownloadTask:(NSURLSessionDownloadTask *)downloadTask
     if (self.dataTaskDidReceiveData) {
         self.dataTaskDidReceiveData(session, dataTask, data);
     }
+
+    [self limitBandwidthForTask:dataTask transferredBytes:(int64_t)[data length] direction:AFNetworkBandwidthDirectionDownload];
 }
 
 //数据任务将要缓存响应代理方法
@@ -1364,15 +2522,24 @@ didBecomeDownloadTask:(NSURLSessionDownloadTask *)downloadTask
 didFinishDownloadingToURL:(NSURL *)location
 {
     AFURLSessionManagerTaskDelegate *delegate = [self delegateForTask:downloadTask];
+    if (delegate.computesSHA256Digest) {
+        //需要计算摘要的下载先暂存，校验通过后再移动到最终存储路径
+        NSURL *fileURL = self.downloadTaskDidFinishDownloading ? self.downloadTaskDidFinishDownloading(session, downloadTask, location) : nil;
+        [delegate URLSession:session downloadTask:downloadTask didFinishDownloadingToURL:location destinationURL:fileURL];
+        return;
+    }
+
     if (self.downloadTaskDidFinishDownloading) {
         //获取下载文件的最终存储路径
         NSURL *fileURL = self.downloadTaskDidFinishDownloading(session, downloadTask, location);
         if (fileURL) {
             delegate.downloadFileURL = fileURL;
+            delegate.downloadFileMoveError = nil;
             NSError *error = nil;
             
             //将临时文件转存到最终存储路径
             if (![[NSFileManager defaultManager] moveItemAtURL:location toURL:fileURL error:&error]) {
+                delegate.downloadFileMoveError = error;
                 //转存文件失败，发送失败消息
                 [[NSNotificationCenter defaultCenter] postNotificationName:AFURLSessionDownloadTaskDidFailToMoveFileNotification object:downloadTask userInfo:error.userInfo];
             }
@@ -1403,6 +2570,8 @@ totalBytesExpectedToWrite:(int64_t)totalBytesExpectedToWrite
     if (self.downloadTaskDidWriteData) {
         self.downloadTaskDidWriteData(session, downloadTask, bytesWritten, totalBytesWritten, totalBytesExpectedToWrite);
     }
+
+    [self limitBandwidthForTask:downloadTask transferredBytes:bytesWritten direction:AFNetworkBandwidthDirectionDownload];
 }
 
 //下载任务 断点续传 代理方法
@@ -1455,3 +2624,1371 @@ expectedTotalBytes:(int64_t)expectedTotalBytes
 }
 
 @end
+
+#pragma mark -
+
+//令牌桶，令牌数量为负表示已经透支，需要等待补充
+@interface AFNetworkBandwidthBucket : NSObject
+//每秒补充的令牌数
+@property (nonatomic, assign) NSUInteger bytesPerSecond;
+//当前令牌数
+@property (nonatomic, assign) double tokens;
+//上次补充令牌的时间
+@property (nonatomic, assign) NSTimeInterval lastRefillTime;
+@end
+
+@implementation AFNetworkBandwidthBucket
+
+//消耗令牌，返回令牌补足前需要等待的时间
+- (NSTimeInterval)consumeBytes:(int64_t)numberOfBytes
+                        atTime:(NSTimeInterval)time
+{
+    //最多积累一秒的令牌，允许短时间的突发
+    self.tokens = MIN((double)self.bytesPerSecond, self.tokens + (time - self.lastRefillTime) * self.bytesPerSecond);
+    self.lastRefillTime = time;
+    self.tokens -= numberOfBytes;
+
+    return self.tokens < 0 ? -self.tokens / self.bytesPerSecond : 0;
+}
+
+@end
+
+#pragma mark -
+
+//令牌桶的key，networkServiceType为NSNotFound时表示该方向的总带宽
+static inline NSString * AFNetworkBandwidthTrafficClassKey(AFNetworkBandwidthDirection direction, NSUInteger networkServiceType) {
+    return [NSString stringWithFormat:@"%ld-%lu", (long)direction, (unsigned long)networkServiceType];
+}
+
+@interface AFNetworkBandwidthLimiter ()
+//令牌桶，以方向和networkServiceType为key
+@property (readwrite, nonatomic, strong) NSMutableDictionary *mutableBucketsKeyedByTrafficClass;
+//线程锁，限速器可以被多个manager共享
+@property (readwrite, nonatomic, strong) NSLock *lock;
+@end
+
+@implementation AFNetworkBandwidthLimiter
+
+- (instancetype)init {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.mutableBucketsKeyedByTrafficClass = [[NSMutableDictionary alloc] init];
+    self.lock = [[NSLock alloc] init];
+
+    return self;
+}
+
+- (void)setBytesPerSecond:(NSUInteger)bytesPerSecond
+             forDirection:(AFNetworkBandwidthDirection)direction
+{
+    [self setBytesPerSecond:bytesPerSecond forTrafficClass:AFNetworkBandwidthTrafficClassKey(direction, NSNotFound)];
+}
+
+- (void)setBytesPerSecond:(NSUInteger)bytesPerSecond
+             forDirection:(AFNetworkBandwidthDirection)direction
+       networkServiceType:(NSURLRequestNetworkServiceType)networkServiceType
+{
+    [self setBytesPerSecond:bytesPerSecond forTrafficClass:AFNetworkBandwidthTrafficClassKey(direction, networkServiceType)];
+}
+
+- (NSUInteger)bytesPerSecondForDirection:(AFNetworkBandwidthDirection)direction {
+    return [self bytesPerSecondForTrafficClass:AFNetworkBandwidthTrafficClassKey(direction, NSNotFound)];
+}
+
+- (NSUInteger)bytesPerSecondForDirection:(AFNetworkBandwidthDirection)direction
+                      networkServiceType:(NSURLRequestNetworkServiceType)networkServiceType
+{
+    return [self bytesPerSecondForTrafficClass:AFNetworkBandwidthTrafficClassKey(direction, networkServiceType)];
+}
+
+- (void)setBytesPerSecond:(NSUInteger)bytesPerSecond
+          forTrafficClass:(NSString *)trafficClass
+{
+    [self.lock lock];
+    if (bytesPerSecond == 0) {
+        [self.mutableBucketsKeyedByTrafficClass removeObjectForKey:trafficClass];
+    } else {
+        AFNetworkBandwidthBucket *bucket = self.mutableBucketsKeyedByTrafficClass[trafficClass];
+        if (!bucket) {
+            //新的令牌桶是满的
+            bucket = [[AFNetworkBandwidthBucket alloc] init];
+            bucket.tokens = bytesPerSecond;
+            bucket.lastRefillTime = [[NSProcessInfo processInfo] systemUptime];
+            self.mutableBucketsKeyedByTrafficClass[trafficClass] = bucket;
+        }
+        bucket.bytesPerSecond = bytesPerSecond;
+    }
+    [self.lock unlock];
+}
+
+- (NSUInteger)bytesPerSecondForTrafficClass:(NSString *)trafficClass {
+    [self.lock lock];
+    NSUInteger bytesPerSecond = [self.mutableBucketsKeyedByTrafficClass[trafficClass] bytesPerSecond];
+    [self.lock unlock];
+
+    return bytesPerSecond;
+}
+
+- (NSTimeInterval)consumeBytes:(int64_t)numberOfBytes
+                  forDirection:(AFNetworkBandwidthDirection)direction
+            networkServiceType:(NSURLRequestNetworkServiceType)networkServiceType
+{
+    NSTimeInterval time = [[NSProcessInfo processInfo] systemUptime];
+    NSTimeInterval delay = 0;
+
+    //同时消耗总带宽和该networkServiceType的令牌，等待时间取两者中较长的
+    [self.lock lock];
+    for (NSString *trafficClass in @[AFNetworkBandwidthTrafficClassKey(direction, NSNotFound), AFNetworkBandwidthTrafficClassKey(direction, networkServiceType)]) {
+        AFNetworkBandwidthBucket *bucket = self.mutableBucketsKeyedByTrafficClass[trafficClass];
+        if (bucket) {
+            delay = MAX(delay, [bucket consumeBytes:numberOfBytes atTime:time]);
+        }
+    }
+    [self.lock unlock];
+
+    return delay;
+}
+
+@end
+
+#pragma mark -
+
+//优先级通道数
+#define AFResponseSerializationNumberOfPriorities ((NSUInteger)AFResponseSerializationPriorityHigh + 1)
+
+//把优先级限制在通道范围内
+static inline NSUInteger AFResponseSerializationLaneIndex(AFResponseSerializationPriority priority) {
+    if (priority <= AFResponseSerializationPriorityBackground) {
+        return 0;
+    }
+
+    return MIN((NSUInteger)priority, AFResponseSerializationNumberOfPriorities - 1);
+}
+
+//在执行器的通道中等待的任务
+@interface AFResponseSerializationWorkItem : NSObject
+//要执行的block
+@property (nonatomic, copy) dispatch_block_t block;
+//加入通道的时间
+@property (nonatomic, assign) NSTimeInterval enqueueTime;
+@end
+
+@implementation AFResponseSerializationWorkItem
+@end
+
+@interface AFResponseSerializationExecutor () {
+    //每个通道开始执行的任务数、总等待时间和最长等待时间
+    NSUInteger _numberOfStartedItems[AFResponseSerializationNumberOfPriorities];
+    NSTimeInterval _totalWaitTime[AFResponseSerializationNumberOfPriorities];
+    NSTimeInterval _maximumWaitTime[AFResponseSerializationNumberOfPriorities];
+}
+@property (readwrite, nonatomic, assign) NSUInteger maximumConcurrentSerializations;
+//正在运行的工作线程数，只在加锁时访问
+@property (readwrite, nonatomic, assign) NSUInteger numberOfWorkers;
+//已经从通道取出、还没有执行完的任务数，只在加锁时访问
+@property (readwrite, nonatomic, assign) NSUInteger numberOfExecutingItems;
+//每个优先级一个先进先出的通道，按优先级从低到高排列
+@property (readwrite, nonatomic, strong) NSArray <NSMutableArray *> *lanes;
+//工作线程执行任务的并发队列
+@property (readwrite, nonatomic, strong) dispatch_queue_t workerQueue;
+//线程锁，执行器可以被多个manager共享
+@property (readwrite, nonatomic, strong) NSLock *lock;
+@end
+
+@implementation AFResponseSerializationExecutor
+
+- (instancetype)init {
+    return [self initWithMaximumConcurrentSerializations:[[NSProcessInfo processInfo] activeProcessorCount]];
+}
+
+- (instancetype)initWithMaximumConcurrentSerializations:(NSUInteger)maximumConcurrentSerializations {
+    NSParameterAssert(maximumConcurrentSerializations > 0);
+
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.maximumConcurrentSerializations = MAX(maximumConcurrentSerializations, (NSUInteger)1);
+    NSMutableArray *lanes = [NSMutableArray arrayWithCapacity:AFResponseSerializationNumberOfPriorities];
+    for (NSUInteger laneIndex = 0; laneIndex < AFResponseSerializationNumberOfPriorities; laneIndex++) {
+        [lanes addObject:[NSMutableArray array]];
+    }
+    self.lanes = lanes;
+    self.workerQueue = dispatch_queue_create("com.alamofire.networking.session.manager.serialization", DISPATCH_QUEUE_CONCURRENT);
+    self.lock = [[NSLock alloc] init];
+
+    return self;
+}
+
+- (void)addSerializationWithPriority:(AFResponseSerializationPriority)priority
+                               block:(dispatch_block_t)block
+{
+    NSParameterAssert(block);
+
+    AFResponseSerializationWorkItem *item = [[AFResponseSerializationWorkItem alloc] init];
+    item.block = block;
+    item.enqueueTime = [[NSProcessInfo processInfo] systemUptime];
+
+    //有空闲的工作线程时启动一个，否则等正在执行的工作线程来取
+    BOOL startsWorker = NO;
+    [self.lock lock];
+    [self.lanes[AFResponseSerializationLaneIndex(priority)] addObject:item];
+    if (self.numberOfWorkers < self.maximumConcurrentSerializations) {
+        self.numberOfWorkers++;
+        startsWorker = YES;
+    }
+    [self.lock unlock];
+
+    if (startsWorker) {
+        dispatch_async(self.workerQueue, ^{
+            [self runWorker];
+        });
+    }
+}
+
+//工作线程循环取出有任务的最高优先级通道中最早的任务执行，所有通道都空时退出
+- (void)runWorker {
+    while (YES) {
+        AFResponseSerializationWorkItem *item = nil;
+
+        [self.lock lock];
+        NSUInteger laneIndex = AFResponseSerializationNumberOfPriorities;
+        while (laneIndex > 0 && !item) {
+            laneIndex--;
+            NSMutableArray *lane = self.lanes[laneIndex];
+            if ([lane count] > 0) {
+                item = lane[0];
+                [lane removeObjectAtIndex:0];
+            }
+        }
+
+        if (!item) {
+            self.numberOfWorkers--;
+            [self.lock unlock];
+            return;
+        }
+
+        NSTimeInterval waitTime = [[NSProcessInfo processInfo] systemUptime] - item.enqueueTime;
+        _numberOfStartedItems[laneIndex]++;
+        _totalWaitTime[laneIndex] += waitTime;
+        _maximumWaitTime[laneIndex] = MAX(_maximumWaitTime[laneIndex], waitTime);
+        self.numberOfExecutingItems++;
+        [self.lock unlock];
+
+        @autoreleasepool {
+            item.block();
+        }
+
+        [self.lock lock];
+        self.numberOfExecutingItems--;
+        [self.lock unlock];
+    }
+}
+
+- (void)serializeResponse:(NSURLResponse *)response
+                     data:(NSData *)data
+   withResponseSerializer:(id <AFURLResponseSerialization>)responseSerializer
+                 priority:(AFResponseSerializationPriority)priority
+        completionHandler:(void (^)(id responseObject, NSError *error))completionHandler
+{
+    NSParameterAssert(responseSerializer);
+    NSParameterAssert(completionHandler);
+
+    [self addSerializationWithPriority:priority block:^{
+        NSError *serializationError = nil;
+        id responseObject = [responseSerializer responseObjectForResponse:response data:data error:&serializationError];
+        completionHandler(responseObject, serializationError);
+    }];
+}
+
+#pragma mark - Metrics
+
+//已经启动但还没有取出任务的工作线程不算在内，任务不会同时被算作等待和运行
+- (NSUInteger)numberOfRunningSerializations {
+    [self.lock lock];
+    NSUInteger numberOfRunningSerializations = self.numberOfExecutingItems;
+    [self.lock unlock];
+
+    return numberOfRunningSerializations;
+}
+
+- (NSUInteger)numberOfPendingSerializationsWithPriority:(AFResponseSerializationPriority)priority {
+    [self.lock lock];
+    NSUInteger numberOfPendingSerializations = [self.lanes[AFResponseSerializationLaneIndex(priority)] count];
+    [self.lock unlock];
+
+    return numberOfPendingSerializations;
+}
+
+- (NSTimeInterval)averageWaitTimeForPriority:(AFResponseSerializationPriority)priority {
+    NSUInteger laneIndex = AFResponseSerializationLaneIndex(priority);
+
+    [self.lock lock];
+    NSTimeInterval averageWaitTime = _numberOfStartedItems[laneIndex] > 0 ? _totalWaitTime[laneIndex] / _numberOfStartedItems[laneIndex] : 0;
+    [self.lock unlock];
+
+    return averageWaitTime;
+}
+
+- (NSTimeInterval)maximumWaitTimeForPriority:(AFResponseSerializationPriority)priority {
+    NSUInteger laneIndex = AFResponseSerializationLaneIndex(priority);
+
+    [self.lock lock];
+    NSTimeInterval maximumWaitTime = _maximumWaitTime[laneIndex];
+    [self.lock unlock];
+
+    return maximumWaitTime;
+}
+
+- (void)resetMetrics {
+    [self.lock lock];
+    for (NSUInteger laneIndex = 0; laneIndex < AFResponseSerializationNumberOfPriorities; laneIndex++) {
+        _numberOfStartedItems[laneIndex] = 0;
+        _totalWaitTime[laneIndex] = 0;
+        _maximumWaitTime[laneIndex] = 0;
+    }
+    [self.lock unlock];
+}
+
+@end
+
+#pragma mark -
+
+//分块上传中解析响应失败时的错误
+static NSError * AFChunkedUploadCannotParseResponseError(NSString *description) {
+    return [NSError errorWithDomain:AFURLResponseSerializationErrorDomain code:NSURLErrorCannotParseResponse userInfo:@{NSLocalizedDescriptionKey: description}];
+}
+
+//不区分大小写地获取响应头
+static NSString * AFChunkedUploadValueForHTTPHeaderField(NSHTTPURLResponse *response, NSString *field) {
+    for (NSString *key in response.allHeaderFields) {
+        if ([key caseInsensitiveCompare:field] == NSOrderedSame) {
+            return response.allHeaderFields[key];
+        }
+    }
+
+    return nil;
+}
+
+//在url后面添加查询字符串
+static NSURL * AFChunkedUploadURLByAppendingQuery(NSURL *URL, NSString *query) {
+    NSString *separator = [URL.query length] > 0 ? @"&" : @"?";
+    return [NSURL URLWithString:[[URL absoluteString] stringByAppendingFormat:@"%@%@", separator, query]];
+}
+
+@interface AFChunkedUploadChunk ()
+@property (readwrite, nonatomic, assign) NSUInteger index;
+@property (readwrite, nonatomic, assign) unsigned long long offset;
+@property (readwrite, nonatomic, assign) unsigned long long length;
+@property (readwrite, nonatomic, copy) NSData *SHA256Digest;
+@property (readwrite, nonatomic, copy) NSString *receipt;
+@end
+
+@implementation AFChunkedUploadChunk
+
++ (BOOL)supportsSecureCoding {
+    return YES;
+}
+
+- (instancetype)initWithCoder:(NSCoder *)decoder {
+    self = [self init];
+    if (!self) {
+        return nil;
+    }
+
+    self.index = (NSUInteger)[decoder decodeIntegerForKey:NSStringFromSelector(@selector(index))];
+    self.offset = (unsigned long long)[decoder decodeInt64ForKey:NSStringFromSelector(@selector(offset))];
+    self.length = (unsigned long long)[decoder decodeInt64ForKey:NSStringFromSelector(@selector(length))];
+    self.SHA256Digest = [decoder decodeObjectOfClass:[NSData class] forKey:NSStringFromSelector(@selector(SHA256Digest))];
+    self.receipt = [decoder decodeObjectOfClass:[NSString class] forKey:NSStringFromSelector(@selector(receipt))];
+
+    return self;
+}
+
+- (void)encodeWithCoder:(NSCoder *)coder {
+    [coder encodeInteger:(NSInteger)self.index forKey:NSStringFromSelector(@selector(index))];
+    [coder encodeInt64:(int64_t)self.offset forKey:NSStringFromSelector(@selector(offset))];
+    [coder encodeInt64:(int64_t)self.length forKey:NSStringFromSelector(@selector(length))];
+    [coder encodeObject:self.SHA256Digest forKey:NSStringFromSelector(@selector(SHA256Digest))];
+    [coder encodeObject:self.receipt forKey:NSStringFromSelector(@selector(receipt))];
+}
+
+@end
+
+#pragma mark -
+
+@interface AFChunkedUploadManifest ()
+@property (readwrite, nonatomic, copy) NSURLRequest *request;
+@property (readwrite, nonatomic, copy) NSURL *fileURL;
+@property (readwrite, nonatomic, assign) unsigned long long fileSize;
+@property (readwrite, nonatomic, copy) NSDate *fileModificationDate;
+@property (readwrite, nonatomic, assign) unsigned long long chunkSize;
+@property (readwrite, nonatomic, copy) NSString *uploadIdentifier;
+@property (readwrite, nonatomic, copy) NSArray <AFChunkedUploadChunk *> *chunks;
+@end
+
+@implementation AFChunkedUploadManifest
+
+//根据文件当前的大小和修改时间创建清单
+- (instancetype)initWithRequest:(NSURLRequest *)request
+                        fileURL:(NSURL *)fileURL
+                      chunkSize:(unsigned long long)chunkSize
+                          error:(NSError * __autoreleasing *)error
+{
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:[fileURL path] error:error];
+    if (!attributes) {
+        return nil;
+    }
+
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.request = request;
+    self.fileURL = fileURL;
+    self.fileSize = [attributes fileSize];
+    self.fileModificationDate = [attributes fileModificationDate];
+    self.chunkSize = chunkSize;
+
+    NSMutableArray *chunks = [NSMutableArray array];
+    for (unsigned long long offset = 0; offset < self.fileSize; offset += chunkSize) {
+        AFChunkedUploadChunk *chunk = [[AFChunkedUploadChunk alloc] init];
+        chunk.index = [chunks count];
+        chunk.offset = offset;
+        chunk.length = MIN(chunkSize, self.fileSize - offset);
+        [chunks addObject:chunk];
+    }
+    self.chunks = chunks;
+
+    return self;
+}
+
+//读取清单文件，文件不存在或者内容无效时返回nil
++ (instancetype)manifestWithContentsOfURL:(NSURL *)manifestURL {
+    NSData *data = [NSData dataWithContentsOfURL:manifestURL];
+    if (!data) {
+        return nil;
+    }
+
+    AFChunkedUploadManifest *manifest = nil;
+    NSKeyedUnarchiver *unarchiver = [[NSKeyedUnarchiver alloc] initForReadingWithData:data];
+    unarchiver.requiresSecureCoding = YES;
+    @try {
+        manifest = [unarchiver decodeObjectOfClass:self forKey:NSKeyedArchiveRootObjectKey];
+    } @catch (__unused NSException *exception) {
+        manifest = nil;
+    }
+    [unarchiver finishDecoding];
+
+    return manifest;
+}
+
+//清单是否属于同一个url和方法的请求、块大小和没有改变过的文件
+- (BOOL)matchesRequest:(NSURLRequest *)request
+               fileURL:(NSURL *)fileURL
+             chunkSize:(unsigned long long)chunkSize
+{
+    if (![self.request.URL isEqual:request.URL] || ![self.request.HTTPMethod isEqualToString:request.HTTPMethod] || ![[self.fileURL path] isEqualToString:[fileURL path]] || self.chunkSize != chunkSize) {
+        return NO;
+    }
+
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:[fileURL path] error:nil];
+
+    return attributes && [attributes fileSize] == self.fileSize && [[attributes fileModificationDate] isEqualToDate:self.fileModificationDate];
+}
+
+- (BOOL)writeToURL:(NSURL *)manifestURL
+             error:(NSError * __autoreleasing *)error
+{
+    return [[NSKeyedArchiver archivedDataWithRootObject:self] writeToURL:manifestURL options:NSDataWritingAtomic error:error];
+}
+
+#pragma mark - NSSecureCoding
+
++ (BOOL)supportsSecureCoding {
+    return YES;
+}
+
+- (instancetype)initWithCoder:(NSCoder *)decoder {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    //清单里只保存请求的url和方法，头信息使用继续上传时的请求
+    NSURL *URL = [decoder decodeObjectOfClass:[NSURL class] forKey:NSStringFromSelector(@selector(URL))];
+    NSString *HTTPMethod = [decoder decodeObjectOfClass:[NSString class] forKey:NSStringFromSelector(@selector(HTTPMethod))];
+    if (URL && HTTPMethod) {
+        NSMutableURLRequest *mutableRequest = [NSMutableURLRequest requestWithURL:URL];
+        mutableRequest.HTTPMethod = HTTPMethod;
+        self.request = mutableRequest;
+    }
+    self.fileURL = [decoder decodeObjectOfClass:[NSURL class] forKey:NSStringFromSelector(@selector(fileURL))];
+    self.fileSize = (unsigned long long)[decoder decodeInt64ForKey:NSStringFromSelector(@selector(fileSize))];
+    self.fileModificationDate = [decoder decodeObjectOfClass:[NSDate class] forKey:NSStringFromSelector(@selector(fileModificationDate))];
+    self.chunkSize = (unsigned long long)[decoder decodeInt64ForKey:NSStringFromSelector(@selector(chunkSize))];
+    self.uploadIdentifier = [decoder decodeObjectOfClass:[NSString class] forKey:NSStringFromSelector(@selector(uploadIdentifier))];
+    self.chunks = [decoder decodeObjectOfClasses:[NSSet setWithObjects:[NSArray class], [AFChunkedUploadChunk class], nil] forKey:NSStringFromSelector(@selector(chunks))];
+
+    if (!self.request || !self.fileURL || !self.chunks) {
+        return nil;
+    }
+
+    return self;
+}
+
+- (void)encodeWithCoder:(NSCoder *)coder {
+    //头信息里可能有授权信息，不写进清单文件
+    [coder encodeObject:self.request.URL forKey:NSStringFromSelector(@selector(URL))];
+    [coder encodeObject:self.request.HTTPMethod forKey:NSStringFromSelector(@selector(HTTPMethod))];
+    [coder encodeObject:self.fileURL forKey:NSStringFromSelector(@selector(fileURL))];
+    [coder encodeInt64:(int64_t)self.fileSize forKey:NSStringFromSelector(@selector(fileSize))];
+    [coder encodeObject:self.fileModificationDate forKey:NSStringFromSelector(@selector(fileModificationDate))];
+    [coder encodeInt64:(int64_t)self.chunkSize forKey:NSStringFromSelector(@selector(chunkSize))];
+    [coder encodeObject:self.uploadIdentifier forKey:NSStringFromSelector(@selector(uploadIdentifier))];
+    [coder encodeObject:self.chunks forKey:NSStringFromSelector(@selector(chunks))];
+}
+
+@end
+
+#pragma mark -
+
+@implementation AFTusChunkedUploadProtocol
+
+//每块作为一个部分上传创建，创建请求中直接带上块的内容
+- (NSURLRequest *)requestForUploadingChunk:(AFChunkedUploadChunk *)chunk
+                                ofManifest:(AFChunkedUploadManifest *)manifest
+{
+    NSMutableURLRequest *mutableRequest = [manifest.request mutableCopy];
+    mutableRequest.HTTPMethod = @"POST";
+    [mutableRequest setValue:@"1.0.0" forHTTPHeaderField:@"Tus-Resumable"];
+    [mutableRequest setValue:@"partial" forHTTPHeaderField:@"Upload-Concat"];
+    [mutableRequest setValue:[NSString stringWithFormat:@"%llu", chunk.length] forHTTPHeaderField:@"Upload-Length"];
+    [mutableRequest setValue:@"application/offset+octet-stream" forHTTPHeaderField:@"Content-Type"];
+    [mutableRequest setValue:[NSString stringWithFormat:@"sha256 %@", [chunk.SHA256Digest base64EncodedStringWithOptions:0]] forHTTPHeaderField:@"Upload-Checksum"];
+
+    return mutableRequest;
+}
+
+//部分上传的地址就是块的确认信息
+- (NSString *)receiptForChunk:(AFChunkedUploadChunk *)chunk
+                     response:(NSHTTPURLResponse *)response
+                         data:(NSData *)data
+                        error:(NSError * __autoreleasing *)error
+{
+    NSString *location = AFChunkedUploadValueForHTTPHeaderField(response, @"Location");
+    if (!location) {
+        if (error) {
+            *error = AFChunkedUploadCannotParseResponseError(NSLocalizedStringFromTable(@"The partial upload response has no Location header.", @"AFNetworking", nil));
+        }
+        return nil;
+    }
+
+    return [[NSURL URLWithString:location relativeToURL:response.URL] absoluteString];
+}
+
+//按顺序合并所有的部分上传
+- (NSURLRequest *)requestForCommittingManifest:(AFChunkedUploadManifest *)manifest {
+    NSMutableURLRequest *mutableRequest = [manifest.request mutableCopy];
+    mutableRequest.HTTPMethod = @"POST";
+    mutableRequest.HTTPBody = nil;
+    [mutableRequest setValue:@"1.0.0" forHTTPHeaderField:@"Tus-Resumable"];
+    [mutableRequest setValue:[@"final;" stringByAppendingString:[[manifest.chunks valueForKey:NSStringFromSelector(@selector(receipt))] componentsJoinedByString:@" "]] forHTTPHeaderField:@"Upload-Concat"];
+
+    return mutableRequest;
+}
+
+@end
+
+#pragma mark -
+
+//xml文本中需要转义的字符
+static NSString * AFS3ChunkedUploadEscapedXMLString(NSString *string) {
+    string = [string stringByReplacingOccurrencesOfString:@"&" withString:@"&amp;"];
+    string = [string stringByReplacingOccurrencesOfString:@"<" withString:@"&lt;"];
+
+    return [string stringByReplacingOccurrencesOfString:@">" withString:@"&gt;"];
+}
+
+@implementation AFS3ChunkedUploadProtocol
+
+//先创建上传，获取UploadId
+- (NSURLRequest *)requestForCreatingUploadOfManifest:(AFChunkedUploadManifest *)manifest {
+    NSMutableURLRequest *mutableRequest = [manifest.request mutableCopy];
+    mutableRequest.URL = AFChunkedUploadURLByAppendingQuery(manifest.request.URL, @"uploads");
+    mutableRequest.HTTPMethod = @"POST";
+    mutableRequest.HTTPBody = nil;
+    [mutableRequest setValue:@"SHA256" forHTTPHeaderField:@"x-amz-checksum-algorithm"];
+
+    return mutableRequest;
+}
+
+- (NSString *)uploadIdentifierForCreationResponse:(NSHTTPURLResponse *)response
+                                             data:(NSData *)data
+                                            error:(NSError * __autoreleasing *)error
+{
+    NSString *string = data ? [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] : nil;
+    NSRange startRange = [string rangeOfString:@"<UploadId>"];
+    NSRange endRange = [string rangeOfString:@"</UploadId>"];
+    if (startRange.location == NSNotFound || endRange.location == NSNotFound || endRange.location < NSMaxRange(startRange)) {
+        if (error) {
+            *error = AFChunkedUploadCannotParseResponseError(NSLocalizedStringFromTable(@"The multipart upload response has no UploadId.", @"AFNetworking", nil));
+        }
+        return nil;
+    }
+
+    return [string substringWithRange:NSMakeRange(NSMaxRange(startRange), endRange.location - NSMaxRange(startRange))];
+}
+
+//每块作为一个编号的part上传，编号从1开始
+- (NSURLRequest *)requestForUploadingChunk:(AFChunkedUploadChunk *)chunk
+                                ofManifest:(AFChunkedUploadManifest *)manifest
+{
+    NSMutableURLRequest *mutableRequest = [manifest.request mutableCopy];
+    mutableRequest.URL = AFChunkedUploadURLByAppendingQuery(manifest.request.URL, [NSString stringWithFormat:@"partNumber=%lu&uploadId=%@", (unsigned long)(chunk.index + 1), AFPercentEscapedStringFromString(manifest.uploadIdentifier)]);
+    mutableRequest.HTTPMethod = @"PUT";
+    [mutableRequest setValue:[chunk.SHA256Digest base64EncodedStringWithOptions:0] forHTTPHeaderField:@"x-amz-checksum-sha256"];
+
+    return mutableRequest;
+}
+
+//part的ETag就是块的确认信息
+- (NSString *)receiptForChunk:(AFChunkedUploadChunk *)chunk
+                     response:(NSHTTPURLResponse *)response
+                         data:(NSData *)data
+                        error:(NSError * __autoreleasing *)error
+{
+    NSString *entityTag = AFChunkedUploadValueForHTTPHeaderField(response, @"ETag");
+    if (!entityTag) {
+        if (error) {
+            *error = AFChunkedUploadCannotParseResponseError(NSLocalizedStringFromTable(@"The part upload response has no ETag header.", @"AFNetworking", nil));
+        }
+        return nil;
+    }
+
+    return entityTag;
+}
+
+//提交所有part的编号、ETag和摘要
+- (NSURLRequest *)requestForCommittingManifest:(AFChunkedUploadManifest *)manifest {
+    NSMutableString *body = [NSMutableString stringWithString:@"<CompleteMultipartUpload>"];
+    for (AFChunkedUploadChunk *chunk in manifest.chunks) {
+        [body appendFormat:@"<Part><PartNumber>%lu</PartNumber><ETag>%@</ETag><ChecksumSHA256>%@</ChecksumSHA256></Part>", (unsigned long)(chunk.index + 1), AFS3ChunkedUploadEscapedXMLString(chunk.receipt), [chunk.SHA256Digest base64EncodedStringWithOptions:0]];
+    }
+    [body appendString:@"</CompleteMultipartUpload>"];
+
+    NSMutableURLRequest *mutableRequest = [manifest.request mutableCopy];
+    mutableRequest.URL = AFChunkedUploadURLByAppendingQuery(manifest.request.URL, [@"uploadId=" stringByAppendingString:AFPercentEscapedStringFromString(manifest.uploadIdentifier)]);
+    mutableRequest.HTTPMethod = @"POST";
+    mutableRequest.HTTPBody = [body dataUsingEncoding:NSUTF8StringEncoding];
+    [mutableRequest setValue:@"application/xml" forHTTPHeaderField:@"Content-Type"];
+
+    return mutableRequest;
+}
+
+@end
+
+#pragma mark -
+
+@implementation AFDeduplicatedUpload
+
+- (BOOL)startWithTask:(NSURLSessionUploadTask * (^)(void))taskFactory {
+    //创建任务和取消在同一个锁中进行，避免取消后仍然创建任务
+    @synchronized (self) {
+        if (self.isCancelled) {
+            return NO;
+        }
+
+        self.task = taskFactory();
+        self.cancellationHandler = nil;
+    }
+
+    [self.task resume];
+
+    return YES;
+}
+
+- (void)cancel {
+    void (^cancellationHandler)(void) = nil;
+    NSURLSessionUploadTask *task = nil;
+    @synchronized (self) {
+        if (self.isCancelled) {
+            return;
+        }
+
+        self.cancelled = YES;
+        task = self.task;
+        if (!task) {
+            cancellationHandler = self.cancellationHandler;
+        }
+        self.cancellationHandler = nil;
+    }
+
+    //任务已创建时取消任务，由任务的完成回调报告取消
+    if (task) {
+        [task cancel];
+    } else if (cancellationHandler) {
+        cancellationHandler();
+    }
+}
+
+@end
+
+#pragma mark -
+
+//重试前的初始等待时间，每次重试加倍
+static NSTimeInterval const AFChunkedUploadInitialRetryDelay = 0.5;
+
+@interface AFChunkedUpload ()
+@property (readwrite, nonatomic, strong) AFChunkedUploadManifest *manifest;
+@property (readwrite, nonatomic, strong) NSProgress *progress;
+@property (readwrite, nonatomic, strong) AFURLSessionManager *sessionManager;
+@property (readwrite, nonatomic, strong) id <AFChunkedUploadProtocol> protocol;
+@property (readwrite, nonatomic, copy) NSURL *manifestURL;
+//无法创建清单时的错误
+@property (readwrite, nonatomic, strong) NSError *manifestError;
+//映射到内存的文件
+@property (readwrite, nonatomic, strong) NSData *fileData;
+//保护上传状态的串行队列
+@property (readwrite, nonatomic, strong) dispatch_queue_t queue;
+//块和创建、提交请求使用的响应序列化对象，只校验状态码
+@property (readwrite, nonatomic, strong) AFHTTPResponseSerializer *rawResponseSerializer;
+//正在运行的任务
+@property (readwrite, nonatomic, strong) NSMutableSet *runningTasks;
+//等待上传的块
+@property (readwrite, nonatomic, strong) NSMutableIndexSet *pendingChunkIndexes;
+//正在上传（包括等待重试）的块数
+@property (readwrite, nonatomic, assign) NSUInteger numberOfUploadingChunks;
+@property (readwrite, nonatomic, assign, getter = isResumed) BOOL resumed;
+@property (readwrite, nonatomic, assign, getter = isFinished) BOOL finished;
+@end
+
+@implementation AFChunkedUpload
+
+- (instancetype)initWithSessionManager:(AFURLSessionManager *)sessionManager
+                               request:(NSURLRequest *)request
+                               fileURL:(NSURL *)fileURL
+                             chunkSize:(unsigned long long)chunkSize
+                           manifestURL:(NSURL *)manifestURL
+                              protocol:(id <AFChunkedUploadProtocol>)protocol
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.sessionManager = sessionManager;
+    self.protocol = protocol;
+    self.manifestURL = manifestURL;
+    self.maximumNumberOfConcurrentChunks = 4;
+    self.maximumNumberOfRetries = 3;
+    self.queue = dispatch_queue_create("com.alamofire.networking.chunked-upload", DISPATCH_QUEUE_SERIAL);
+    self.rawResponseSerializer = [AFHTTPResponseSerializer serializer];
+    self.runningTasks = [NSMutableSet set];
+
+    //同一个请求、文件和块大小的清单可以继续使用，之后的请求都根据调用方当前的请求生成
+    AFChunkedUploadManifest *manifest = [AFChunkedUploadManifest manifestWithContentsOfURL:manifestURL];
+    if ([manifest matchesRequest:request fileURL:fileURL chunkSize:chunkSize]) {
+        manifest.request = request;
+    } else {
+        NSError *error = nil;
+        manifest = [[AFChunkedUploadManifest alloc] initWithRequest:request fileURL:fileURL chunkSize:chunkSize error:&error];
+        self.manifestError = error;
+    }
+    self.manifest = manifest;
+
+    self.progress = [NSProgress progressWithTotalUnitCount:(int64_t)manifest.fileSize];
+    self.progress.cancellable = YES;
+    __weak __typeof__(self) weakSelf = self;
+    self.progress.cancellationHandler = ^{
+        [weakSelf cancel];
+    };
+
+    self.pendingChunkIndexes = [NSMutableIndexSet indexSet];
+    for (AFChunkedUploadChunk *chunk in manifest.chunks) {
+        if (chunk.receipt) {
+            self.progress.completedUnitCount += (int64_t)chunk.length;
+        } else {
+            [self.pendingChunkIndexes addIndex:chunk.index];
+        }
+    }
+
+    return self;
+}
+
+- (void)resume {
+    dispatch_async(self.queue, ^{
+        if (self.isResumed || self.isFinished) {
+            return;
+        }
+        self.resumed = YES;
+
+        if (!self.manifest) {
+            [self finishWithResponse:nil responseObject:nil error:self.manifestError];
+            return;
+        }
+
+        NSError *error = nil;
+        self.fileData = [NSData dataWithContentsOfURL:self.manifest.fileURL options:NSDataReadingMappedIfSafe error:&error];
+        if (!self.fileData) {
+            [self finishWithResponse:nil responseObject:nil error:error];
+            return;
+        }
+
+        NSURLRequest *creationRequest = nil;
+        if (!self.manifest.uploadIdentifier && [self.protocol respondsToSelector:@selector(requestForCreatingUploadOfManifest:)]) {
+            creationRequest = [self.protocol requestForCreatingUploadOfManifest:self.manifest];
+        }
+
+        if (!creationRequest) {
+            [self uploadPendingChunks];
+            return;
+        }
+
+        [self sendRequest:creationRequest bodyData:nil responseSerializer:self.rawResponseSerializer attempt:0 completionHandler:^(NSURLResponse *response, id responseObject, NSError *error) {
+            if (error) {
+                [self finishWithResponse:response responseObject:nil error:error];
+                return;
+            }
+
+            //协议没有实现解析上传标识的方法时，不记录标识直接上传块
+            if (![self.protocol respondsToSelector:@selector(uploadIdentifierForCreationResponse:data:error:)]) {
+                [self uploadPendingChunks];
+                return;
+            }
+
+            NSString *uploadIdentifier = [self.protocol uploadIdentifierForCreationResponse:(NSHTTPURLResponse *)response data:responseObject error:&error];
+            if (!uploadIdentifier) {
+                [self finishWithResponse:response responseObject:nil error:error];
+                return;
+            }
+
+            self.manifest.uploadIdentifier = uploadIdentifier;
+            [self.manifest writeToURL:self.manifestURL error:nil];
+            [self uploadPendingChunks];
+        }];
+    });
+}
+
+- (void)cancel {
+    dispatch_async(self.queue, ^{
+        if (self.isFinished) {
+            return;
+        }
+
+        [self cancelRunningTasks];
+        [self finishWithResponse:nil responseObject:nil error:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+    });
+}
+
+#pragma mark -
+
+//在并发数允许的范围内开始上传等待的块，所有块都确认后提交
+- (void)uploadPendingChunks {
+    if (self.isFinished) {
+        return;
+    }
+
+    while ([self.pendingChunkIndexes count] > 0 && self.numberOfUploadingChunks < MAX(self.maximumNumberOfConcurrentChunks, (NSUInteger)1)) {
+        NSUInteger index = [self.pendingChunkIndexes firstIndex];
+        [self.pendingChunkIndexes removeIndex:index];
+        [self uploadChunk:self.manifest.chunks[index]];
+    }
+
+    if ([self.pendingChunkIndexes count] == 0 && self.numberOfUploadingChunks == 0) {
+        [self commit];
+    }
+}
+
+- (void)uploadChunk:(AFChunkedUploadChunk *)chunk {
+    NSRange range = NSMakeRange((NSUInteger)chunk.offset, (NSUInteger)chunk.length);
+
+    //块的内容地址在第一次上传前计算，之后保存在清单中。分段交给CC_SHA256_Update，超过4GB的块也不会被截断
+    if (!chunk.SHA256Digest) {
+        CC_SHA256_CTX context;
+        CC_SHA256_Init(&context);
+        const uint8_t *bytes = (const uint8_t *)[self.fileData bytes] + range.location;
+        for (NSUInteger offset = 0; offset < range.length; offset += AFDownloadDigestBlockLength) {
+            CC_SHA256_Update(&context, bytes + offset, (CC_LONG)MIN(AFDownloadDigestBlockLength, range.length - offset));
+        }
+
+        NSMutableData *digest = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+        CC_SHA256_Final([digest mutableBytes], &context);
+        chunk.SHA256Digest = digest;
+    }
+
+    NSURLRequest *request = [self.protocol requestForUploadingChunk:chunk ofManifest:self.manifest];
+    NSData *bodyData = [self.fileData subdataWithRange:range];
+
+    self.numberOfUploadingChunks++;
+    [self sendRequest:request bodyData:bodyData responseSerializer:self.rawResponseSerializer attempt:0 completionHandler:^(NSURLResponse *response, id responseObject, NSError *error) {
+        self.numberOfUploadingChunks--;
+
+        NSString *receipt = nil;
+        if (!error) {
+            receipt = [self.protocol receiptForChunk:chunk response:(NSHTTPURLResponse *)response data:responseObject error:&error];
+        }
+
+        if (!receipt) {
+            [self cancelRunningTasks];
+            [self finishWithResponse:response responseObject:nil error:error];
+            return;
+        }
+
+        //每块确认后立即持久化清单，中断后可以从这里继续
+        chunk.receipt = receipt;
+        [self.manifest writeToURL:self.manifestURL error:nil];
+
+        self.progress.completedUnitCount += (int64_t)chunk.length;
+        if (self.uploadProgressBlock) {
+            self.uploadProgressBlock(self.progress);
+        }
+
+        [self uploadPendingChunks];
+    }];
+}
+
+//所有块都确认后发送提交请求，提交成功后删除清单
+- (void)commit {
+    NSURLRequest *request = [self.protocol requestForCommittingManifest:self.manifest];
+    [self sendRequest:request bodyData:request.HTTPBody responseSerializer:nil attempt:0 completionHandler:^(NSURLResponse *response, id responseObject, NSError *error) {
+        if (!error) {
+            [[NSFileManager defaultManager] removeItemAtURL:self.manifestURL error:nil];
+        }
+
+        [self finishWithResponse:response responseObject:responseObject error:error];
+    }];
+}
+
+//发送请求，网络错误、服务器错误和限流时延迟重试，在串行队列中回调
+- (void)sendRequest:(NSURLRequest *)request
+           bodyData:(NSData *)bodyData
+ responseSerializer:(id <AFURLResponseSerialization>)responseSerializer
+            attempt:(NSUInteger)attempt
+  completionHandler:(void (^)(NSURLResponse *response, id responseObject, NSError *error))completionHandler
+{
+    if (self.isFinished) {
+        return;
+    }
+
+    __block NSURLSessionTask *task = nil;
+    void (^taskCompletionHandler)(NSURLResponse *, id, NSError *) = ^(NSURLResponse *response, id responseObject, NSError *error) {
+        dispatch_async(self.queue, ^{
+            [self.runningTasks removeObject:task];
+            if (self.isFinished) {
+                return;
+            }
+
+            if (error && attempt < self.maximumNumberOfRetries && [self shouldRetryRequestWithResponse:response error:error]) {
+                dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(AFChunkedUploadInitialRetryDelay * (1 << attempt) * NSEC_PER_SEC)), self.queue, ^{
+                    [self sendRequest:request bodyData:bodyData responseSerializer:responseSerializer attempt:attempt + 1 completionHandler:completionHandler];
+                });
+                return;
+            }
+
+            completionHandler(response, responseObject, error);
+        });
+    };
+
+    if (bodyData) {
+        task = [self.sessionManager uploadTaskWithRequest:request fromData:bodyData progress:nil completionHandler:taskCompletionHandler];
+    } else {
+        task = [self.sessionManager dataTaskWithRequest:request completionHandler:taskCompletionHandler];
+    }
+
+    if (responseSerializer) {
+        [self.sessionManager delegateForTask:task].responseSerializer = responseSerializer;
+    }
+
+    [self.runningTasks addObject:task];
+    [task resume];
+}
+
+//客户端错误不重试，请求超时和限流除外
+- (BOOL)shouldRetryRequestWithResponse:(NSURLResponse *)response
+                                 error:(NSError *)error
+{
+    if ([error.domain isEqualToString:NSURLErrorDomain] && error.code == NSURLErrorCancelled) {
+        return NO;
+    }
+
+    if (![response isKindOfClass:[NSHTTPURLResponse class]]) {
+        return YES;
+    }
+
+    NSInteger statusCode = [(NSHTTPURLResponse *)response statusCode];
+
+    return statusCode < 400 || statusCode >= 500 || statusCode == 408 || statusCode == 429;
+}
+
+- (void)cancelRunningTasks {
+    for (NSURLSessionTask *task in self.runningTasks) {
+        [task cancel];
+    }
+    [self.runningTasks removeAllObjects];
+}
+
+//结束上传，在回调队列中调用完成回调
+- (void)finishWithResponse:(NSURLResponse *)response
+            responseObject:(id)responseObject
+                     error:(NSError *)error
+{
+    if (self.isFinished) {
+        return;
+    }
+    self.finished = YES;
+    self.fileData = nil;
+
+    void (^completionHandler)(NSURLResponse *, id, NSError *) = self.completionHandler;
+    if (completionHandler) {
+        dispatch_async(self.sessionManager.completionQueue ?: dispatch_get_main_queue(), ^{
+            completionHandler(response, responseObject, error);
+        });
+    }
+}
+
+@end
+
+#pragma mark -
+
+//生产者默认的缓存容量
+static NSUInteger const kAFUploadStreamProducerDefaultCapacity = 256 * 1024;
+
+/**
+ 生产者写入的缓存。使用绑定的流对，上传任务从输入流读取，生产者写入输出流，缓存为空时输入流的读取阻塞直到有数据或者结束
+ */
+@interface AFUploadProducerBuffer : NSObject
+//缓存容量
+@property (readonly, nonatomic, assign) NSUInteger capacity;
+//上传任务读取的输入流
+@property (readonly, nonatomic, strong) NSInputStream *inputStream;
+//生产者写入的输出流
+@property (readonly, nonatomic, strong) NSOutputStream *outputStream;
+//派发输出流事件的私有队列
+@property (readonly, nonatomic, strong) dispatch_queue_t streamQueue;
+//保护写入状态，阻塞的写入在上面等待输出流的可写事件
+@property (readwrite, nonatomic, strong) NSCondition *condition;
+//已经写入输出流的字节数
+@property (readwrite, nonatomic, assign) unsigned long long numberOfBytesWritten;
+//生产者是否已经标记结束
+@property (readwrite, nonatomic, assign, getter = isFinished) BOOL finished;
+//关闭的错误，不为nil时写入失败
+@property (readwrite, nonatomic, strong) NSError *closeError;
+//输出流是否已经关闭
+@property (readwrite, nonatomic, assign, getter = isOutputStreamClosed) BOOL outputStreamClosed;
+//是否有写入因为缓存满没有全部完成
+@property (readwrite, nonatomic, assign) BOOL waitingForSpace;
+//缓存有空间时执行的回调和队列
+@property (readwrite, nonatomic, copy) void (^spaceAvailableBlock)(void);
+@property (readwrite, nonatomic, strong) dispatch_queue_t spaceAvailableQueue;
+//读取输入流的上传任务，生产者被关闭时取消
+@property (readwrite, nonatomic, weak) NSURLSessionTask *task;
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+//写入数据，deadline为nil时不阻塞，只写入缓存能容纳的部分。生产者已经结束、关闭或者等待超时时返回-1
+- (NSInteger)writeBytes:(const uint8_t *)bytes
+              maxLength:(NSUInteger)length
+       waitingUntilDate:(NSDate *)deadline
+                  error:(NSError * __autoreleasing *)error;
+- (void)finishWriting;
+- (void)closeWithError:(NSError *)error;
+//关闭输出流并移除事件回调，之后输入流读完缓存后结束
+- (void)closeOutputStream;
+- (void)handleOutputStreamEvent:(CFStreamEventType)event;
+@end
+
+//输出流事件回调的上下文持有缓存
+static void * AFUploadProducerBufferRetain(void *info) {
+    CFRetain(info);
+    return info;
+}
+
+static void AFUploadProducerBufferRelease(void *info) {
+    CFRelease(info);
+}
+
+//输出流的事件回调，在私有队列上调用
+static void AFUploadProducerBufferOutputStreamCallback(__unused CFWriteStreamRef stream, CFStreamEventType event, void *info) {
+    [(__bridge AFUploadProducerBuffer *)info handleOutputStreamEvent:event];
+}
+
+@interface AFUploadProducerBuffer ()
+@property (readwrite, nonatomic, assign) NSUInteger capacity;
+@property (readwrite, nonatomic, strong) NSInputStream *inputStream;
+@property (readwrite, nonatomic, strong) NSOutputStream *outputStream;
+@property (readwrite, nonatomic, strong) dispatch_queue_t streamQueue;
+@end
+
+@implementation AFUploadProducerBuffer
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.capacity = capacity;
+    self.condition = [[NSCondition alloc] init];
+    self.streamQueue = dispatch_queue_create("com.alamofire.networking.upload-producer", DISPATCH_QUEUE_SERIAL);
+
+    CFReadStreamRef readStream = NULL;
+    CFWriteStreamRef writeStream = NULL;
+    CFStreamCreateBoundPair(kCFAllocatorDefault, &readStream, &writeStream, (CFIndex)capacity);
+    self.inputStream = (__bridge_transfer NSInputStream *)readStream;
+    self.outputStream = (__bridge_transfer NSOutputStream *)writeStream;
+
+    //输出流的事件在私有队列上派发，不依赖写入方的runloop。回调持有缓存，关闭输出流时移除
+    CFStreamClientContext context = {0, (__bridge void *)self, AFUploadProducerBufferRetain, AFUploadProducerBufferRelease, NULL};
+    CFWriteStreamSetClient(writeStream, kCFStreamEventCanAcceptBytes | kCFStreamEventErrorOccurred | kCFStreamEventEndEncountered, AFUploadProducerBufferOutputStreamCallback, &context);
+    CFWriteStreamSetDispatchQueue(writeStream, self.streamQueue);
+    [self.outputStream open];
+
+    return self;
+}
+
+- (NSInteger)writeBytes:(const uint8_t *)bytes
+              maxLength:(NSUInteger)length
+       waitingUntilDate:(NSDate *)deadline
+                  error:(NSError * __autoreleasing *)error
+{
+    NSUInteger totalNumberOfBytesWritten = 0;
+
+    [self.condition lock];
+    while (totalNumberOfBytesWritten < length) {
+        if (self.closeError || self.isFinished) {
+            if (error) {
+                *error = self.closeError ?: [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+            }
+            [self.condition unlock];
+            return -1;
+        }
+
+        //缓存满时写入输出流会阻塞，只在有空间时写入，否则等待输出流的可写事件
+        if (![self.outputStream hasSpaceAvailable]) {
+            if (!deadline) {
+                self.waitingForSpace = YES;
+                break;
+            }
+            if (![self.condition waitUntilDate:deadline]) {
+                if (error) {
+                    *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:nil];
+                }
+                [self.condition unlock];
+                return -1;
+            }
+            continue;
+        }
+
+        NSInteger numberOfBytesWritten = [self.outputStream write:bytes + totalNumberOfBytesWritten maxLength:length - totalNumberOfBytesWritten];
+        if (numberOfBytesWritten < 0) {
+            if (error) {
+                *error = self.outputStream.streamError ?: [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+            }
+            [self.condition unlock];
+            return -1;
+        }
+        totalNumberOfBytesWritten += (NSUInteger)numberOfBytesWritten;
+        self.numberOfBytesWritten += (unsigned long long)numberOfBytesWritten;
+    }
+    [self.condition unlock];
+
+    return (NSInteger)totalNumberOfBytesWritten;
+}
+
+//关闭输出流后，输入流读完缓存中的数据后结束
+- (void)finishWriting {
+    [self.condition lock];
+    BOOL finishes = !self.isFinished && !self.closeError;
+    self.finished = YES;
+    [self.condition broadcast];
+    [self.condition unlock];
+
+    if (finishes) {
+        [self closeOutputStream];
+    }
+}
+
+//关闭表示上传被放弃。输出流保持打开，避免上传任务把已经写入的部分当作完整的body发送，由取消任务结束上传
+- (void)closeWithError:(NSError *)error {
+    [self.condition lock];
+    if (!self.closeError) {
+        self.closeError = error ?: [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+    }
+    [self.condition broadcast];
+    //异步写入的一方需要知道已经不能继续写入
+    BOOL notifiesSpaceAvailable = self.waitingForSpace;
+    self.waitingForSpace = NO;
+    NSURLSessionTask *task = self.task;
+    [self.condition unlock];
+
+    [task cancel];
+
+    if (notifiesSpaceAvailable) {
+        [self notifySpaceAvailable];
+    }
+}
+
+- (void)closeOutputStream {
+    [self.condition lock];
+    BOOL closes = !self.isOutputStreamClosed;
+    self.outputStreamClosed = YES;
+    [self.condition unlock];
+
+    if (closes) {
+        CFWriteStreamRef writeStream = (__bridge CFWriteStreamRef)self.outputStream;
+        CFWriteStreamSetClient(writeStream, kCFStreamEventNone, NULL, NULL);
+        CFWriteStreamSetDispatchQueue(writeStream, NULL);
+        [self.outputStream close];
+    }
+}
+
+- (void)handleOutputStreamEvent:(CFStreamEventType)event {
+    if (event != kCFStreamEventCanAcceptBytes) {
+        //上传任务提前关闭了输入流，写入的数据不会再被读取
+        [self closeWithError:self.outputStream.streamError];
+        return;
+    }
+
+    [self.condition lock];
+    [self.condition broadcast];
+    BOOL notifiesSpaceAvailable = self.waitingForSpace;
+    self.waitingForSpace = NO;
+    [self.condition unlock];
+
+    if (notifiesSpaceAvailable) {
+        [self notifySpaceAvailable];
+    }
+}
+
+- (void)notifySpaceAvailable {
+    [self.condition lock];
+    void (^spaceAvailableBlock)(void) = self.spaceAvailableBlock;
+    dispatch_queue_t spaceAvailableQueue = self.spaceAvailableQueue;
+    [self.condition unlock];
+
+    if (spaceAvailableBlock) {
+        dispatch_async(spaceAvailableQueue ?: dispatch_get_main_queue(), spaceAvailableBlock);
+    }
+}
+
+@end
+
+#pragma mark -
+
+@interface AFUploadStreamProducer ()
+//写入的缓存，写入状态都保存在缓存中
+@property (readwrite, nonatomic, strong) AFUploadProducerBuffer *buffer;
+@end
+
+@implementation AFUploadStreamProducer
+
+- (instancetype)init {
+    return [self initWithCapacity:kAFUploadStreamProducerDefaultCapacity];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    NSParameterAssert(capacity > 0);
+
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.buffer = [[AFUploadProducerBuffer alloc] initWithCapacity:MAX(capacity, (NSUInteger)1)];
+
+    return self;
+}
+
+//输出流的事件回调持有缓存，生产者释放时关闭输出流
+- (void)dealloc {
+    [_buffer closeOutputStream];
+}
+
+- (NSUInteger)capacity {
+    return self.buffer.capacity;
+}
+
+- (unsigned long long)numberOfBytesWritten {
+    [self.buffer.condition lock];
+    unsigned long long numberOfBytesWritten = self.buffer.numberOfBytesWritten;
+    [self.buffer.condition unlock];
+
+    return numberOfBytesWritten;
+}
+
+- (NSInputStream *)inputStream {
+    return self.buffer.inputStream;
+}
+
+- (NSInteger)writeBytes:(const uint8_t *)bytes
+              maxLength:(NSUInteger)length
+{
+    return [self.buffer writeBytes:bytes maxLength:length waitingUntilDate:nil error:nil];
+}
+
+- (BOOL)writeData:(NSData *)data
+          timeout:(NSTimeInterval)timeout
+            error:(NSError * __autoreleasing *)error
+{
+    NSDate *deadline = timeout < 0 ? [NSDate distantFuture] : [NSDate dateWithTimeIntervalSinceNow:timeout];
+    return [self.buffer writeBytes:[data bytes] maxLength:[data length] waitingUntilDate:deadline error:error] >= 0;
+}
+
+- (void)setSpaceAvailableHandler:(void (^)(AFUploadStreamProducer *producer))block
+                           queue:(dispatch_queue_t)queue
+{
+    //缓存被生产者持有，回调中弱引用生产者避免循环引用
+    __weak __typeof__(self) weakSelf = self;
+    [self.buffer.condition lock];
+    self.buffer.spaceAvailableBlock = block ? ^{
+        __strong __typeof__(weakSelf) strongSelf = weakSelf;
+        if (strongSelf) {
+            block(strongSelf);
+        }
+    } : nil;
+    self.buffer.spaceAvailableQueue = queue;
+    [self.buffer.condition unlock];
+}
+
+- (void)finishWriting {
+    [self.buffer finishWriting];
+}
+
+- (void)closeWithError:(NSError *)error {
+    [self.buffer closeWithError:error];
+}
+
+- (void)attachToTask:(NSURLSessionTask *)task {
+    [self.buffer.condition lock];
+    self.buffer.task = task;
+    BOOL closed = self.buffer.closeError != nil;
+    [self.buffer.condition unlock];
+
+    //已经关闭的生产者不会再写入，任务开始前取消
+    if (closed) {
+        [task cancel];
+    }
+}
+
+- (NSError *)closeWithTaskError:(NSError *)error {
+    [self.buffer.condition lock];
+    NSError *closeError = self.buffer.closeError;
+    [self.buffer.condition unlock];
+
+    [self.buffer closeWithError:error];
+    [self.buffer closeOutputStream];
+
+    //任务因为生产者被关闭而取消时，以关闭的错误结束
+    if (closeError && [error.domain isEqualToString:NSURLErrorDomain] && error.code == NSURLErrorCancelled) {
+        return closeError;
+    }
+
+    return error;
+}
+
+@end
@@ -0,0 +1,310 @@
+// AFCBORSerializationTests.m
+// Copyright (c) 2011–2016 Alamofire Software Foundation ( http://alamofire.org/ )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "AFTestCase.h"
+
+#import "AFURLRequestSerialization.h"
+#import "AFURLResponseSerialization.h"
+
+static NSData * AFCBORTestData() {
+    const uint8_t bytes[] = {0xa1, 0x63, 'f', 'o', 'o', 0x63, 'b', 'a', 'r'};
+    return [NSData dataWithBytes:bytes length:sizeof(bytes)];
+}
+
+#pragma mark -
+
+@interface AFCBORRequestSerializationTests : AFTestCase
+@property (nonatomic, strong) AFCBORRequestSerializer *requestSerializer;
+@end
+
+@implementation AFCBORRequestSerializationTests
+
+- (void)setUp {
+    [super setUp];
+    self.requestSerializer = [AFCBORRequestSerializer serializer];
+}
+
+#pragma mark -
+
+- (void)testThatCBORRequestSerializationHandlesParametersDictionary {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+
+    NSError *error = nil;
+    NSURLRequest *serializedRequest = [self.requestSerializer requestBySerializingRequest:request withParameters:@{@"a": @1} error:&error];
+
+    const uint8_t expectedBytes[] = {0xa1, 0x61, 'a', 0x01};
+    XCTAssertNil(error);
+    XCTAssertEqualObjects([serializedRequest valueForHTTPHeaderField:@"Content-Type"], @"application/cbor");
+    XCTAssertEqualObjects(serializedRequest.HTTPBody, [NSData dataWithBytes:expectedBytes length:sizeof(expectedBytes)]);
+}
+
+- (void)testThatCBORRequestSerializationHandlesParametersArray {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+
+    NSError *error = nil;
+    NSURLRequest *serializedRequest = [self.requestSerializer requestBySerializingRequest:request withParameters:@[@-1, @300, @YES, [NSNull null]] error:&error];
+
+    const uint8_t expectedBytes[] = {0x84, 0x20, 0x19, 0x01, 0x2c, 0xf5, 0xf6};
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(serializedRequest.HTTPBody, [NSData dataWithBytes:expectedBytes length:sizeof(expectedBytes)]);
+}
+
+- (void)testThatCBORRequestSerializationEncodesDecimalNumbersAsStrings {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+
+    NSError *error = nil;
+    NSURLRequest *serializedRequest = [self.requestSerializer requestBySerializingRequest:request withParameters:@[[NSDecimalNumber decimalNumberWithString:@"0.10"]] error:&error];
+
+    const uint8_t expectedBytes[] = {0x81, 0x63, '0', '.', '1'};
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(serializedRequest.HTTPBody, [NSData dataWithBytes:expectedBytes length:sizeof(expectedBytes)]);
+}
+
+- (void)testThatCBORRequestSerializationErrorsWithInvalidParameters {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+
+    NSError *error = nil;
+    NSURLRequest *serializedRequest = [self.requestSerializer requestBySerializingRequest:request withParameters:@{@"set": [NSSet setWithObject:@1]} error:&error];
+
+    XCTAssertNil(serializedRequest);
+    XCTAssertEqualObjects(error.domain, AFURLRequestSerializationErrorDomain);
+    XCTAssertEqual(error.code, NSURLErrorCannotDecodeContentData);
+}
+
+- (void)testThatCBORRequestSerializationEncodesParametersInURIForGET {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"GET";
+
+    NSURLRequest *serializedRequest = [self.requestSerializer requestBySerializingRequest:request withParameters:@{@"key": @"value"} error:nil];
+
+    XCTAssertEqualObjects(serializedRequest.URL.query, @"key=value");
+    XCTAssertNil(serializedRequest.HTTPBody);
+}
+
+#pragma mark -
+
+- (void)testPerformanceOfWideDocumentSerialization {
+    [self measureRequestSerializationOfParameters:AFJSONWideDocument()];
+}
+
+- (void)testPerformanceOfDeepDocumentSerialization {
+    [self measureRequestSerializationOfParameters:AFJSONDeepDocument()];
+}
+
+- (void)testPerformanceOfStringHeavyDocumentSerialization {
+    [self measureRequestSerializationOfParameters:AFJSONStringHeavyDocument()];
+}
+
+#pragma mark - Helper Methods
+
+- (void)measureRequestSerializationOfParameters:(id)parameters {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+    [self measureBlock:^{
+        for (NSUInteger idx = 0; idx < 10; idx++) {
+            [self.requestSerializer requestBySerializingRequest:request withParameters:parameters error:nil];
+        }
+    }];
+}
+
+@end
+
+#pragma mark -
+
+@interface AFCBORResponseSerializationTests : AFTestCase
+@property (nonatomic, strong) AFCBORRequestSerializer *requestSerializer;
+@property (nonatomic, strong) AFCBORResponseSerializer *responseSerializer;
+@end
+
+@implementation AFCBORResponseSerializationTests
+
+- (void)setUp {
+    [super setUp];
+    self.requestSerializer = [AFCBORRequestSerializer serializer];
+    self.responseSerializer = [AFCBORResponseSerializer serializer];
+}
+
+#pragma mark -
+
+- (void)testThatCBORResponseSerializerAcceptsCBORMimeType {
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": @"application/cbor"}];
+
+    NSError *error = nil;
+    [self.responseSerializer validateResponse:response data:AFCBORTestData() error:&error];
+
+    XCTAssertNil(error, @"Error handling application/cbor");
+}
+
+- (void)testThatCBORResponseSerializerDoesNotAcceptJSONMimeType {
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": @"application/json"}];
+
+    NSError *error = nil;
+    [self.responseSerializer validateResponse:response data:AFCBORTestData() error:&error];
+
+    XCTAssertNotNil(error);
+}
+
+- (void)testThatCBORResponseSerializerReturnsDictionaryForValidData {
+    NSHTTPURLResponse *response = [self responseWithContentType:@"application/cbor"];
+
+    NSError *error = nil;
+    id responseObject = [self.responseSerializer responseObjectForResponse:response data:AFCBORTestData() error:&error];
+
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(responseObject, @{@"foo": @"bar"});
+}
+
+- (void)testThatCBORResponseSerializerReturnsErrorForTruncatedData {
+    NSData *data = [AFCBORTestData() subdataWithRange:NSMakeRange(0, 6)];
+
+    NSError *error = nil;
+    id responseObject = [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/cbor"] data:data error:&error];
+
+    XCTAssertNil(responseObject);
+    XCTAssertEqualObjects(error.domain, AFURLResponseSerializationErrorDomain);
+    XCTAssertEqual(error.code, NSURLErrorCannotParseResponse);
+}
+
+- (void)testThatCBORResponseSerializerReturnsErrorForTrailingData {
+    NSMutableData *data = [AFCBORTestData() mutableCopy];
+    [data appendBytes:"\xf6" length:1];
+
+    NSError *error = nil;
+    id responseObject = [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/cbor"] data:data error:&error];
+
+    XCTAssertNil(responseObject);
+    XCTAssertEqual(error.code, NSURLErrorCannotParseResponse);
+}
+
+- (void)testThatCBORResponseSerializerReturnsNilObjectAndNilErrorForEmptyData {
+    NSError *error = nil;
+    id responseObject = [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/cbor"] data:[NSData data] error:&error];
+
+    XCTAssertNil(responseObject);
+    XCTAssertNil(error);
+}
+
+- (void)testThatCBORRoundTripsDocuments {
+    for (id document in @[AFJSONWideDocument(), AFJSONDeepDocument(), AFJSONStringHeavyDocument()]) {
+        XCTAssertEqualObjects([self objectByRoundTrippingObject:document], document);
+    }
+}
+
+- (void)testThatCBORRoundTripsDates {
+    NSDate *date = [NSDate dateWithTimeIntervalSince1970:1500000000.25];
+    NSDate *wholeSecondDate = [NSDate dateWithTimeIntervalSince1970:1500000000];
+
+    XCTAssertEqualObjects([self objectByRoundTrippingObject:@[date, wholeSecondDate]], (@[date, wholeSecondDate]));
+}
+
+- (void)testThatCBORDecodesBinaryWithoutCopying {
+    const uint8_t bytes[] = {0x43, 0x01, 0x02, 0x03};
+    NSData *data = [NSData dataWithBytes:bytes length:sizeof(bytes)];
+
+    NSData *responseObject = [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/cbor"] data:data error:nil];
+
+    const uint8_t expectedBytes[] = {0x01, 0x02, 0x03};
+    XCTAssertEqualObjects(responseObject, [NSData dataWithBytes:expectedBytes length:sizeof(expectedBytes)]);
+    XCTAssertEqual((const uint8_t *)[responseObject bytes], (const uint8_t *)[data bytes] + 1);
+}
+
+- (void)testThatCBORDecodesLargeUnsignedIntegers {
+    const uint8_t bytes[] = {0x1b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+    NSNumber *responseObject = [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/cbor"] data:[NSData dataWithBytes:bytes length:sizeof(bytes)] error:nil];
+
+    XCTAssertEqual([responseObject unsignedLongLongValue], UINT64_MAX);
+}
+
+- (void)testThatCBORDecodesIndefiniteLengthArraysMapsAndStrings {
+    const uint8_t bytes[] = {0xbf, 0x7f, 0x62, 'f', 'o', 0x61, 'o', 0xff, 0x9f, 0x01, 0x5f, 0x41, 0x01, 0x41, 0x02, 0xff, 0xff, 0xff};
+
+    NSError *error = nil;
+    id responseObject = [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/cbor"] data:[NSData dataWithBytes:bytes length:sizeof(bytes)] error:&error];
+
+    const uint8_t expectedBytes[] = {0x01, 0x02};
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(responseObject, (@{@"foo": @[@1, [NSData dataWithBytes:expectedBytes length:sizeof(expectedBytes)]]}));
+}
+
+- (void)testThatCBORDecodesHalfPrecisionFloats {
+    const uint8_t bytes[] = {0x83, 0xf9, 0x3c, 0x00, 0xf9, 0xc4, 0x00, 0xf9, 0x7c, 0x00};
+
+    NSArray *responseObject = [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/cbor"] data:[NSData dataWithBytes:bytes length:sizeof(bytes)] error:nil];
+
+    XCTAssertEqualObjects(responseObject, (@[@1.0, @-4.0, @(INFINITY)]));
+}
+
+- (void)testThatCBORReturnsErrorForUnterminatedIndefiniteLengthArray {
+    const uint8_t bytes[] = {0x9f, 0x01, 0x02};
+
+    NSError *error = nil;
+    id responseObject = [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/cbor"] data:[NSData dataWithBytes:bytes length:sizeof(bytes)] error:&error];
+
+    XCTAssertNil(responseObject);
+    XCTAssertEqual(error.code, NSURLErrorCannotParseResponse);
+}
+
+#pragma mark -
+
+- (void)testPerformanceOfWideDocumentDeserialization {
+    [self measureResponseSerializationOfObject:AFJSONWideDocument()];
+}
+
+- (void)testPerformanceOfDeepDocumentDeserialization {
+    [self measureResponseSerializationOfObject:AFJSONDeepDocument()];
+}
+
+- (void)testPerformanceOfStringHeavyDocumentDeserialization {
+    [self measureResponseSerializationOfObject:AFJSONStringHeavyDocument()];
+}
+
+#pragma mark - Helper Methods
+
+- (NSHTTPURLResponse *)responseWithContentType:(NSString *)contentType {
+    return [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": contentType}];
+}
+
+- (id)objectByRoundTrippingObject:(id)object {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+    NSData *data = [self.requestSerializer requestBySerializingRequest:request withParameters:object error:nil].HTTPBody;
+
+    return [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/cbor"] data:data error:nil];
+}
+
+- (void)measureResponseSerializationOfObject:(id)object {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+    NSData *data = [self.requestSerializer requestBySerializingRequest:request withParameters:object error:nil].HTTPBody;
+    NSHTTPURLResponse *response = [self responseWithContentType:@"application/cbor"];
+    [self measureBlock:^{
+        for (NSUInteger idx = 0; idx < 10; idx++) {
+            [self.responseSerializer responseObjectForResponse:response data:data error:nil];
+        }
+    }];
+}
+
+@end
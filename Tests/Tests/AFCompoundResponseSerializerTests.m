@@ -23,6 +23,26 @@
 #import "AFTestCase.h"
 #import "AFURLResponseSerialization.h"
 
+@interface AFCountingResponseSerializer : AFHTTPResponseSerializer
+@property (nonatomic, assign) NSUInteger numberOfResponsesSerialized;
+@end
+
+@implementation AFCountingResponseSerializer
+
+- (id)responseObjectForResponse:(NSURLResponse *)response
+                           data:(NSData *)data
+                          error:(NSError *__autoreleasing *)error
+{
+    self.numberOfResponsesSerialized++;
+    if (![self validateResponse:(NSHTTPURLResponse *)response data:data error:error]) {
+        return nil;
+    }
+
+    return self;
+}
+
+@end
+
 @interface AFCompoundResponseSerializerTests : AFTestCase
 
 @end
@@ -60,6 +80,65 @@
     XCTAssertNil(error);
 }
 
+- (void)testCompoundSerializerHandsResponseToMatchingSerializerOnly {
+    AFCountingResponseSerializer *jsonSerializer = [AFCountingResponseSerializer serializer];
+    jsonSerializer.acceptableContentTypes = [NSSet setWithObject:@"application/json"];
+    AFCountingResponseSerializer *imageSerializer = [AFCountingResponseSerializer serializer];
+    imageSerializer.acceptableContentTypes = [NSSet setWithObject:@"image/*"];
+    AFCompoundResponseSerializer *compoundSerializer = [AFCompoundResponseSerializer compoundSerializerWithResponseSerializers:@[jsonSerializer, imageSerializer]];
+
+    NSURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"image/png"}];
+    id responseObject = [compoundSerializer responseObjectForResponse:response data:[NSData dataWithBytes:"png" length:3] error:nil];
+
+    XCTAssertEqual(responseObject, imageSerializer);
+    XCTAssertEqual(jsonSerializer.numberOfResponsesSerialized, 0);
+    XCTAssertEqual(imageSerializer.numberOfResponsesSerialized, 1);
+}
+
+- (void)testCompoundSerializerHandsJSONSuffixTypesToJSONSerializer {
+    AFImageResponseSerializer *imageSerializer = [AFImageResponseSerializer serializer];
+    AFJSONResponseSerializer *jsonSerializer = [AFJSONResponseSerializer serializer];
+    AFCompoundResponseSerializer *compoundSerializer = [AFCompoundResponseSerializer compoundSerializerWithResponseSerializers:@[imageSerializer, jsonSerializer]];
+
+    NSData *data = [NSJSONSerialization dataWithJSONObject:@{@"title":@"Not Found"} options:(NSJSONWritingOptions)0 error:nil];
+    NSURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/problem+json"}];
+
+    NSError *error = nil;
+    id responseObject = [compoundSerializer responseObjectForResponse:response data:data error:&error];
+
+    XCTAssertEqualObjects(responseObject, @{@"title":@"Not Found"});
+    XCTAssertNil(error);
+}
+
+- (void)testCompoundSerializerTriesEachSerializerForUnknownTypes {
+    AFCountingResponseSerializer *jsonSerializer = [AFCountingResponseSerializer serializer];
+    jsonSerializer.acceptableContentTypes = [NSSet setWithObject:@"application/json"];
+    AFCountingResponseSerializer *imageSerializer = [AFCountingResponseSerializer serializer];
+    imageSerializer.acceptableContentTypes = [NSSet setWithObject:@"image/*"];
+    AFCompoundResponseSerializer *compoundSerializer = [AFCompoundResponseSerializer compoundSerializerWithResponseSerializers:@[jsonSerializer, imageSerializer]];
+
+    NSData *data = [@"text" dataUsingEncoding:NSUTF8StringEncoding];
+    NSURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"text/plain"}];
+    id responseObject = [compoundSerializer responseObjectForResponse:response data:data error:nil];
+
+    XCTAssertEqualObjects(responseObject, data);
+    XCTAssertEqual(jsonSerializer.numberOfResponsesSerialized, 1);
+    XCTAssertEqual(imageSerializer.numberOfResponsesSerialized, 1);
+}
+
+- (void)testCompoundSerializerPrefersEarlierSerializerAcceptingAnyType {
+    AFCountingResponseSerializer *anySerializer = [AFCountingResponseSerializer serializer];
+    AFCountingResponseSerializer *jsonSerializer = [AFCountingResponseSerializer serializer];
+    jsonSerializer.acceptableContentTypes = [NSSet setWithObject:@"application/json"];
+    AFCompoundResponseSerializer *compoundSerializer = [AFCompoundResponseSerializer compoundSerializerWithResponseSerializers:@[anySerializer, jsonSerializer]];
+
+    NSURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+    id responseObject = [compoundSerializer responseObjectForResponse:response data:[NSData dataWithBytes:"{}" length:2] error:nil];
+
+    XCTAssertEqual(responseObject, anySerializer);
+    XCTAssertEqual(jsonSerializer.numberOfResponsesSerialized, 0);
+}
+
 - (void)testCompoundSerializerCanBeCopied {
     AFImageResponseSerializer *imageSerializer = [AFImageResponseSerializer serializer];
     AFJSONResponseSerializer *jsonSerializer = [AFJSONResponseSerializer serializer];
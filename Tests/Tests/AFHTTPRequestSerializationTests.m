@@ -19,9 +19,13 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#import <fcntl.h>
+#import <unistd.h>
+
 #import "AFTestCase.h"
 
 #import "AFURLRequestSerialization.h"
+#import "AFURLSessionManager.h"
 
 @interface AFMultipartBodyStream : NSInputStream <NSStreamDelegate>
 @property (readwrite, nonatomic, strong) NSMutableArray *HTTPBodyParts;
@@ -50,6 +54,106 @@
         maxLength:(NSUInteger)length;
 @end
 
+static NSData * AFDataByReadingStream(NSInputStream *inputStream, NSUInteger bufferLength) {
+    NSMutableData *data = [NSMutableData data];
+    uint8_t *buffer = malloc(bufferLength);
+    [inputStream open];
+    NSInteger numberOfBytesRead = 0;
+    while ((numberOfBytesRead = [inputStream read:buffer maxLength:bufferLength]) > 0) {
+        [data appendBytes:buffer length:(NSUInteger)numberOfBytesRead];
+    }
+    [inputStream close];
+    free(buffer);
+
+    return data;
+}
+
+static NSUInteger AFNumberOfOpenFileDescriptors() {
+    NSUInteger numberOfOpenFileDescriptors = 0;
+    for (int fileDescriptor = 0; fileDescriptor < getdtablesize(); fileDescriptor++) {
+        if (fcntl(fileDescriptor, F_GETFD) != -1) {
+            numberOfOpenFileDescriptors++;
+        }
+    }
+
+    return numberOfOpenFileDescriptors;
+}
+
+static NSArray <NSURL *> * AFCreateTemporaryFiles(NSUInteger numberOfFiles, NSUInteger fileLength) {
+    NSURL *directoryURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]] isDirectory:YES];
+    [[NSFileManager defaultManager] createDirectoryAtURL:directoryURL withIntermediateDirectories:YES attributes:nil error:nil];
+
+    NSMutableArray *fileURLs = [NSMutableArray array];
+    NSData *data = [NSMutableData dataWithLength:fileLength];
+    for (NSUInteger idx = 0; idx < numberOfFiles; idx++) {
+        NSURL *fileURL = [directoryURL URLByAppendingPathComponent:[NSString stringWithFormat:@"%lu.bin", (unsigned long)idx]];
+        [data writeToURL:fileURL atomically:NO];
+        [fileURLs addObject:fileURL];
+    }
+
+    return fileURLs;
+}
+
+//第一次读取前等待信号的输入流，用于在写入过程中取消
+@interface AFBlockingInputStream : NSInputStream
+@property (nonatomic, strong) NSData *data;
+@property (nonatomic, strong) dispatch_semaphore_t semaphore;
+@property (nonatomic, assign) NSUInteger offset;
+@property (nonatomic, assign) NSStreamStatus status;
+@end
+
+@implementation AFBlockingInputStream
+
+- (instancetype)initWithData:(NSData *)data {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.data = data;
+    self.semaphore = dispatch_semaphore_create(0);
+
+    return self;
+}
+
+- (void)open {
+    self.status = NSStreamStatusOpen;
+}
+
+- (void)close {
+    self.status = NSStreamStatusClosed;
+}
+
+- (NSStreamStatus)streamStatus {
+    return self.status;
+}
+
+- (BOOL)hasBytesAvailable {
+    return self.offset < [self.data length];
+}
+
+- (NSInteger)read:(uint8_t *)buffer
+        maxLength:(NSUInteger)length
+{
+    if (self.offset == 0) {
+        dispatch_semaphore_wait(self.semaphore, DISPATCH_TIME_FOREVER);
+    }
+
+    NSUInteger numberOfBytesRead = MIN(length, [self.data length] - self.offset);
+    [self.data getBytes:buffer range:NSMakeRange(self.offset, numberOfBytesRead)];
+    self.offset += numberOfBytesRead;
+
+    return (NSInteger)numberOfBytesRead;
+}
+
+- (BOOL)getBuffer:(__unused uint8_t **)buffer
+           length:(__unused NSUInteger *)len
+{
+    return NO;
+}
+
+@end
+
 #pragma mark -
 
 @interface AFHTTPRequestSerializationTests : AFTestCase
@@ -150,6 +254,322 @@
     XCTAssertTrue([part.headers[@"Content-Type"] isEqualToString:@"application/x-x509-ca-cert"], @"MIME Type has not been obtained correctly (%@)", part.headers[@"Content-Type"]);
 }
 
+- (void)testThatMultipartBodyStreamIsReadWhileMainThreadIsBlocked {
+    NSURL *fileURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]]];
+    [[NSMutableData dataWithLength:1024 * 1024] writeToURL:fileURL atomically:YES];
+
+    NSMutableURLRequest *request = [self.requestSerializer multipartFormRequestWithMethod:@"POST" URLString:@"http://example.com" parameters:@{@"key": @"value"} constructingBodyWithBlock:^(id<AFMultipartFormData> formData) {
+        for (NSUInteger idx = 0; idx < 16; idx++) {
+            [formData appendPartWithFileURL:fileURL name:[NSString stringWithFormat:@"file%lu", (unsigned long)idx] fileName:@"file.bin" mimeType:@"application/octet-stream" error:NULL];
+        }
+    } error:nil];
+    unsigned long long expectedLength = [[request valueForHTTPHeaderField:@"Content-Length"] longLongValue];
+
+    //在后台线程读取整个body，主线程一直阻塞在信号量上，不会处理主队列中的任何任务
+    NSInputStream *bodyStream = request.HTTPBodyStream;
+    __block unsigned long long totalNumberOfBytesRead = 0;
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        uint8_t buffer[32 * 1024];
+        [bodyStream open];
+        NSInteger numberOfBytesRead = 0;
+        while ((numberOfBytesRead = [bodyStream read:buffer maxLength:sizeof(buffer)]) > 0) {
+            totalNumberOfBytesRead += (unsigned long long)numberOfBytesRead;
+        }
+        [bodyStream close];
+        dispatch_semaphore_signal(semaphore);
+    });
+
+    long result = dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(10 * NSEC_PER_SEC)));
+    [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+
+    XCTAssertEqual(result, 0, @"Reading the body stream should not depend on the main thread");
+    XCTAssertEqual(totalNumberOfBytesRead, expectedLength);
+}
+
+- (void)testThatMultipartBodyStreamProducesTheSameBytesForAnyReadLength {
+    NSURL *fileURL = [NSURL fileURLWithPath:[[NSBundle bundleForClass:[self class]] pathForResource:@"ADNNetServerTrustChain/adn_0" ofType:@"cer"]];
+    NSMutableURLRequest *request = [self.requestSerializer multipartFormRequestWithMethod:@"POST" URLString:@"http://example.com" parameters:@{@"key": @"value"} constructingBodyWithBlock:^(id<AFMultipartFormData> formData) {
+        [formData appendPartWithFormData:[@"first" dataUsingEncoding:NSUTF8StringEncoding] name:@"first"];
+        [formData appendPartWithFileURL:fileURL name:@"file" error:NULL];
+        [formData appendPartWithFormData:[NSData data] name:@"empty"];
+        [formData appendPartWithFormData:[@"last" dataUsingEncoding:NSUTF8StringEncoding] name:@"last"];
+    } error:nil];
+
+    NSData *body = AFDataByReadingStream([request.HTTPBodyStream copy], 64 * 1024);
+    XCTAssertEqual([body length], (NSUInteger)[[request valueForHTTPHeaderField:@"Content-Length"] integerValue]);
+    XCTAssertEqualObjects(AFDataByReadingStream([request.HTTPBodyStream copy], 1), body);
+    XCTAssertEqualObjects(AFDataByReadingStream([request.HTTPBodyStream copy], 7), body);
+}
+
+- (void)testThatMultipartBodyStreamCapsReadsAtPacketSizeWithoutDelay {
+    NSMutableURLRequest *request = [self.requestSerializer multipartFormRequestWithMethod:@"POST" URLString:@"http://example.com" parameters:nil constructingBodyWithBlock:^(id<AFMultipartFormData> formData) {
+        [formData appendPartWithFormData:[NSMutableData dataWithLength:1024] name:@"data"];
+        [formData throttleBandwidthWithPacketSize:16 delay:0];
+    } error:nil];
+
+    NSInputStream *inputStream = request.HTTPBodyStream;
+    uint8_t buffer[256];
+    [inputStream open];
+    NSInteger numberOfBytesRead = 0;
+    while ((numberOfBytesRead = [inputStream read:buffer maxLength:sizeof(buffer)]) > 0) {
+        XCTAssertLessThanOrEqual(numberOfBytesRead, 16);
+    }
+    [inputStream close];
+}
+
+- (void)testPerformanceOfReadingMultipartBodyWithManySmallParts {
+    NSData *data = [NSMutableData dataWithLength:100];
+    NSMutableURLRequest *request = [self.requestSerializer multipartFormRequestWithMethod:@"POST" URLString:@"http://example.com" parameters:nil constructingBodyWithBlock:^(id<AFMultipartFormData> formData) {
+        for (NSUInteger idx = 0; idx < 2000; idx++) {
+            [formData appendPartWithFormData:data name:[NSString stringWithFormat:@"part%lu", (unsigned long)idx]];
+        }
+    } error:nil];
+
+    [self measureBlock:^{
+        AFDataByReadingStream([request.HTTPBodyStream copy], 32 * 1024);
+    }];
+}
+
+- (void)testThatFilePartsAreNotKeptOpenWhileStreaming {
+    NSArray *fileURLs = AFCreateTemporaryFiles(300, 1024);
+    NSMutableURLRequest *request = [self.requestSerializer multipartFormRequestWithMethod:@"POST" URLString:@"http://example.com" parameters:nil constructingBodyWithBlock:^(id<AFMultipartFormData> formData) {
+        for (NSURL *fileURL in fileURLs) {
+            [formData appendPartWithFileURL:fileURL name:@"files[]" error:NULL];
+        }
+    } error:nil];
+
+    NSUInteger numberOfOpenFileDescriptors = AFNumberOfOpenFileDescriptors();
+    NSInputStream *bodyStream = request.HTTPBodyStream;
+    uint8_t buffer[4096];
+    unsigned long long totalNumberOfBytesRead = 0;
+    NSUInteger maximumNumberOfOpenFileDescriptors = 0;
+    [bodyStream open];
+    NSInteger numberOfBytesRead = 0;
+    while ((numberOfBytesRead = [bodyStream read:buffer maxLength:sizeof(buffer)]) > 0) {
+        totalNumberOfBytesRead += (unsigned long long)numberOfBytesRead;
+        maximumNumberOfOpenFileDescriptors = MAX(maximumNumberOfOpenFileDescriptors, AFNumberOfOpenFileDescriptors());
+    }
+    [bodyStream close];
+    [[NSFileManager defaultManager] removeItemAtURL:[[fileURLs firstObject] URLByDeletingLastPathComponent] error:nil];
+
+    XCTAssertEqual(totalNumberOfBytesRead, (unsigned long long)[[request valueForHTTPHeaderField:@"Content-Length"] longLongValue]);
+    XCTAssertLessThanOrEqual(maximumNumberOfOpenFileDescriptors, numberOfOpenFileDescriptors + 2);
+}
+
+- (void)testPerformanceOfUploadingOneThousandFilesToLoopbackServer {
+    NSArray *fileURLs = AFCreateTemporaryFiles(1000, 16 * 1024);
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(NSURLRequest *request, NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        return [[NSString stringWithFormat:@"%lu", (unsigned long)[request.HTTPBody length]] dataUsingEncoding:NSUTF8StringEncoding];
+    }];
+    AFURLSessionManager *manager = [[AFURLSessionManager alloc] initWithSessionConfiguration:[NSURLSessionConfiguration ephemeralSessionConfiguration]];
+    manager.responseSerializer = [AFHTTPResponseSerializer serializer];
+
+    [self measureBlock:^{
+        NSMutableURLRequest *request = [self.requestSerializer multipartFormRequestWithMethod:@"POST" URLString:[server.baseURL absoluteString] parameters:nil constructingBodyWithBlock:^(id<AFMultipartFormData> formData) {
+            for (NSURL *fileURL in fileURLs) {
+                [formData appendPartWithFileURL:fileURL name:@"files[]" error:NULL];
+            }
+        } error:nil];
+
+        XCTestExpectation *expectation = [self expectationWithDescription:@"Upload should complete"];
+        [[manager uploadTaskWithStreamedRequest:request progress:nil completionHandler:^(NSURLResponse * _Nonnull response, id  _Nullable responseObject, NSError * _Nullable error) {
+            XCTAssertNil(error);
+            XCTAssertEqualObjects([[NSString alloc] initWithData:responseObject encoding:NSUTF8StringEncoding], [request valueForHTTPHeaderField:@"Content-Length"]);
+            [expectation fulfill];
+        }] resume];
+        [self waitForExpectationsWithCommonTimeout];
+    }];
+
+    [manager invalidateSessionCancelingTasks:YES];
+    [server stop];
+    [[NSFileManager defaultManager] removeItemAtURL:[[fileURLs firstObject] URLByDeletingLastPathComponent] error:nil];
+}
+
+- (void)testThatMultipartBodyIsSpooledToFile {
+    NSArray *fileURLs = AFCreateTemporaryFiles(600, 4 * 1024);
+    NSMutableURLRequest *request = [self.requestSerializer multipartFormRequestWithMethod:@"POST" URLString:@"http://example.com" parameters:@{@"key": @"value"} constructingBodyWithBlock:^(id<AFMultipartFormData> formData) {
+        [formData appendPartWithFormData:[@"first" dataUsingEncoding:NSUTF8StringEncoding] name:@"first"];
+        for (NSURL *fileURL in fileURLs) {
+            [formData appendPartWithFileURL:fileURL name:@"files[]" error:NULL];
+        }
+        [formData appendPartWithFormData:[NSData data] name:@"empty"];
+    } error:nil];
+    NSData *body = AFDataByReadingStream([request.HTTPBodyStream copy], 64 * 1024);
+    NSURL *spoolURL = [[[fileURLs firstObject] URLByDeletingLastPathComponent] URLByAppendingPathComponent:@"body"];
+
+    __block int64_t completedUnitCount = 0;
+    __block int64_t totalUnitCount = 0;
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Spooling should complete"];
+    NSMutableURLRequest *spooledRequest = [self.requestSerializer requestWithMultipartFormRequest:request writingStreamContentsToFile:spoolURL progress:^(NSProgress *writingProgress) {
+        XCTAssertTrue([NSThread isMainThread]);
+        completedUnitCount = writingProgress.completedUnitCount;
+        totalUnitCount = writingProgress.totalUnitCount;
+    } completionHandler:^(NSError *error) {
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+
+    XCTAssertNil(spooledRequest.HTTPBodyStream);
+    XCTAssertEqualObjects([NSData dataWithContentsOfURL:spoolURL], body);
+    XCTAssertEqual(totalUnitCount, (int64_t)[body length]);
+    XCTAssertEqual(completedUnitCount, totalUnitCount);
+    [[NSFileManager defaultManager] removeItemAtURL:[spoolURL URLByDeletingLastPathComponent] error:nil];
+}
+
+- (void)testThatCancellingSpoolingRemovesPartialFile {
+    AFBlockingInputStream *inputStream = [[AFBlockingInputStream alloc] initWithData:[NSMutableData dataWithLength:1024 * 1024]];
+    NSMutableURLRequest *request = [self.requestSerializer multipartFormRequestWithMethod:@"POST" URLString:@"http://example.com" parameters:@{@"key": @"value"} constructingBodyWithBlock:^(id<AFMultipartFormData> formData) {
+        [formData appendPartWithInputStream:inputStream name:@"stream" fileName:@"stream.bin" length:1024 * 1024 mimeType:@"application/octet-stream"];
+    } error:nil];
+    NSURL *spoolURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]]];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Spooling should be cancelled"];
+    [self.requestSerializer requestWithMultipartFormRequest:request writingStreamContentsToFile:spoolURL progress:^(NSProgress *writingProgress) {
+        [writingProgress cancel];
+        dispatch_semaphore_signal(inputStream.semaphore);
+    } completionHandler:^(NSError *error) {
+        XCTAssertEqualObjects(error.domain, NSURLErrorDomain);
+        XCTAssertEqual(error.code, NSURLErrorCancelled);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[spoolURL path]]);
+}
+
+- (void)testPerformanceOfSpoolingLargeMultipartBodyToFile {
+    NSArray *fileURLs = AFCreateTemporaryFiles(16, 4 * 1024 * 1024);
+    NSMutableURLRequest *request = [self.requestSerializer multipartFormRequestWithMethod:@"POST" URLString:@"http://example.com" parameters:nil constructingBodyWithBlock:^(id<AFMultipartFormData> formData) {
+        for (NSURL *fileURL in fileURLs) {
+            [formData appendPartWithFileURL:fileURL name:@"files[]" error:NULL];
+        }
+    } error:nil];
+    NSURL *spoolURL = [[[fileURLs firstObject] URLByDeletingLastPathComponent] URLByAppendingPathComponent:@"body"];
+
+    [self measureBlock:^{
+        XCTestExpectation *expectation = [self expectationWithDescription:@"Spooling should complete"];
+        NSMutableURLRequest *copiedRequest = [request mutableCopy];
+        copiedRequest.HTTPBodyStream = [request.HTTPBodyStream copy];
+        [self.requestSerializer requestWithMultipartFormRequest:copiedRequest writingStreamContentsToFile:spoolURL completionHandler:^(NSError *error) {
+            XCTAssertNil(error);
+            [expectation fulfill];
+        }];
+        [self waitForExpectationsWithCommonTimeout];
+    }];
+
+    [[NSFileManager defaultManager] removeItemAtURL:[spoolURL URLByDeletingLastPathComponent] error:nil];
+}
+
+- (void)testThatCopiedMultipartBodyStreamReplaysTheSameBytes {
+    NSArray *fileURLs = AFCreateTemporaryFiles(1, 64 * 1024);
+    NSMutableURLRequest *request = [self.requestSerializer multipartFormRequestWithMethod:@"POST" URLString:@"http://example.com" parameters:@{@"key": @"value"} constructingBodyWithBlock:^(id<AFMultipartFormData> formData) {
+        [formData appendPartWithFileURL:[fileURLs firstObject] name:@"file" error:NULL];
+    } error:nil];
+
+    NSInputStream *bodyStream = [request.HTTPBodyStream copy];
+    NSData *body = AFDataByReadingStream(bodyStream, 32 * 1024);
+    XCTAssertEqualObjects(AFDataByReadingStream([bodyStream copy], 7), body);
+    XCTAssertEqualObjects(AFDataByReadingStream([[bodyStream copy] copy], 32 * 1024), body);
+
+    [[NSFileManager defaultManager] removeItemAtURL:[[fileURLs firstObject] URLByDeletingLastPathComponent] error:nil];
+}
+
+- (void)testThatResumedMultipartRequestContinuesFromOffset {
+    NSArray *fileURLs = AFCreateTemporaryFiles(1, 64 * 1024);
+    NSMutableData *fileData = [NSMutableData dataWithLength:64 * 1024];
+    for (NSUInteger idx = 0; idx < [fileData length]; idx++) {
+        ((uint8_t *)[fileData mutableBytes])[idx] = (uint8_t)(idx % 251);
+    }
+    [fileData writeToURL:[fileURLs firstObject] atomically:NO];
+
+    NSMutableURLRequest *request = [self.requestSerializer multipartFormRequestWithMethod:@"POST" URLString:@"http://example.com" parameters:@{@"key": @"value"} constructingBodyWithBlock:^(id<AFMultipartFormData> formData) {
+        [formData appendPartWithFileURL:[fileURLs firstObject] name:@"file" error:NULL];
+        [formData appendPartWithFormData:[@"last" dataUsingEncoding:NSUTF8StringEncoding] name:@"last"];
+    } error:nil];
+
+    NSData *body = AFDataByReadingStream([request.HTTPBodyStream copy], 32 * 1024);
+    NSUInteger length = [body length];
+    NSArray *offsets = @[@0, @1, @10, @100, @200, @(length / 2), @(length - 100), @(length - 1), @(length)];
+    for (NSNumber *offset in offsets) {
+        NSUInteger location = [offset unsignedIntegerValue];
+        NSMutableURLRequest *resumedRequest = [self.requestSerializer requestWithMultipartFormRequest:request resumingFromOffset:location];
+        NSData *expectedBody = [body subdataWithRange:NSMakeRange(location, length - location)];
+
+        XCTAssertEqualObjects(AFDataByReadingStream(resumedRequest.HTTPBodyStream, 7), expectedBody, @"Resuming from %lu", (unsigned long)location);
+        XCTAssertEqualObjects(AFDataByReadingStream([resumedRequest.HTTPBodyStream copy], 32 * 1024), expectedBody, @"Resuming from %lu", (unsigned long)location);
+        XCTAssertEqual((NSUInteger)[[resumedRequest valueForHTTPHeaderField:@"Content-Length"] integerValue], length - location);
+        if (location < length) {
+            XCTAssertEqualObjects([resumedRequest valueForHTTPHeaderField:@"Content-Range"], ([NSString stringWithFormat:@"bytes %lu-%lu/%lu", (unsigned long)location, (unsigned long)(length - 1), (unsigned long)length]));
+        } else {
+            XCTAssertEqualObjects([resumedRequest valueForHTTPHeaderField:@"Content-Range"], ([NSString stringWithFormat:@"bytes */%lu", (unsigned long)length]));
+        }
+    }
+
+    XCTAssertNil([self.requestSerializer requestWithMultipartFormRequest:request resumingFromOffset:length + 1]);
+
+    [[NSFileManager defaultManager] removeItemAtURL:[[fileURLs firstObject] URLByDeletingLastPathComponent] error:nil];
+}
+
+- (void)testPerformanceOfResumingMultipartBodyWithManyParts {
+    NSArray *fileURLs = AFCreateTemporaryFiles(200, 16 * 1024);
+    NSMutableURLRequest *request = [self.requestSerializer multipartFormRequestWithMethod:@"POST" URLString:@"http://example.com" parameters:nil constructingBodyWithBlock:^(id<AFMultipartFormData> formData) {
+        for (NSURL *fileURL in fileURLs) {
+            [formData appendPartWithFileURL:fileURL name:@"files[]" error:NULL];
+        }
+    } error:nil];
+    unsigned long long offset = (unsigned long long)[[request valueForHTTPHeaderField:@"Content-Length"] longLongValue] - 1024;
+
+    [self measureBlock:^{
+        for (NSUInteger idx = 0; idx < 100; idx++) {
+            AFDataByReadingStream([[self.requestSerializer requestWithMultipartFormRequest:request resumingFromOffset:offset] HTTPBodyStream], 32 * 1024);
+        }
+    }];
+
+    [[NSFileManager defaultManager] removeItemAtURL:[[fileURLs firstObject] URLByDeletingLastPathComponent] error:nil];
+}
+
+- (void)testThatFilePartsKnownToServerAreSentAsReferences {
+    NSArray *fileURLs = AFCreateTemporaryFiles(2, 64 * 1024);
+    [[NSMutableData dataWithLength:64 * 1024] writeToURL:fileURLs[0] atomically:NO];
+    [[@"different contents" dataUsingEncoding:NSUTF8StringEncoding] writeToURL:fileURLs[1] atomically:NO];
+    NSString *knownDigest = [AFUploadDeduplicator SHA256DigestOfFileAtURL:fileURLs[0] error:nil];
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(NSURLRequest *request, NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *statusCode = [[request.URL lastPathComponent] isEqualToString:knownDigest] ? 200 : 404;
+        return nil;
+    }];
+    AFURLSessionManager *sessionManager = [[AFURLSessionManager alloc] initWithSessionConfiguration:[NSURLSessionConfiguration ephemeralSessionConfiguration]];
+    AFUploadDeduplicator *deduplicator = [[AFUploadDeduplicator alloc] initWithLookupURL:[server.baseURL URLByAppendingPathComponent:@"blobs"]];
+    deduplicator.sessionManager = sessionManager;
+
+    NSMutableURLRequest *request = [self.requestSerializer multipartFormRequestWithMethod:@"POST" URLString:@"http://example.com" parameters:@{@"key": @"value"} constructingBodyWithBlock:^(id<AFMultipartFormData> formData) {
+        for (NSURL *fileURL in fileURLs) {
+            [formData appendPartWithFileURL:fileURL name:@"files[]" error:NULL];
+        }
+    } error:nil];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Deduplication should complete"];
+    __block NSMutableURLRequest *deduplicatedRequest = nil;
+    [self.requestSerializer deduplicateFilePartsOfMultipartFormRequest:request withDeduplicator:deduplicator completionHandler:^(NSMutableURLRequest *mutableRequest) {
+        deduplicatedRequest = mutableRequest;
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+
+    NSData *body = AFDataByReadingStream(deduplicatedRequest.HTTPBodyStream, 32 * 1024);
+    NSString *bodyString = [[NSString alloc] initWithData:body encoding:NSISOLatin1StringEncoding];
+    XCTAssertEqual([body length], (NSUInteger)[[deduplicatedRequest valueForHTTPHeaderField:@"Content-Length"] integerValue]);
+    XCTAssertEqual([body length] + 64 * 1024, (NSUInteger)[[request valueForHTTPHeaderField:@"Content-Length"] integerValue] + [[NSString stringWithFormat:@"X-Content-SHA256: %@\r\n", knownDigest] length]);
+    XCTAssertTrue([bodyString rangeOfString:[NSString stringWithFormat:@"X-Content-SHA256: %@", knownDigest]].location != NSNotFound);
+    XCTAssertTrue([bodyString rangeOfString:@"different contents"].location != NSNotFound);
+    XCTAssertEqual(deduplicator.numberOfBytesSaved, 64 * 1024);
+
+    [sessionManager invalidateSessionCancelingTasks:YES];
+    [server stop];
+    [[NSFileManager defaultManager] removeItemAtURL:[[fileURLs firstObject] URLByDeletingLastPathComponent] error:nil];
+}
+
 #pragma mark -
 
 - (void)testThatValueForHTTPHeaderFieldReturnsSetValue {
@@ -211,6 +631,66 @@
     } // Test succeeds if it does not EXC_BAD_ACCESS when cleaning up the @autoreleasepool
 }
 
+- (void)testThatHTTPHeaderValueIsAppliedToRequestImmediatelyAfterBeingSet {
+    [self.requestSerializer setValue:@"value" forHTTPHeaderField:@"Immediate-Header"];
+    NSURLRequest *request = [self.requestSerializer requestWithMethod:@"GET" URLString:@"http://example.com" parameters:nil error:nil];
+    XCTAssertEqualObjects([request valueForHTTPHeaderField:@"Immediate-Header"], @"value");
+
+    [self.requestSerializer setValue:nil forHTTPHeaderField:@"Immediate-Header"];
+    request = [self.requestSerializer requestWithMethod:@"GET" URLString:@"http://example.com" parameters:nil error:nil];
+    XCTAssertNil([request valueForHTTPHeaderField:@"Immediate-Header"]);
+}
+
+- (void)testThatHTTPRequestHeadersAreNotCopiedWhenUnchanged {
+    NSDictionary *headers = self.requestSerializer.HTTPRequestHeaders;
+    XCTAssertEqual(headers, self.requestSerializer.HTTPRequestHeaders);
+
+    [self.requestSerializer setValue:@"value" forHTTPHeaderField:@"Changed-Header"];
+    XCTAssertNotEqual(headers, self.requestSerializer.HTTPRequestHeaders);
+    XCTAssertNil(headers[@"Changed-Header"]);
+}
+
+- (void)testThatExistingRequestHeadersAreNotOverwrittenBySerializerHeaders {
+    [self.requestSerializer setValue:@"serializer" forHTTPHeaderField:@"X-Test"];
+
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com"]];
+    [request setValue:@"request" forHTTPHeaderField:@"X-Test"];
+
+    NSURLRequest *serializedRequest = [self.requestSerializer requestBySerializingRequest:request withParameters:nil error:nil];
+    XCTAssertEqualObjects([serializedRequest valueForHTTPHeaderField:@"X-Test"], @"request");
+    XCTAssertNotNil([serializedRequest valueForHTTPHeaderField:@"User-Agent"]);
+}
+
+- (void)testThatChangedRequestPropertiesAreAppliedToCreatedRequests {
+    self.requestSerializer.timeoutInterval = 12.0;
+    self.requestSerializer.cachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+    self.requestSerializer.HTTPShouldHandleCookies = NO;
+
+    NSURLRequest *request = [self.requestSerializer requestWithMethod:@"GET" URLString:@"http://example.com" parameters:nil error:nil];
+    XCTAssertEqual(request.timeoutInterval, 12.0);
+    XCTAssertEqual(request.cachePolicy, NSURLRequestReloadIgnoringLocalCacheData);
+    XCTAssertFalse(request.HTTPShouldHandleCookies);
+}
+
+- (void)testThatUnchangedRequestPropertiesKeepRequestDefaults {
+    NSURLRequest *defaultRequest = [NSURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com"]];
+    NSURLRequest *request = [self.requestSerializer requestWithMethod:@"GET" URLString:@"http://example.com" parameters:nil error:nil];
+
+    XCTAssertEqual(request.timeoutInterval, defaultRequest.timeoutInterval);
+    XCTAssertEqual(request.allowsCellularAccess, defaultRequest.allowsCellularAccess);
+    XCTAssertEqual(request.HTTPShouldHandleCookies, defaultRequest.HTTPShouldHandleCookies);
+}
+
+- (void)testThatCopiedSerializerKeepsHTTPRequestHeaders {
+    [self.requestSerializer setValue:@"value" forHTTPHeaderField:@"Copied-Header"];
+    AFHTTPRequestSerializer *copiedSerializer = [self.requestSerializer copy];
+
+    XCTAssertEqualObjects([copiedSerializer valueForHTTPHeaderField:@"Copied-Header"], @"value");
+
+    [copiedSerializer setValue:@"other" forHTTPHeaderField:@"Copied-Header"];
+    XCTAssertEqualObjects([self.requestSerializer valueForHTTPHeaderField:@"Copied-Header"], @"value");
+}
+
 #pragma mark - Helper Methods
 
 - (void)testQueryStringFromParameters {
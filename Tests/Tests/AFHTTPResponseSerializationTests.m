@@ -78,6 +78,21 @@
     XCTAssertNotNil(error, @"Error handling status code %@", @(statusCode));
 }
 
+- (void)testThatAFHTTPResponseSerializationAcceptsWildcardAndJSONSuffixContentTypes {
+    NSData *data = [@"test" dataUsingEncoding:NSUTF8StringEncoding];
+    self.responseSerializer.acceptableContentTypes = [NSSet setWithObjects:@"image/*", @"application/json", nil];
+
+    for (NSString *contentType in @[@"image/png", @"image/webp", @"application/json", @"application/problem+json"]) {
+        NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": contentType}];
+        XCTAssertTrue([self.responseSerializer validateResponse:response data:data error:nil], @"%@ should be acceptable", contentType);
+    }
+
+    for (NSString *contentType in @[@"text/plain", @"application/xml", @"application/jsonp"]) {
+        NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": contentType}];
+        XCTAssertFalse([self.responseSerializer validateResponse:response data:data error:nil], @"%@ should not be acceptable", contentType);
+    }
+}
+
 - (void)testThatAFHTTPResponseSerializationFailsAll4XX5XXStatusCodes {
     NSIndexSet *indexSet = [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(400, 200)];
     [indexSet enumerateIndexesUsingBlock:^(NSUInteger statusCode, BOOL *stop) {
@@ -610,4 +610,266 @@
     [manager invalidateSessionCancelingTasks:YES];
 }
 
+#pragma mark - Server-Sent Events
+
+- (void)testThatEventSourceReconnectsWithLastEventID {
+    NSMutableArray *lastEventIdentifiers = [NSMutableArray array];
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"text/event-stream"};
+        NSString *lastEventIdentifier = [request valueForHTTPHeaderField:@"Last-Event-ID"];
+        @synchronized (lastEventIdentifiers) {
+            [lastEventIdentifiers addObject:lastEventIdentifier ?: [NSNull null]];
+        }
+
+        if (!lastEventIdentifier) {
+            return [@"retry: 50\n: heartbeat\nid: 1\ndata: first\ndata: line\n\nevent: ignored\ndata: x\n\n" dataUsingEncoding:NSUTF8StringEncoding];
+        }
+        return [@"id: 2\r\nevent: update\r\ndata: second\r\n\r\n" dataUsingEncoding:NSUTF8StringEncoding];
+    }];
+
+    AFHTTPSessionManager *manager = [[AFHTTPSessionManager alloc] initWithBaseURL:server.baseURL];
+    AFEventSource *eventSource = [manager eventSourceWithURLString:@"events" parameters:nil error:nil];
+    XCTAssertEqual(eventSource.state, AFEventSourceStateClosed);
+
+    NSMutableArray *events = [NSMutableArray array];
+    XCTestExpectation *messageExpectation = [self expectationWithDescription:@"Message should be received"];
+    [eventSource setHandler:^(AFServerSentEvent *event) {
+        [events addObject:event];
+        [messageExpectation fulfill];
+    } forEventType:@"message"];
+
+    XCTestExpectation *updateExpectation = [self expectationWithDescription:@"Update should be received after reconnecting"];
+    [eventSource setHandler:^(AFServerSentEvent *event) {
+        [events addObject:event];
+        [updateExpectation fulfill];
+    } forEventType:@"update"];
+
+    [eventSource open];
+    [self waitForExpectationsWithCommonTimeout];
+    [eventSource close];
+
+    XCTAssertEqual(eventSource.state, AFEventSourceStateClosed);
+    XCTAssertEqualObjects([events[0] data], @"first\nline");
+    XCTAssertEqualObjects([events[0] identifier], @"1");
+    XCTAssertEqualObjects([events[1] type], @"update");
+    XCTAssertEqualObjects([events[1] data], @"second");
+    XCTAssertEqualObjects(eventSource.lastEventIdentifier, @"2");
+    XCTAssertEqualWithAccuracy(eventSource.reconnectionInterval, 0.05, 0.001);
+    @synchronized (lastEventIdentifiers) {
+        XCTAssertEqualObjects([lastEventIdentifiers subarrayWithRange:NSMakeRange(0, 2)], (@[[NSNull null], @"1"]));
+    }
+
+    [manager invalidateSessionCancelingTasks:YES];
+    [server stop];
+}
+
+- (void)testThatEventSourceReconnectsWhenHeartbeatTimesOut {
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        [NSThread sleepForTimeInterval:2.0];
+        *headers = @{@"Content-Type": @"text/event-stream"};
+        return nil;
+    }];
+
+    AFHTTPSessionManager *manager = [[AFHTTPSessionManager alloc] initWithBaseURL:server.baseURL];
+    AFEventSource *eventSource = [manager eventSourceWithURLString:@"events" parameters:nil error:nil];
+    eventSource.heartbeatTimeout = 0.2;
+    eventSource.reconnectionInterval = 60.0;
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Connection should time out"];
+    [eventSource setErrorHandler:^(NSError *error) {
+        XCTAssertEqualObjects(error.domain, NSURLErrorDomain);
+        XCTAssertEqual(error.code, NSURLErrorTimedOut);
+        XCTAssertEqual(eventSource.state, AFEventSourceStateConnecting);
+        [expectation fulfill];
+    }];
+
+    [eventSource open];
+    [self waitForExpectationsWithCommonTimeout];
+    [eventSource close];
+
+    [manager invalidateSessionCancelingTasks:YES];
+    [server stop];
+}
+
+- (void)testThatEventSourceClosesOnNoContentResponse {
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, NSInteger *statusCode, __unused NSDictionary *__autoreleasing *headers) {
+        *statusCode = 204;
+        return nil;
+    }];
+
+    AFHTTPSessionManager *manager = [[AFHTTPSessionManager alloc] initWithBaseURL:server.baseURL];
+    AFEventSource *eventSource = [manager eventSourceWithURLString:@"events" parameters:nil error:nil];
+    eventSource.reconnectionInterval = 0.01;
+    [eventSource open];
+
+    [self keyValueObservingExpectationForObject:eventSource keyPath:@"state" expectedValue:@(AFEventSourceStateClosed)];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [manager invalidateSessionCancelingTasks:YES];
+    [server stop];
+}
+
+- (void)testThatEventSourceStopsSendingLastEventIDAfterReset {
+    NSMutableArray *lastEventIdentifiers = [NSMutableArray array];
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"text/event-stream"};
+        NSString *lastEventIdentifier = [request valueForHTTPHeaderField:@"Last-Event-ID"];
+        NSUInteger numberOfConnections = 0;
+        @synchronized (lastEventIdentifiers) {
+            [lastEventIdentifiers addObject:lastEventIdentifier ?: [NSNull null]];
+            numberOfConnections = [lastEventIdentifiers count];
+        }
+
+        switch (numberOfConnections) {
+            case 1:
+                return [@"retry: 10\nid: 1\ndata: first\n\n" dataUsingEncoding:NSUTF8StringEncoding];
+            case 2:
+                return [@"id:\ndata: second\n\n" dataUsingEncoding:NSUTF8StringEncoding];
+            default:
+                return [@"event: last\ndata: third\n\n" dataUsingEncoding:NSUTF8StringEncoding];
+        }
+    }];
+
+    AFHTTPSessionManager *manager = [[AFHTTPSessionManager alloc] initWithBaseURL:server.baseURL];
+    AFEventSource *eventSource = [manager eventSourceWithURLString:@"events" parameters:nil error:nil];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Third connection should be made"];
+    [eventSource setHandler:^(__unused AFServerSentEvent *event) {
+        [expectation fulfill];
+    } forEventType:@"last"];
+    [eventSource open];
+    [self waitForExpectationsWithCommonTimeout];
+    [eventSource close];
+
+    XCTAssertNil(eventSource.lastEventIdentifier);
+    @synchronized (lastEventIdentifiers) {
+        XCTAssertEqualObjects([lastEventIdentifiers subarrayWithRange:NSMakeRange(0, 3)], (@[[NSNull null], @"1", [NSNull null]]));
+    }
+
+    [manager invalidateSessionCancelingTasks:YES];
+    [server stop];
+}
+
+- (void)testThatEventSourceClosesOnUnacceptableContentType {
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"application/json"};
+        return [@"{}" dataUsingEncoding:NSUTF8StringEncoding];
+    }];
+
+    AFHTTPSessionManager *manager = [[AFHTTPSessionManager alloc] initWithBaseURL:server.baseURL];
+    AFEventSource *eventSource = [manager eventSourceWithURLString:@"events" parameters:nil error:nil];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Event source should fail"];
+    [eventSource setErrorHandler:^(NSError *error) {
+        XCTAssertEqual(error.code, NSURLErrorCannotDecodeContentData);
+        XCTAssertEqual(eventSource.state, AFEventSourceStateClosed);
+        [expectation fulfill];
+    }];
+    [eventSource open];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [manager invalidateSessionCancelingTasks:YES];
+    [server stop];
+}
+
+@end
+
+#pragma mark -
+
+@interface AFServerSentEventParserTests : AFTestCase
+@end
+
+@implementation AFServerSentEventParserTests
+
+- (void)testThatParserSplitsLinesAcrossChunksWithAnyLineEnding {
+    const uint8_t byteOrderMark[] = {0xEF, 0xBB, 0xBF};
+    NSMutableData *data = [NSMutableData dataWithBytes:byteOrderMark length:sizeof(byteOrderMark)];
+    [data appendData:[@"data:a\r\rdata: b\rdata\r\n\r\nid: 7\nevent:custom\ndata:  c\n\n" dataUsingEncoding:NSUTF8StringEncoding]];
+
+    NSMutableArray *events = [NSMutableArray array];
+    AFServerSentEventParser *parser = [[AFServerSentEventParser alloc] initWithEventHandler:^(AFServerSentEvent *event) {
+        [events addObject:event];
+    }];
+    for (NSUInteger idx = 0; idx < [data length]; idx++) {
+        XCTAssertTrue([parser parseData:[data subdataWithRange:NSMakeRange(idx, 1)] error:nil]);
+    }
+    [parser finishParsingWithError:nil];
+
+    XCTAssertEqual([events count], 3);
+    XCTAssertEqualObjects([events[0] data], @"a");
+    XCTAssertEqualObjects([events[1] data], @"b\n");
+    XCTAssertEqualObjects([events[2] type], @"custom");
+    XCTAssertEqualObjects([events[2] data], @" c");
+    XCTAssertEqualObjects([events[2] identifier], @"7");
+    XCTAssertEqualObjects(parser.lastEventIdentifier, @"7");
+}
+
+- (void)testThatParserSkipsByteOrderMarkSplitAcrossChunks {
+    NSMutableArray *events = [NSMutableArray array];
+    AFServerSentEventParser *parser = [[AFServerSentEventParser alloc] initWithEventHandler:^(AFServerSentEvent *event) {
+        [events addObject:event];
+    }];
+
+    const uint8_t firstChunk[] = {0xEF, 0xBB};
+    const uint8_t secondChunk[] = {0xBF, 'd', 'a', 't', 'a', ':', 'a', '\n', '\n'};
+    XCTAssertTrue([parser parseData:[NSData dataWithBytes:firstChunk length:sizeof(firstChunk)] error:nil]);
+    XCTAssertTrue([parser parseData:[NSData dataWithBytes:secondChunk length:sizeof(secondChunk)] error:nil]);
+
+    XCTAssertEqual([events count], 1);
+    XCTAssertEqualObjects([events[0] type], @"message");
+    XCTAssertEqualObjects([events[0] data], @"a");
+}
+
+- (void)testThatParserReplacesInvalidUTF8WithReplacementCharacter {
+    NSMutableArray *events = [NSMutableArray array];
+    AFServerSentEventParser *parser = [[AFServerSentEventParser alloc] initWithEventHandler:^(AFServerSentEvent *event) {
+        [events addObject:event];
+    }];
+
+    const uint8_t bytes[] = {'d', 'a', 't', 'a', ':', 'a', 0xE2, 0x82, 'b', 0xFF, '\n', '\n'};
+    XCTAssertTrue([parser parseData:[NSData dataWithBytes:bytes length:sizeof(bytes)] error:nil]);
+
+    XCTAssertEqual([events count], 1);
+    XCTAssertEqualObjects([events[0] data], @"a\uFFFDb\uFFFD");
+}
+
+- (void)testThatEmptyIdentifierResetsLastEventIdentifier {
+    NSMutableArray *events = [NSMutableArray array];
+    AFServerSentEventParser *parser = [[AFServerSentEventParser alloc] initWithEventHandler:^(AFServerSentEvent *event) {
+        [events addObject:event];
+    }];
+    parser.lastEventIdentifier = @"3";
+
+    XCTAssertTrue([parser parseData:[@"data: a\n\nid\ndata: b\n\n" dataUsingEncoding:NSUTF8StringEncoding] error:nil]);
+
+    XCTAssertEqual([events count], 2);
+    XCTAssertEqualObjects([events[0] identifier], @"3");
+    XCTAssertNil([events[1] identifier]);
+    XCTAssertNil(parser.lastEventIdentifier);
+}
+
+- (void)testThatParserDiscardsIncompleteEventAtEndOfStream {
+    __block NSUInteger numberOfEvents = 0;
+    AFServerSentEventParser *parser = [[AFServerSentEventParser alloc] initWithEventHandler:^(__unused AFServerSentEvent *event) {
+        numberOfEvents++;
+    }];
+
+    [parser parseData:[@"data: incomplete\n" dataUsingEncoding:NSUTF8StringEncoding] error:nil];
+    [parser finishParsingWithError:nil];
+
+    XCTAssertEqual(numberOfEvents, 0);
+}
+
+- (void)testThatParserReportsHeartbeatsForComments {
+    __block NSUInteger numberOfHeartbeats = 0;
+    AFServerSentEventParser *parser = [[AFServerSentEventParser alloc] initWithEventHandler:^(__unused AFServerSentEvent *event) {}];
+    parser.heartbeatHandler = ^{
+        numberOfHeartbeats++;
+    };
+
+    [parser parseData:[@": ping\n" dataUsingEncoding:NSUTF8StringEncoding] error:nil];
+    [parser parseData:[@": ping\n" dataUsingEncoding:NSUTF8StringEncoding] error:nil];
+
+    XCTAssertEqual(numberOfHeartbeats, 2);
+}
+
 @end
@@ -21,6 +21,8 @@
 
 #import "AFTestCase.h"
 
+#import <malloc/malloc.h>
+
 #import "AFURLRequestSerialization.h"
 #import "AFURLResponseSerialization.h"
 
@@ -28,6 +30,26 @@ static NSData * AFJSONTestData() {
     return [NSJSONSerialization dataWithJSONObject:@{@"foo": @"bar"} options:(NSJSONWritingOptions)0 error:nil];
 }
 
+static NSInteger AFJSONTestNumberOfBlocksInUse() {
+    malloc_statistics_t statistics;
+    malloc_zone_statistics(NULL, &statistics);
+
+    return (NSInteger)statistics.blocks_in_use;
+}
+
+static NSData * AFDataByReadingStream(NSInputStream *inputStream) {
+    NSMutableData *data = [NSMutableData data];
+    uint8_t buffer[1000];
+    [inputStream open];
+    NSInteger numberOfBytesRead = 0;
+    while ((numberOfBytesRead = [inputStream read:buffer maxLength:sizeof(buffer)]) > 0) {
+        [data appendBytes:buffer length:(NSUInteger)numberOfBytesRead];
+    }
+    [inputStream close];
+
+    return data;
+}
+
 #pragma mark -
 
 @interface AFJSONRequestSerializationTests : AFTestCase
@@ -89,6 +111,133 @@ static NSData * AFJSONTestData() {
     XCTAssertEqualObjects(error.localizedFailureReason, @"The `parameters` argument is not valid JSON.");
 }
 
+- (void)testThatJSONRequestSerializationMatchesNSJSONSerializationForStringsIntegersAndLiterals {
+    NSArray *parameters = @[@"plain", @"quote \" slash / backslash \\", @"line\nbreak\ttab", @"\u00e9\u4e2d\U0001F600", @0, @42, @(-42), @(LLONG_MIN), @(ULLONG_MAX), @YES, @NO, [NSNull null], @{}, @[]];
+    NSError *error = nil;
+    NSMutableURLRequest *request = [self.requestSerializer requestWithMethod:@"POST" URLString:self.baseURL.absoluteString parameters:parameters error:&error];
+
+    XCTAssertNil(error);
+    XCTAssertEqualObjects([request HTTPBody], [NSJSONSerialization dataWithJSONObject:parameters options:(NSJSONWritingOptions)0 error:nil]);
+}
+
+- (void)testThatJSONRequestSerializationRoundTripsNestedDocuments {
+    NSDictionary *parameters = @{@"control": @"\x01\x1f", @"double": @(0.1), @"float": @(1.5f), @"negative": @(-2.25), @"nested": @{@"array": @[@1, @[@2, @{@"three": @3}]]}};
+    NSError *error = nil;
+    NSMutableURLRequest *request = [self.requestSerializer requestWithMethod:@"POST" URLString:self.baseURL.absoluteString parameters:parameters error:&error];
+
+    XCTAssertNil(error);
+    XCTAssertEqualObjects([NSJSONSerialization JSONObjectWithData:[request HTTPBody] options:(NSJSONReadingOptions)0 error:nil], parameters);
+}
+
+- (void)testThatJSONRequestSerializationErrorsWithNonStringKeys {
+    NSDictionary *parameters = @{@1: @"value"};
+    NSError *error = nil;
+    NSMutableURLRequest *request = [self.requestSerializer requestWithMethod:@"POST" URLString:self.baseURL.absoluteString parameters:parameters error:&error];
+
+    XCTAssertNil(request);
+    XCTAssertEqual(error.code, NSURLErrorCannotDecodeContentData);
+}
+
+- (void)testThatJSONRequestSerializationErrorsWithNonFiniteNumbers {
+    NSDictionary *parameters = @{@"key": @(NAN)};
+    NSError *error = nil;
+    NSMutableURLRequest *request = [self.requestSerializer requestWithMethod:@"POST" URLString:self.baseURL.absoluteString parameters:parameters error:&error];
+
+    XCTAssertNil(request);
+    XCTAssertEqual(error.code, NSURLErrorCannotDecodeContentData);
+}
+
+- (void)testThatJSONRequestSerializationUsesNSJSONSerializationForNonDefaultWritingOptions {
+    self.requestSerializer.writingOptions = NSJSONWritingPrettyPrinted;
+    NSDictionary *parameters = @{@"key": @"value"};
+    NSMutableURLRequest *request = [self.requestSerializer requestWithMethod:@"POST" URLString:self.baseURL.absoluteString parameters:parameters error:nil];
+
+    XCTAssertEqualObjects([request HTTPBody], [NSJSONSerialization dataWithJSONObject:parameters options:NSJSONWritingPrettyPrinted error:nil]);
+}
+
+- (void)testThatStreamedJSONRequestBodyMatchesHTTPBody {
+    NSDictionary *parameters = AFJSONStringHeavyDocument();
+    NSData *expectedBody = [[self.requestSerializer requestWithMethod:@"POST" URLString:self.baseURL.absoluteString parameters:parameters error:nil] HTTPBody];
+
+    self.requestSerializer.streamsHTTPBody = YES;
+    NSError *error = nil;
+    NSMutableURLRequest *request = [self.requestSerializer requestWithMethod:@"POST" URLString:self.baseURL.absoluteString parameters:parameters error:&error];
+
+    XCTAssertNil(error);
+    XCTAssertNil([request HTTPBody]);
+    XCTAssertNotNil([request HTTPBodyStream]);
+    XCTAssertEqualObjects([request valueForHTTPHeaderField:@"Content-Length"], ([NSString stringWithFormat:@"%lu", (unsigned long)[expectedBody length]]));
+    XCTAssertEqualObjects(AFDataByReadingStream([request HTTPBodyStream]), expectedBody);
+    XCTAssertEqualObjects(AFDataByReadingStream([[request HTTPBodyStream] copy]), expectedBody, @"A copied body stream should be encoded from the start");
+}
+
+- (void)testThatStreamedJSONRequestSerializationErrorsWithInvalidJSON {
+    self.requestSerializer.streamsHTTPBody = YES;
+    NSDictionary *parameters = @{@"key": @[@1, [NSSet setWithObject:@"value"]]};
+    NSError *error = nil;
+    NSMutableURLRequest *request = [self.requestSerializer requestWithMethod:@"POST" URLString:self.baseURL.absoluteString parameters:parameters error:&error];
+
+    XCTAssertNil(request);
+    XCTAssertEqualObjects(error.localizedFailureReason, @"The `parameters` argument is not valid JSON.");
+}
+
+- (void)testThatCopiedJSONRequestSerializerKeepsStreamsHTTPBody {
+    self.requestSerializer.streamsHTTPBody = YES;
+    AFJSONRequestSerializer *copiedSerializer = [self.requestSerializer copy];
+
+    XCTAssertTrue(copiedSerializer.streamsHTTPBody);
+}
+
+#pragma mark - Performance
+
+- (void)testPerformanceOfWideDocumentSerialization {
+    [self measureRequestSerializationOfParameters:AFJSONWideDocument()];
+}
+
+- (void)testPerformanceOfWideDocumentSerializationUsingNSJSONSerialization {
+    [self measureNSJSONSerializationOfParameters:AFJSONWideDocument()];
+}
+
+- (void)testPerformanceOfDeepDocumentSerialization {
+    [self measureRequestSerializationOfParameters:AFJSONDeepDocument()];
+}
+
+- (void)testPerformanceOfDeepDocumentSerializationUsingNSJSONSerialization {
+    [self measureNSJSONSerializationOfParameters:AFJSONDeepDocument()];
+}
+
+- (void)testPerformanceOfStringHeavyDocumentSerialization {
+    [self measureRequestSerializationOfParameters:AFJSONStringHeavyDocument()];
+}
+
+- (void)testPerformanceOfStringHeavyDocumentSerializationUsingNSJSONSerialization {
+    [self measureNSJSONSerializationOfParameters:AFJSONStringHeavyDocument()];
+}
+
+#pragma mark - Helper Methods
+
+- (void)measureRequestSerializationOfParameters:(id)parameters {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+    [self measureBlock:^{
+        for (NSUInteger idx = 0; idx < 10; idx++) {
+            [self.requestSerializer requestBySerializingRequest:request withParameters:parameters error:nil];
+        }
+    }];
+}
+
+//与之前的实现相同：先校验，再编码
+- (void)measureNSJSONSerializationOfParameters:(id)parameters {
+    [self measureBlock:^{
+        for (NSUInteger idx = 0; idx < 10; idx++) {
+            NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+            if ([NSJSONSerialization isValidJSONObject:parameters]) {
+                [request setHTTPBody:[NSJSONSerialization dataWithJSONObject:parameters options:(NSJSONWritingOptions)0 error:nil]];
+            }
+        }
+    }];
+}
+
 @end
 
 #pragma mark -
@@ -191,11 +340,251 @@ static NSData * AFJSONTestData() {
     XCTAssertNil(responseObject[@"array"][0][@"subnullkey"]);
 }
 
+- (void)testThatJSONRemovesKeysWithNullValuesInPlaceForMutableContainers {
+    self.responseSerializer.removesKeysWithNullValues = YES;
+    self.responseSerializer.readingOptions = NSJSONReadingMutableContainers;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+    NSData *data = [@"{\"key\":\"value\",\"nullkey\":null,\"object\":{\"subnullkey\":null,\"subkey\":1},\"array\":[null,{\"subnullkey\":null}]}" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSError *error = nil;
+    NSMutableDictionary *responseObject = [self.responseSerializer responseObjectForResponse:response data:data error:&error];
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(responseObject, (@{@"key": @"value", @"object": @{@"subkey": @1}, @"array": @[[NSNull null], @{}]}));
+
+    XCTAssertNoThrow([responseObject setObject:@"added" forKey:@"added"]);
+    XCTAssertNoThrow([responseObject[@"object"] setObject:@"added" forKey:@"added"]);
+    XCTAssertNoThrow([responseObject[@"array"] addObject:@"added"]);
+}
+
+- (void)testThatJSONRemovesKeysWithNullValuesOnlyFromDictionaries {
+    self.responseSerializer.removesKeysWithNullValues = YES;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+    NSData *data = [@"[null,{\"a\":null,\"b\":[{\"c\":null,\"d\":[]}]},{\"e\":{}}]" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSError *error = nil;
+    NSArray *responseObject = [self.responseSerializer responseObjectForResponse:response data:data error:&error];
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(responseObject, (@[[NSNull null], @{@"b": @[@{@"d": @[]}]}, @{@"e": @{}}]));
+}
+
+- (void)testThatJSONRemovesKeysWithNullValuesFromUTF16Responses {
+    self.responseSerializer.removesKeysWithNullValues = YES;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+    NSString *string = @"{\"a\":null,\"b\":[{\"c\":null,\"d\":1}]}";
+
+    // UTF-16 is not handled by the structural index, so these keys are removed in a separate pass.
+    NSError *error = nil;
+    NSDictionary *responseObject = [self.responseSerializer responseObjectForResponse:response data:[string dataUsingEncoding:NSUTF16StringEncoding] error:&error];
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(responseObject, (@{@"b": @[@{@"d": @1}]}));
+    XCTAssertEqualObjects(responseObject, [self.responseSerializer responseObjectForResponse:response data:[string dataUsingEncoding:NSUTF8StringEncoding] error:nil]);
+}
+
+- (void)testThatLazilyDecodedResponseMatchesEagerlyDecodedResponse {
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+    NSData *data = [@"{\"string\":\"plain\",\"escaped\":\"quote \\\" slash \\/ tab \\t \\u00e9 \\ud83d\\ude00\",\"unicode\":\"\u4e2d\u6587\",\"numbers\":[0,-1,42,9223372036854775807,-9223372036854775808,1.5,-25e-2,1E10],\"literals\":[true,false,null],\"nested\":{\"array\":[[],{},[{\"key\":\"value\"}]]}}" dataUsingEncoding:NSUTF8StringEncoding];
+
+    id eagerResponseObject = [self.responseSerializer responseObjectForResponse:response data:data error:nil];
+
+    self.responseSerializer.decodesLazily = YES;
+    NSError *error = nil;
+    NSDictionary *lazyResponseObject = [self.responseSerializer responseObjectForResponse:response data:data error:&error];
+    XCTAssertNil(error);
+    XCTAssertTrue([lazyResponseObject isKindOfClass:[NSDictionary class]]);
+    XCTAssertTrue([lazyResponseObject[@"numbers"] isKindOfClass:[NSArray class]]);
+    XCTAssertEqualObjects(lazyResponseObject[@"nested"][@"array"][2][0][@"key"], @"value");
+    XCTAssertEqualObjects(lazyResponseObject, eagerResponseObject);
+    XCTAssertEqualObjects(eagerResponseObject, lazyResponseObject);
+}
+
+- (void)testThatLazilyDecodedDeepDocumentMatchesEagerlyDecodedDocument {
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+    NSData *data = [NSJSONSerialization dataWithJSONObject:AFJSONDeepDocument() options:(NSJSONWritingOptions)0 error:nil];
+
+    self.responseSerializer.decodesLazily = YES;
+    NSError *error = nil;
+    id responseObject = [self.responseSerializer responseObjectForResponse:response data:data error:&error];
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(responseObject, AFJSONDeepDocument());
+}
+
+- (void)testThatLazilyDecodedResponseCanBeCopiedAndArchived {
+    self.responseSerializer.decodesLazily = YES;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+    NSData *data = [@"{\"key\":[1,{\"nested\":\"value\"}]}" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSDictionary *responseObject = [self.responseSerializer responseObjectForResponse:response data:data error:nil];
+    NSDictionary *expectedObject = @{@"key": @[@1, @{@"nested": @"value"}]};
+
+    XCTAssertEqualObjects([responseObject copy], expectedObject);
+    NSMutableDictionary *mutableResponseObject = [responseObject mutableCopy];
+    mutableResponseObject[@"added"] = @YES;
+    XCTAssertEqual([mutableResponseObject count], 2);
+
+    NSData *archivedData = [NSKeyedArchiver archivedDataWithRootObject:responseObject];
+    id unarchivedObject = [NSKeyedUnarchiver unarchiveObjectWithData:archivedData];
+    XCTAssertEqualObjects(unarchivedObject, expectedObject);
+}
+
+- (void)testThatLazilyDecodedResponseRemovesKeysWithNullValues {
+    self.responseSerializer.decodesLazily = YES;
+    self.responseSerializer.removesKeysWithNullValues = YES;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+    NSData *data = [@"{\"key\":\"value\",\"nullkey\":null,\"array\":[null,{\"subnullkey\":null}]}" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSDictionary *responseObject = [self.responseSerializer responseObjectForResponse:response data:data error:nil];
+    XCTAssertEqual([responseObject count], 2);
+    XCTAssertNil(responseObject[@"nullkey"]);
+    XCTAssertEqualObjects(responseObject[@"array"], (@[[NSNull null], @{}]));
+}
+
+- (void)testThatLazyDecodingReportsInvalidJSON {
+    self.responseSerializer.decodesLazily = YES;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+
+    for (NSString *string in @[@"{", @"[1,]", @"{\"a\"}", @"{\"a\":1,}", @"[01]", @"[1.]", @"[1e999]", @"[tru]", @"{\"a\":1}x", @"[\"\\x\"]", @"[\"\\ud800\"]", @"\"fragment\""]) {
+        NSError *error = nil;
+        id responseObject = [self.responseSerializer responseObjectForResponse:response data:[string dataUsingEncoding:NSUTF8StringEncoding] error:&error];
+        XCTAssertNil(responseObject, @"%@", string);
+        XCTAssertNotNil(error, @"%@", string);
+        XCTAssertEqualObjects(error.domain, AFURLResponseSerializationErrorDomain, @"%@", string);
+    }
+
+    const uint8_t invalidUTF8[] = {'[', '"', 0xc3, 0x28, '"', ']'};
+    NSError *error = nil;
+    XCTAssertNil([self.responseSerializer responseObjectForResponse:response data:[NSData dataWithBytes:invalidUTF8 length:sizeof(invalidUTF8)] error:&error]);
+    XCTAssertNotNil(error);
+}
+
+- (void)testThatLazyDecodingFallsBackForByteOrderMarksAndUTF16 {
+    self.responseSerializer.decodesLazily = YES;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+
+    NSMutableData *UTF8DataWithByteOrderMark = [NSMutableData dataWithBytes:"\xEF\xBB\xBF" length:3];
+    [UTF8DataWithByteOrderMark appendData:[@"{\"key\":[1,\"value\"]}" dataUsingEncoding:NSUTF8StringEncoding]];
+    NSData *UTF16Data = [@"{\"key\":[1,\"value\"]}" dataUsingEncoding:NSUTF16LittleEndianStringEncoding];
+
+    for (NSData *data in @[UTF8DataWithByteOrderMark, UTF16Data]) {
+        NSError *error = nil;
+        XCTAssertEqualObjects([self.responseSerializer responseObjectForResponse:response data:data error:&error], [NSJSONSerialization JSONObjectWithData:data options:(NSJSONReadingOptions)0 error:nil]);
+        XCTAssertNil(error);
+    }
+}
+
+- (void)testThatLazyDecodingAllowsFragmentsWhenRequested {
+    self.responseSerializer.decodesLazily = YES;
+    self.responseSerializer.readingOptions = NSJSONReadingAllowFragments;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+
+    XCTAssertEqualObjects([self.responseSerializer responseObjectForResponse:response data:[@"\"fragment\"" dataUsingEncoding:NSUTF8StringEncoding] error:nil], @"fragment");
+    XCTAssertEqualObjects([self.responseSerializer responseObjectForResponse:response data:[@" 42 " dataUsingEncoding:NSUTF8StringEncoding] error:nil], @42);
+}
+
+- (void)testThatLazilyDecodedResponseCanBeReadConcurrently {
+    self.responseSerializer.decodesLazily = YES;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+    NSDictionary *document = AFJSONWideDocument();
+    NSData *data = [NSJSONSerialization dataWithJSONObject:document options:(NSJSONWritingOptions)0 error:nil];
+    NSDictionary *responseObject = [self.responseSerializer responseObjectForResponse:response data:data error:nil];
+
+    NSArray *keys = [document allKeys];
+    dispatch_apply([keys count], dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t idx) {
+        NSString *key = keys[([keys count] - 1 - idx) % [keys count]];
+        XCTAssertEqualObjects(responseObject[key][@"id"], document[key][@"id"]);
+    });
+    XCTAssertEqualObjects(responseObject, document);
+}
+
+- (void)testThatStructuralIndexBackendMatchesNSJSONSerialization {
+    self.responseSerializer.readingBackend = AFJSONReadingBackendStructuralIndex;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+
+    // Backslash runs of every length at every offset exercise escapes that straddle 64 byte blocks.
+    NSMutableArray *escapedStrings = [NSMutableArray array];
+    for (NSUInteger padding = 0; padding < 70; padding++) {
+        for (NSUInteger numberOfBackslashes = 1; numberOfBackslashes < 4; numberOfBackslashes++) {
+            NSString *prefix = [@"" stringByPaddingToLength:padding withString:@"x" startingAtIndex:0];
+            NSString *backslashes = [@"" stringByPaddingToLength:numberOfBackslashes withString:@"\\" startingAtIndex:0];
+            [escapedStrings addObject:[NSString stringWithFormat:@"%@%@\"{}[],: \u00e9\U0001F600", prefix, backslashes]];
+        }
+    }
+
+    NSArray *documents = @[AFJSONWideDocument(), AFJSONDeepDocument(), AFJSONStringHeavyDocument(), escapedStrings, @{@"numbers": @[@0, @(-1), @(LLONG_MAX), @(LLONG_MIN), @1.5, @(-0.25), @1e10], @"literals": @[@YES, @NO, [NSNull null]], @"empty": @{@"array": @[], @"object": @{}, @"string": @""}}];
+    for (id document in documents) {
+        NSData *data = [NSJSONSerialization dataWithJSONObject:document options:NSJSONWritingPrettyPrinted error:nil];
+        NSError *error = nil;
+        id responseObject = [self.responseSerializer responseObjectForResponse:response data:data error:&error];
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(responseObject, [NSJSONSerialization JSONObjectWithData:data options:(NSJSONReadingOptions)0 error:nil]);
+    }
+}
+
+- (void)testThatStructuralIndexBackendMatchesNSJSONSerializationForByteOrderMarksAndUTF16AndUTF32 {
+    self.responseSerializer.readingBackend = AFJSONReadingBackendStructuralIndex;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+
+    NSString *string = @"{\"key\":[1,\"value\",{\"nested\":true}]}";
+    NSMutableData *UTF8DataWithByteOrderMark = [NSMutableData dataWithBytes:"\xEF\xBB\xBF" length:3];
+    [UTF8DataWithByteOrderMark appendData:[string dataUsingEncoding:NSUTF8StringEncoding]];
+    NSArray *datas = @[UTF8DataWithByteOrderMark, [string dataUsingEncoding:NSUTF16StringEncoding], [string dataUsingEncoding:NSUTF16BigEndianStringEncoding], [string dataUsingEncoding:NSUTF32LittleEndianStringEncoding]];
+
+    for (NSData *data in datas) {
+        NSError *error = nil;
+        id expectedObject = [NSJSONSerialization JSONObjectWithData:data options:(NSJSONReadingOptions)0 error:nil];
+        XCTAssertNotNil(expectedObject);
+        XCTAssertEqualObjects([self.responseSerializer responseObjectForResponse:response data:data error:&error], expectedObject);
+        XCTAssertNil(error);
+    }
+}
+
+- (void)testThatStructuralIndexBackendReportsInvalidJSON {
+    self.responseSerializer.readingBackend = AFJSONReadingBackendStructuralIndex;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+
+    for (NSString *string in @[@"{", @"[1,]", @"[1 2]", @"[1x]", @"[truex]", @"{\"a\"}", @"{\"a\":1,}", @"[01]", @"[1.]", @"[1e999]", @"{\"a\":1}x", @"[\"a\"1]", @"[\"\\x\"]", @"[\"\\ud800\"]", @"[\"unterminated]", @"[\"tab\there\"]", @"\"fragment\""]) {
+        NSError *error = nil;
+        id responseObject = [self.responseSerializer responseObjectForResponse:response data:[string dataUsingEncoding:NSUTF8StringEncoding] error:&error];
+        XCTAssertNil(responseObject, @"%@", string);
+        XCTAssertNotNil(error, @"%@", string);
+        XCTAssertNil([NSJSONSerialization JSONObjectWithData:[string dataUsingEncoding:NSUTF8StringEncoding] options:(NSJSONReadingOptions)0 error:nil], @"%@", string);
+    }
+}
+
+- (void)testThatStructuralIndexBackendHonorsReadingOptions {
+    self.responseSerializer.readingBackend = AFJSONReadingBackendStructuralIndex;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+    NSData *data = [@"{\"array\":[\"string\"],\"null\":null}" dataUsingEncoding:NSUTF8StringEncoding];
+
+    self.responseSerializer.readingOptions = NSJSONReadingMutableContainers | NSJSONReadingMutableLeaves;
+    NSMutableDictionary *responseObject = [self.responseSerializer responseObjectForResponse:response data:data error:nil];
+    XCTAssertNoThrow([responseObject setObject:@"added" forKey:@"added"]);
+    XCTAssertNoThrow([responseObject[@"array"] addObject:@"added"]);
+    XCTAssertNoThrow([responseObject[@"array"][0] appendString:@"added"]);
+
+    self.responseSerializer.readingOptions = NSJSONReadingAllowFragments;
+    XCTAssertEqualObjects([self.responseSerializer responseObjectForResponse:response data:[@" \"fragment\" " dataUsingEncoding:NSUTF8StringEncoding] error:nil], @"fragment");
+
+    self.responseSerializer.readingOptions = (NSJSONReadingOptions)0;
+    self.responseSerializer.removesKeysWithNullValues = YES;
+    XCTAssertEqualObjects([self.responseSerializer responseObjectForResponse:response data:data error:nil], (@{@"array": @[@"string"]}));
+}
+
+- (void)testThatLazyDecodingIsIgnoredForMutableReadingOptions {
+    self.responseSerializer.decodesLazily = YES;
+    self.responseSerializer.readingOptions = NSJSONReadingMutableContainers;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type":@"application/json"}];
+
+    NSMutableDictionary *responseObject = [self.responseSerializer responseObjectForResponse:response data:[@"{\"key\":\"value\"}" dataUsingEncoding:NSUTF8StringEncoding] error:nil];
+    XCTAssertNoThrow([responseObject setObject:@"added" forKey:@"added"]);
+}
+
 - (void)testThatJSONResponseSerializerCanBeCopied {
     [self.responseSerializer setAcceptableStatusCodes:[NSIndexSet indexSetWithIndex:100]];
     [self.responseSerializer setAcceptableContentTypes:[NSSet setWithObject:@"test/type"]];
     [self.responseSerializer setReadingOptions:NSJSONReadingMutableLeaves];
     [self.responseSerializer setRemovesKeysWithNullValues:YES];
+    [self.responseSerializer setDecodesLazily:YES];
+    [self.responseSerializer setReadingBackend:AFJSONReadingBackendStructuralIndex];
 
     AFJSONResponseSerializer *copiedSerializer = [self.responseSerializer copy];
     XCTAssertNotEqual(copiedSerializer, self.responseSerializer);
@@ -203,6 +592,716 @@ static NSData * AFJSONTestData() {
     XCTAssertEqual(copiedSerializer.acceptableContentTypes, self.responseSerializer.acceptableContentTypes);
     XCTAssertEqual(copiedSerializer.readingOptions, self.responseSerializer.readingOptions);
     XCTAssertEqual(copiedSerializer.removesKeysWithNullValues, self.responseSerializer.removesKeysWithNullValues);
+    XCTAssertEqual(copiedSerializer.decodesLazily, self.responseSerializer.decodesLazily);
+    XCTAssertEqual(copiedSerializer.readingBackend, self.responseSerializer.readingBackend);
+}
+
+#pragma mark -
+
+//与MessagePack、CBOR的解码性能测试对照
+- (void)testPerformanceOfWideDocumentDeserialization {
+    [self measureResponseSerializationOfObject:AFJSONWideDocument()];
+}
+
+- (void)testPerformanceOfDeepDocumentDeserialization {
+    [self measureResponseSerializationOfObject:AFJSONDeepDocument()];
+}
+
+- (void)testPerformanceOfStringHeavyDocumentDeserialization {
+    [self measureResponseSerializationOfObject:AFJSONStringHeavyDocument()];
+}
+
+// Removing null values should add next to no overhead over plain decoding.
+- (void)testPerformanceOfWideDocumentDeserializationRemovingKeysWithNullValues {
+    self.responseSerializer.removesKeysWithNullValues = YES;
+    [self measureResponseSerializationOfObject:AFJSONWideDocument()];
+}
+
+- (void)testPerformanceOfWideDocumentDeserializationUsingStructuralIndexBackend {
+    self.responseSerializer.readingBackend = AFJSONReadingBackendStructuralIndex;
+    [self measureResponseSerializationOfObject:AFJSONWideDocument()];
+}
+
+- (void)testPerformanceOfDeepDocumentDeserializationUsingStructuralIndexBackend {
+    self.responseSerializer.readingBackend = AFJSONReadingBackendStructuralIndex;
+    [self measureResponseSerializationOfObject:AFJSONDeepDocument()];
+}
+
+- (void)testPerformanceOfStringHeavyDocumentDeserializationUsingStructuralIndexBackend {
+    self.responseSerializer.readingBackend = AFJSONReadingBackendStructuralIndex;
+    [self measureResponseSerializationOfObject:AFJSONStringHeavyDocument()];
+}
+
+// Lazy decoding should only pay for the values that are read.
+- (void)testPerformanceOfWideDocumentLazyDeserializationReadingFewValues {
+    self.responseSerializer.decodesLazily = YES;
+    NSData *data = [NSJSONSerialization dataWithJSONObject:AFJSONWideDocument() options:(NSJSONWritingOptions)0 error:nil];
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": @"application/json"}];
+    [self measureBlock:^{
+        for (NSUInteger idx = 0; idx < 10; idx++) {
+            NSDictionary *responseObject = [self.responseSerializer responseObjectForResponse:response data:data error:nil];
+            XCTAssertNotNil(responseObject[@"key1"][@"name"]);
+            XCTAssertNotNil(responseObject[@"key500"][@"score"]);
+            XCTAssertNotNil(responseObject[@"key9999"][@"active"]);
+        }
+    }];
+}
+
+- (void)testPerformanceOfWideDocumentDeserializationRemovingKeysWithNullValuesFromMutableContainers {
+    self.responseSerializer.removesKeysWithNullValues = YES;
+    self.responseSerializer.readingOptions = NSJSONReadingMutableContainers;
+    [self measureResponseSerializationOfObject:AFJSONWideDocument()];
+}
+
+#pragma mark - Helper Methods
+
+- (void)measureResponseSerializationOfObject:(id)object {
+    NSData *data = [NSJSONSerialization dataWithJSONObject:object options:(NSJSONWritingOptions)0 error:nil];
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": @"application/json"}];
+    [self measureBlock:^{
+        for (NSUInteger idx = 0; idx < 10; idx++) {
+            [self.responseSerializer responseObjectForResponse:response data:data error:nil];
+        }
+    }];
+}
+
+@end
+
+#pragma mark -
+
+@interface AFJSONStreamParserTests : AFTestCase
+@end
+
+@implementation AFJSONStreamParserTests
+
+- (void)testThatStreamParserMatchesNSJSONSerializationWhenFedOneByteAtATime {
+    NSString *string = @"{\"string\": \"a\\\"b\\\\c\\/d\\n\\u00e9\\ud83d\\ude00\u4e2d\", \"numbers\": [0, -1, 1.5, -2.5e3, 9223372036854775807], \"literals\": [true, false, null], \"empty\": [{}, []]}";
+    NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding];
+
+    AFJSONStreamParser *parser = [[AFJSONStreamParser alloc] init];
+    for (NSUInteger idx = 0; idx < [data length]; idx++) {
+        XCTAssertTrue([parser parseData:[data subdataWithRange:NSMakeRange(idx, 1)] error:nil]);
+    }
+
+    NSError *error = nil;
+    id document = [parser finishParsingWithError:&error];
+
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(document, [NSJSONSerialization JSONObjectWithData:data options:(NSJSONReadingOptions)0 error:nil]);
+}
+
+- (void)testThatStreamParserParsesIntegersBeyondLongLongAsUnsigned {
+    AFJSONStreamParser *parser = [[AFJSONStreamParser alloc] init];
+    XCTAssertTrue([parser parseData:[@"[18446744073709551615]" dataUsingEncoding:NSUTF8StringEncoding] error:nil]);
+
+    XCTAssertEqual([[parser finishParsingWithError:nil][0] unsignedLongLongValue], UINT64_MAX);
+}
+
+- (void)testThatStreamParserHandsOutElementsOfArrayAtKeyPath {
+    NSData *data = [@"{\"data\": {\"cursor\": \"next\", \"posts\": [{\"id\": 1, \"tags\": [\"a\"]}, {\"id\": 2, \"tags\": []}]}}" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSMutableArray *posts = [NSMutableArray array];
+    AFJSONStreamParser *parser = [[AFJSONStreamParser alloc] init];
+    [parser setElementHandler:^(id element, __unused BOOL *stop) {
+        [posts addObject:element];
+    } forArrayAtKeyPath:@"data.posts"];
+
+    XCTAssertTrue([parser parseData:[data subdataWithRange:NSMakeRange(0, 62)] error:nil]);
+    XCTAssertEqualObjects(posts, (@[@{@"id": @1, @"tags": @[@"a"]}]));
+    XCTAssertTrue([parser parseData:[data subdataWithRange:NSMakeRange(62, [data length] - 62)] error:nil]);
+
+    id document = [parser finishParsingWithError:nil];
+    XCTAssertEqualObjects(posts, (@[@{@"id": @1, @"tags": @[@"a"]}, @{@"id": @2, @"tags": @[]}]));
+    XCTAssertEqualObjects(document, (@{@"data": @{@"cursor": @"next", @"posts": @[]}}));
+}
+
+- (void)testThatStreamParserHandsOutElementsOfTopLevelArrayButNotOfNestedArrays {
+    NSData *data = [@"[[1, 2], [3]]" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSMutableArray *elements = [NSMutableArray array];
+    AFJSONStreamParser *parser = [[AFJSONStreamParser alloc] init];
+    [parser setElementHandler:^(id element, __unused BOOL *stop) {
+        [elements addObject:element];
+    } forArrayAtKeyPath:@""];
+
+    XCTAssertTrue([parser parseData:data error:nil]);
+    XCTAssertEqualObjects([parser finishParsingWithError:nil], @[]);
+    XCTAssertEqualObjects(elements, (@[@[@1, @2], @[@3]]));
+}
+
+- (void)testThatStoppingElementHandlerCancelsParsing {
+    NSData *data = [@"[1, 2, 3]" dataUsingEncoding:NSUTF8StringEncoding];
+
+    __block NSUInteger numberOfElements = 0;
+    AFJSONStreamParser *parser = [[AFJSONStreamParser alloc] init];
+    [parser setElementHandler:^(__unused id element, BOOL *stop) {
+        numberOfElements++;
+        *stop = YES;
+    } forArrayAtKeyPath:@""];
+
+    NSError *error = nil;
+    XCTAssertFalse([parser parseData:data error:&error]);
+    XCTAssertEqual(numberOfElements, 1);
+    XCTAssertEqualObjects(error.domain, NSURLErrorDomain);
+    XCTAssertEqual(error.code, NSURLErrorCancelled);
+}
+
+- (void)testThatStreamParserReturnsErrorForInvalidJSON {
+    for (NSString *string in @[@"{\"a\" 1}", @"[1,]", @"[01]", @"[tru]", @"\"\\ud800\"", @"[1] 2", @"{\"a\": [1, 2"]) {
+        AFJSONStreamParser *parser = [[AFJSONStreamParser alloc] init];
+        NSError *error = nil;
+        [parser parseData:[string dataUsingEncoding:NSUTF8StringEncoding] error:&error];
+        id document = [parser finishParsingWithError:&error];
+
+        XCTAssertNil(document, @"%@", string);
+        XCTAssertEqualObjects(error.domain, AFURLResponseSerializationErrorDomain, @"%@", string);
+        XCTAssertEqual(error.code, NSURLErrorCannotParseResponse, @"%@", string);
+    }
+}
+
+- (void)testThatStreamParserReturnsNilObjectAndNilErrorForWhitespace {
+    AFJSONStreamParser *parser = [[AFJSONStreamParser alloc] init];
+    XCTAssertTrue([parser parseData:[NSData dataWithBytes:" " length:1] error:nil]);
+
+    NSError *error = nil;
+    XCTAssertNil([parser finishParsingWithError:&error]);
+    XCTAssertNil(error);
+}
+
+- (void)testThatStreamParserParsesTopLevelNumberAtEndOfData {
+    AFJSONStreamParser *parser = [[AFJSONStreamParser alloc] init];
+    XCTAssertTrue([parser parseData:[@"42" dataUsingEncoding:NSUTF8StringEncoding] error:nil]);
+
+    XCTAssertEqualObjects([parser finishParsingWithError:nil], @42);
+}
+
+#pragma mark -
+
+- (void)testPerformanceOfStreamingStringHeavyDocument {
+    NSData *data = [NSJSONSerialization dataWithJSONObject:AFJSONStringHeavyDocument() options:(NSJSONWritingOptions)0 error:nil];
+    [self measureBlock:^{
+        AFJSONStreamParser *parser = [[AFJSONStreamParser alloc] init];
+        [parser setElementHandler:^(__unused id element, __unused BOOL *stop) {} forArrayAtKeyPath:@"strings"];
+        for (NSUInteger offset = 0; offset < [data length]; offset += 16 * 1024) {
+            [parser parseData:[data subdataWithRange:NSMakeRange(offset, MIN(16 * 1024, [data length] - offset))] error:nil];
+        }
+        [parser finishParsingWithError:nil];
+    }];
+}
+
+- (void)testPerformanceOfStreamingWideDocument {
+    NSData *data = [NSJSONSerialization dataWithJSONObject:AFJSONWideDocument() options:(NSJSONWritingOptions)0 error:nil];
+    [self measureBlock:^{
+        AFJSONStreamParser *parser = [[AFJSONStreamParser alloc] init];
+        for (NSUInteger offset = 0; offset < [data length]; offset += 16 * 1024) {
+            [parser parseData:[data subdataWithRange:NSMakeRange(offset, MIN(16 * 1024, [data length] - offset))] error:nil];
+        }
+        [parser finishParsingWithError:nil];
+    }];
+}
+
+@end
+
+#pragma mark -
+
+@interface AFJSONLinesSerializationTests : AFTestCase
+@end
+
+@implementation AFJSONLinesSerializationTests
+
+- (void)testThatJSONLinesResponseSerializerAcceptsNDJSONMimeTypes {
+    AFJSONLinesResponseSerializer *responseSerializer = [AFJSONLinesResponseSerializer serializer];
+    for (NSString *contentType in @[@"application/x-ndjson", @"application/ndjson", @"application/jsonl", @"application/x-jsonlines"]) {
+        NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": contentType}];
+
+        NSError *error = nil;
+        [responseSerializer validateResponse:response data:AFJSONTestData() error:&error];
+
+        XCTAssertNil(error, @"Error handling %@", contentType);
+    }
+}
+
+- (void)testThatJSONLinesResponseSerializerReturnsRecordsSkippingBlankLines {
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": @"application/x-ndjson"}];
+    NSData *data = [@"{\"id\": 1}\r\n\n  \n\"two\"\n3" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSError *error = nil;
+    id responseObject = [[AFJSONLinesResponseSerializer serializer] responseObjectForResponse:response data:data error:&error];
+
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(responseObject, (@[@{@"id": @1}, @"two", @3]));
+}
+
+- (void)testThatJSONLinesResponseSerializerReportsLineOfInvalidRecord {
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": @"application/x-ndjson"}];
+    NSData *data = [@"1\n\n{\n" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSError *error = nil;
+    id responseObject = [[AFJSONLinesResponseSerializer serializer] responseObjectForResponse:response data:data error:&error];
+
+    XCTAssertNil(responseObject);
+    XCTAssertEqual(error.code, NSURLErrorCannotParseResponse);
+    XCTAssertTrue([error.localizedFailureReason containsString:@"line 3"]);
+}
+
+- (void)testThatJSONLinesStreamParserSplitsRecordsAcrossChunks {
+    NSData *data = [@"{\"id\": 1}\n{\"id\": 2}\n\n{\"id\": 3}" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSMutableArray *records = [NSMutableArray array];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Records should be delivered"];
+    AFJSONLinesStreamParser *parser = [[AFJSONLinesStreamParser alloc] initWithRecordsHandler:^(NSArray *batch) {
+        [records addObjectsFromArray:batch];
+        if ([records count] == 3) {
+            [expectation fulfill];
+        }
+    } queue:nil];
+
+    for (NSUInteger idx = 0; idx < [data length]; idx++) {
+        XCTAssertTrue([parser parseData:[data subdataWithRange:NSMakeRange(idx, 1)] error:nil]);
+    }
+    XCTAssertEqualObjects([parser finishParsingWithError:nil], @3);
+    [self waitForExpectationsWithCommonTimeout];
+
+    XCTAssertEqualObjects(records, (@[@{@"id": @1}, @{@"id": @2}, @{@"id": @3}]));
+}
+
+- (void)testThatJSONLinesStreamParserDeliversConcurrentlyParsedBatchesInOrder {
+    NSMutableString *string = [NSMutableString string];
+    for (NSUInteger idx = 0; idx < 1000; idx++) {
+        [string appendFormat:@"{\"id\": %lu}\n", (unsigned long)idx];
+    }
+
+    NSMutableArray *records = [NSMutableArray array];
+    __block NSUInteger maximumBatchCount = 0;
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Records should be delivered"];
+    AFJSONLinesStreamParser *parser = [[AFJSONLinesStreamParser alloc] initWithRecordsHandler:^(NSArray *batch) {
+        maximumBatchCount = MAX(maximumBatchCount, [batch count]);
+        [records addObjectsFromArray:batch];
+        if ([records count] == 1000) {
+            [expectation fulfill];
+        }
+    } queue:dispatch_queue_create("com.alamofire.tests.jsonlines", DISPATCH_QUEUE_SERIAL)];
+    parser.batchSize = 64;
+    parser.parsesBatchesConcurrently = YES;
+
+    XCTAssertTrue([parser parseData:[string dataUsingEncoding:NSUTF8StringEncoding] error:nil]);
+    XCTAssertEqualObjects([parser finishParsingWithError:nil], @1000);
+    [self waitForExpectationsWithCommonTimeout];
+
+    XCTAssertLessThanOrEqual(maximumBatchCount, 64);
+    for (NSUInteger idx = 0; idx < [records count]; idx++) {
+        XCTAssertEqual([records[idx][@"id"] unsignedIntegerValue], idx);
+    }
+}
+
+- (void)testThatJSONLinesStreamParserFinishesAfterLastRecordsAreDelivered {
+    NSMutableArray *records = [NSMutableArray array];
+    AFJSONLinesStreamParser *parser = [[AFJSONLinesStreamParser alloc] initWithRecordsHandler:^(NSArray *batch) {
+        [NSThread sleepForTimeInterval:0.05];
+        @synchronized (records) {
+            [records addObjectsFromArray:batch];
+        }
+    } queue:dispatch_queue_create("com.alamofire.tests.jsonlines", DISPATCH_QUEUE_SERIAL)];
+    parser.batchSize = 2;
+
+    XCTAssertTrue([parser parseData:[@"1\n2\n3\n4\n5" dataUsingEncoding:NSUTF8StringEncoding] error:nil]);
+    XCTAssertEqualObjects([parser finishParsingWithError:nil], @5);
+
+    @synchronized (records) {
+        XCTAssertEqualObjects(records, (@[@1, @2, @3, @4, @5]));
+    }
+}
+
+- (void)testThatJSONLinesStreamParserFinishesAsynchronouslyAfterLastRecordsAreDelivered {
+    NSMutableArray *records = [NSMutableArray array];
+    dispatch_queue_t queue = dispatch_queue_create("com.alamofire.tests.jsonlines", DISPATCH_QUEUE_SERIAL);
+    AFJSONLinesStreamParser *parser = [[AFJSONLinesStreamParser alloc] initWithRecordsHandler:^(NSArray *batch) {
+        [NSThread sleepForTimeInterval:0.05];
+        @synchronized (records) {
+            [records addObjectsFromArray:batch];
+        }
+    } queue:queue];
+    parser.batchSize = 2;
+
+    XCTAssertTrue([parser parseData:[@"1\n2\n3\n4\n5" dataUsingEncoding:NSUTF8StringEncoding] error:nil]);
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Parsing should finish"];
+    [parser finishParsingWithCompletionHandler:^(id responseObject, NSError *error) {
+        XCTAssertEqualObjects(responseObject, @5);
+        XCTAssertNil(error);
+        @synchronized (records) {
+            XCTAssertEqualObjects(records, (@[@1, @2, @3, @4, @5]));
+        }
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+}
+
+- (void)testThatJSONLinesStreamParserRequestsSuspensionWhenRecordsHandlerFallsBehind {
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    AFJSONLinesStreamParser *parser = [[AFJSONLinesStreamParser alloc] initWithRecordsHandler:^(__unused NSArray *batch) {
+        dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+    } queue:dispatch_queue_create("com.alamofire.tests.jsonlines", DISPATCH_QUEUE_SERIAL)];
+    parser.maximumNumberOfPendingBatches = 2;
+
+    NSMutableArray *requests = [NSMutableArray array];
+    __block XCTestExpectation *suspensionExpectation = [self expectationWithDescription:@"Transfer should be suspended"];
+    __block XCTestExpectation *resumptionExpectation = nil;
+    [parser setBackpressureHandler:^(BOOL shouldSuspend) {
+        @synchronized (requests) {
+            [requests addObject:@(shouldSuspend)];
+        }
+        [(shouldSuspend ? suspensionExpectation : resumptionExpectation) fulfill];
+    }];
+
+    XCTAssertTrue([parser parseData:[@"1\n" dataUsingEncoding:NSUTF8StringEncoding] error:nil]);
+    XCTAssertTrue([parser parseData:[@"2\n" dataUsingEncoding:NSUTF8StringEncoding] error:nil]);
+    [self waitForExpectationsWithCommonTimeout];
+    @synchronized (requests) {
+        XCTAssertEqualObjects(requests, @[@YES]);
+    }
+
+    // The records handler is blocked, so the transfer cannot be resumed before this expectation exists.
+    resumptionExpectation = [self expectationWithDescription:@"Transfer should be resumed"];
+    dispatch_semaphore_signal(semaphore);
+    dispatch_semaphore_signal(semaphore);
+    [self waitForExpectationsWithCommonTimeout];
+
+    @synchronized (requests) {
+        XCTAssertEqualObjects(requests, (@[@YES, @NO]));
+    }
+}
+
+- (void)testThatJSONLinesStreamParserFailsOnInvalidRecord {
+    AFJSONLinesStreamParser *parser = [[AFJSONLinesStreamParser alloc] initWithRecordsHandler:^(__unused NSArray *batch) {} queue:nil];
+
+    NSError *error = nil;
+    XCTAssertFalse([parser parseData:[@"1\n{\n" dataUsingEncoding:NSUTF8StringEncoding] error:&error]);
+    XCTAssertEqual(error.code, NSURLErrorCannotParseResponse);
+    XCTAssertNil([parser finishParsingWithError:nil]);
+}
+
+@end
+
+#pragma mark -
+
+@interface AFJSONTestUser : NSObject <AFJSONModel>
+@property (nonatomic, assign) NSUInteger userID;
+@property (nonatomic, copy) NSString *username;
+@property (nonatomic, strong) NSURL *avatarImageURL;
+- (instancetype)initWithAttributes:(NSDictionary *)attributes;
+@end
+
+@implementation AFJSONTestUser
+
++ (NSDictionary <NSString *, NSString *> *)JSONKeyPathsByPropertyKey {
+    return @{@"userID": @"id", @"username": @"username", @"avatarImageURL": @"avatar_image.url"};
+}
+
+- (instancetype)initWithAttributes:(NSDictionary *)attributes {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.userID = [attributes[@"id"] unsignedIntegerValue];
+    self.username = attributes[@"username"];
+    NSString *avatarImageURLString = attributes[@"avatar_image"][@"url"];
+    self.avatarImageURL = avatarImageURLString ? [NSURL URLWithString:avatarImageURLString] : nil;
+
+    return self;
+}
+
+@end
+
+@interface AFJSONTestPost : NSObject <AFJSONModel>
+@property (nonatomic, assign) NSUInteger postID;
+@property (nonatomic, copy) NSString *text;
+@property (nonatomic, strong) AFJSONTestUser *user;
+- (instancetype)initWithAttributes:(NSDictionary *)attributes;
+@end
+
+@implementation AFJSONTestPost
+
++ (NSDictionary <NSString *, NSString *> *)JSONKeyPathsByPropertyKey {
+    return @{@"postID": @"id", @"text": @"text", @"user": @"user"};
+}
+
+- (instancetype)initWithAttributes:(NSDictionary *)attributes {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.postID = [attributes[@"id"] unsignedIntegerValue];
+    self.text = attributes[@"text"];
+    self.user = [[AFJSONTestUser alloc] initWithAttributes:attributes[@"user"]];
+
+    return self;
+}
+
+@end
+
+@interface AFJSONTestValues : NSObject <AFJSONModel>
+@property (nonatomic, assign) char charValue;
+@property (nonatomic, assign) unsigned short unsignedShortValue;
+@property (nonatomic, assign) int intValue;
+@property (nonatomic, assign) long long longLongValue;
+@property (nonatomic, assign) unsigned long long unsignedLongLongValue;
+@property (nonatomic, assign) BOOL boolValue;
+@property (nonatomic, assign) float floatValue;
+@property (nonatomic, assign) double doubleValue;
+@property (nonatomic, strong) NSNumber *number;
+@property (nonatomic, copy) NSString *string;
+@property (nonatomic, strong) NSMutableString *mutableString;
+@property (nonatomic, copy) NSArray *array;
+@property (nonatomic, strong) NSMutableDictionary *mutableDictionary;
+@property (nonatomic, strong) id value;
+@property (nonatomic, copy) NSArray <AFJSONTestUser *> *users;
+@property (nonatomic, copy, getter=isNamed, setter=markNamed:) NSString *name;
+@property (readonly, nonatomic, copy) NSString *readonlyString;
+@property (readonly, nonatomic, copy) NSString *computedString;
+@end
+
+@implementation AFJSONTestValues
+
++ (NSDictionary <NSString *, NSString *> *)JSONKeyPathsByPropertyKey {
+    NSMutableDictionary *keyPathsByPropertyKey = [NSMutableDictionary dictionary];
+    for (NSString *propertyKey in @[@"charValue", @"unsignedShortValue", @"intValue", @"longLongValue", @"unsignedLongLongValue", @"boolValue", @"floatValue", @"doubleValue", @"number", @"string", @"mutableString", @"array", @"mutableDictionary", @"value", @"users", @"name", @"readonlyString", @"computedString"]) {
+        keyPathsByPropertyKey[propertyKey] = propertyKey;
+    }
+
+    return keyPathsByPropertyKey;
+}
+
++ (NSDictionary <NSString *, Class> *)JSONModelClassesByPropertyKey {
+    return @{@"users": [AFJSONTestUser class]};
+}
+
+- (NSString *)computedString {
+    return [self.string uppercaseString];
+}
+
+@end
+
+@interface AFJSONModelResponseSerializerTests : AFTestCase
+@property (nonatomic, strong) AFJSONModelResponseSerializer *responseSerializer;
+@property (nonatomic, strong) NSHTTPURLResponse *response;
+@end
+
+@implementation AFJSONModelResponseSerializerTests
+
+- (void)setUp {
+    [super setUp];
+    self.responseSerializer = [AFJSONModelResponseSerializer serializerWithModelClass:[AFJSONTestPost class] rootKeyPath:@"data"];
+    self.response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": @"application/json"}];
+}
+
+#pragma mark -
+
+- (void)testThatModelSerializerDecodesModelsAtRootKeyPath {
+    NSString *string = @"{\"meta\":{\"skipped\":[1,{\"a\":[]}]},\"data\":[{\"id\":1,\"text\":\"Hello\",\"extra\":{\"deep\":[null,true]},\"user\":{\"id\":7,\"username\":\"mattt\",\"avatar_image\":{\"url\":\"http://example.com/a.png\",\"width\":48}}},null,{\"id\":2,\"text\":\"W\\u00f6rld\",\"user\":{\"id\":7,\"username\":\"mattt\"}}],\"count\":2}";
+
+    NSError *error = nil;
+    NSArray <AFJSONTestPost *> *posts = [self.responseSerializer responseObjectForResponse:self.response data:[string dataUsingEncoding:NSUTF8StringEncoding] error:&error];
+    XCTAssertNil(error);
+    XCTAssertEqual([posts count], 2);
+
+    XCTAssertEqual(posts[0].postID, 1);
+    XCTAssertEqualObjects(posts[0].text, @"Hello");
+    XCTAssertEqual(posts[0].user.userID, 7);
+    XCTAssertEqualObjects(posts[0].user.username, @"mattt");
+    XCTAssertEqualObjects(posts[0].user.avatarImageURL, [NSURL URLWithString:@"http://example.com/a.png"]);
+
+    XCTAssertEqual(posts[1].postID, 2);
+    XCTAssertEqualObjects(posts[1].text, @"W\u00f6rld");
+    XCTAssertNil(posts[1].user.avatarImageURL);
+}
+
+- (void)testThatModelSerializerInternsRepeatedStrings {
+    NSString *string = @"{\"data\":[{\"id\":1,\"user\":{\"username\":\"mattt\"}},{\"id\":2,\"user\":{\"username\":\"mattt\"}}]}";
+
+    NSArray <AFJSONTestPost *> *posts = [self.responseSerializer responseObjectForResponse:self.response data:[string dataUsingEncoding:NSUTF8StringEncoding] error:nil];
+    XCTAssertEqual([posts count], 2);
+    XCTAssertEqual(posts[0].user.username, posts[1].user.username);
+}
+
+- (void)testThatModelSerializerDecodesSingleObjectWithoutRootKeyPath {
+    self.responseSerializer.rootKeyPath = nil;
+
+    AFJSONTestPost *post = [self.responseSerializer responseObjectForResponse:self.response data:[@" {\"id\":3,\"text\":\"root\"} " dataUsingEncoding:NSUTF8StringEncoding] error:nil];
+    XCTAssert([post isKindOfClass:[AFJSONTestPost class]]);
+    XCTAssertEqual(post.postID, 3);
+    XCTAssertEqualObjects(post.text, @"root");
+    XCTAssertNil(post.user);
+}
+
+- (void)testThatModelSerializerSetsPropertiesOfAllSupportedTypes {
+    self.responseSerializer.modelClass = [AFJSONTestValues class];
+    self.responseSerializer.rootKeyPath = nil;
+    NSString *string = @"{\"charValue\":65,\"unsignedShortValue\":65535,\"intValue\":-42,\"longLongValue\":-9223372036854775808,\"unsignedLongLongValue\":18446744073709551615,\"boolValue\":true,\"floatValue\":1.5,\"doubleValue\":2.5e3,\"number\":12,\"string\":\"s\",\"mutableString\":\"m\",\"array\":[1,\"two\",{\"three\":3}],\"mutableDictionary\":{\"key\":null},\"value\":[false],\"users\":[{\"id\":1},null,{\"id\":2}],\"name\":\"named\",\"readonlyString\":\"readonly\",\"computedString\":\"computed\"}";
+
+    NSError *error = nil;
+    AFJSONTestValues *values = [self.responseSerializer responseObjectForResponse:self.response data:[string dataUsingEncoding:NSUTF8StringEncoding] error:&error];
+    XCTAssertNil(error);
+    XCTAssertEqual(values.charValue, 'A');
+    XCTAssertEqual(values.unsignedShortValue, 65535);
+    XCTAssertEqual(values.intValue, -42);
+    XCTAssertEqual(values.longLongValue, LLONG_MIN);
+    XCTAssertEqual(values.unsignedLongLongValue, ULLONG_MAX);
+    XCTAssertTrue(values.boolValue);
+    XCTAssertEqual(values.floatValue, 1.5f);
+    XCTAssertEqual(values.doubleValue, 2500.0);
+    XCTAssertEqualObjects(values.number, @12);
+    XCTAssertEqualObjects(values.string, @"s");
+    XCTAssertEqualObjects(values.mutableString, @"m");
+    XCTAssertNoThrow([values.mutableString appendString:@"utable"]);
+    XCTAssertEqualObjects(values.array, (@[@1, @"two", @{@"three": @3}]));
+    XCTAssertEqualObjects(values.mutableDictionary, @{@"key": [NSNull null]});
+    XCTAssertNoThrow([values.mutableDictionary removeAllObjects]);
+    XCTAssertEqualObjects(values.value, @[@NO]);
+    XCTAssertEqual([values.users count], 2);
+    XCTAssertEqual(values.users[1].userID, 2);
+    XCTAssertEqualObjects(values.isNamed, @"named");
+    XCTAssertEqualObjects(values.readonlyString, @"readonly");
+    XCTAssertEqualObjects(values.computedString, @"S");
+}
+
+- (void)testThatModelSerializerLeavesPropertiesUntouchedForNullAndMismatchedValues {
+    self.responseSerializer.modelClass = [AFJSONTestValues class];
+    self.responseSerializer.rootKeyPath = nil;
+    NSString *string = @"{\"intValue\":\"1\",\"boolValue\":null,\"number\":\"12\",\"string\":12,\"array\":{\"a\":1},\"mutableDictionary\":[],\"value\":null,\"users\":\"none\"}";
+
+    NSError *error = nil;
+    AFJSONTestValues *values = [self.responseSerializer responseObjectForResponse:self.response data:[string dataUsingEncoding:NSUTF8StringEncoding] error:&error];
+    XCTAssertNil(error);
+    XCTAssertEqual(values.intValue, 0);
+    XCTAssertFalse(values.boolValue);
+    XCTAssertNil(values.number);
+    XCTAssertNil(values.string);
+    XCTAssertNil(values.array);
+    XCTAssertNil(values.mutableDictionary);
+    XCTAssertNil(values.value);
+    XCTAssertNil(values.users);
+}
+
+- (void)testThatModelSerializerReportsInvalidJSON {
+    for (NSString *string in @[@"{", @"{\"data\":[1,]}", @"{\"data\":{\"id\":}}", @"{\"data\":{\"id\":1,}}", @"{\"data\":{\"id\":01}}", @"{\"data\":{\"id\":tru}}", @"{\"data\":{\"unmapped\":tru}}", @"{\"data\":{\"unmapped\":[1,{\"a\":nul}]}}", @"{\"data\":{\"unmapped\":01}}", @"{\"data\":[]}x", @"{\"data\":[]]", @"{\"data\":{\"text\":\"\\x\"}}", @"{\"other\":[]}", @"{\"data\":1}", @"[]"]) {
+        NSError *error = nil;
+        id responseObject = [self.responseSerializer responseObjectForResponse:self.response data:[string dataUsingEncoding:NSUTF8StringEncoding] error:&error];
+        XCTAssertNil(responseObject, @"%@", string);
+        XCTAssertNotNil(error, @"%@", string);
+        XCTAssertEqualObjects(error.domain, AFURLResponseSerializationErrorDomain, @"%@", string);
+    }
+}
+
+- (void)testThatModelSerializerSetsNumbersLongerThanSixtyFourCharacters {
+    self.responseSerializer.modelClass = [AFJSONTestValues class];
+    self.responseSerializer.rootKeyPath = nil;
+    NSString *zeros = [@"" stringByPaddingToLength:70 withString:@"0" startingAtIndex:0];
+    NSString *string = [NSString stringWithFormat:@"{\"doubleValue\":1.%@1e2,\"longLongValue\":-42.%@}", zeros, zeros];
+
+    NSError *error = nil;
+    AFJSONTestValues *values = [self.responseSerializer responseObjectForResponse:self.response data:[string dataUsingEncoding:NSUTF8StringEncoding] error:&error];
+    XCTAssertNil(error);
+    XCTAssertEqual(values.doubleValue, 100.0);
+    XCTAssertEqual(values.longLongValue, -42);
+}
+
+- (void)testThatModelSerializerWithoutModelClassBehavesLikeJSONSerializer {
+    self.responseSerializer.modelClass = nil;
+
+    NSDictionary *responseObject = [self.responseSerializer responseObjectForResponse:self.response data:AFJSONTestData() error:nil];
+    XCTAssertEqualObjects(responseObject, @{@"foo": @"bar"});
+}
+
+- (void)testThatModelSerializerCanBeCopiedAndArchived {
+    AFJSONModelResponseSerializer *copiedSerializer = [self.responseSerializer copy];
+    XCTAssertEqual(copiedSerializer.modelClass, [AFJSONTestPost class]);
+    XCTAssertEqualObjects(copiedSerializer.rootKeyPath, @"data");
+
+    AFJSONModelResponseSerializer *unarchivedSerializer = [NSKeyedUnarchiver unarchiveObjectWithData:[NSKeyedArchiver archivedDataWithRootObject:self.responseSerializer]];
+    XCTAssertEqual(unarchivedSerializer.modelClass, [AFJSONTestPost class]);
+    XCTAssertEqualObjects(unarchivedSerializer.rootKeyPath, @"data");
+}
+
+- (void)testThatModelSerializerIsNotUnarchivedWithClassNotAdoptingModelProtocol {
+    self.responseSerializer.modelClass = [NSString class];
+
+    XCTAssertNil([NSKeyedUnarchiver unarchiveObjectWithData:[NSKeyedArchiver archivedDataWithRootObject:self.responseSerializer]]);
+}
+
+#pragma mark -
+
+- (void)testPerformanceOfDirectModelDecoding {
+    NSData *data = [self postsData];
+    [self measureBlock:^{
+        for (NSUInteger idx = 0; idx < 10; idx++) {
+            [self.responseSerializer responseObjectForResponse:self.response data:data error:nil];
+        }
+    }];
+}
+
+- (void)testPerformanceOfTwoStepModelDecoding {
+    NSData *data = [self postsData];
+    AFJSONResponseSerializer *JSONSerializer = [AFJSONResponseSerializer serializer];
+    [self measureBlock:^{
+        for (NSUInteger idx = 0; idx < 10; idx++) {
+            [self postsWithAttributes:[JSONSerializer responseObjectForResponse:self.response data:data error:nil]];
+        }
+    }];
+}
+
+- (void)testThatDirectModelDecodingKeepsFewerBlocksAliveThanTwoStepDecoding {
+    NSData *data = [self postsData];
+    AFJSONResponseSerializer *JSONSerializer = [AFJSONResponseSerializer serializer];
+
+    // Warm up the schema cache and class realization so that neither side pays for them.
+    [self.responseSerializer responseObjectForResponse:self.response data:data error:nil];
+    [self postsWithAttributes:[JSONSerializer responseObjectForResponse:self.response data:data error:nil]];
+
+    // Every step drains its own pool, so only what the step returns is counted. The two-step path needs the whole dictionary tree alive while it builds the models, so the tree is part of its peak.
+    NSInteger baseline = AFJSONTestNumberOfBlocksInUse();
+    NSArray *directPosts = nil;
+    @autoreleasepool {
+        directPosts = [self.responseSerializer responseObjectForResponse:self.response data:data error:nil];
+    }
+    NSInteger numberOfDirectBlocks = AFJSONTestNumberOfBlocksInUse() - baseline;
+
+    baseline = AFJSONTestNumberOfBlocksInUse();
+    NSDictionary *attributes = nil;
+    NSArray *twoStepPosts = nil;
+    @autoreleasepool {
+        attributes = [JSONSerializer responseObjectForResponse:self.response data:data error:nil];
+    }
+    @autoreleasepool {
+        twoStepPosts = [self postsWithAttributes:attributes];
+    }
+    NSInteger numberOfTwoStepBlocks = AFJSONTestNumberOfBlocksInUse() - baseline;
+
+    XCTAssertEqual([directPosts count], 5000);
+    XCTAssertEqual([twoStepPosts count], 5000);
+    XCTAssertGreaterThan(numberOfDirectBlocks, 0);
+    XCTAssertLessThan(numberOfDirectBlocks, numberOfTwoStepBlocks);
+}
+
+#pragma mark - Helper Methods
+
+- (NSData *)postsData {
+    NSMutableArray *posts = [NSMutableArray array];
+    for (NSUInteger idx = 0; idx < 5000; idx++) {
+        [posts addObject:@{@"id": @(idx), @"text": [NSString stringWithFormat:@"Post %lu", (unsigned long)idx], @"created_at": @"2016-01-01T00:00:00Z", @"likes": @(idx % 100), @"tags": @[@"swift", @"ios"], @"user": @{@"id": @(idx % 20), @"username": [NSString stringWithFormat:@"user%lu", (unsigned long)(idx % 20)], @"avatar_image": @{@"url": @"http://example.com/avatar.png", @"width": @48, @"height": @48}}}];
+    }
+
+    return [NSJSONSerialization dataWithJSONObject:@{@"data": posts, @"meta": @{@"count": @([posts count])}} options:(NSJSONWritingOptions)0 error:nil];
+}
+
+- (NSArray *)postsWithAttributes:(NSDictionary *)attributes {
+    NSMutableArray *posts = [NSMutableArray array];
+    for (NSDictionary *postAttributes in attributes[@"data"]) {
+        [posts addObject:[[AFJSONTestPost alloc] initWithAttributes:postAttributes]];
+    }
+
+    return posts;
 }
 
 @end
@@ -0,0 +1,283 @@
+// AFMessagePackSerializationTests.m
+// Copyright (c) 2011–2016 Alamofire Software Foundation ( http://alamofire.org/ )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "AFTestCase.h"
+
+#import "AFURLRequestSerialization.h"
+#import "AFURLResponseSerialization.h"
+
+static NSData * AFMessagePackTestData() {
+    const uint8_t bytes[] = {0x81, 0xa3, 'f', 'o', 'o', 0xa3, 'b', 'a', 'r'};
+    return [NSData dataWithBytes:bytes length:sizeof(bytes)];
+}
+
+#pragma mark -
+
+@interface AFMessagePackRequestSerializationTests : AFTestCase
+@property (nonatomic, strong) AFMessagePackRequestSerializer *requestSerializer;
+@end
+
+@implementation AFMessagePackRequestSerializationTests
+
+- (void)setUp {
+    [super setUp];
+    self.requestSerializer = [AFMessagePackRequestSerializer serializer];
+}
+
+#pragma mark -
+
+- (void)testThatMessagePackRequestSerializationHandlesParametersDictionary {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+
+    NSError *error = nil;
+    NSURLRequest *serializedRequest = [self.requestSerializer requestBySerializingRequest:request withParameters:@{@"a": @1} error:&error];
+
+    const uint8_t expectedBytes[] = {0x81, 0xa1, 'a', 0x01};
+    XCTAssertNil(error);
+    XCTAssertEqualObjects([serializedRequest valueForHTTPHeaderField:@"Content-Type"], @"application/msgpack");
+    XCTAssertEqualObjects(serializedRequest.HTTPBody, [NSData dataWithBytes:expectedBytes length:sizeof(expectedBytes)]);
+}
+
+- (void)testThatMessagePackRequestSerializationHandlesParametersArray {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+
+    NSError *error = nil;
+    NSURLRequest *serializedRequest = [self.requestSerializer requestBySerializingRequest:request withParameters:@[@-1, @300, @YES, [NSNull null]] error:&error];
+
+    const uint8_t expectedBytes[] = {0x94, 0xff, 0xcd, 0x01, 0x2c, 0xc3, 0xc0};
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(serializedRequest.HTTPBody, [NSData dataWithBytes:expectedBytes length:sizeof(expectedBytes)]);
+}
+
+- (void)testThatMessagePackRequestSerializationEncodesDecimalNumbersAsStrings {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+
+    NSError *error = nil;
+    NSURLRequest *serializedRequest = [self.requestSerializer requestBySerializingRequest:request withParameters:@[[NSDecimalNumber decimalNumberWithString:@"0.10"]] error:&error];
+
+    const uint8_t expectedBytes[] = {0x91, 0xa3, '0', '.', '1'};
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(serializedRequest.HTTPBody, [NSData dataWithBytes:expectedBytes length:sizeof(expectedBytes)]);
+}
+
+- (void)testThatMessagePackRequestSerializationErrorsWithInvalidParameters {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+
+    NSError *error = nil;
+    NSURLRequest *serializedRequest = [self.requestSerializer requestBySerializingRequest:request withParameters:@{@"set": [NSSet setWithObject:@1]} error:&error];
+
+    XCTAssertNil(serializedRequest);
+    XCTAssertEqualObjects(error.domain, AFURLRequestSerializationErrorDomain);
+    XCTAssertEqual(error.code, NSURLErrorCannotDecodeContentData);
+}
+
+- (void)testThatMessagePackRequestSerializationEncodesParametersInURIForGET {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"GET";
+
+    NSURLRequest *serializedRequest = [self.requestSerializer requestBySerializingRequest:request withParameters:@{@"key": @"value"} error:nil];
+
+    XCTAssertEqualObjects(serializedRequest.URL.query, @"key=value");
+    XCTAssertNil(serializedRequest.HTTPBody);
+}
+
+#pragma mark -
+
+- (void)testPerformanceOfWideDocumentSerialization {
+    [self measureRequestSerializationOfParameters:AFJSONWideDocument()];
+}
+
+- (void)testPerformanceOfDeepDocumentSerialization {
+    [self measureRequestSerializationOfParameters:AFJSONDeepDocument()];
+}
+
+- (void)testPerformanceOfStringHeavyDocumentSerialization {
+    [self measureRequestSerializationOfParameters:AFJSONStringHeavyDocument()];
+}
+
+#pragma mark - Helper Methods
+
+- (void)measureRequestSerializationOfParameters:(id)parameters {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+    [self measureBlock:^{
+        for (NSUInteger idx = 0; idx < 10; idx++) {
+            [self.requestSerializer requestBySerializingRequest:request withParameters:parameters error:nil];
+        }
+    }];
+}
+
+@end
+
+#pragma mark -
+
+@interface AFMessagePackResponseSerializationTests : AFTestCase
+@property (nonatomic, strong) AFMessagePackRequestSerializer *requestSerializer;
+@property (nonatomic, strong) AFMessagePackResponseSerializer *responseSerializer;
+@end
+
+@implementation AFMessagePackResponseSerializationTests
+
+- (void)setUp {
+    [super setUp];
+    self.requestSerializer = [AFMessagePackRequestSerializer serializer];
+    self.responseSerializer = [AFMessagePackResponseSerializer serializer];
+}
+
+#pragma mark -
+
+- (void)testThatMessagePackResponseSerializerAcceptsMessagePackMimeTypes {
+    for (NSString *contentType in @[@"application/msgpack", @"application/x-msgpack", @"application/vnd.msgpack"]) {
+        NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": contentType}];
+
+        NSError *error = nil;
+        [self.responseSerializer validateResponse:response data:AFMessagePackTestData() error:&error];
+
+        XCTAssertNil(error, @"Error handling %@", contentType);
+    }
+}
+
+- (void)testThatMessagePackResponseSerializerDoesNotAcceptJSONMimeType {
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": @"application/json"}];
+
+    NSError *error = nil;
+    [self.responseSerializer validateResponse:response data:AFMessagePackTestData() error:&error];
+
+    XCTAssertNotNil(error);
+}
+
+- (void)testThatMessagePackResponseSerializerReturnsDictionaryForValidData {
+    NSHTTPURLResponse *response = [self responseWithContentType:@"application/msgpack"];
+
+    NSError *error = nil;
+    id responseObject = [self.responseSerializer responseObjectForResponse:response data:AFMessagePackTestData() error:&error];
+
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(responseObject, @{@"foo": @"bar"});
+}
+
+- (void)testThatMessagePackResponseSerializerReturnsErrorForTruncatedData {
+    NSData *data = [AFMessagePackTestData() subdataWithRange:NSMakeRange(0, 6)];
+
+    NSError *error = nil;
+    id responseObject = [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/msgpack"] data:data error:&error];
+
+    XCTAssertNil(responseObject);
+    XCTAssertEqualObjects(error.domain, AFURLResponseSerializationErrorDomain);
+    XCTAssertEqual(error.code, NSURLErrorCannotParseResponse);
+}
+
+- (void)testThatMessagePackResponseSerializerReturnsErrorForTrailingData {
+    NSMutableData *data = [AFMessagePackTestData() mutableCopy];
+    [data appendBytes:"\xc0" length:1];
+
+    NSError *error = nil;
+    id responseObject = [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/msgpack"] data:data error:&error];
+
+    XCTAssertNil(responseObject);
+    XCTAssertEqual(error.code, NSURLErrorCannotParseResponse);
+}
+
+- (void)testThatMessagePackResponseSerializerReturnsNilObjectAndNilErrorForEmptyData {
+    NSError *error = nil;
+    id responseObject = [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/msgpack"] data:[NSData data] error:&error];
+
+    XCTAssertNil(responseObject);
+    XCTAssertNil(error);
+}
+
+- (void)testThatMessagePackRoundTripsDocuments {
+    for (id document in @[AFJSONWideDocument(), AFJSONDeepDocument(), AFJSONStringHeavyDocument()]) {
+        XCTAssertEqualObjects([self objectByRoundTrippingObject:document], document);
+    }
+}
+
+- (void)testThatMessagePackRoundTripsDates {
+    NSDate *date = [NSDate dateWithTimeIntervalSince1970:1500000000.25];
+    NSDate *wholeSecondDate = [NSDate dateWithTimeIntervalSince1970:1500000000];
+
+    XCTAssertEqualObjects([self objectByRoundTrippingObject:@[date, wholeSecondDate]], (@[date, wholeSecondDate]));
+}
+
+- (void)testThatMessagePackDecodesBinaryWithoutCopying {
+    const uint8_t bytes[] = {0xc4, 0x03, 0x01, 0x02, 0x03};
+    NSData *data = [NSData dataWithBytes:bytes length:sizeof(bytes)];
+
+    NSData *responseObject = [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/msgpack"] data:data error:nil];
+
+    const uint8_t expectedBytes[] = {0x01, 0x02, 0x03};
+    XCTAssertEqualObjects(responseObject, [NSData dataWithBytes:expectedBytes length:sizeof(expectedBytes)]);
+    XCTAssertEqual((const uint8_t *)[responseObject bytes], (const uint8_t *)[data bytes] + 2);
+}
+
+- (void)testThatMessagePackDecodesLargeUnsignedIntegers {
+    const uint8_t bytes[] = {0xcf, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+    NSNumber *responseObject = [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/msgpack"] data:[NSData dataWithBytes:bytes length:sizeof(bytes)] error:nil];
+
+    XCTAssertEqual([responseObject unsignedLongLongValue], UINT64_MAX);
+}
+
+#pragma mark -
+
+- (void)testPerformanceOfWideDocumentDeserialization {
+    [self measureResponseSerializationOfObject:AFJSONWideDocument()];
+}
+
+- (void)testPerformanceOfDeepDocumentDeserialization {
+    [self measureResponseSerializationOfObject:AFJSONDeepDocument()];
+}
+
+- (void)testPerformanceOfStringHeavyDocumentDeserialization {
+    [self measureResponseSerializationOfObject:AFJSONStringHeavyDocument()];
+}
+
+#pragma mark - Helper Methods
+
+- (NSHTTPURLResponse *)responseWithContentType:(NSString *)contentType {
+    return [[NSHTTPURLResponse alloc] initWithURL:self.baseURL statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": contentType}];
+}
+
+- (id)objectByRoundTrippingObject:(id)object {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+    NSData *data = [self.requestSerializer requestBySerializingRequest:request withParameters:object error:nil].HTTPBody;
+
+    return [self.responseSerializer responseObjectForResponse:[self responseWithContentType:@"application/msgpack"] data:data error:nil];
+}
+
+- (void)measureResponseSerializationOfObject:(id)object {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.baseURL];
+    request.HTTPMethod = @"POST";
+    NSData *data = [self.requestSerializer requestBySerializingRequest:request withParameters:object error:nil].HTTPBody;
+    NSHTTPURLResponse *response = [self responseWithContentType:@"application/msgpack"];
+    [self measureBlock:^{
+        for (NSUInteger idx = 0; idx < 10; idx++) {
+            [self.responseSerializer responseObjectForResponse:response data:data error:nil];
+        }
+    }];
+}
+
+@end
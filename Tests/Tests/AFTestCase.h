@@ -21,6 +21,23 @@
 
 #import <XCTest/XCTest.h>
 
+typedef NSData * (^AFLoopbackHTTPServerHandler)(NSURLRequest *request, NSInteger *statusCode, NSDictionary * __autoreleasing *headers);
+
+//只监听127.0.0.1的简单HTTP服务器，每个连接处理一个请求，请求的body放在request.HTTPBody中
+@interface AFLoopbackHTTPServer : NSObject
+
+@property (nonatomic, strong, readonly) NSURL *baseURL;
+
+- (instancetype)initWithHandler:(AFLoopbackHTTPServerHandler)handler;
+- (void)stop;
+
+@end
+
+//JSON、MessagePack和CBOR序列化性能测试共用的文档
+FOUNDATION_EXPORT NSDictionary * AFJSONWideDocument(void);
+FOUNDATION_EXPORT NSArray * AFJSONDeepDocument(void);
+FOUNDATION_EXPORT NSDictionary * AFJSONStringHeavyDocument(void);
+
 @interface AFTestCase : XCTestCase
 
 @property (nonatomic, strong, readonly) NSURL *baseURL;
@@ -21,6 +21,184 @@
 
 #import "AFTestCase.h"
 
+#import <netinet/in.h>
+#import <sys/socket.h>
+#import <unistd.h>
+
+@interface AFLoopbackHTTPServer ()
+@property (nonatomic, strong, readwrite) NSURL *baseURL;
+@property (nonatomic, copy) AFLoopbackHTTPServerHandler handler;
+@property (nonatomic, strong) dispatch_source_t listeningSource;
+@end
+
+@implementation AFLoopbackHTTPServer
+
+- (instancetype)initWithHandler:(AFLoopbackHTTPServerHandler)handler {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    self.handler = handler;
+    int listeningSocket = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    socklen_t addressLength = sizeof(address);
+    if (bind(listeningSocket, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listeningSocket, 128) != 0 || getsockname(listeningSocket, (struct sockaddr *)&address, &addressLength) != 0) {
+        close(listeningSocket);
+        return nil;
+    }
+
+    self.baseURL = [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1:%d", ntohs(address.sin_port)]];
+
+    AFLoopbackHTTPServerHandler serverHandler = self.handler;
+    Class serverClass = [self class];
+    self.listeningSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, (uintptr_t)listeningSocket, 0, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+    dispatch_source_set_event_handler(self.listeningSource, ^{
+        int connection = accept(listeningSocket, NULL, NULL);
+        if (connection < 0) {
+            return;
+        }
+
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            [serverClass handleConnection:connection handler:serverHandler];
+            close(connection);
+        });
+    });
+    dispatch_source_set_cancel_handler(self.listeningSource, ^{
+        close(listeningSocket);
+    });
+    dispatch_resume(self.listeningSource);
+
+    return self;
+}
+
+- (void)dealloc {
+    [self stop];
+}
+
+- (void)stop {
+    if (self.listeningSource) {
+        dispatch_source_cancel(self.listeningSource);
+        self.listeningSource = nil;
+    }
+}
+
++ (BOOL)readFromConnection:(int)connection
+                  intoData:(NSMutableData *)data
+{
+    uint8_t buffer[64 * 1024];
+    ssize_t numberOfBytesRead = recv(connection, buffer, sizeof(buffer), 0);
+    if (numberOfBytesRead <= 0) {
+        return NO;
+    }
+
+    [data appendBytes:buffer length:(NSUInteger)numberOfBytesRead];
+
+    return YES;
+}
+
++ (void)handleConnection:(int)connection
+                 handler:(AFLoopbackHTTPServerHandler)handler
+{
+    NSMutableData *data = [NSMutableData data];
+    NSData *separator = [@"\r\n\r\n" dataUsingEncoding:NSASCIIStringEncoding];
+    NSRange separatorRange = NSMakeRange(NSNotFound, 0);
+    while ((separatorRange = [data rangeOfData:separator options:(NSDataSearchOptions)0 range:NSMakeRange(0, [data length])]).location == NSNotFound) {
+        if (![self readFromConnection:connection intoData:data]) {
+            return;
+        }
+    }
+
+    NSString *head = [[NSString alloc] initWithData:[data subdataWithRange:NSMakeRange(0, separatorRange.location)] encoding:NSUTF8StringEncoding];
+    NSArray *lines = [head componentsSeparatedByString:@"\r\n"];
+    NSArray *requestLine = [[lines firstObject] componentsSeparatedByString:@" "];
+    if ([requestLine count] < 2) {
+        return;
+    }
+
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:requestLine[1] relativeToURL:[NSURL URLWithString:@"http://127.0.0.1"]]];
+    request.HTTPMethod = requestLine[0];
+    for (NSString *line in [lines subarrayWithRange:NSMakeRange(1, [lines count] - 1)]) {
+        NSRange colonRange = [line rangeOfString:@":"];
+        if (colonRange.location != NSNotFound) {
+            NSString *field = [line substringToIndex:colonRange.location];
+            NSString *value = [[line substringFromIndex:NSMaxRange(colonRange)] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+            [request setValue:value forHTTPHeaderField:field];
+        }
+    }
+
+    NSMutableData *body = [[data subdataWithRange:NSMakeRange(NSMaxRange(separatorRange), [data length] - NSMaxRange(separatorRange))] mutableCopy];
+    if ([[[request valueForHTTPHeaderField:@"Transfer-Encoding"] lowercaseString] isEqualToString:@"chunked"]) {
+        NSMutableData *decodedBody = [NSMutableData data];
+        NSUInteger offset = 0;
+        while (YES) {
+            NSRange lineRange = [body rangeOfData:[@"\r\n" dataUsingEncoding:NSASCIIStringEncoding] options:(NSDataSearchOptions)0 range:NSMakeRange(offset, [body length] - offset)];
+            if (lineRange.location == NSNotFound) {
+                if (![self readFromConnection:connection intoData:body]) {
+                    return;
+                }
+                continue;
+            }
+
+            NSString *sizeLine = [[NSString alloc] initWithData:[body subdataWithRange:NSMakeRange(offset, lineRange.location - offset)] encoding:NSASCIIStringEncoding];
+            unsigned long long chunkSize = strtoull([sizeLine UTF8String], NULL, 16);
+            while ([body length] < NSMaxRange(lineRange) + chunkSize + 2) {
+                if (![self readFromConnection:connection intoData:body]) {
+                    return;
+                }
+            }
+
+            if (chunkSize == 0) {
+                break;
+            }
+
+            [decodedBody appendData:[body subdataWithRange:NSMakeRange(NSMaxRange(lineRange), (NSUInteger)chunkSize)]];
+            offset = NSMaxRange(lineRange) + (NSUInteger)chunkSize + 2;
+        }
+        body = decodedBody;
+    } else {
+        NSUInteger contentLength = (NSUInteger)[[request valueForHTTPHeaderField:@"Content-Length"] integerValue];
+        while ([body length] < contentLength) {
+            if (![self readFromConnection:connection intoData:body]) {
+                return;
+            }
+        }
+    }
+    request.HTTPBody = body;
+
+    NSInteger statusCode = 200;
+    NSDictionary *headers = nil;
+    NSData *responseBody = handler(request, &statusCode, &headers) ?: [NSData data];
+
+    NSMutableString *responseHead = [NSMutableString stringWithFormat:@"HTTP/1.1 %ld Status\r\n", (long)statusCode];
+    [headers enumerateKeysAndObjectsUsingBlock:^(NSString *field, NSString *value, __unused BOOL *stop) {
+        [responseHead appendFormat:@"%@: %@\r\n", field, value];
+    }];
+    [responseHead appendFormat:@"Content-Length: %lu\r\nConnection: close\r\n\r\n", (unsigned long)[responseBody length]];
+
+    NSMutableData *response = [[responseHead dataUsingEncoding:NSUTF8StringEncoding] mutableCopy];
+    [response appendData:responseBody];
+    NSUInteger offset = 0;
+    while (offset < [response length]) {
+        ssize_t numberOfBytesWritten = send(connection, (const uint8_t *)[response bytes] + offset, [response length] - offset, 0);
+        if (numberOfBytesWritten <= 0) {
+            return;
+        }
+        offset += (NSUInteger)numberOfBytesWritten;
+    }
+}
+
+@end
+
+#pragma mark -
+
 @implementation AFTestCase
 
 - (void)setUp {
@@ -64,3 +242,34 @@
 }
 
 @end
+
+#pragma mark -
+
+NSDictionary * AFJSONWideDocument(void) {
+    NSMutableDictionary *document = [NSMutableDictionary dictionary];
+    for (NSUInteger idx = 0; idx < 10000; idx++) {
+        document[[NSString stringWithFormat:@"key%lu", (unsigned long)idx]] = @{@"id": @(idx), @"score": @(idx * 0.5), @"active": @(idx % 2 == 0), @"name": @"name"};
+    }
+
+    return document;
+}
+
+NSArray * AFJSONDeepDocument(void) {
+    NSArray *document = @[];
+    for (NSUInteger idx = 0; idx < 500; idx++) {
+        document = @[@{@"depth": @(idx), @"children": document}];
+    }
+
+    return document;
+}
+
+NSDictionary * AFJSONStringHeavyDocument(void) {
+    NSMutableArray *strings = [NSMutableArray array];
+    for (NSUInteger idx = 0; idx < 2000; idx++) {
+        [strings addObject:[NSString stringWithFormat:@"Lorem ipsum dolor sit amet, \"consectetur\" adipiscing elit / %lu \u00e9\u00e8\u4e2d\u6587\n", (unsigned long)idx]];
+        [strings addObject:[@"" stringByPaddingToLength:256 withString:@"abcdefghijklmnopqrstuvwxyz" startingAtIndex:idx % 26]];
+    }
+
+    return @{@"strings": strings};
+}
+
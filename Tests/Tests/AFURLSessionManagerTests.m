@@ -20,6 +20,8 @@
 // THE SOFTWARE.
 
 #import <objc/runtime.h>
+#import <CommonCrypto/CommonDigest.h>
+#import <zlib.h>
 
 #import "AFTestCase.h"
 
@@ -31,6 +33,69 @@
 #define NSFoundationVersionNumber_With_Fixed_28588583_bug DBL_MAX
 #endif
 
+static NSData * AFGzipCompressedData(NSData *data) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY);
+
+    NSMutableData *compressedData = [NSMutableData dataWithLength:deflateBound(&stream, (uLong)[data length])];
+    stream.next_in = (Bytef *)[data bytes];
+    stream.avail_in = (uInt)[data length];
+    stream.next_out = [compressedData mutableBytes];
+    stream.avail_out = (uInt)[compressedData length];
+    deflate(&stream, Z_FINISH);
+    [compressedData setLength:stream.total_out];
+    deflateEnd(&stream);
+
+    return compressedData;
+}
+
+// Brotli compressed JSON, repeating {"message":"Hello, brotli!"} twenty times.
+static const uint8_t AFBrotliCompressedBytes[] = {
+    0x1b, 0x2f, 0x02, 0xf8, 0x1d, 0x09, 0xd9, 0x99, 0xcc, 0x6d, 0x34, 0x51, 0xdd, 0x30, 0xbe, 0x16,
+    0x09, 0xa1, 0xdb, 0xdb, 0x3a, 0x62, 0x72, 0x7d, 0x32, 0x8d, 0xed, 0x2d, 0x2b, 0xd9, 0x84, 0xb7,
+    0xd4, 0x60, 0x85, 0x99, 0x9c, 0x60, 0xa8, 0xde, 0xd9, 0x5e, 0x72,
+};
+
+static NSData * AFBrotliUncompressedData(void) {
+    return [[@"" stringByPaddingToLength:28 * 20 withString:@"{\"message\":\"Hello, brotli!\"}" startingAtIndex:0] dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+// A stream parser that keeps every chunk it is given.
+@interface AFRetainingStreamParser : NSObject <AFURLResponseStreamParsing>
+@property (readonly, nonatomic, strong) NSMutableArray <NSData *> *chunks;
+@end
+
+@implementation AFRetainingStreamParser
+
+- (instancetype)init {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _chunks = [NSMutableArray array];
+
+    return self;
+}
+
+- (BOOL)parseData:(NSData *)data
+            error:(__unused NSError * __autoreleasing *)error
+{
+    [self.chunks addObject:data];
+    return YES;
+}
+
+- (id)finishParsingWithError:(__unused NSError * __autoreleasing *)error {
+    NSMutableData *data = [NSMutableData data];
+    for (NSData *chunk in self.chunks) {
+        [data appendData:chunk];
+    }
+
+    return data;
+}
+
+@end
 
 @interface AFURLSessionManagerTests : AFTestCase
 @property (readwrite, nonatomic, strong) AFURLSessionManager *localManager;
@@ -431,6 +496,1358 @@
     }
 }
 
+#pragma mark - Bandwidth Limiting
+
+- (void)testThatBandwidthLimiterAllowsBurstOfOneSecond {
+    AFNetworkBandwidthLimiter *limiter = [[AFNetworkBandwidthLimiter alloc] init];
+    [limiter setBytesPerSecond:1000 forDirection:AFNetworkBandwidthDirectionUpload];
+
+    XCTAssertEqual([limiter consumeBytes:1000 forDirection:AFNetworkBandwidthDirectionUpload networkServiceType:NSURLNetworkServiceTypeDefault], 0);
+    XCTAssertEqualWithAccuracy([limiter consumeBytes:500 forDirection:AFNetworkBandwidthDirectionUpload networkServiceType:NSURLNetworkServiceTypeDefault], 0.5, 0.1);
+}
+
+- (void)testThatBandwidthLimiterDoesNotLimitOtherDirection {
+    AFNetworkBandwidthLimiter *limiter = [[AFNetworkBandwidthLimiter alloc] init];
+    [limiter setBytesPerSecond:1000 forDirection:AFNetworkBandwidthDirectionUpload];
+
+    XCTAssertEqual([limiter consumeBytes:10000 forDirection:AFNetworkBandwidthDirectionDownload networkServiceType:NSURLNetworkServiceTypeDefault], 0);
+}
+
+- (void)testThatBandwidthLimiterLimitsOnlyTheConfiguredNetworkServiceType {
+    AFNetworkBandwidthLimiter *limiter = [[AFNetworkBandwidthLimiter alloc] init];
+    [limiter setBytesPerSecond:1000 forDirection:AFNetworkBandwidthDirectionUpload networkServiceType:NSURLNetworkServiceTypeBackground];
+
+    XCTAssertEqual([limiter consumeBytes:10000 forDirection:AFNetworkBandwidthDirectionUpload networkServiceType:NSURLNetworkServiceTypeDefault], 0);
+    XCTAssertGreaterThan([limiter consumeBytes:10000 forDirection:AFNetworkBandwidthDirectionUpload networkServiceType:NSURLNetworkServiceTypeBackground], 0);
+}
+
+- (void)testThatBandwidthLimiterUsesTheLongerDelayOfTotalAndNetworkServiceTypeLimits {
+    AFNetworkBandwidthLimiter *limiter = [[AFNetworkBandwidthLimiter alloc] init];
+    [limiter setBytesPerSecond:4000 forDirection:AFNetworkBandwidthDirectionDownload];
+    [limiter setBytesPerSecond:1000 forDirection:AFNetworkBandwidthDirectionDownload networkServiceType:NSURLNetworkServiceTypeBackground];
+
+    XCTAssertEqualWithAccuracy([limiter consumeBytes:3000 forDirection:AFNetworkBandwidthDirectionDownload networkServiceType:NSURLNetworkServiceTypeBackground], 2.0, 0.1);
+}
+
+- (void)testThatBandwidthLimitCanBeRemoved {
+    AFNetworkBandwidthLimiter *limiter = [[AFNetworkBandwidthLimiter alloc] init];
+    [limiter setBytesPerSecond:1000 forDirection:AFNetworkBandwidthDirectionUpload];
+    [limiter setBytesPerSecond:0 forDirection:AFNetworkBandwidthDirectionUpload];
+
+    XCTAssertEqual([limiter bytesPerSecondForDirection:AFNetworkBandwidthDirectionUpload], 0);
+    XCTAssertEqual([limiter consumeBytes:10000 forDirection:AFNetworkBandwidthDirectionUpload networkServiceType:NSURLNetworkServiceTypeDefault], 0);
+}
+
+- (void)testThatUploadTaskCompletesWhenPacedByBandwidthLimiter {
+    NSData *payload = [NSMutableData dataWithLength:20000];
+    NSURL *url = [NSURL URLWithString:[[self.baseURL absoluteString] stringByAppendingString:@"/post"]];
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:url cachePolicy:NSURLRequestReloadIgnoringCacheData timeoutInterval:60.0];
+    [request setHTTPMethod:@"POST"];
+
+    self.localManager.bandwidthLimiter = [[AFNetworkBandwidthLimiter alloc] init];
+    [self.localManager.bandwidthLimiter setBytesPerSecond:10000 forDirection:AFNetworkBandwidthDirectionUpload];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Upload should complete"];
+    NSDate *startDate = [NSDate date];
+    NSURLSessionTask *task = [self.localManager uploadTaskWithRequest:request fromData:payload progress:nil completionHandler:^(NSURLResponse * _Nonnull response, id  _Nullable responseObject, NSError * _Nullable error) {
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    //一秒的突发之后，剩余的一万字节需要大约一秒
+    XCTAssertGreaterThan([[NSDate date] timeIntervalSinceDate:startDate], 0.5);
+}
+
+- (NSMutableURLRequest *)bandwidthLimitedPostRequest {
+    NSURL *url = [NSURL URLWithString:[[self.baseURL absoluteString] stringByAppendingString:@"/post"]];
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:url cachePolicy:NSURLRequestReloadIgnoringCacheData timeoutInterval:60.0];
+    [request setHTTPMethod:@"POST"];
+
+    self.localManager.bandwidthLimiter = [[AFNetworkBandwidthLimiter alloc] init];
+    [self.localManager.bandwidthLimiter setBytesPerSecond:10000 forDirection:AFNetworkBandwidthDirectionUpload];
+
+    return request;
+}
+
+- (void)testThatBandwidthLimiterPausesDoNotPostSuspendAndResumeNotifications {
+    NSMutableURLRequest *request = [self bandwidthLimitedPostRequest];
+
+    __block NSUInteger numberOfSuspendNotifications = 0;
+    __block NSUInteger numberOfResumeNotifications = 0;
+    id suspendObserver = [[NSNotificationCenter defaultCenter] addObserverForName:AFNetworkingTaskDidSuspendNotification object:nil queue:nil usingBlock:^(__unused NSNotification *notification) {
+        numberOfSuspendNotifications++;
+    }];
+    id resumeObserver = [[NSNotificationCenter defaultCenter] addObserverForName:AFNetworkingTaskDidResumeNotification object:nil queue:nil usingBlock:^(__unused NSNotification *notification) {
+        numberOfResumeNotifications++;
+    }];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Upload should complete"];
+    NSURLSessionTask *task = [self.localManager uploadTaskWithRequest:request fromData:[NSMutableData dataWithLength:30000] progress:nil completionHandler:^(__unused NSURLResponse *response, __unused id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [[NSNotificationCenter defaultCenter] removeObserver:suspendObserver];
+    [[NSNotificationCenter defaultCenter] removeObserver:resumeObserver];
+
+    // Only the application's own resume is reported.
+    XCTAssertEqual(numberOfSuspendNotifications, 0);
+    XCTAssertEqual(numberOfResumeNotifications, 1);
+}
+
+- (void)testThatBandwidthLimiterDoesNotResumeTaskSuspendedByApplication {
+    NSMutableURLRequest *request = [self bandwidthLimitedPostRequest];
+
+    __block NSURLSessionTask *task = nil;
+    __block BOOL suspendedTask = NO;
+    NSOperationQueue *operationQueue = self.localManager.operationQueue;
+    [self.localManager setTaskDidSendBodyDataBlock:^(__unused NSURLSession *session, __unused NSURLSessionTask *sendingTask, __unused int64_t bytesSent, int64_t totalBytesSent, __unused int64_t totalBytesExpectedToSend) {
+        // Once the one second burst is used up, the limiter pauses the task, and the application suspends it while it is paused.
+        if (!suspendedTask && totalBytesSent > 10000) {
+            suspendedTask = YES;
+            [operationQueue addOperationWithBlock:^{
+                [task suspend];
+            }];
+        }
+    }];
+
+    // The completion expectation is created only after the pause, so that waiting for the pause does not wait for the upload.
+    __block XCTestExpectation *expectation = nil;
+    task = [self.localManager uploadTaskWithRequest:request fromData:[NSMutableData dataWithLength:30000] progress:nil completionHandler:^(__unused NSURLResponse *response, __unused id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }];
+    [task resume];
+
+    XCTestExpectation *pauseExpectation = [self expectationWithDescription:@"The limiter pause should end"];
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(3 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [pauseExpectation fulfill];
+    });
+    [self waitForExpectationsWithCommonTimeout];
+
+    XCTAssertTrue(suspendedTask);
+    XCTAssertEqual(task.state, NSURLSessionTaskStateSuspended);
+
+    expectation = [self expectationWithDescription:@"Upload should complete"];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+}
+
+#pragma mark - Chunked Uploads
+
+- (NSURL *)temporaryFileURLWithLength:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    uint8_t *bytes = [data mutableBytes];
+    for (NSUInteger idx = 0; idx < length; idx++) {
+        bytes[idx] = (uint8_t)(idx * 31 + idx / 7);
+    }
+
+    NSURL *fileURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]]];
+    [data writeToURL:fileURL atomically:NO];
+
+    return fileURL;
+}
+
+//tus concatenation扩展的简单实现，partialUploads保存每个部分上传的内容，shouldFail返回YES时返回指定的状态码
+- (AFLoopbackHTTPServer *)tusServerWithPartialUploads:(NSMutableDictionary *)partialUploads
+                                        finalUploads:(NSMutableArray *)finalUploads
+                                    failureStatusCode:(NSInteger (^)(NSUInteger partialUploadIndex))failureStatusCode
+{
+    __block NSUInteger numberOfPartialUploadRequests = 0;
+    return [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(NSURLRequest *request, NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        NSString *concat = [request valueForHTTPHeaderField:@"Upload-Concat"];
+        @synchronized (partialUploads) {
+            if ([concat isEqualToString:@"partial"]) {
+                NSUInteger partialUploadIndex = numberOfPartialUploadRequests++;
+                NSInteger failure = failureStatusCode ? failureStatusCode(partialUploadIndex) : 0;
+                if (failure) {
+                    *statusCode = failure;
+                    return nil;
+                }
+
+                NSMutableData *digest = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+                CC_SHA256([request.HTTPBody bytes], (CC_LONG)[request.HTTPBody length], [digest mutableBytes]);
+                NSString *checksum = [@"sha256 " stringByAppendingString:[digest base64EncodedStringWithOptions:0]];
+                if (![[request valueForHTTPHeaderField:@"Upload-Checksum"] isEqualToString:checksum] || [[request valueForHTTPHeaderField:@"Upload-Length"] integerValue] != (NSInteger)[request.HTTPBody length]) {
+                    *statusCode = 460;
+                    return nil;
+                }
+
+                NSString *location = [NSString stringWithFormat:@"/files/%lu", (unsigned long)partialUploadIndex];
+                partialUploads[location] = request.HTTPBody;
+                *statusCode = 201;
+                *headers = @{@"Location": location, @"Tus-Resumable": @"1.0.0"};
+                return nil;
+            } else if ([concat hasPrefix:@"final;"]) {
+                NSMutableData *finalUpload = [NSMutableData data];
+                for (NSString *partialUploadURLString in [[concat substringFromIndex:[@"final;" length]] componentsSeparatedByString:@" "]) {
+                    NSData *partialUpload = partialUploads[[[NSURL URLWithString:partialUploadURLString] path]];
+                    if (!partialUpload) {
+                        *statusCode = 400;
+                        return nil;
+                    }
+                    [finalUpload appendData:partialUpload];
+                }
+                [finalUploads addObject:finalUpload];
+                *statusCode = 201;
+                *headers = @{@"Content-Type": @"application/json"};
+                return [[NSString stringWithFormat:@"{\"length\":%lu}", (unsigned long)[finalUpload length]] dataUsingEncoding:NSUTF8StringEncoding];
+            }
+        }
+
+        *statusCode = 400;
+        return nil;
+    }];
+}
+
+- (void)testThatChunkedUploadRetriesFailedChunksAndCommitsFileToLoopbackServer {
+    NSURL *fileURL = [self temporaryFileURLWithLength:100000];
+    NSURL *manifestURL = [fileURL URLByAppendingPathExtension:@"manifest"];
+    NSMutableDictionary *partialUploads = [NSMutableDictionary dictionary];
+    NSMutableArray *finalUploads = [NSMutableArray array];
+    AFLoopbackHTTPServer *server = [self tusServerWithPartialUploads:partialUploads finalUploads:finalUploads failureStatusCode:^NSInteger(NSUInteger partialUploadIndex) {
+        return partialUploadIndex == 2 || partialUploadIndex == 5 ? 503 : 0;
+    }];
+
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"files"]];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Chunked upload should complete"];
+    AFChunkedUpload *chunkedUpload = [self.localManager chunkedUploadWithRequest:request fromFile:fileURL chunkSize:16384 manifestURL:manifestURL protocol:[[AFTusChunkedUploadProtocol alloc] init] progress:nil completionHandler:^(NSURLResponse *response, id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(responseObject[@"length"], @100000);
+        [expectation fulfill];
+    }];
+    [chunkedUpload resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    XCTAssertEqual([chunkedUpload.manifest.chunks count], 7);
+    XCTAssertEqual(chunkedUpload.progress.completedUnitCount, 100000);
+    XCTAssertEqualObjects([finalUploads firstObject], [NSData dataWithContentsOfURL:fileURL]);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[manifestURL path]]);
+
+    [server stop];
+    [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+}
+
+- (void)testThatChunkedUploadResumesFromPersistedManifest {
+    NSURL *fileURL = [self temporaryFileURLWithLength:100000];
+    NSURL *manifestURL = [fileURL URLByAppendingPathExtension:@"manifest"];
+    NSMutableDictionary *partialUploads = [NSMutableDictionary dictionary];
+    NSMutableArray *finalUploads = [NSMutableArray array];
+    __block BOOL failsThirdChunk = YES;
+    __block NSUInteger numberOfPartialUploadRequests = 0;
+    AFLoopbackHTTPServer *server = [self tusServerWithPartialUploads:partialUploads finalUploads:finalUploads failureStatusCode:^NSInteger(NSUInteger partialUploadIndex) {
+        numberOfPartialUploadRequests++;
+        return failsThirdChunk && partialUploadIndex == 2 ? 400 : 0;
+    }];
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"files"]];
+    [request setValue:@"Bearer expired-token" forHTTPHeaderField:@"Authorization"];
+
+    XCTestExpectation *failureExpectation = [self expectationWithDescription:@"Chunked upload should fail"];
+    AFChunkedUpload *chunkedUpload = [self.localManager chunkedUploadWithRequest:request fromFile:fileURL chunkSize:16384 manifestURL:manifestURL protocol:[[AFTusChunkedUploadProtocol alloc] init] progress:nil completionHandler:^(NSURLResponse *response, id responseObject, NSError *error) {
+        XCTAssertEqual([(NSHTTPURLResponse *)response statusCode], 400);
+        XCTAssertNotNil(error);
+        [failureExpectation fulfill];
+    }];
+    chunkedUpload.maximumNumberOfConcurrentChunks = 1;
+    [chunkedUpload resume];
+    [self waitForExpectationsWithCommonTimeout];
+    XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:[manifestURL path]]);
+
+    // Header fields are not written to the manifest.
+    NSData *manifestData = [NSData dataWithContentsOfURL:manifestURL];
+    XCTAssertEqual([manifestData rangeOfData:[@"expired-token" dataUsingEncoding:NSUTF8StringEncoding] options:0 range:NSMakeRange(0, [manifestData length])].location, NSNotFound);
+
+    //模拟重新启动，新的分块上传从清单继续，只上传剩余的块
+    failsThirdChunk = NO;
+    numberOfPartialUploadRequests = 0;
+    [request setValue:@"Bearer current-token" forHTTPHeaderField:@"Authorization"];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Chunked upload should complete"];
+    AFChunkedUpload *resumedUpload = [self.localManager chunkedUploadWithRequest:request fromFile:fileURL chunkSize:16384 manifestURL:manifestURL protocol:[[AFTusChunkedUploadProtocol alloc] init] progress:nil completionHandler:^(NSURLResponse *response, id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }];
+    XCTAssertEqual(resumedUpload.progress.completedUnitCount, 2 * 16384);
+    // The resumed upload builds its requests from the current request.
+    XCTAssertEqualObjects([resumedUpload.manifest.request valueForHTTPHeaderField:@"Authorization"], @"Bearer current-token");
+    [resumedUpload resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    XCTAssertEqual(numberOfPartialUploadRequests, 5);
+    XCTAssertEqualObjects([finalUploads firstObject], [NSData dataWithContentsOfURL:fileURL]);
+
+    [server stop];
+    [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+}
+
+- (void)testThatChunkedUploadCommitsPartsWithS3Protocol {
+    NSURL *fileURL = [self temporaryFileURLWithLength:50000];
+    NSURL *manifestURL = [fileURL URLByAppendingPathExtension:@"manifest"];
+    NSMutableDictionary *parts = [NSMutableDictionary dictionary];
+    __block NSData *object = nil;
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(NSURLRequest *request, NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        NSString *query = request.URL.query;
+        @synchronized (parts) {
+            if ([request.HTTPMethod isEqualToString:@"POST"] && [query isEqualToString:@"uploads"]) {
+                return [@"<InitiateMultipartUploadResult><UploadId>upload+1</UploadId></InitiateMultipartUploadResult>" dataUsingEncoding:NSUTF8StringEncoding];
+            } else if ([request.HTTPMethod isEqualToString:@"PUT"] && [query hasSuffix:@"&uploadId=upload%2B1"]) {
+                NSString *partNumber = [[query componentsSeparatedByString:@"&"][0] substringFromIndex:[@"partNumber=" length]];
+                parts[partNumber] = request.HTTPBody;
+                *headers = @{@"ETag": [NSString stringWithFormat:@"\"etag-%@\"", partNumber]};
+                return nil;
+            } else if ([request.HTTPMethod isEqualToString:@"POST"] && [query isEqualToString:@"uploadId=upload%2B1"]) {
+                NSString *body = [[NSString alloc] initWithData:request.HTTPBody encoding:NSUTF8StringEncoding];
+                NSMutableData *data = [NSMutableData data];
+                for (NSUInteger partNumber = 1; partNumber <= [parts count]; partNumber++) {
+                    if ([body rangeOfString:[NSString stringWithFormat:@"<PartNumber>%lu</PartNumber><ETag>\"etag-%lu\"</ETag>", (unsigned long)partNumber, (unsigned long)partNumber]].location == NSNotFound) {
+                        *statusCode = 400;
+                        return nil;
+                    }
+                    [data appendData:parts[[NSString stringWithFormat:@"%lu", (unsigned long)partNumber]]];
+                }
+                object = data;
+                *headers = @{@"Content-Type": @"application/json"};
+                return [@"{}" dataUsingEncoding:NSUTF8StringEncoding];
+            }
+        }
+
+        *statusCode = 400;
+        return nil;
+    }];
+
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"bucket/object"]];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Chunked upload should complete"];
+    AFChunkedUpload *chunkedUpload = [self.localManager chunkedUploadWithRequest:request fromFile:fileURL chunkSize:16384 manifestURL:manifestURL protocol:[[AFS3ChunkedUploadProtocol alloc] init] progress:nil completionHandler:^(NSURLResponse *response, id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }];
+    [chunkedUpload resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    XCTAssertEqualObjects(chunkedUpload.manifest.uploadIdentifier, @"upload+1");
+    XCTAssertEqualObjects(object, [NSData dataWithContentsOfURL:fileURL]);
+
+    [server stop];
+    [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+}
+
+#pragma mark - Upload Deduplication
+
+//保存收到的内容摘要的简单服务器，HEAD /blobs/<摘要>查询，POST /upload上传
+- (AFLoopbackHTTPServer *)deduplicatingServerWithDigests:(NSMutableSet *)digests
+                                            bodyLengths:(NSMutableArray *)bodyLengths
+                                                lookups:(NSMutableArray *)lookups
+{
+    return [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(NSURLRequest *request, NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        @synchronized (digests) {
+            if ([request.HTTPMethod isEqualToString:@"HEAD"]) {
+                [lookups addObject:[request.URL lastPathComponent]];
+                *statusCode = [digests containsObject:[request.URL lastPathComponent]] ? 200 : 404;
+                return nil;
+            }
+
+            [bodyLengths addObject:@([request.HTTPBody length])];
+            if ([request.HTTPBody length] > 0) {
+                unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+                CC_SHA256([request.HTTPBody bytes], (CC_LONG)[request.HTTPBody length], digest);
+                NSMutableString *hexDigest = [NSMutableString string];
+                for (NSUInteger idx = 0; idx < CC_SHA256_DIGEST_LENGTH; idx++) {
+                    [hexDigest appendFormat:@"%02x", digest[idx]];
+                }
+                if (![hexDigest isEqualToString:[request valueForHTTPHeaderField:@"X-Content-SHA256"]]) {
+                    *statusCode = 400;
+                    return nil;
+                }
+                [digests addObject:hexDigest];
+            } else if (![digests containsObject:[request valueForHTTPHeaderField:@"X-Content-SHA256"]]) {
+                *statusCode = 409;
+                return nil;
+            }
+
+            *headers = @{@"Content-Type": @"application/json"};
+            return [@"{}" dataUsingEncoding:NSUTF8StringEncoding];
+        }
+    }];
+}
+
+- (void)uploadFileAtURL:(NSURL *)fileURL
+              toServer:(AFLoopbackHTTPServer *)server
+      withDeduplicator:(AFUploadDeduplicator *)deduplicator
+{
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"upload"]];
+    request.HTTPMethod = @"POST";
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Upload should complete"];
+    [self.localManager uploadWithRequest:request fromFile:fileURL deduplicator:deduplicator progress:nil completionHandler:^(NSURLResponse *response, id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+}
+
+- (void)testThatDeduplicatedUploadSendsReferenceForContentKnownToServer {
+    NSURL *fileURL = [self temporaryFileURLWithLength:200000];
+    NSMutableSet *digests = [NSMutableSet set];
+    NSMutableArray *bodyLengths = [NSMutableArray array];
+    NSMutableArray *lookups = [NSMutableArray array];
+    AFLoopbackHTTPServer *server = [self deduplicatingServerWithDigests:digests bodyLengths:bodyLengths lookups:lookups];
+    AFUploadDeduplicator *deduplicator = [[AFUploadDeduplicator alloc] initWithLookupURL:[server.baseURL URLByAppendingPathComponent:@"blobs"]];
+
+    //第一次完整上传，第二次命中本地缓存，不需要查询
+    [self uploadFileAtURL:fileURL toServer:server withDeduplicator:deduplicator];
+    [self uploadFileAtURL:fileURL toServer:server withDeduplicator:deduplicator];
+    XCTAssertEqual([lookups count], 1);
+
+    //没有缓存时由服务器确认
+    AFUploadDeduplicator *otherDeduplicator = [[AFUploadDeduplicator alloc] initWithLookupURL:deduplicator.lookupURL];
+    [self uploadFileAtURL:fileURL toServer:server withDeduplicator:otherDeduplicator];
+    XCTAssertEqual([lookups count], 2);
+
+    XCTAssertEqualObjects(bodyLengths, (@[@200000, @0, @0]));
+    XCTAssertEqual(deduplicator.numberOfBytesSaved, 200000);
+    XCTAssertEqual(otherDeduplicator.numberOfBytesSaved, 200000);
+    XCTAssertTrue([otherDeduplicator hasCachedDigest:[AFUploadDeduplicator SHA256DigestOfFileAtURL:fileURL error:nil]]);
+
+    [server stop];
+    [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+}
+
+- (void)testThatDeduplicatedUploadCancelledDuringLookupFailsWithoutCreatingTask {
+    NSURL *fileURL = [self temporaryFileURLWithLength:200000];
+    NSMutableSet *digests = [NSMutableSet set];
+    NSMutableArray *bodyLengths = [NSMutableArray array];
+    NSMutableArray *lookups = [NSMutableArray array];
+    AFLoopbackHTTPServer *server = [self deduplicatingServerWithDigests:digests bodyLengths:bodyLengths lookups:lookups];
+    AFUploadDeduplicator *deduplicator = [[AFUploadDeduplicator alloc] initWithLookupURL:[server.baseURL URLByAppendingPathComponent:@"blobs"]];
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"upload"]];
+    request.HTTPMethod = @"POST";
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Upload should fail"];
+    AFDeduplicatedUpload *upload = [self.localManager uploadWithRequest:request fromFile:fileURL deduplicator:deduplicator progress:nil completionHandler:^(NSURLResponse *response, id responseObject, NSError *error) {
+        XCTAssertEqual(error.code, NSURLErrorCancelled);
+        [expectation fulfill];
+    }];
+    [upload cancel];
+    [self waitForExpectationsWithCommonTimeout];
+
+    // Wait for the lookup to finish, then check that no task was created after cancelling.
+    [self expectationForPredicate:[NSPredicate predicateWithBlock:^BOOL(__unused id evaluatedObject, __unused NSDictionary *bindings) {
+        @synchronized (digests) {
+            return [lookups count] == 1;
+        }
+    }] evaluatedWithObject:self handler:nil];
+    [self waitForExpectationsWithCommonTimeout];
+    [NSThread sleepForTimeInterval:0.5];
+    XCTAssertNil(upload.task);
+    @synchronized (digests) {
+        XCTAssertEqual([bodyLengths count], 0);
+    }
+
+    [server stop];
+    [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+}
+
+- (void)testThatDeduplicatorEvictsLeastRecentlyUsedDigests {
+    AFUploadDeduplicator *deduplicator = [[AFUploadDeduplicator alloc] initWithLookupURL:[NSURL URLWithString:@"http://example.com/blobs"]];
+    deduplicator.maximumNumberOfCachedDigests = 2;
+    [deduplicator cacheDigest:@"a"];
+    [deduplicator cacheDigest:@"b"];
+    XCTAssertTrue([deduplicator hasCachedDigest:@"a"]);
+    [deduplicator cacheDigest:@"c"];
+
+    XCTAssertTrue([deduplicator hasCachedDigest:@"a"]);
+    XCTAssertFalse([deduplicator hasCachedDigest:@"b"]);
+    XCTAssertTrue([deduplicator hasCachedDigest:@"c"]);
+}
+
+- (void)testPerformanceOfRepeatedUploadOfKnownContentWithDeduplication {
+    NSURL *fileURL = [self temporaryFileURLWithLength:8 * 1024 * 1024];
+    NSMutableSet *digests = [NSMutableSet set];
+    NSMutableArray *bodyLengths = [NSMutableArray array];
+    NSMutableArray *lookups = [NSMutableArray array];
+    AFLoopbackHTTPServer *server = [self deduplicatingServerWithDigests:digests bodyLengths:bodyLengths lookups:lookups];
+    AFUploadDeduplicator *deduplicator = [[AFUploadDeduplicator alloc] initWithLookupURL:[server.baseURL URLByAppendingPathComponent:@"blobs"]];
+    [self uploadFileAtURL:fileURL toServer:server withDeduplicator:deduplicator];
+
+    [self measureBlock:^{
+        [self uploadFileAtURL:fileURL toServer:server withDeduplicator:deduplicator];
+    }];
+
+    XCTAssertEqual(deduplicator.numberOfBytesSaved, (int64_t)([bodyLengths count] - 1) * 8 * 1024 * 1024);
+
+    [server stop];
+    [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+}
+
+#pragma mark - Producer Uploads
+
+- (void)testThatProducerUploadIsSentWithChunkedEncodingThroughBoundedBuffer {
+    __block NSData *receivedBody = nil;
+    __block NSString *transferEncoding = nil;
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(NSURLRequest *request, __unused NSInteger *statusCode, __unused NSDictionary *__autoreleasing *headers) {
+        @synchronized (self) {
+            receivedBody = request.HTTPBody;
+            transferEncoding = [request valueForHTTPHeaderField:@"Transfer-Encoding"];
+        }
+        return nil;
+    }];
+
+    AFUploadStreamProducer *producer = [[AFUploadStreamProducer alloc] initWithCapacity:16 * 1024];
+    NSMutableData *expectedBody = [NSMutableData dataWithLength:2 * 1024 * 1024];
+    for (NSUInteger idx = 0; idx < [expectedBody length]; idx++) {
+        ((uint8_t *)[expectedBody mutableBytes])[idx] = (uint8_t)(idx % 251);
+    }
+
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"logs"]];
+    request.HTTPMethod = @"POST";
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Upload should complete"];
+    NSURLSessionUploadTask *task = [self.localManager uploadTaskWithStreamedRequest:request producer:producer progress:nil completionHandler:^(__unused NSURLResponse *response, __unused id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }];
+    [task resume];
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        for (NSUInteger offset = 0; offset < [expectedBody length]; offset += 4096) {
+            XCTAssertTrue([producer writeData:[expectedBody subdataWithRange:NSMakeRange(offset, 4096)] timeout:-1 error:nil]);
+            // Pause so the upload task drains the buffer, which must not be taken for the end of the body.
+            if (offset % (256 * 1024) == 0) {
+                [NSThread sleepForTimeInterval:0.05];
+            }
+        }
+        [producer finishWriting];
+    });
+    [self waitForExpectationsWithCommonTimeout];
+
+    @synchronized (self) {
+        XCTAssertEqualObjects(receivedBody, expectedBody);
+        XCTAssertEqualObjects([transferEncoding lowercaseString], @"chunked");
+    }
+    XCTAssertEqual(producer.numberOfBytesWritten, (unsigned long long)[expectedBody length]);
+
+    [server stop];
+}
+
+- (void)testThatBlockingProducerWriteTimesOutWhenBufferIsFull {
+    AFUploadStreamProducer *producer = [[AFUploadStreamProducer alloc] initWithCapacity:4];
+    NSError *error = nil;
+
+    XCTAssertFalse([producer writeData:[@"12345678" dataUsingEncoding:NSUTF8StringEncoding] timeout:0.1 error:&error]);
+    XCTAssertEqualObjects(error.domain, NSURLErrorDomain);
+    XCTAssertEqual(error.code, NSURLErrorTimedOut);
+    XCTAssertEqual(producer.numberOfBytesWritten, 4);
+}
+
+- (void)testThatClosingProducerFailsBlockedWrites {
+    AFUploadStreamProducer *producer = [[AFUploadStreamProducer alloc] initWithCapacity:4];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Write should fail"];
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        NSError *error = nil;
+        XCTAssertFalse([producer writeData:[@"12345678" dataUsingEncoding:NSUTF8StringEncoding] timeout:-1 error:&error]);
+        XCTAssertEqual(error.code, NSURLErrorCancelled);
+        [expectation fulfill];
+    });
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.1 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [producer closeWithError:nil];
+    });
+    [self waitForExpectationsWithCommonTimeout];
+}
+
+- (void)testThatProducerSpaceAvailableHandlerIsCalledWhenBufferIsRead {
+    AFUploadStreamProducer *producer = [[AFUploadStreamProducer alloc] initWithCapacity:8];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Space should become available"];
+    static const uint8_t bytes[16] = {0};
+    [producer setSpaceAvailableHandler:^(AFUploadStreamProducer *availableProducer) {
+        XCTAssertEqual([availableProducer writeBytes:bytes maxLength:sizeof(bytes)], 5);
+        XCTAssertEqual(availableProducer.numberOfBytesWritten, 13);
+        [expectation fulfill];
+    } queue:nil];
+
+    XCTAssertEqual([producer writeBytes:bytes maxLength:sizeof(bytes)], 8);
+    XCTAssertEqual([producer writeBytes:bytes maxLength:sizeof(bytes)], 0);
+
+    uint8_t buffer[5];
+    [producer.inputStream open];
+    XCTAssertEqual([producer.inputStream read:buffer maxLength:sizeof(buffer)], 5);
+    [self waitForExpectationsWithCommonTimeout];
+
+    [producer finishWriting];
+    XCTAssertEqual([producer writeBytes:bytes maxLength:sizeof(bytes)], -1);
+}
+
+- (void)testThatProducerStreamWaitsForBytesUntilWritingIsFinished {
+    AFUploadStreamProducer *producer = [[AFUploadStreamProducer alloc] initWithCapacity:8];
+    NSInputStream *inputStream = producer.inputStream;
+    [inputStream open];
+
+    uint8_t buffer[8];
+    static const uint8_t bytes[4] = {1, 2, 3, 4};
+    XCTAssertFalse([inputStream hasBytesAvailable]);
+    XCTAssertEqual([producer writeBytes:bytes maxLength:sizeof(bytes)], 4);
+    XCTAssertEqual([inputStream read:buffer maxLength:sizeof(buffer)], 4);
+
+    // Reading an empty buffer waits for the next write instead of returning 0 for the end.
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.1 * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        XCTAssertEqual([producer writeBytes:bytes maxLength:sizeof(bytes)], 4);
+        [producer finishWriting];
+    });
+    XCTAssertEqual([inputStream read:buffer maxLength:sizeof(buffer)], 4);
+    XCTAssertEqual([inputStream read:buffer maxLength:sizeof(buffer)], 0);
+    XCTAssertEqual([inputStream streamStatus], NSStreamStatusAtEnd);
+}
+
+- (void)testThatClosingProducerFailsUploadWithCloseError {
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, __unused NSDictionary *__autoreleasing *headers) {
+        return nil;
+    }];
+    AFUploadStreamProducer *producer = [[AFUploadStreamProducer alloc] initWithCapacity:1024];
+    NSError *closeError = [NSError errorWithDomain:@"AFTestErrorDomain" code:1 userInfo:nil];
+
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"logs"]];
+    request.HTTPMethod = @"POST";
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Upload should fail"];
+    NSURLSessionUploadTask *task = [self.localManager uploadTaskWithStreamedRequest:request producer:producer progress:nil completionHandler:^(__unused NSURLResponse *response, __unused id responseObject, NSError *error) {
+        XCTAssertEqualObjects(error, closeError);
+        [expectation fulfill];
+    }];
+    [task resume];
+
+    XCTAssertEqual([producer writeBytes:(const uint8_t *)"partial" maxLength:7], 7);
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.1 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [producer closeWithError:closeError];
+    });
+    [self waitForExpectationsWithCommonTimeout];
+
+    [server stop];
+}
+
+#pragma mark - JSON Stream Parsing
+
+- (void)testThatJSONStreamParserDataTaskHandsOutArrayElements {
+    NSMutableString *body = [NSMutableString stringWithString:@"{\"cursor\": \"next\", \"posts\": ["];
+    for (NSUInteger idx = 0; idx < 10000; idx++) {
+        [body appendFormat:@"%@{\"id\": %lu, \"title\": \"post\"}", idx > 0 ? @"," : @"", (unsigned long)idx];
+    }
+    [body appendString:@"]}"];
+
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"application/json"};
+        return [body dataUsingEncoding:NSUTF8StringEncoding];
+    }];
+
+    __block NSUInteger numberOfPosts = 0;
+    __block BOOL postsAreInOrder = YES;
+    AFJSONStreamParser *parser = [[AFJSONStreamParser alloc] init];
+    [parser setElementHandler:^(id element, __unused BOOL *stop) {
+        postsAreInOrder = postsAreInOrder && [element[@"id"] unsignedIntegerValue] == numberOfPosts;
+        numberOfPosts++;
+    } forArrayAtKeyPath:@"posts"];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Request should complete"];
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"timeline"]];
+    NSURLSessionDataTask *task = [self.localManager dataTaskWithRequest:request JSONStreamParser:parser downloadProgress:nil completionHandler:^(__unused NSURLResponse *response, id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(responseObject, (@{@"cursor": @"next", @"posts": @[]}));
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    XCTAssertEqual(numberOfPosts, 10000);
+    XCTAssertTrue(postsAreInOrder);
+
+    [server stop];
+}
+
+- (void)testThatJSONStreamParserDataTaskDoesNotParseInvalidResponse {
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"text/html"};
+        return [@"<html></html>" dataUsingEncoding:NSUTF8StringEncoding];
+    }];
+
+    AFJSONStreamParser *parser = [[AFJSONStreamParser alloc] init];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Request should fail"];
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"timeline"]];
+    NSURLSessionDataTask *task = [self.localManager dataTaskWithRequest:request JSONStreamParser:parser downloadProgress:nil completionHandler:^(__unused NSURLResponse *response, id responseObject, NSError *error) {
+        XCTAssertNil(responseObject);
+        XCTAssertEqualObjects(error.domain, AFURLResponseSerializationErrorDomain);
+        XCTAssertEqual(error.code, NSURLErrorCannotDecodeContentData);
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [server stop];
+}
+
+- (void)testThatJSONLinesStreamParserDataTaskDeliversRecordsInBatches {
+    NSMutableString *body = [NSMutableString string];
+    for (NSUInteger idx = 0; idx < 5000; idx++) {
+        [body appendFormat:@"{\"event\": %lu}\n", (unsigned long)idx];
+    }
+
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"application/x-ndjson"};
+        return [body dataUsingEncoding:NSUTF8StringEncoding];
+    }];
+
+    NSMutableArray *events = [NSMutableArray array];
+    dispatch_queue_t queue = dispatch_queue_create("com.alamofire.tests.events", DISPATCH_QUEUE_SERIAL);
+    AFJSONLinesStreamParser *parser = [[AFJSONLinesStreamParser alloc] initWithRecordsHandler:^(NSArray *records) {
+        [NSThread sleepForTimeInterval:0.001];
+        [events addObjectsFromArray:records];
+    } queue:queue];
+    parser.maximumNumberOfPendingBatches = 1;
+
+    __block NSUInteger numberOfSuspendNotifications = 0;
+    __block NSUInteger numberOfResumeNotifications = 0;
+    id suspendObserver = [[NSNotificationCenter defaultCenter] addObserverForName:AFNetworkingTaskDidSuspendNotification object:nil queue:nil usingBlock:^(__unused NSNotification *notification) {
+        numberOfSuspendNotifications++;
+    }];
+    id resumeObserver = [[NSNotificationCenter defaultCenter] addObserverForName:AFNetworkingTaskDidResumeNotification object:nil queue:nil usingBlock:^(__unused NSNotification *notification) {
+        numberOfResumeNotifications++;
+    }];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Request should complete"];
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"events"]];
+    NSURLSessionDataTask *task = [self.localManager dataTaskWithRequest:request streamParser:parser downloadProgress:nil completionHandler:^(__unused NSURLResponse *response, id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(responseObject, @5000);
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    // Every batch is dispatched to the queue before parsing finishes.
+    dispatch_sync(queue, ^{
+        XCTAssertEqual([events count], 5000);
+        XCTAssertEqualObjects([events lastObject], @{@"event": @4999});
+    });
+
+    [[NSNotificationCenter defaultCenter] removeObserver:suspendObserver];
+    [[NSNotificationCenter defaultCenter] removeObserver:resumeObserver];
+
+    // Backpressure suspends the task internally, so only the application's own resume is reported.
+    XCTAssertEqual(numberOfSuspendNotifications, 0);
+    XCTAssertEqual(numberOfResumeNotifications, 1);
+
+    [server stop];
+}
+
+#pragma mark - Response Decoding
+
+- (void)testThatGzipResponseDecoderDecodesBodyFedOneByteAtATime {
+    NSData *data = [[@"" stringByPaddingToLength:10000 withString:@"{\"id\": 1}," startingAtIndex:0] dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *compressedData = AFGzipCompressedData(data);
+
+    AFGzipResponseDecoder *decoder = [AFGzipResponseDecoder decoder];
+    NSMutableData *decodedData = [NSMutableData data];
+    NSMutableData *buffer = [NSMutableData data];
+    for (NSUInteger idx = 0; idx < [compressedData length]; idx++) {
+        [buffer setLength:0];
+        XCTAssertTrue([decoder decodeData:[compressedData subdataWithRange:NSMakeRange(idx, 1)] toBuffer:buffer error:nil]);
+        [decodedData appendData:buffer];
+    }
+    [buffer setLength:0];
+    XCTAssertTrue([decoder finishDecodingToBuffer:buffer error:nil]);
+    [decodedData appendData:buffer];
+
+    XCTAssertEqualObjects(decodedData, data);
+}
+
+- (void)testThatGzipResponseDecoderDecodesConcatenatedMembers {
+    NSMutableData *compressedData = [AFGzipCompressedData([@"first," dataUsingEncoding:NSUTF8StringEncoding]) mutableCopy];
+    [compressedData appendData:AFGzipCompressedData([@"second" dataUsingEncoding:NSUTF8StringEncoding])];
+
+    AFGzipResponseDecoder *decoder = [AFGzipResponseDecoder decoder];
+    NSMutableData *buffer = [NSMutableData data];
+    XCTAssertTrue([decoder decodeData:compressedData toBuffer:buffer error:nil]);
+    XCTAssertTrue([decoder finishDecodingToBuffer:buffer error:nil]);
+
+    XCTAssertEqualObjects(buffer, [@"first,second" dataUsingEncoding:NSUTF8StringEncoding]);
+}
+
+- (void)testThatGzipResponseDecoderFailsForTruncatedBody {
+    NSData *compressedData = AFGzipCompressedData([@"truncated body" dataUsingEncoding:NSUTF8StringEncoding]);
+
+    AFGzipResponseDecoder *decoder = [AFGzipResponseDecoder decoder];
+    NSMutableData *buffer = [NSMutableData data];
+    XCTAssertTrue([decoder decodeData:[compressedData subdataWithRange:NSMakeRange(0, [compressedData length] - 4)] toBuffer:buffer error:nil]);
+
+    NSError *error = nil;
+    XCTAssertFalse([decoder finishDecodingToBuffer:buffer error:&error]);
+    XCTAssertEqualObjects(error.domain, AFURLResponseSerializationErrorDomain);
+    XCTAssertEqual(error.code, NSURLErrorCannotDecodeRawData);
+}
+
+- (void)testThatGzipResponseDecoderFailsForUncompressedBody {
+    AFGzipResponseDecoder *decoder = [AFGzipResponseDecoder decoder];
+    NSError *error = nil;
+    XCTAssertFalse([decoder decodeData:[@"{\"id\": 1}" dataUsingEncoding:NSUTF8StringEncoding] toBuffer:[NSMutableData data] error:&error]);
+    XCTAssertEqual(error.code, NSURLErrorCannotDecodeRawData);
+}
+
+- (void)testThatDataTaskDecodesGzipBodyAndReportsByteCounts {
+    NSMutableArray *posts = [NSMutableArray array];
+    for (NSUInteger idx = 0; idx < 5000; idx++) {
+        [posts addObject:@{@"id": @(idx), @"title": @"post"}];
+    }
+    NSData *data = [NSJSONSerialization dataWithJSONObject:posts options:(NSJSONWritingOptions)0 error:nil];
+    NSData *compressedData = AFGzipCompressedData(data);
+
+    // The body is gzip-wrapped without a Content-Encoding header, so the session leaves it as it is.
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"application/json"};
+        return compressedData;
+    }];
+
+    [self.localManager setDataTaskResponseDecoderBlock:^id <AFURLResponseDecoding> (__unused NSURLSession *session, __unused NSURLSessionDataTask *dataTask, NSURLResponse *response) {
+        return [[response.URL pathExtension] isEqualToString:@"gz"] ? [AFGzipResponseDecoder decoder] : nil;
+    }];
+
+    [self expectationForNotification:AFNetworkingTaskDidCompleteNotification object:nil handler:^BOOL(NSNotification *notification) {
+        XCTAssertEqualObjects(notification.userInfo[AFNetworkingTaskDidCompleteCountOfEncodedBytesKey], @([compressedData length]));
+        XCTAssertEqualObjects(notification.userInfo[AFNetworkingTaskDidCompleteCountOfDecodedBytesKey], @([data length]));
+        return YES;
+    }];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Request should complete"];
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"posts.json.gz"]];
+    NSURLSessionDataTask *task = [self.localManager dataTaskWithRequest:request uploadProgress:nil downloadProgress:nil completionHandler:^(__unused NSURLResponse *response, id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(responseObject, posts);
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [server stop];
+}
+
+- (void)testThatDataTaskFailsWithDecodingErrorForCorruptGzipBody {
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"application/json"};
+        return [@"[1, 2, 3]" dataUsingEncoding:NSUTF8StringEncoding];
+    }];
+
+    [self.localManager setDataTaskResponseDecoderBlock:^id <AFURLResponseDecoding> (__unused NSURLSession *session, __unused NSURLSessionDataTask *dataTask, __unused NSURLResponse *response) {
+        return [AFGzipResponseDecoder decoder];
+    }];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Request should fail"];
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"numbers.json.gz"]];
+    NSURLSessionDataTask *task = [self.localManager dataTaskWithRequest:request uploadProgress:nil downloadProgress:nil completionHandler:^(__unused NSURLResponse *response, id responseObject, NSError *error) {
+        XCTAssertNil(responseObject);
+        XCTAssertEqualObjects(error.domain, AFURLResponseSerializationErrorDomain);
+        XCTAssertEqual(error.code, NSURLErrorCannotDecodeRawData);
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [server stop];
+}
+
+- (void)testThatBrotliResponseDecoderDecodesBodyFedOneByteAtATime {
+    AFBrotliResponseDecoder *decoder = [AFBrotliResponseDecoder decoder];
+    if (!decoder) {
+        // Brotli decoding needs iOS 15, macOS 12, tvOS 15 or watchOS 8.
+        return;
+    }
+
+    NSMutableData *decodedData = [NSMutableData data];
+    NSMutableData *buffer = [NSMutableData data];
+    for (NSUInteger idx = 0; idx < sizeof(AFBrotliCompressedBytes); idx++) {
+        [buffer setLength:0];
+        XCTAssertTrue([decoder decodeData:[NSData dataWithBytes:&AFBrotliCompressedBytes[idx] length:1] toBuffer:buffer error:nil]);
+        [decodedData appendData:buffer];
+    }
+    [buffer setLength:0];
+    XCTAssertTrue([decoder finishDecodingToBuffer:buffer error:nil]);
+    [decodedData appendData:buffer];
+
+    XCTAssertEqualObjects(decodedData, AFBrotliUncompressedData());
+}
+
+- (void)testThatBrotliResponseDecoderFailsForTruncatedBody {
+    AFBrotliResponseDecoder *decoder = [AFBrotliResponseDecoder decoder];
+    if (!decoder) {
+        return;
+    }
+
+    NSMutableData *buffer = [NSMutableData data];
+    [decoder decodeData:[NSData dataWithBytes:AFBrotliCompressedBytes length:sizeof(AFBrotliCompressedBytes) - 4] toBuffer:buffer error:nil];
+
+    NSError *error = nil;
+    XCTAssertFalse([decoder finishDecodingToBuffer:buffer error:&error]);
+    XCTAssertEqualObjects(error.domain, AFURLResponseSerializationErrorDomain);
+    XCTAssertEqual(error.code, NSURLErrorCannotDecodeRawData);
+}
+
+- (void)testThatBrotliResponseDecoderFailsForDataAfterEndOfStream {
+    AFBrotliResponseDecoder *decoder = [AFBrotliResponseDecoder decoder];
+    if (!decoder) {
+        return;
+    }
+
+    NSMutableData *compressedData = [NSMutableData dataWithBytes:AFBrotliCompressedBytes length:sizeof(AFBrotliCompressedBytes)];
+    [compressedData appendData:[@"trailing" dataUsingEncoding:NSUTF8StringEncoding]];
+
+    NSError *error = nil;
+    XCTAssertFalse([decoder decodeData:compressedData toBuffer:[NSMutableData data] error:&error]);
+    XCTAssertEqual(error.code, NSURLErrorCannotDecodeRawData);
+}
+
+- (void)testThatDecodedChunksGivenToStreamParserAreNotReused {
+    NSData *firstData = [[@"" stringByPaddingToLength:100000 withString:@"first," startingAtIndex:0] dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *secondData = [[@"" stringByPaddingToLength:100000 withString:@"second," startingAtIndex:0] dataUsingEncoding:NSUTF8StringEncoding];
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"application/json"};
+        return AFGzipCompressedData([[request.URL lastPathComponent] isEqualToString:@"first.gz"] ? firstData : secondData);
+    }];
+
+    // Only the decoder block is set, so the session manager has to ask for the response itself.
+    [self.localManager setDataTaskResponseDecoderBlock:^id <AFURLResponseDecoding> (__unused NSURLSession *session, __unused NSURLSessionDataTask *dataTask, __unused NSURLResponse *response) {
+        return [AFGzipResponseDecoder decoder];
+    }];
+
+    AFRetainingStreamParser *firstParser = [[AFRetainingStreamParser alloc] init];
+    for (AFRetainingStreamParser *parser in @[firstParser, [[AFRetainingStreamParser alloc] init]]) {
+        XCTestExpectation *expectation = [self expectationWithDescription:@"Request should complete"];
+        NSString *path = parser == firstParser ? @"first.gz" : @"second.gz";
+        NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:path]];
+        NSURLSessionDataTask *task = [self.localManager dataTaskWithRequest:request streamParser:parser downloadProgress:nil completionHandler:^(__unused NSURLResponse *response, id responseObject, NSError *error) {
+            XCTAssertNil(error);
+            XCTAssertEqualObjects(responseObject, parser == firstParser ? firstData : secondData);
+            [expectation fulfill];
+        }];
+        [task resume];
+        [self waitForExpectationsWithCommonTimeout];
+    }
+
+    // The decoding buffers have been reused by the second task, but the chunks of the first parser are unchanged.
+    XCTAssertEqualObjects([firstParser finishParsingWithError:nil], firstData);
+
+    [server stop];
+}
+
+#pragma mark - Downloaded File Serialization
+
+- (NSURLSessionDownloadTask *)serializingDownloadTaskFromServer:(AFLoopbackHTTPServer *)server
+                                                        fileURL:(NSURL *)fileURL
+                                                     completion:(void (^)(NSURL *filePath, id responseObject, NSError *error))completion
+{
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"export"]];
+
+    return [self.localManager downloadTaskWithRequest:request progress:nil destination:^NSURL *(__unused NSURL *targetPath, __unused NSURLResponse *response) {
+        return fileURL;
+    } serializingCompletionHandler:^(__unused NSURLResponse *response, NSURL *filePath, id responseObject, NSError *error) {
+        completion(filePath, responseObject, error);
+        [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+    }];
+}
+
+- (NSURL *)temporaryDownloadFileURL {
+    return [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+}
+
+- (void)testThatDownloadedFileIsReturnedByDefault {
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"application/json"};
+        return [@"[1, 2, 3]" dataUsingEncoding:NSUTF8StringEncoding];
+    }];
+
+    self.localManager.responseSerializer = [AFJSONResponseSerializer serializer];
+
+    NSURL *fileURL = [self temporaryDownloadFileURL];
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"export"]];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download should complete"];
+    NSURLSessionDownloadTask *task = [self.localManager downloadTaskWithRequest:request progress:nil destination:^NSURL *(__unused NSURL *targetPath, __unused NSURLResponse *response) {
+        return fileURL;
+    } completionHandler:^(__unused NSURLResponse *response, NSURL *filePath, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(filePath, fileURL);
+        [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [server stop];
+}
+
+- (void)testThatDownloadedFileIsSerializedFromMappedData {
+    NSMutableArray *records = [NSMutableArray array];
+    for (NSUInteger idx = 0; idx < 10000; idx++) {
+        [records addObject:@{@"id": @(idx)}];
+    }
+    NSData *data = [NSJSONSerialization dataWithJSONObject:records options:(NSJSONWritingOptions)0 error:nil];
+
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"application/json"};
+        return data;
+    }];
+
+    [self expectationForNotification:AFNetworkingTaskDidCompleteNotification object:nil handler:^BOOL(NSNotification *notification) {
+        XCTAssertNotNil(notification.userInfo[AFNetworkingTaskDidCompleteAssetPathKey]);
+        return YES;
+    }];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download should complete"];
+    NSURL *fileURL = [self temporaryDownloadFileURL];
+    NSURLSessionDownloadTask *task = [self serializingDownloadTaskFromServer:server fileURL:fileURL completion:^(NSURL *filePath, id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(filePath, fileURL);
+        XCTAssertEqualObjects(responseObject, records);
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [server stop];
+}
+
+- (void)testThatDownloadWithoutDestinationIsSerializedFromTemporaryFile {
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"application/json"};
+        return [@"[1, 2, 3]" dataUsingEncoding:NSUTF8StringEncoding];
+    }];
+
+    self.localManager.responseSerializer = [AFJSONResponseSerializer serializer];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download should complete"];
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"export"]];
+    NSURLSessionDownloadTask *task = [self.localManager downloadTaskWithRequest:request progress:nil destination:nil serializingCompletionHandler:^(__unused NSURLResponse *response, NSURL *filePath, id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertNil(filePath);
+        XCTAssertEqualObjects(responseObject, (@[@1, @2, @3]));
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [server stop];
+}
+
+- (void)testThatDownloadedFileIsSerializedFromStreamBySerializersThatSupportStreams {
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"application/xml"};
+        return [@"<export><record id=\"1\"/></export>" dataUsingEncoding:NSUTF8StringEncoding];
+    }];
+
+    self.localManager.responseSerializer = [AFXMLParserResponseSerializer serializer];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download should complete"];
+    NSURLSessionDownloadTask *task = [self serializingDownloadTaskFromServer:server fileURL:[self temporaryDownloadFileURL] completion:^(__unused NSURL *filePath, id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertTrue([responseObject isKindOfClass:[NSXMLParser class]]);
+        XCTAssertTrue([(NSXMLParser *)responseObject parse]);
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [server stop];
+}
+
+- (void)testThatDownloadedFileWithUnacceptableContentTypeFailsStreamSerialization {
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"text/html"};
+        return [@"<html></html>" dataUsingEncoding:NSUTF8StringEncoding];
+    }];
+
+    self.localManager.responseSerializer = [AFXMLParserResponseSerializer serializer];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download should fail"];
+    NSURLSessionDownloadTask *task = [self serializingDownloadTaskFromServer:server fileURL:[self temporaryDownloadFileURL] completion:^(__unused NSURL *filePath, id responseObject, NSError *error) {
+        XCTAssertNil(responseObject);
+        XCTAssertEqualObjects(error.domain, AFURLResponseSerializationErrorDomain);
+        XCTAssertEqual(error.code, NSURLErrorCannotDecodeContentData);
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [server stop];
+}
+
+- (void)testThatDownloadedFileThatCannotBeMovedIsNotSerialized {
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"application/json"};
+        return [@"[1, 2, 3]" dataUsingEncoding:NSUTF8StringEncoding];
+    }];
+
+    // The destination directory does not exist, so the move fails.
+    NSURL *fileURL = [[self temporaryDownloadFileURL] URLByAppendingPathComponent:@"export.json"];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download should fail"];
+    NSURLSessionDownloadTask *task = [self serializingDownloadTaskFromServer:server fileURL:fileURL completion:^(NSURL *filePath, id responseObject, NSError *error) {
+        XCTAssertNil(filePath);
+        XCTAssertNil(responseObject);
+        XCTAssertEqualObjects(error.domain, NSCocoaErrorDomain);
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [server stop];
+}
+
+#pragma mark - Download Integrity
+
+- (NSData *)SHA256DigestOfData:(NSData *)data {
+    NSMutableData *digest = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256([data bytes], (CC_LONG)[data length], [digest mutableBytes]);
+    return digest;
+}
+
+- (AFLoopbackHTTPServer *)assetServerWithData:(NSData *)data {
+    return [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"application/octet-stream"};
+        return data;
+    }];
+}
+
+- (void)testThatVerifiedDownloadIsMovedToDestinationWhenDigestMatches {
+    NSData *data = [[@"" stringByPaddingToLength:100000 withString:@"asset" startingAtIndex:0] dataUsingEncoding:NSUTF8StringEncoding];
+    AFLoopbackHTTPServer *server = [self assetServerWithData:data];
+    NSURL *destinationURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download should complete"];
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"asset"]];
+    NSURLSessionDownloadTask *task = [self.localManager downloadTaskWithRequest:request expectedSHA256Digest:[self SHA256DigestOfData:data] progress:nil destination:^NSURL *(__unused NSURL *targetPath, __unused NSURLResponse *response) {
+        return destinationURL;
+    } completionHandler:^(__unused NSURLResponse *response, NSURL *filePath, NSData *SHA256Digest, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(filePath, destinationURL);
+        XCTAssertEqualObjects(SHA256Digest, [self SHA256DigestOfData:data]);
+        XCTAssertEqualObjects([NSData dataWithContentsOfURL:destinationURL], data);
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [[NSFileManager defaultManager] removeItemAtURL:destinationURL error:nil];
+    [server stop];
+}
+
+- (void)testThatVerifiedDownloadIsDeletedWhenDigestDoesNotMatch {
+    NSData *data = [@"tampered asset" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *expectedDigest = [self SHA256DigestOfData:[@"original asset" dataUsingEncoding:NSUTF8StringEncoding]];
+    AFLoopbackHTTPServer *server = [self assetServerWithData:data];
+    NSURL *destinationURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download should fail"];
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"asset"]];
+    NSURLSessionDownloadTask *task = [self.localManager downloadTaskWithRequest:request expectedSHA256Digest:expectedDigest progress:nil destination:^NSURL *(__unused NSURL *targetPath, __unused NSURLResponse *response) {
+        return destinationURL;
+    } completionHandler:^(__unused NSURLResponse *response, NSURL *filePath, NSData *SHA256Digest, NSError *error) {
+        XCTAssertNil(filePath);
+        XCTAssertEqualObjects(SHA256Digest, [self SHA256DigestOfData:data]);
+        XCTAssertEqualObjects(error.domain, AFURLSessionManagerErrorDomain);
+        XCTAssertEqual(error.code, AFURLSessionManagerErrorDownloadDigestMismatch);
+        XCTAssertEqualObjects(error.userInfo[AFURLSessionManagerExpectedSHA256DigestErrorKey], expectedDigest);
+        XCTAssertEqualObjects(error.userInfo[AFURLSessionManagerSHA256DigestErrorKey], SHA256Digest);
+        XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[destinationURL path]]);
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [server stop];
+}
+
+- (void)testThatVerifiedDownloadFailsWithFileManagerErrorWhenItCannotBeMoved {
+    // Larger than one digest block, so the file is hashed in several reads.
+    NSData *data = [[@"" stringByPaddingToLength:(3 * 1024 * 1024 + 1) withString:@"asset" startingAtIndex:0] dataUsingEncoding:NSUTF8StringEncoding];
+    AFLoopbackHTTPServer *server = [self assetServerWithData:data];
+    // The destination directory does not exist, so the move fails.
+    NSURL *destinationURL = [[[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[[NSUUID UUID] UUIDString]] URLByAppendingPathComponent:@"asset"];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download should fail"];
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"asset"]];
+    NSURLSessionDownloadTask *task = [self.localManager downloadTaskWithRequest:request expectedSHA256Digest:[self SHA256DigestOfData:data] progress:nil destination:^NSURL *(__unused NSURL *targetPath, __unused NSURLResponse *response) {
+        return destinationURL;
+    } completionHandler:^(__unused NSURLResponse *response, NSURL *filePath, NSData *SHA256Digest, NSError *error) {
+        XCTAssertNil(filePath);
+        XCTAssertEqualObjects(SHA256Digest, [self SHA256DigestOfData:data]);
+        XCTAssertEqualObjects(error.domain, NSCocoaErrorDomain);
+        XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[destinationURL path]]);
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [server stop];
+}
+
+- (void)testThatDownloadDigestIsComputedWithoutExpectedDigest {
+    NSData *data = [@"asset" dataUsingEncoding:NSUTF8StringEncoding];
+    AFLoopbackHTTPServer *server = [self assetServerWithData:data];
+    NSURL *destinationURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+
+    [self expectationForNotification:AFNetworkingTaskDidCompleteNotification object:nil handler:^BOOL(NSNotification *notification) {
+        XCTAssertEqualObjects(notification.userInfo[AFNetworkingTaskDidCompleteSHA256DigestKey], [self SHA256DigestOfData:data]);
+        XCTAssertEqualObjects(notification.userInfo[AFNetworkingTaskDidCompleteAssetPathKey], destinationURL);
+        return YES;
+    }];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download should complete"];
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"asset"]];
+    NSURLSessionDownloadTask *task = [self.localManager downloadTaskWithRequest:request expectedSHA256Digest:nil progress:nil destination:^NSURL *(__unused NSURL *targetPath, __unused NSURLResponse *response) {
+        return destinationURL;
+    } completionHandler:^(__unused NSURLResponse *response, NSURL *filePath, NSData *SHA256Digest, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(filePath, destinationURL);
+        XCTAssertEqualObjects(SHA256Digest, [self SHA256DigestOfData:data]);
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [[NSFileManager defaultManager] removeItemAtURL:destinationURL error:nil];
+    [server stop];
+}
+
+#pragma mark - Response Serialization Executor
+
+- (void)testThatSerializationExecutorRunsAtMostItsWidthAtOnce {
+    AFResponseSerializationExecutor *executor = [[AFResponseSerializationExecutor alloc] initWithMaximumConcurrentSerializations:2];
+    NSLock *lock = [[NSLock alloc] init];
+    __block NSUInteger numberOfRunningBlocks = 0;
+    __block NSUInteger maximumNumberOfRunningBlocks = 0;
+    dispatch_group_t group = dispatch_group_create();
+
+    for (NSUInteger idx = 0; idx < 20; idx++) {
+        dispatch_group_enter(group);
+        [executor addSerializationWithPriority:AFResponseSerializationPriorityDefault block:^{
+            [lock lock];
+            numberOfRunningBlocks++;
+            maximumNumberOfRunningBlocks = MAX(maximumNumberOfRunningBlocks, numberOfRunningBlocks);
+            [lock unlock];
+
+            [NSThread sleepForTimeInterval:0.01];
+
+            [lock lock];
+            numberOfRunningBlocks--;
+            [lock unlock];
+            dispatch_group_leave(group);
+        }];
+    }
+
+    XCTAssertEqual(dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(10 * NSEC_PER_SEC))), 0);
+    XCTAssertEqual(maximumNumberOfRunningBlocks, 2);
+}
+
+- (void)testThatSerializationExecutorRunsHigherPriorityLanesFirst {
+    AFResponseSerializationExecutor *executor = [[AFResponseSerializationExecutor alloc] initWithMaximumConcurrentSerializations:1];
+    dispatch_semaphore_t started = dispatch_semaphore_create(0);
+    dispatch_semaphore_t blocker = dispatch_semaphore_create(0);
+    [executor addSerializationWithPriority:AFResponseSerializationPriorityDefault block:^{
+        dispatch_semaphore_signal(started);
+        dispatch_semaphore_wait(blocker, DISPATCH_TIME_FOREVER);
+    }];
+    dispatch_semaphore_wait(started, DISPATCH_TIME_FOREVER);
+
+    NSMutableArray *order = [NSMutableArray array];
+    dispatch_group_t group = dispatch_group_create();
+    NSArray *priorities = @[@(AFResponseSerializationPriorityBackground), @(AFResponseSerializationPriorityDefault), @(AFResponseSerializationPriorityHigh), @(AFResponseSerializationPriorityBackground), @(AFResponseSerializationPriorityHigh)];
+    [priorities enumerateObjectsUsingBlock:^(NSNumber *priority, NSUInteger idx, __unused BOOL *stop) {
+        dispatch_group_enter(group);
+        [executor addSerializationWithPriority:(AFResponseSerializationPriority)[priority integerValue] block:^{
+            [order addObject:@(idx)];
+            dispatch_group_leave(group);
+        }];
+    }];
+
+    // Work waits in its lane while the only worker is busy.
+    XCTAssertEqual([executor numberOfRunningSerializations], 1);
+    XCTAssertEqual([executor numberOfPendingSerializationsWithPriority:AFResponseSerializationPriorityHigh], 2);
+    XCTAssertEqual([executor numberOfPendingSerializationsWithPriority:AFResponseSerializationPriorityDefault], 1);
+    XCTAssertEqual([executor numberOfPendingSerializationsWithPriority:AFResponseSerializationPriorityBackground], 2);
+
+    [NSThread sleepForTimeInterval:0.05];
+    dispatch_semaphore_signal(blocker);
+    XCTAssertEqual(dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(10 * NSEC_PER_SEC))), 0);
+
+    XCTAssertEqualObjects(order, (@[@2, @4, @1, @0, @3]));
+    XCTAssertGreaterThanOrEqual([executor maximumWaitTimeForPriority:AFResponseSerializationPriorityBackground], 0.05);
+    XCTAssertGreaterThan([executor averageWaitTimeForPriority:AFResponseSerializationPriorityHigh], 0);
+
+    [executor resetMetrics];
+    XCTAssertEqual([executor averageWaitTimeForPriority:AFResponseSerializationPriorityHigh], 0);
+    XCTAssertEqual([executor maximumWaitTimeForPriority:AFResponseSerializationPriorityBackground], 0);
+}
+
+- (void)testThatSerializationExecutorDoesNotCountWorkAsPendingAndRunning {
+    AFResponseSerializationExecutor *executor = [[AFResponseSerializationExecutor alloc] initWithMaximumConcurrentSerializations:1];
+    dispatch_semaphore_t started = dispatch_semaphore_create(0);
+    dispatch_semaphore_t blocker = dispatch_semaphore_create(0);
+    [executor addSerializationWithPriority:AFResponseSerializationPriorityDefault block:^{
+        dispatch_semaphore_signal(started);
+        dispatch_semaphore_wait(blocker, DISPATCH_TIME_FOREVER);
+    }];
+
+    // A worker that has been started but has not dequeued the block yet must not count it as running.
+    NSUInteger numberOfRunningSerializations = [executor numberOfRunningSerializations];
+    NSUInteger numberOfPendingSerializations = [executor numberOfPendingSerializationsWithPriority:AFResponseSerializationPriorityDefault];
+    XCTAssertLessThanOrEqual(numberOfRunningSerializations + numberOfPendingSerializations, 1);
+
+    dispatch_semaphore_wait(started, DISPATCH_TIME_FOREVER);
+    XCTAssertEqual([executor numberOfRunningSerializations], 1);
+    XCTAssertEqual([executor numberOfPendingSerializationsWithPriority:AFResponseSerializationPriorityDefault], 0);
+    dispatch_semaphore_signal(blocker);
+}
+
+- (void)testThatSerializationExecutorSerializesResponseWithAnyResponseSerializer {
+    AFResponseSerializationExecutor *executor = [[AFResponseSerializationExecutor alloc] init];
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:[NSURL URLWithString:@"http://example.com"] statusCode:200 HTTPVersion:@"1.1" headerFields:@{@"Content-Type": @"application/json"}];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Serialization should complete"];
+    [executor serializeResponse:response data:[@"{\"id\": 1}" dataUsingEncoding:NSUTF8StringEncoding] withResponseSerializer:[AFJSONResponseSerializer serializer] priority:AFResponseSerializationPriorityHigh completionHandler:^(id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(responseObject, @{@"id": @1});
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+}
+
+- (void)testThatDataTaskIsSerializedInTheLaneOfItsPriority {
+    AFLoopbackHTTPServer *server = [[AFLoopbackHTTPServer alloc] initWithHandler:^NSData *(__unused NSURLRequest *request, __unused NSInteger *statusCode, NSDictionary *__autoreleasing *headers) {
+        *headers = @{@"Content-Type": @"application/json"};
+        return [@"[1, 2, 3]" dataUsingEncoding:NSUTF8StringEncoding];
+    }];
+
+    AFResponseSerializationExecutor *executor = [[AFResponseSerializationExecutor alloc] initWithMaximumConcurrentSerializations:1];
+    self.localManager.serializationExecutor = executor;
+
+    // Keep the only worker busy so the response waits in its lane.
+    dispatch_semaphore_t blocker = dispatch_semaphore_create(0);
+    [executor addSerializationWithPriority:AFResponseSerializationPriorityBackground block:^{
+        dispatch_semaphore_wait(blocker, DISPATCH_TIME_FOREVER);
+    }];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Request should complete"];
+    NSURLRequest *request = [NSURLRequest requestWithURL:[server.baseURL URLByAppendingPathComponent:@"numbers"]];
+    NSURLSessionDataTask *task = [self.localManager dataTaskWithRequest:request uploadProgress:nil downloadProgress:nil completionHandler:^(__unused NSURLResponse *response, id responseObject, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(responseObject, (@[@1, @2, @3]));
+        [expectation fulfill];
+    }];
+    task.priority = NSURLSessionTaskPriorityHigh;
+    [task resume];
+
+    [self expectationForPredicate:[NSPredicate predicateWithBlock:^BOOL(AFResponseSerializationExecutor *evaluatedExecutor, __unused NSDictionary *bindings) {
+        return [evaluatedExecutor numberOfPendingSerializationsWithPriority:AFResponseSerializationPriorityHigh] == 1;
+    }] evaluatedWithObject:executor handler:^BOOL{
+        dispatch_semaphore_signal(blocker);
+        return YES;
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+
+    [server stop];
+}
+
 #pragma mark - private
 
 - (void)_testResumeNotificationForTask:(NSURLSessionTask *)task {
@@ -0,0 +1,223 @@
+// AFXMLSerializationTests.m
+// Copyright (c) 2011–2016 Alamofire Software Foundation ( http://alamofire.org/ )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import "AFTestCase.h"
+
+#import "AFURLResponseSerialization.h"
+
+static NSData * AFXMLFeedData(NSUInteger numberOfItems) {
+    NSMutableString *string = [NSMutableString stringWithString:@"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<rss version=\"2.0\">\n  <channel>\n    <title>Feed</title>\n"];
+    for (NSUInteger idx = 0; idx < numberOfItems; idx++) {
+        [string appendFormat:@"    <item id=\"%lu\">\n      <title>Item &amp; %lu</title>\n      <description><![CDATA[<p>Description of item %lu</p>]]></description>\n    </item>\n", (unsigned long)idx, (unsigned long)idx, (unsigned long)idx];
+    }
+    [string appendString:@"  </channel>\n</rss>\n"];
+
+    return [string dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+@interface AFXMLStreamParserTests : AFTestCase
+@end
+
+@implementation AFXMLStreamParserTests
+
+- (void)testThatStreamParserBuildsElementTree {
+    NSString *string = @"<?xml version='1.0'?>\n<!DOCTYPE note [<!ELEMENT note ANY>]>\n<!-- comment -->\n<note lang=\"en\" title='A &quot;quoted&quot; &#x4E2D;&#25991; title'>\n  <to>Tove</to>\n  <from/>\n  <body>Don't forget <em>me</em> this &lt;weekend&gt;!<![CDATA[ <raw> ]]></body>\n</note>\n";
+
+    AFXMLStreamParser *parser = [[AFXMLStreamParser alloc] init];
+    NSError *error = nil;
+    XCTAssertTrue([parser parseData:[string dataUsingEncoding:NSUTF8StringEncoding] error:&error]);
+    AFXMLElement *note = [parser finishParsingWithError:&error];
+    XCTAssertNil(error);
+
+    XCTAssertEqualObjects(note.name, @"note");
+    XCTAssertEqualObjects(note.attributes, (@{@"lang": @"en", @"title": @"A \"quoted\" \u4e2d\u6587 title"}));
+    XCTAssertEqualObjects([note.children valueForKey:@"name"], (@[@"to", @"from", @"body"]));
+    XCTAssertEqualObjects(note.text, @"");
+    XCTAssertEqualObjects([note childNamed:@"to"].text, @"Tove");
+    XCTAssertEqualObjects([note childNamed:@"from"].text, @"");
+    XCTAssertEqualObjects([note childNamed:@"body"].text, @"Don't forget  this <weekend>! <raw> ");
+    XCTAssertEqualObjects([[note childNamed:@"body"] childNamed:@"em"].text, @"me");
+    XCTAssertNil([note childNamed:@"missing"]);
+}
+
+- (void)testThatStreamParserMatchesWholeDocumentWhenFedOneByteAtATime {
+    const uint8_t byteOrderMark[] = {0xEF, 0xBB, 0xBF};
+    NSMutableData *data = [NSMutableData dataWithBytes:byteOrderMark length:sizeof(byteOrderMark)];
+    [data appendData:AFXMLFeedData(3)];
+    [data appendData:[@"<!-- trailing -->\n" dataUsingEncoding:NSUTF8StringEncoding]];
+
+    AFXMLStreamParser *parser = [[AFXMLStreamParser alloc] init];
+    for (NSUInteger idx = 0; idx < [data length]; idx++) {
+        XCTAssertTrue([parser parseData:[data subdataWithRange:NSMakeRange(idx, 1)] error:nil]);
+    }
+    AFXMLElement *rss = [parser finishParsingWithError:nil];
+
+    AFXMLElement *channel = [rss childNamed:@"channel"];
+    NSArray <AFXMLElement *> *items = [channel childrenNamed:@"item"];
+    XCTAssertEqualObjects(rss.attributes, @{@"version": @"2.0"});
+    XCTAssertEqualObjects([channel childNamed:@"title"].text, @"Feed");
+    XCTAssertEqual([items count], 3);
+    XCTAssertEqualObjects(items[2].attributes, @{@"id": @"2"});
+    XCTAssertEqualObjects([items[2] childNamed:@"title"].text, @"Item & 2");
+    XCTAssertEqualObjects([items[2] childNamed:@"description"].text, @"<p>Description of item 2</p>");
+}
+
+- (void)testThatStreamParserResumesSearchForCharacterDataEndAcrossChunks {
+    NSMutableString *text = [NSMutableString string];
+    for (NSUInteger idx = 0; idx < 20000; idx++) {
+        [text appendString:@"]] ]> - "];
+    }
+    NSString *string = [NSString stringWithFormat:@"<a><!-- %@ --><![CDATA[%@]]><?pi %@?></a>", text, text, text];
+    NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding];
+
+    AFXMLStreamParser *parser = [[AFXMLStreamParser alloc] init];
+    for (NSUInteger idx = 0; idx < [data length]; idx += 7) {
+        XCTAssertTrue([parser parseData:[data subdataWithRange:NSMakeRange(idx, MIN((NSUInteger)7, [data length] - idx))] error:nil]);
+    }
+    NSError *error = nil;
+    AFXMLElement *element = [parser finishParsingWithError:&error];
+
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(element.text, text);
+}
+
+- (void)testThatStreamParserHandsOutElementsAtPath {
+    AFXMLStreamParser *parser = [[AFXMLStreamParser alloc] init];
+    NSMutableArray *titles = [NSMutableArray array];
+    [parser setElementHandler:^(AFXMLElement *element, BOOL *stop) {
+        [titles addObject:[element childNamed:@"title"].text];
+    } forElementPath:@"rss/channel/item"];
+
+    NSData *data = AFXMLFeedData(100);
+    for (NSUInteger idx = 0; idx < [data length]; idx += 64) {
+        XCTAssertTrue([parser parseData:[data subdataWithRange:NSMakeRange(idx, MIN((NSUInteger)64, [data length] - idx))] error:nil]);
+    }
+    AFXMLElement *rss = [parser finishParsingWithError:nil];
+
+    XCTAssertEqual([titles count], 100);
+    XCTAssertEqualObjects(titles[99], @"Item & 99");
+    XCTAssertEqualObjects([[rss childNamed:@"channel"].children valueForKey:@"name"], @[@"title"]);
+    XCTAssertEqualObjects([rss childNamed:@"channel"].text, @"");
+}
+
+- (void)testThatStoppingElementHandlerCancelsParsing {
+    AFXMLStreamParser *parser = [[AFXMLStreamParser alloc] init];
+    __block NSUInteger numberOfItems = 0;
+    [parser setElementHandler:^(AFXMLElement *element, BOOL *stop) {
+        numberOfItems++;
+        *stop = YES;
+    } forElementPath:@"rss/channel/item"];
+
+    NSError *error = nil;
+    XCTAssertFalse([parser parseData:AFXMLFeedData(10) error:&error]);
+    XCTAssertEqual(numberOfItems, 1);
+    XCTAssertEqualObjects(error.domain, NSURLErrorDomain);
+    XCTAssertEqual(error.code, NSURLErrorCancelled);
+}
+
+- (void)testThatStreamParserReturnsErrorForInvalidXML {
+    for (NSString *string in @[@"<a>", @"<a></b>", @"<a><b></a></b>", @"<a/><b/>", @"text<a/>", @"<a>&unknown;</a>", @"<a>&#0;</a>", @"<a>& b</a>", @"<a b=\"1\" b=\"2\"/>", @"<a b=1/>", @"<a b=\"1\"c=\"2\"/>", @"<a b=\"<\"/>", @"< a/>", @"<a><!-- unterminated</a>", @"<!-- comment only -->", @"<!DOCTYPE a [<!ENTITY external SYSTEM \"file:///etc/hosts\">]><a>&external;</a>"]) {
+        AFXMLStreamParser *parser = [[AFXMLStreamParser alloc] init];
+        NSError *error = nil;
+        [parser parseData:[string dataUsingEncoding:NSUTF8StringEncoding] error:&error];
+        id responseObject = [parser finishParsingWithError:&error];
+        XCTAssertNil(responseObject, @"%@", string);
+        XCTAssertNotNil(error, @"%@", string);
+    }
+
+    const uint8_t invalidUTF8[] = {'<', 'a', '>', 0xc3, 0x28, '<', '/', 'a', '>'};
+    AFXMLStreamParser *parser = [[AFXMLStreamParser alloc] init];
+    NSError *error = nil;
+    XCTAssertFalse([parser parseData:[NSData dataWithBytes:invalidUTF8 length:sizeof(invalidUTF8)] error:&error]);
+    XCTAssertEqualObjects(error.domain, AFURLResponseSerializationErrorDomain);
+    XCTAssertEqual(error.code, NSURLErrorCannotParseResponse);
+}
+
+- (void)testThatStreamParserReplacesEntitiesDeclaredInDocument {
+    NSString *string = @"<!DOCTYPE feed [<!ENTITY name \"W&#246;rld\"><!ENTITY greeting \"Hello <em>&name;</em>\">]><feed xmlns=\"http://www.w3.org/2005/Atom\" xmlns:media=\"http://search.yahoo.com/mrss/\" title=\"&name;\"><title>&greeting;</title><media:content url=\"a.png\"/></feed>";
+
+    AFXMLStreamParser *parser = [[AFXMLStreamParser alloc] init];
+    NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding];
+    for (NSUInteger idx = 0; idx < [data length]; idx += 5) {
+        XCTAssertTrue([parser parseData:[data subdataWithRange:NSMakeRange(idx, MIN((NSUInteger)5, [data length] - idx))] error:nil]);
+    }
+    NSError *error = nil;
+    AFXMLElement *feed = [parser finishParsingWithError:&error];
+
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(feed.attributes, (@{@"xmlns": @"http://www.w3.org/2005/Atom", @"xmlns:media": @"http://search.yahoo.com/mrss/", @"title": @"W\u00f6rld"}));
+    XCTAssertEqualObjects([feed childNamed:@"title"].text, @"Hello ");
+    XCTAssertEqualObjects([[feed childNamed:@"title"] childNamed:@"em"].text, @"W\u00f6rld");
+    XCTAssertEqualObjects([feed childNamed:@"media:content"].attributes, @{@"url": @"a.png"});
+}
+
+- (void)testThatStreamParserDetectsEncodingOfDocument {
+    NSString *string = @"<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?><a>caf\u00e9</a>";
+    NSData *latin1Data = [string dataUsingEncoding:NSISOLatin1StringEncoding];
+    NSMutableData *UTF16Data = [NSMutableData dataWithBytes:"\xFF\xFE" length:2];
+    [UTF16Data appendData:[@"<a>caf\u00e9</a>" dataUsingEncoding:NSUTF16LittleEndianStringEncoding]];
+
+    for (NSData *data in @[latin1Data, UTF16Data]) {
+        AFXMLStreamParser *parser = [[AFXMLStreamParser alloc] init];
+        for (NSUInteger idx = 0; idx < [data length]; idx++) {
+            XCTAssertTrue([parser parseData:[data subdataWithRange:NSMakeRange(idx, 1)] error:nil]);
+        }
+        NSError *error = nil;
+        AFXMLElement *element = [parser finishParsingWithError:&error];
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(element.text, @"caf\u00e9");
+    }
+}
+
+- (void)testThatStreamParserReturnsNilObjectAndNilErrorForWhitespace {
+    AFXMLStreamParser *parser = [[AFXMLStreamParser alloc] init];
+    NSError *error = nil;
+    XCTAssertTrue([parser parseData:[@" \n\t" dataUsingEncoding:NSUTF8StringEncoding] error:&error]);
+    XCTAssertNil([parser finishParsingWithError:&error]);
+    XCTAssertNil(error);
+}
+
+- (void)testThatStreamParserValidatesXMLContentTypes {
+    AFXMLStreamParser *parser = [[AFXMLStreamParser alloc] init];
+    XCTAssertEqualObjects(parser.responseSerializer.acceptableContentTypes, ([NSSet setWithObjects:@"application/xml", @"text/xml", nil]));
+}
+
+#pragma mark -
+
+- (void)testPerformanceOfStreamingFeedElementByElement {
+    NSData *data = AFXMLFeedData(5000);
+    [self measureBlock:^{
+        AFXMLStreamParser *parser = [[AFXMLStreamParser alloc] init];
+        __block NSUInteger numberOfItems = 0;
+        [parser setElementHandler:^(AFXMLElement *element, BOOL *stop) {
+            numberOfItems++;
+        } forElementPath:@"rss/channel/item"];
+
+        for (NSUInteger idx = 0; idx < [data length]; idx += 16384) {
+            [parser parseData:[data subdataWithRange:NSMakeRange(idx, MIN((NSUInteger)16384, [data length] - idx))] error:nil];
+        }
+        [parser finishParsingWithError:nil];
+        XCTAssertEqual(numberOfItems, 5000);
+    }];
+}
+
+@end